@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstring>
 #include <iterator>
 #include <memory>
 #include <string>
@@ -74,6 +75,17 @@ bool opus::Encoder::ResetState() {
   return valid_;
 }
 
+bool opus::Encoder::CopyStateFrom(const Encoder& other) {
+  if (encoder_ == nullptr || other.encoder_ == nullptr ||
+      num_channels_ != other.num_channels_) {
+    return false;
+  }
+  std::memcpy(encoder_.get(), other.encoder_.get(),
+              opus_encoder_get_size(num_channels_));
+  valid_ = other.valid_;
+  return valid_;
+}
+
 bool opus::Encoder::SetBitrate(int bitrate) {
   valid_ = Ctl(OPUS_SET_BITRATE(bitrate)) == OPUS_OK;
   return valid_;
@@ -102,7 +114,7 @@ std::vector<std::vector<unsigned char>> opus::Encoder::Encode(
   auto data_length = pcm.size() * sample_size;
   if (data_length % frame_length != 0u) {
     // LOG(WARNING) << "PCM samples contain an incomplete frame. Ignoring the "
-                    "incomplete frame.";
+    //                 "incomplete frame.";
     data_length -= (data_length % frame_length);
   }
 
@@ -113,6 +125,11 @@ std::vector<std::vector<unsigned char>> opus::Encoder::Encode(
   return encoded;
 }
 
+int opus::Encoder::EncodeInto(const opus_int16* pcm, int frame_size,
+                              unsigned char* data, opus_int32 max_data_bytes) {
+  return opus_encode(encoder_.get(), pcm, frame_size, data, max_data_bytes);
+}
+
 std::vector<unsigned char> opus::Encoder::EncodeFrame(
     const std::vector<opus_int16>::const_iterator& frame_start,
     int frame_size) {
@@ -135,6 +152,11 @@ opus::Decoder::Decoder(opus_uint32 sample_rate, int num_channels)
   valid_ = error == OPUS_OK;
 }
 
+bool opus::Decoder::ResetState() {
+  valid_ = opus_decoder_ctl(decoder_.get(), OPUS_RESET_STATE) == OPUS_OK;
+  return valid_;
+}
+
 std::vector<opus_int16> opus::Decoder::Decode(
     const std::vector<std::vector<unsigned char>>& packets, int frame_size,
     bool decode_fec) {
@@ -173,3 +195,10 @@ std::vector<opus_int16> opus::Decoder::DecodeDummy(int frame_size) {
   decoded.resize(num_samples * num_channels_);
   return decoded;
 }
+
+int opus::Decoder::DecodeInto(const unsigned char* packet, opus_int32 size,
+                              int frame_size, bool decode_fec,
+                              opus_int16* pcm) {
+  return opus_decode(decoder_.get(), packet, packet != nullptr ? size : 0, pcm,
+                     frame_size, decode_fec);
+}
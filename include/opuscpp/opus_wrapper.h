@@ -50,6 +50,12 @@ class Encoder {
   // give the same result. Returns true on success.
   bool ResetState();
 
+  // Copies the whole state of another encoder with the same number of
+  // channels, settings included, so that this encoder continues the other's
+  // stream exactly. The state is position independent, so it is copied as
+  // bytes. Returns true on success.
+  bool CopyStateFrom(const Encoder& other);
+
   // Sets the desired bitrate. Rates from 500 to 512000 are meaningful as well
   // as the special values OPUS_AUTO and OPUS_BITRATE_MAX. If this method
   // is not called, the default value of OPUS_AUTO is used.
@@ -77,6 +83,12 @@ class Encoder {
   std::vector<std::vector<unsigned char>> Encode(
       const std::vector<opus_int16>& pcm, int frame_size);
 
+  // Encodes one frame into a caller-owned buffer of max_data_bytes, without
+  // allocating, so that a buffer reused for every frame never allocates.
+  // Returns the length of the packet, or a negative opus error code.
+  int EncodeInto(const opus_int16* pcm, int frame_size, unsigned char* data,
+                 opus_int32 max_data_bytes);
+
   int valid() const { return valid_; }
 
  private:
@@ -111,6 +123,11 @@ class Decoder {
 
   int valid() const { return valid_; }
 
+  // Resets internal state of decoder. This should be called before decoding
+  // a different stream, so that it does not continue from the previous one.
+  // Returns true on success.
+  bool ResetState();
+
   // Takes an encoded packet and decodes it. Returns the decoded audio
   // see documentation at:
   // https://mf4.xiph.org/jenkins/view/opus/job/opus/ws/doc/html/group__opus__decoder.html#ga7d1111f64c36027ddcb81799df9b3fc9
@@ -120,6 +137,13 @@ class Decoder {
   // Generates a dummy frame by passing nullptr to the underlying opus decode.
   std::vector<opus_int16> DecodeDummy(int frame_size);
 
+  // Decodes one packet into a caller-owned buffer of frame_size * channels
+  // samples, without allocating. A null packet generates a dummy frame, as
+  // DecodeDummy does. Returns the samples decoded per channel, or a negative
+  // opus error code.
+  int DecodeInto(const unsigned char* packet, opus_int32 size, int frame_size,
+                 bool decode_fec, opus_int16* pcm);
+
  private:
   int num_channels_{};
   bool valid_{};
@@ -0,0 +1,196 @@
+#include "active_speaker_detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // How quickly a speaker's smoothed loudness follows their audio level. Long enough to ignore clicks and single syllables.
+    constexpr std::chrono::milliseconds LoudnessTimeConstant(400);
+
+    // How often speakers are re-ranked. Ranking every packet would cost more and gain nothing at this smoothing.
+    constexpr std::chrono::milliseconds RankingInterval(100);
+
+    // How long a speaker is forwarded for before a louder speaker may displace them.
+    constexpr std::chrono::milliseconds MinimumActiveDuration(1500);
+
+    // How much louder, in dB, a speaker must be than an active speaker to displace them.
+    constexpr double DisplacementMargin = 6.0;
+}
+
+namespace Comms {
+    ActiveSpeakerDetector::ActiveSpeakerDetector(std::size_t lastN) :
+        _lastN(lastN) {
+    }
+
+    void ActiveSpeakerDetector::AddSpeaker(std::uint32_t speakerId, Clock::time_point now) {
+        if (FindSpeaker(speakerId) != nullptr) {
+            return;
+        }
+
+        Speaker speaker;
+        speaker._id = speakerId;
+        speaker._lastUpdate = now;
+
+        _speakers.push_back(speaker);
+
+        FillActivePlaces(now);
+    }
+
+    void ActiveSpeakerDetector::RemoveSpeaker(std::uint32_t speakerId, Clock::time_point now) {
+        auto speaker = std::find_if(_speakers.begin(), _speakers.end(), [speakerId](const Speaker& other) {
+            return other._id == speakerId;
+        });
+
+        if (speaker == _speakers.end()) {
+            return;
+        }
+
+        if (speaker->_isActive) {
+            _activeSpeakerCount--;
+        }
+
+        _speakers.erase(speaker);
+
+        FillActivePlaces(now);
+    }
+
+    std::vector<std::uint32_t> ActiveSpeakerDetector::Update(std::uint32_t speakerId, AudioLevel level, Clock::time_point now) {
+        if (_lastN == 0) {
+            return {};
+        }
+
+        auto speaker = FindSpeaker(speakerId);
+
+        if (speaker == nullptr) {
+            return {};
+        }
+
+        // Levels without voice activity are background noise, which is no reason to forward a speaker.
+        const double loudness = level._isVoiceActive ? AudioLevel::Silence - level._level : 0.0;
+        const double elapsed = std::chrono::duration<double>(now - speaker->_lastUpdate).count();
+        const double weight = 1.0 - std::exp(-elapsed / std::chrono::duration<double>(LoudnessTimeConstant).count());
+
+        speaker->_loudness += weight * (loudness - speaker->_loudness);
+        speaker->_lastUpdate = now;
+
+        if (now - _lastRanking < RankingInterval) {
+            return {};
+        }
+
+        _lastRanking = now;
+
+        return Rank(now);
+    }
+
+    bool ActiveSpeakerDetector::IsForwarded(std::uint32_t speakerId, std::uint32_t receiverId) const {
+        if (speakerId == receiverId) {
+            return false;
+        }
+
+        if (_lastN == 0) {
+            return true;
+        }
+
+        auto speaker = FindSpeaker(speakerId);
+
+        return speaker != nullptr && speaker->_isActive;
+    }
+
+    std::vector<std::uint32_t> ActiveSpeakerDetector::GetActiveSpeakers() const {
+        std::vector<const Speaker*> active;
+
+        for (const auto& speaker : _speakers) {
+            if (_lastN == 0 || speaker._isActive) {
+                active.push_back(&speaker);
+            }
+        }
+
+        std::stable_sort(active.begin(), active.end(), [](const Speaker* left, const Speaker* right) {
+            return left->_activeSince < right->_activeSince;
+        });
+
+        std::vector<std::uint32_t> activeSpeakers;
+        activeSpeakers.reserve(active.size());
+
+        for (const auto speaker : active) {
+            activeSpeakers.push_back(speaker->_id);
+        }
+
+        return activeSpeakers;
+    }
+
+    ActiveSpeakerDetector::Speaker* ActiveSpeakerDetector::FindSpeaker(std::uint32_t speakerId) {
+        auto speaker = std::find_if(_speakers.begin(), _speakers.end(), [speakerId](const Speaker& other) {
+            return other._id == speakerId;
+        });
+
+        return speaker == _speakers.end() ? nullptr : &*speaker;
+    }
+
+    const ActiveSpeakerDetector::Speaker* ActiveSpeakerDetector::FindSpeaker(std::uint32_t speakerId) const {
+        return const_cast<ActiveSpeakerDetector*>(this)->FindSpeaker(speakerId);
+    }
+
+    double ActiveSpeakerDetector::GetLoudness(const Speaker& speaker, Clock::time_point now) const {
+        // A speaker who stops sending, e.g. during DTX, fades out as if they were sending silence.
+        const double elapsed = std::chrono::duration<double>(now - speaker._lastUpdate).count();
+
+        return speaker._loudness * std::exp(-elapsed / std::chrono::duration<double>(LoudnessTimeConstant).count());
+    }
+
+    void ActiveSpeakerDetector::FillActivePlaces(Clock::time_point now) {
+        while (_lastN != 0 && _activeSpeakerCount < _lastN) {
+            Speaker* loudest = nullptr;
+
+            for (auto& speaker : _speakers) {
+                if (!speaker._isActive && (loudest == nullptr || GetLoudness(speaker, now) > GetLoudness(*loudest, now))) {
+                    loudest = &speaker;
+                }
+            }
+
+            if (loudest == nullptr) {
+                return; // Every speaker is active.
+            }
+
+            loudest->_isActive = true;
+            loudest->_activeSince = now;
+            _activeSpeakerCount++;
+        }
+    }
+
+    std::vector<std::uint32_t> ActiveSpeakerDetector::Rank(Clock::time_point now) {
+        std::vector<std::uint32_t> demoted;
+
+        while (true) {
+            Speaker* loudestInactive = nullptr;
+            Speaker* quietestActive = nullptr;
+
+            for (auto& speaker : _speakers) {
+                const double loudness = GetLoudness(speaker, now);
+
+                if (!speaker._isActive) {
+                    if (loudestInactive == nullptr || loudness > GetLoudness(*loudestInactive, now)) {
+                        loudestInactive = &speaker;
+                    }
+                }
+                else if (now - speaker._activeSince >= MinimumActiveDuration) {
+                    if (quietestActive == nullptr || loudness < GetLoudness(*quietestActive, now)) {
+                        quietestActive = &speaker;
+                    }
+                }
+            }
+
+            if (loudestInactive == nullptr || quietestActive == nullptr ||
+                GetLoudness(*loudestInactive, now) < GetLoudness(*quietestActive, now) + DisplacementMargin) {
+                return demoted;
+            }
+
+            // The promoted speaker has only just become active, so it cannot be displaced again in this ranking.
+            quietestActive->_isActive = false;
+            loudestInactive->_isActive = true;
+            loudestInactive->_activeSince = now;
+
+            demoted.push_back(quietestActive->_id);
+        }
+    }
+}
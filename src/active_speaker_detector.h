@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "audio_level.h"
+
+namespace Comms {
+
+    /*
+    * Chooses the last-N speakers of a room, the loudest N that are forwarded to every receiver, from the audio levels senders
+    * attach to their packets.
+    *
+    * Each speaker's loudness is smoothed over a few hundred milliseconds so that single loud packets do not count as speech.
+    * To stop the forwarded set flapping between speakers of similar loudness, a speaker only displaces a forwarded one if it
+    * is clearly louder and the forwarded speaker has been forwarded for a minimum time.
+    *
+    * Every receiver is forwarded the active speakers other than itself, so an active speaker hears N - 1 others.
+    * Not thread safe. An SfuRoom's detector is only used on its worker thread.
+    */
+    class ActiveSpeakerDetector {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /*
+        * Constructor.
+        *
+        * @param lastN The number of speakers forwarded to each receiver. 0 forwards every speaker.
+        */
+        ActiveSpeakerDetector(std::size_t lastN);
+
+        /*
+        * Starts tracking a speaker. New speakers become active while there are fewer than N active speakers.
+        */
+        void AddSpeaker(std::uint32_t speakerId, Clock::time_point now);
+
+        /*
+        * Stops tracking a speaker, promoting the loudest inactive speaker in its place if it was active.
+        */
+        void RemoveSpeaker(std::uint32_t speakerId, Clock::time_point now);
+
+        /*
+        * Records the level of a packet from a speaker, and re-ranks the speakers if they have not been ranked recently.
+        *
+        * @param speakerId The speaker that sent the packet.
+        * @param level The level of the packet. Silent and DTX packets should be given AudioLevel::Silence.
+        * @param now The time the packet was received.
+        * @return The speakers that stopped being active as a result, whose forwarded streams should be released.
+        */
+        std::vector<std::uint32_t> Update(std::uint32_t speakerId, AudioLevel level, Clock::time_point now);
+
+        /*
+        * @return Whether a speaker's audio should be forwarded to a receiver.
+        */
+        bool IsForwarded(std::uint32_t speakerId, std::uint32_t receiverId) const;
+
+        /*
+        * @return The active speakers, in the order they became active.
+        */
+        std::vector<std::uint32_t> GetActiveSpeakers() const;
+
+    private:
+        /*
+        * The smoothed loudness of one speaker.
+        */
+        struct Speaker {
+            std::uint32_t _id; // Identifies the speaker.
+            double _loudness = 0.0; // Smoothed loudness in dB above silence, from 0 to 127.
+            Clock::time_point _lastUpdate; // When _loudness was last updated.
+            Clock::time_point _activeSince; // When the speaker last became active.
+            bool _isActive = false; // Whether the speaker is forwarded.
+        };
+
+        /*
+        * @return The speaker with the given id, or null if it is not tracked.
+        */
+        Speaker* FindSpeaker(std::uint32_t speakerId);
+        const Speaker* FindSpeaker(std::uint32_t speakerId) const;
+
+        /*
+        * @return The speaker's loudness decayed to the given time, so that speakers who stop sending fade out.
+        */
+        double GetLoudness(const Speaker& speaker, Clock::time_point now) const;
+
+        /*
+        * Promotes the loudest inactive speakers while there are fewer than N active speakers.
+        */
+        void FillActivePlaces(Clock::time_point now);
+
+        /*
+        * Swaps inactive speakers with quieter active ones while the hysteresis conditions allow it.
+        *
+        * @return The speakers demoted.
+        */
+        std::vector<std::uint32_t> Rank(Clock::time_point now);
+
+        const std::size_t _lastN; // The number of speakers forwarded to each receiver. 0 forwards every speaker.
+
+        std::vector<Speaker> _speakers; // Every speaker in the room. Rooms are small, so searches are linear.
+        std::size_t _activeSpeakerCount = 0; // The number of active speakers.
+        Clock::time_point _lastRanking; // When the speakers were last ranked.
+    };
+}
@@ -0,0 +1,77 @@
+#include "allocation_counter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "allocation_tracker.h"
+
+namespace {
+    thread_local Comms::AllocationCounter::Counts ThreadCounts; // The calling thread's allocations.
+
+    const bool IsHooked = (Comms::AllocationTracker::SetHooked(), true);
+
+    void Count(std::size_t size) {
+        ThreadCounts._count++;
+        ThreadCounts._bytes += size;
+        Comms::AllocationTracker::OnHookedAllocation(size);
+    }
+}
+
+namespace Comms {
+    AllocationCounter::Counts AllocationCounter::GetThreadCounts() {
+        return ThreadCounts;
+    }
+}
+
+// The array and nothrow forms of the standard library call these, so replacing them counts every form. The sized forms
+// of delete are replaced as well, as a program that replaces one form is expected to replace both.
+
+void* operator new(std::size_t size) {
+    Count(size);
+
+    if (void* memory = std::malloc(size > 0 ? size : 1)) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    operator delete(memory);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    Count(size);
+
+#ifdef _WIN32
+    void* memory = _aligned_malloc(size > 0 ? size : 1, static_cast<std::size_t>(alignment));
+#else
+    // aligned_alloc requires a size that is a multiple of the alignment.
+    const auto alignmentBytes = static_cast<std::size_t>(alignment);
+    const auto alignedSize = std::max<std::size_t>((size + alignmentBytes - 1) / alignmentBytes, 1) * alignmentBytes;
+    void* memory = std::aligned_alloc(alignmentBytes, alignedSize);
+#endif
+
+    if (memory != nullptr) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(memory, alignment);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Comms {
+
+    /*
+    * Counts the heap allocations each thread makes through operator new, so that a benchmark can report what a piece of
+    * code allocates as well as how long it takes.
+    *
+    * Counting replaces the global operator new and delete, which also hooks them for the AllocationTracker, so it is linked
+    * only into the benchmarks, the load generator, and the Debug builds of the client and CLI, not into the servers or a
+    * release of the client. Allocations made with malloc, e.g. inside C libraries, are not seen.
+    */
+    class AllocationCounter {
+    public:
+        /*
+        * The allocations a thread has made.
+        */
+        struct Counts {
+            std::uint64_t _count = 0; // Allocations made.
+            std::uint64_t _bytes = 0; // Bytes requested by them.
+        };
+
+        /*
+        * @return The allocations the calling thread has made since it started.
+        */
+        static Counts GetThreadCounts();
+    };
+}
@@ -0,0 +1,254 @@
+#include "allocation_tracker.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <dbghelp.h>
+#pragma comment(lib, "dbghelp.lib")
+#else
+#include <cstdlib>
+#include <execinfo.h>
+#endif
+
+#include "metrics.h"
+
+namespace {
+    constexpr std::size_t MaximumStackDepth = 32; // Frames kept of the stack of a flagged allocation.
+
+    /*
+    * An allocation flagged on a real-time thread.
+    */
+    struct RealTimeAllocation {
+        const char* _threadName; // The thread it was made on.
+        Comms::AllocationTag _tag; // The subsystem the thread was allocating for.
+        std::size_t _bytes; // The bytes allocated.
+        std::array<void*, MaximumStackDepth> _stack; // The return addresses of the stack it was made from, innermost first.
+        std::size_t _stackDepth; // The frames of _stack captured.
+        std::atomic<bool> _isWritten = false; // Published once the rest is written.
+    };
+
+    // Set once the metrics below are registered. Allocations are hooked from the start of the process, and registering
+    // them allocates, so until then they are not counted.
+    std::atomic<bool> IsRegistered = false;
+
+    std::array<Comms::Counter*, Comms::AllocationTagCount> TagAllocationsTotal{}; // Allocations counted for each subsystem.
+    std::array<Comms::Counter*, Comms::AllocationTagCount> TagAllocatedBytesTotal{}; // Their bytes.
+    Comms::Counter* RealTimeAllocationsTotal = nullptr; // Allocations flagged on real-time threads.
+
+    std::atomic<bool> IsHookInstalled = false; // Whether operator new is hooked in this build.
+    std::atomic<std::uint64_t> FlaggedCount = 0; // Allocations flagged, each taking the report slot of its index.
+    std::array<RealTimeAllocation, Comms::RealTimeReportCapacity> Flagged; // The first allocations flagged.
+
+    std::mutex SymbolMutex; // Taken to symbolise stacks, as DbgHelp is single threaded.
+
+    thread_local Comms::AllocationTag ThreadTag = Comms::AllocationTag::Other; // The subsystem the calling thread allocates for.
+    thread_local const char* RealTimeThreadName = nullptr; // The calling thread's name if it is real-time, else null.
+    thread_local bool IsFlagging = false; // Whether the calling thread is flagging an allocation, which may itself allocate.
+
+    const char* GetTagName(Comms::AllocationTag tag) {
+        switch (tag) {
+            case Comms::AllocationTag::Other: return "other";
+            case Comms::AllocationTag::Capture: return "capture";
+            case Comms::AllocationTag::Playback: return "playback";
+            case Comms::AllocationTag::Codec: return "codec";
+            case Comms::AllocationTag::Transport: return "transport";
+            case Comms::AllocationTag::Mixer: return "mixer";
+        }
+
+        return "unknown";
+    }
+
+    const bool IsMetricsRegistered = []() {
+        // Allocations of no subsystem are not counted, as that would be every allocation the process makes.
+        for (std::size_t i = 1; i < Comms::AllocationTagCount; i++) {
+            const auto labels = std::string("subsystem=\"") + GetTagName(static_cast<Comms::AllocationTag>(i)) + "\"";
+
+            TagAllocationsTotal[i] = &Comms::Metrics::AddCounter("comms_allocations_total", "Heap allocations made by each subsystem.", labels);
+            TagAllocatedBytesTotal[i] = &Comms::Metrics::AddCounter("comms_allocated_bytes_total", "Bytes of heap allocations made by each subsystem.", labels);
+        }
+
+        RealTimeAllocationsTotal = &Comms::Metrics::AddCounter("comms_realtime_allocations_total", "Heap allocations made on threads registered as real-time.");
+        IsRegistered.store(true, std::memory_order_release);
+
+        return true;
+    }();
+
+    /*
+    * @return The frames of the calling stack captured, beyond this function and its caller on platforms that can skip them.
+    */
+    std::size_t CaptureStack(std::array<void*, MaximumStackDepth>& stack) {
+#ifdef _WIN32
+        return CaptureStackBackTrace(2, static_cast<DWORD>(stack.size()), stack.data(), nullptr);
+#else
+        return static_cast<std::size_t>(backtrace(stack.data(), static_cast<int>(stack.size())));
+#endif
+    }
+
+    /*
+    * @return Each frame of a stack as its function and, where known, its source line. Requires SymbolMutex.
+    */
+    nlohmann::json SymbolizeStack(void* const* stack, std::size_t depth) {
+        nlohmann::json frames = nlohmann::json::array();
+
+#ifdef _WIN32
+        const HANDLE process = GetCurrentProcess();
+        static const bool isInitialised = SymInitialize(process, nullptr, TRUE) == TRUE;
+
+        for (std::size_t i = 0; i < depth; i++) {
+            const auto address = reinterpret_cast<DWORD64>(stack[i]);
+            char text[MAX_SYM_NAME + 64];
+            std::snprintf(text, sizeof(text), "0x%llx", static_cast<unsigned long long>(address));
+
+            alignas(SYMBOL_INFO) char symbolStorage[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+            auto symbol = reinterpret_cast<SYMBOL_INFO*>(symbolStorage);
+            symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+            symbol->MaxNameLen = MAX_SYM_NAME;
+            DWORD64 displacement = 0;
+
+            if (isInitialised && SymFromAddr(process, address, &displacement, symbol)) {
+                IMAGEHLP_LINE64 line{};
+                line.SizeOfStruct = sizeof(line);
+                DWORD lineDisplacement = 0;
+
+                if (SymGetLineFromAddr64(process, address, &lineDisplacement, &line)) {
+                    std::snprintf(text, sizeof(text), "%s (%s:%lu)", symbol->Name, line.FileName, line.LineNumber);
+                }
+                else {
+                    std::snprintf(text, sizeof(text), "%s+0x%llx", symbol->Name, static_cast<unsigned long long>(displacement));
+                }
+            }
+
+            frames.push_back(text);
+        }
+#else
+        char** symbols = backtrace_symbols(stack, static_cast<int>(depth));
+
+        for (std::size_t i = 0; i < depth; i++) {
+            frames.push_back(symbols != nullptr ? symbols[i] : "?");
+        }
+
+        std::free(symbols);
+#endif
+
+        return frames;
+    }
+}
+
+namespace Comms {
+    void AllocationTracker::Record(AllocationTag tag, std::size_t bytes) {
+        if (tag == AllocationTag::Other || !IsRegistered.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        const auto index = static_cast<std::size_t>(tag);
+        TagAllocationsTotal[index]->Increment();
+        TagAllocatedBytesTotal[index]->Increment(bytes);
+    }
+
+    AllocationTag AllocationTracker::GetThreadTag() {
+        return ThreadTag;
+    }
+
+    void AllocationTracker::RegisterRealTimeThread(const char* name) {
+        if (RealTimeThreadName == nullptr) {
+            RealTimeThreadName = name;
+        }
+    }
+
+    bool AllocationTracker::IsRealTimeThread() {
+        return RealTimeThreadName != nullptr;
+    }
+
+    void AllocationTracker::OnHookedAllocation(std::size_t bytes) {
+        Record(ThreadTag, bytes);
+
+        if (RealTimeThreadName == nullptr || IsFlagging) {
+            return;
+        }
+
+        IsFlagging = true;
+
+        if (IsRegistered.load(std::memory_order_acquire)) {
+            RealTimeAllocationsTotal->Increment();
+        }
+
+        const auto index = FlaggedCount.fetch_add(1, std::memory_order_relaxed);
+
+        if (index < Flagged.size()) {
+            auto& flagged = Flagged[index];
+            flagged._threadName = RealTimeThreadName;
+            flagged._tag = ThreadTag;
+            flagged._bytes = bytes;
+            flagged._stackDepth = CaptureStack(flagged._stack);
+            flagged._isWritten.store(true, std::memory_order_release);
+        }
+
+        IsFlagging = false;
+    }
+
+    void AllocationTracker::SetHooked() {
+        IsHookInstalled = true;
+    }
+
+    bool AllocationTracker::IsHooked() {
+        return IsHookInstalled;
+    }
+
+    std::uint64_t AllocationTracker::GetRealTimeAllocationCount() {
+        return FlaggedCount.load(std::memory_order_relaxed);
+    }
+
+    nlohmann::json AllocationTracker::RealTimeAllocationsToJson() {
+        const auto count = GetRealTimeAllocationCount();
+        nlohmann::json allocations = nlohmann::json::array();
+        std::lock_guard<std::mutex> lock(SymbolMutex);
+
+        for (std::size_t i = 0; i < std::min<std::uint64_t>(count, Flagged.size()); i++) {
+            const auto& flagged = Flagged[i];
+
+            if (!flagged._isWritten.load(std::memory_order_acquire)) {
+                continue; // Still being written.
+            }
+
+            allocations.push_back({
+                {"thread", flagged._threadName},
+                {"subsystem", GetTagName(flagged._tag)},
+                {"bytes", flagged._bytes},
+                {"stack", SymbolizeStack(flagged._stack.data(), flagged._stackDepth)}
+            });
+        }
+
+        return {
+            {"hooked", IsHooked()},
+            {"realtime_allocations", count},
+            {"allocations", allocations}
+        };
+    }
+
+    AllocationScope::AllocationScope(AllocationTag tag) :
+        _previousTag(ThreadTag) {
+        ThreadTag = tag;
+    }
+
+    AllocationScope::~AllocationScope() {
+        ThreadTag = _previousTag;
+    }
+
+    RealTimeScope::RealTimeScope(const char* name) :
+        _previousName(RealTimeThreadName) {
+        RealTimeThreadName = name;
+    }
+
+    RealTimeScope::~RealTimeScope() {
+        RealTimeThreadName = _previousName;
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "json/json.hpp"
+
+namespace Comms {
+
+    /*
+    * The subsystem a heap allocation is made for.
+    */
+    enum class AllocationTag {
+        Other, // Made outside any tagged subsystem. Not counted.
+        Capture, // Taking audio from the microphone.
+        Playback, // Playing audio to the speakers.
+        Codec, // Encoding and decoding Opus.
+        Transport, // Packetising, pacing and sending packets, and receiving them.
+        Mixer // Mixing a room's audio.
+    };
+
+    constexpr std::size_t AllocationTagCount = 6;
+
+    constexpr std::size_t RealTimeReportCapacity = 64; // Allocations flagged on real-time threads whose stacks are kept.
+
+    /*
+    * Accounts for heap allocations by subsystem, and catches allocations on threads that must never allocate.
+    *
+    * Allocations are counted per subsystem in the metrics comms_allocations_total and comms_allocated_bytes_total, labelled
+    * by subsystem. Containers a subsystem owns count theirs through a TaggedAllocator in every build. Everything else made
+    * within an AllocationScope, e.g. the vectors opuscpp returns and the packets libdatachannel copies, is counted only in a
+    * build that hooks operator new. @see AllocationCounter
+    *
+    * A thread registered as real-time, e.g. an audio device's callback thread, has a deadline every period, and an
+    * allocation may take a lock in the heap or a page fault that misses it. In a build that hooks operator new, every
+    * allocation made on one is flagged: counted in comms_realtime_allocations_total, with the stack it was made from kept
+    * for the report. The client and CLI hook it in their Debug builds. The benchmarks and load generator always do.
+    */
+    class AllocationTracker {
+    public:
+        /*
+        * Counts an allocation for a subsystem. Any thread.
+        *
+        * @param tag The subsystem.
+        * @param bytes The bytes allocated.
+        */
+        static void Record(AllocationTag tag, std::size_t bytes);
+
+        /*
+        * @return The subsystem the calling thread is allocating for. @see AllocationScope
+        */
+        static AllocationTag GetThreadTag();
+
+        /*
+        * Registers the calling thread as real-time, under a name for the report. Called again by a callback on each
+        * period, as a device's thread is not created by us; only the first call on a thread takes effect.
+        *
+        * @param name The thread's name, which must outlive the thread.
+        */
+        static void RegisterRealTimeThread(const char* name);
+
+        /*
+        * @return Whether the calling thread is registered as real-time.
+        */
+        static bool IsRealTimeThread();
+
+        /*
+        * Called by the operator new hook on every allocation, before it is made. Counts it for the calling thread's
+        * subsystem and, on a real-time thread, flags it. Never allocates.
+        *
+        * @param bytes The bytes being allocated.
+        */
+        static void OnHookedAllocation(std::size_t bytes);
+
+        /*
+        * Called once by the operator new hook as the process starts, so that the report can tell a clean run from one
+        * nothing was checked in.
+        */
+        static void SetHooked();
+
+        /*
+        * @return Whether operator new is hooked in this build.
+        */
+        static bool IsHooked();
+
+        /*
+        * @return Allocations flagged on real-time threads.
+        */
+        static std::uint64_t GetRealTimeAllocationCount();
+
+        /*
+        * @return Whether operator new is hooked, the allocations flagged, and the thread, subsystem, size and symbolised
+        *         stack of the first RealTimeReportCapacity of them.
+        */
+        static nlohmann::json RealTimeAllocationsToJson();
+    };
+
+    /*
+    * Attributes the calling thread's hooked allocations to a subsystem while it is in scope, restoring the one before it on
+    * leaving.
+    */
+    class AllocationScope {
+    public:
+        AllocationScope(AllocationTag tag);
+        ~AllocationScope();
+
+        AllocationScope(const AllocationScope&) = delete;
+        AllocationScope& operator=(const AllocationScope&) = delete;
+
+    private:
+        const AllocationTag _previousTag; // The thread's subsystem before the scope.
+    };
+
+    /*
+    * Registers the calling thread as real-time while it is in scope, for work that runs as a real-time thread's would but on
+    * a thread that also does other work, e.g. a simulated device period, or a CallManager's frame on its audio thread.
+    * A scope with no name lifts real-time for the scope, for a harness's own work called from real-time code, e.g. a
+    * benchmark recording a frame's timings, or a simulated network carrying a packet.
+    */
+    class RealTimeScope {
+    public:
+        /*
+        * @param name The name allocations in the scope are reported under, which must outlive the scope, or null for
+        * the thread not to be real-time in the scope.
+        */
+        RealTimeScope(const char* name);
+        ~RealTimeScope();
+
+        RealTimeScope(const RealTimeScope&) = delete;
+        RealTimeScope& operator=(const RealTimeScope&) = delete;
+
+    private:
+        const char* const _previousName; // The thread's real-time name before the scope, or null.
+    };
+
+    /*
+    * A standard allocator that counts what a container allocates for a subsystem. @see AllocationTracker
+    */
+    template <typename T, AllocationTag Tag>
+    class TaggedAllocator {
+    public:
+        using value_type = T;
+
+        TaggedAllocator() noexcept = default;
+
+        template <typename U>
+        TaggedAllocator(const TaggedAllocator<U, Tag>&) noexcept {
+        }
+
+        T* allocate(std::size_t count) {
+            AllocationTracker::Record(Tag, count * sizeof(T));
+            AllocationScope scope(AllocationTag::Other); // Counted above, so not again by the hook.
+
+            return std::allocator<T>().allocate(count);
+        }
+
+        void deallocate(T* memory, std::size_t count) noexcept {
+            std::allocator<T>().deallocate(memory, count);
+        }
+
+        template <typename U>
+        struct rebind {
+            using other = TaggedAllocator<U, Tag>;
+        };
+
+        template <typename U>
+        bool operator==(const TaggedAllocator<U, Tag>&) const noexcept {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const TaggedAllocator<U, Tag>&) const noexcept {
+            return false;
+        }
+    };
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+#include "audio_level.h"
+
+namespace Comms {
+
+    /*
+    * A connection carrying a call's audio to and from one remote peer, as a CallManager uses it. Implemented by
+    * WebRTCPeerConnection for calls over the network, and by stand-ins that benchmarks and simulations plug into a
+    * CallManager, so that they run the audio thread of a real call.
+    */
+    class AudioConnection {
+    public:
+        /*
+        * A snapshot of the connection's audio and of the path to the remote peer. @see GetStats
+        */
+        struct Stats {
+            std::optional<double> _roundTripTime; // Smoothed, in milliseconds, or nothing until it is first measured.
+            double _jitter; // Interarrival jitter of the audio received, in milliseconds.
+            double _sentLossFraction; // The fraction of the packets sent the remote peer reported lost, over about a second.
+            int _sendBitrate; // Audio sent over the last second, headers included, in bits per second.
+            int _receiveBitrate; // Audio received over the last second, headers included, in bits per second.
+            int _targetBitrate; // The bitrate audio should be encoded at. @see GetTargetBitrate
+            std::uint64_t _sentPackets; // Audio packets sent.
+            std::uint64_t _receivedPackets; // Audio packets received.
+        };
+
+        virtual ~AudioConnection() = default;
+
+        /*
+        * Connects to the remote peer, blocking until it is connected, it fails or the connection is closed.
+        */
+        virtual void Connect() = 0;
+
+        /*
+        * Stops connecting and closes the connection. A Connect in progress returns promptly. Thread safe.
+        */
+        virtual void Close() = 0;
+
+        /*
+        * @return The current state of the connection.
+        */
+        virtual rtc::PeerConnection::State GetConnectionState() = 0;
+
+        /*
+        * Sends an encoded frame of audio to the remote peer, wrapped in the connection's own RTP header.
+        *
+        * @param opusData The Opus packet.
+        * @param level The level of the captured audio the packet was encoded from. @see MeasureAudioLevel
+        * @return The RTP sequence number the frame was sent with.
+        */
+        virtual std::uint16_t SendAudioData(const std::vector<std::byte>& opusData, AudioLevel level) = 0;
+
+        /*
+        * Sets the function called with each RTP packet of audio received from the remote peer.
+        */
+        virtual void OnAudioData(std::function<void(const rtc::binary& packet)> callback) = 0;
+
+        /*
+        * @return The bitrate audio should be encoded at for the path to the remote peer, in bits per second.
+        */
+        virtual int GetTargetBitrate() const = 0;
+
+        /*
+        * @return A snapshot of the connection's audio and its path, read without blocking the threads sending and receiving.
+        */
+        virtual Stats GetStats() const = 0;
+
+        /*
+        * @return The id the connection's packets are tagged with in a PipelineTrace. @see PipelineTrace::NewConnectionId
+        */
+        virtual std::uint32_t GetTraceId() const = 0;
+    };
+}
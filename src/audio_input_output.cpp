@@ -1,7 +1,13 @@
 #define MA_ENABLE_ONLY_SPECIFIC_BACKENDS
+#ifdef _WIN32
 #define MA_ENABLE_WASAPI
-#define MA_NO_DECODING
-#define MA_NO_ENCODING
+#else
+#define MA_ENABLE_PULSEAUDIO
+#define MA_ENABLE_ALSA
+#endif
+#define MA_ENABLE_NULL
+#define MA_NO_MP3
+#define MA_NO_FLAC
 #define MA_NO_RESOURCE_MANAGER
 #define MA_NO_NODE_GRAPH
 #define MA_NO_ENGINE
@@ -10,21 +16,41 @@
 
 #include "audio_input_output.h"
 
+#include "allocation_tracker.h"
+#include "metrics.h"
+#include "pipeline_trace.h"
+
 namespace {
 	const ma_format AudioFormat = ma_format_s16;
 	const ma_uint32 AudioChannels = 1;
 	const ma_uint32 AudioSampleRate = 48000;	
+
+	const char* DiscardDeviceName = "Discard (virtual)"; // The virtual output that is always available.
+
+	Comms::Counter& CapturedSamplesTotal = Comms::Metrics::AddCounter("comms_audio_captured_samples_total", "Samples captured from the input device.");
+	Comms::Counter& DroppedSamplesTotal = Comms::Metrics::AddCounter("comms_audio_dropped_samples_total", "Captured samples dropped as the microphone queue was full.");
+	Comms::Counter& PlayedSamplesTotal = Comms::Metrics::AddCounter("comms_audio_played_samples_total", "Samples played to the output device.");
+	Comms::Counter& UnderrunSamplesTotal = Comms::Metrics::AddCounter("comms_audio_underrun_samples_total", "Samples played as silence as the speaker queue was empty.");
 }
 
 namespace Comms {
-	AudioInputOutput::AudioInputOutput(std::shared_ptr<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>> inputBuffer,
-		std::shared_ptr<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>> outputBuffer) :
+	AudioInputOutput::AudioInputOutput(std::shared_ptr<AudioBuffer> inputBuffer,
+		std::shared_ptr<AudioBuffer> outputBuffer,
+		Backend backend) :
 		_inputBuffer(inputBuffer),
 		_outputBuffer(outputBuffer) {
 		_audioContext = std::unique_ptr<ma_context, std::function<void(ma_context*)>>(
-			[]() {
+			[backend]() {
 				ma_context* context = new ma_context();
-				ma_context_init(NULL, 0, NULL, context);
+
+				if (backend == Backend::Null) {
+					const ma_backend nullBackend = ma_backend_null;
+					ma_context_init(&nullBackend, 1, NULL, context);
+				}
+				else {
+					ma_context_init(NULL, 0, NULL, context); // The first backend that works, in miniaudio's order of preference.
+				}
+
 				return context;
 			}(),
 			[](ma_context* context) {
@@ -33,6 +59,11 @@ namespace Comms {
 			}
 		);
 
+		VirtualAudioDevice::Configuration discard;
+		discard._name = DiscardDeviceName;
+		discard._isInput = false;
+		_virtualDevices.push_back(discard);
+
 		_inputDevice = std::unique_ptr<ma_device, std::function<void(ma_device*)>>(
 			nullptr,
 			[](ma_device* device) {
@@ -54,6 +85,10 @@ namespace Comms {
 		SetOutputDevice("");
 	}
 
+	void AudioInputOutput::AddVirtualDevice(const VirtualAudioDevice::Configuration& configuration) {
+		_virtualDevices.push_back(configuration);
+	}
+
 	std::string AudioInputOutput::GetInputDeviceName() const {
 		return _inputDeviceName;
 	}
@@ -63,8 +98,26 @@ namespace Comms {
 	}
 
 	void AudioInputOutput::SetInputDevice(std::string inputDeviceName) {
+		if (!_inputBuffer) {
+			return;
+		}
+
 		for (const auto& device : GetDevices()) {
 			if (device._isInput && (inputDeviceName.empty() || device._name == inputDeviceName)) {
+				if (device._virtual.has_value()) {
+					// Opened before the current device is closed, so that it is kept if the file cannot be opened.
+					auto virtualDevice = std::make_unique<VirtualAudioDevice>(*device._virtual,
+						[buffer = _inputBuffer](std::int16_t* samples, ma_uint32 numFrames) { CaptureSamples(*buffer, samples, numFrames); });
+
+					_inputDevice.reset();
+					_virtualInputDevice = std::move(virtualDevice);
+					_inputDeviceName = device._name;
+
+					return;
+				}
+
+				_virtualInputDevice.reset();
+
 				ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
 				deviceConfig.capture.pDeviceID = &device._id;
 				deviceConfig.capture.format = AudioFormat;
@@ -85,6 +138,20 @@ namespace Comms {
 	void AudioInputOutput::SetOutputDevice(std::string outputDeviceName) {
 		for (const auto& device : GetDevices()) {
 			if (!device._isInput && (outputDeviceName.empty() || device._name == outputDeviceName)) {
+				if (device._virtual.has_value()) {
+					// Opened before the current device is closed, so that it is kept if the file cannot be opened.
+					auto virtualDevice = std::make_unique<VirtualAudioDevice>(*device._virtual,
+						[buffer = _outputBuffer](std::int16_t* samples, ma_uint32 numFrames) { PlaySamples(*buffer, samples, numFrames); });
+
+					_outputDevice.reset();
+					_virtualOutputDevice = std::move(virtualDevice);
+					_outputDeviceName = device._name;
+
+					return;
+				}
+
+				_virtualOutputDevice.reset();
+
 				ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
 				deviceConfig.playback.pDeviceID = &device._id;
 				deviceConfig.playback.format = AudioFormat;
@@ -127,14 +194,47 @@ namespace Comms {
 	}
 
 	void AudioInputOutput::StartAudioStreams() {
-		ma_device_start(_inputDevice.get());
-		ma_device_start(_outputDevice.get());
+		// A device's callback thread takes one on its first traced period, when it must not allocate one.
+		PipelineTrace::ReserveThreadRings();
+
+		if (_inputDevice) {
+			ma_device_start(_inputDevice.get());
+		}
+
+		if (_outputDevice) {
+			ma_device_start(_outputDevice.get());
+		}
+
+		if (_virtualInputDevice) {
+			_virtualInputDevice->Start();
+		}
+
+		if (_virtualOutputDevice) {
+			_virtualOutputDevice->Start();
+		}
 	}
 
 	void AudioInputOutput::StopAudioStreams()
 	{
-		ma_device_stop(_inputDevice.get());
-		ma_device_stop(_outputDevice.get());
+		if (_inputDevice) {
+			ma_device_stop(_inputDevice.get());
+		}
+
+		if (_outputDevice) {
+			ma_device_stop(_outputDevice.get());
+		}
+
+		if (_virtualInputDevice) {
+			_virtualInputDevice->Stop();
+		}
+
+		if (_virtualOutputDevice) {
+			_virtualOutputDevice->Stop();
+		}
+	}
+
+	bool AudioInputOutput::IsInputFinished() const {
+		return _virtualInputDevice && _virtualInputDevice->IsFinished();
 	}
 
 	std::vector<AudioInputOutput::Device> AudioInputOutput::GetDevices() const {
@@ -167,33 +267,66 @@ namespace Comms {
 			devices.push_back(device);
 		}
 
+		for (const auto& configuration : _virtualDevices) {
+			AudioInputOutput::Device device{};
+
+			device._name = configuration._name;
+			device._isInput = configuration._isInput;
+			device._virtual = configuration;
+
+			devices.push_back(device);
+		}
+
 		return devices;
 	}
 
-	void AudioInputOutput::ReadFromDevice(ma_device* device, void* output, const void* input, ma_uint32 numFrames) {
-		auto buffer = static_cast<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>*>(device->pUserData);
-		const std::int16_t* samples = static_cast<const std::int16_t*>(input);
+	void AudioInputOutput::ReadFromDevice(ma_device* device, [[maybe_unused]] void* output, const void* input, ma_uint32 numFrames) {
+		PipelineTrace::NameThread("Capture device");
+		AllocationTracker::RegisterRealTimeThread("Capture device");
+		AllocationScope scope(AllocationTag::Capture);
+		CaptureSamples(*static_cast<AudioBuffer*>(device->pUserData), static_cast<const std::int16_t*>(input), numFrames);
+	}
+
+	void AudioInputOutput::WriteToDevice(ma_device* device, void* output, [[maybe_unused]] const void* input, ma_uint32 numFrames) {
+		PipelineTrace::NameThread("Playback device");
+		AllocationTracker::RegisterRealTimeThread("Playback device");
+		AllocationScope scope(AllocationTag::Playback);
+		PlaySamples(*static_cast<AudioBuffer*>(device->pUserData), static_cast<std::int16_t*>(output), numFrames);
+	}
+
+	void AudioInputOutput::CaptureSamples(AudioBuffer& buffer, const std::int16_t* samples, ma_uint32 numFrames) {
+		TraceSpan span(TraceStage::Capture);
+		ma_uint32 droppedCount = 0;
 
 		for (ma_uint32 i = 0; i < numFrames; i++) {
-			buffer->push(samples[i]);
+			if (!buffer.push(samples[i])) {
+				droppedCount++;
+			}
 		}
+
+		CapturedSamplesTotal.Increment(numFrames);
+		DroppedSamplesTotal.Increment(droppedCount);
 	}
 
-	void AudioInputOutput::WriteToDevice(ma_device* device, void* output, const void* input, ma_uint32 numFrames) {
-		auto buffer = static_cast<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>*>(device->pUserData);
-		std::int16_t* samples = static_cast<std::int16_t*>(output);
+	ma_uint32 AudioInputOutput::PlaySamples(AudioBuffer& buffer, std::int16_t* samples, ma_uint32 numFrames) {
+		TraceSpan span(TraceStage::Playback);
+		ma_uint32 underrunCount = 0;
 
 		for (ma_uint32 i = 0; i < numFrames; i++) {
 			std::int16_t sample = 0;
 
-			if (buffer->pop(sample)) {
+			if (buffer.pop(sample)) {
 				samples[i] = sample;
 			}
 			else {
 				samples[i] = 0; // Fill with silence if no available data
+				underrunCount++;
 			}
 		}
-	}
-}
 
+		PlayedSamplesTotal.Increment(numFrames);
+		UnderrunSamplesTotal.Increment(underrunCount);
 
+		return numFrames - underrunCount;
+	}
+}
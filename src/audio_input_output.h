@@ -1,32 +1,60 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
 
 #include "boost/lockfree/spsc_queue.hpp"
 #include "miniaudio/miniaudio.h"
 
+#include "virtual_audio_device.h"
+
 namespace Comms {
 
+	/*
+	* A lockfree queue of 48 kHz mono samples, written by one thread and read by another.
+	*/
+	using AudioBuffer = boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>;
+
 	/*
 	* Handles interaction with audio input (e.g. microphone) and output (e.g. speakers) devices.
 	* This includes listing available audio devices and selecting desired devices to read from and write to.
 	* Audio data is stored in boost lockfree queues to prevent blocking the thread while waiting for access to the buffers for reading or writing data.
 	* 
 	* Audio device interaction is provided by the miniaudio library.
+	* Virtual devices, which capture from and play to files without audio hardware, are listed after the real devices, and
+	* an output that discards what it plays is always available. @see VirtualAudioDevice
 	*/
 	class AudioInputOutput
 	{
 
 	public:
+		/*
+		* The audio system devices are opened through.
+		*/
+		enum class Backend {
+			System, // The platform's audio system, e.g. WASAPI on Windows or PulseAudio on Linux.
+			Null // miniaudio's null backend: a silent input and an output that discards audio, both running in real time.
+		};
+
 		/*
 		* Constructor.
 		* 
-		* @param inputBuffer Lockfree queue to write input audio data to.
+		* @param inputBuffer Lockfree queue to write input audio data to, or null to open no input device.
 		* @param outputBuffer Lockfree queue to read output audio data from.
+		* @param backend The audio system to open devices through.
+		*/
+		AudioInputOutput(std::shared_ptr<AudioBuffer> inputBuffer,
+			std::shared_ptr<AudioBuffer> outputBuffer,
+			Backend backend = Backend::System);
+
+		/*
+		* Adds a virtual device, listed after the real devices and selected by its name in the same way.
+		* Its file is not opened until it is selected.
+		*
+		* @param configuration The device.
 		*/
-		AudioInputOutput(std::shared_ptr<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>> inputBuffer,
-			std::shared_ptr<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>> outputBuffer);
+		void AddVirtualDevice(const VirtualAudioDevice::Configuration& configuration);
 
 		/*
 		* @return The name of the input device if one has been selected, else empty string.
@@ -44,6 +72,7 @@ namespace Comms {
 		* @see GetInputDeviceNames
 		* 
 		* @param inputDeviceName The name of the device being selected from the list of available devices.
+		* @throws std::runtime_error If a virtual device is selected and its file cannot be opened.
 		*/
 		void SetInputDevice(std::string inputDeviceName);
 
@@ -53,6 +82,7 @@ namespace Comms {
 		* @see GetOutputDeviceNames.
 		*
 		* @param outputDeviceName The name of the device being selected from the list of available devices.
+		* @throws std::runtime_error If a virtual device is selected and its file cannot be created.
 		*/
 		void SetOutputDevice(std::string outputDeviceName);
 
@@ -76,6 +106,25 @@ namespace Comms {
 		*/
 		void StopAudioStreams();
 
+		/*
+		* @return Whether the input device is a virtual device that has captured the whole of its file.
+		*/
+		bool IsInputFinished() const;
+
+		/*
+		* Writes captured samples to an input buffer. The contract of ReadFromDevice, shared with virtual devices and the
+		* devices a CallSimulation simulates.
+		*/
+		static void CaptureSamples(AudioBuffer& buffer, const std::int16_t* samples, ma_uint32 numFrames);
+
+		/*
+		* Fills samples to play from an output buffer, with silence for any it is short of. The contract of WriteToDevice,
+		* shared with virtual devices and the devices a CallSimulation simulates.
+		*
+		* @return The number of samples taken from the buffer.
+		*/
+		static ma_uint32 PlaySamples(AudioBuffer& buffer, std::int16_t* samples, ma_uint32 numFrames);
+
 	private:
 
 		/*
@@ -83,8 +132,9 @@ namespace Comms {
 		*/
 		struct Device {
 			std::string _name; // Device name shown to the user.
-			ma_device_id _id; // Underlying device id used by the WASAPI backend.
+			ma_device_id _id; // Underlying device id used by the backend.
 			bool _isInput; // Whether or not the device is an input device (as opposed to output).
+			std::optional<VirtualAudioDevice::Configuration> _virtual; // The virtual device, if it is one rather than a real device.
 		};
 
 		/*
@@ -115,13 +165,16 @@ namespace Comms {
 		*/
 		static void WriteToDevice(ma_device* device, void* output, const void* input, ma_uint32 numFrames);
 
-		std::unique_ptr<ma_context, std::function<void(ma_context*)>> _audioContext; // MiniAudio context. This represents the WASAPI backend.
+		std::unique_ptr<ma_context, std::function<void(ma_context*)>> _audioContext; // MiniAudio context. This represents the backend.
 		std::unique_ptr<ma_device, std::function<void(ma_device*)>> _inputDevice = nullptr; // Input device.
 		std::unique_ptr<ma_device, std::function<void(ma_device*)>> _outputDevice = nullptr; // Output device.
+		std::vector<VirtualAudioDevice::Configuration> _virtualDevices; // Virtual devices, listed after the real devices.
+		std::unique_ptr<VirtualAudioDevice> _virtualInputDevice; // Input device, when a virtual device is selected.
+		std::unique_ptr<VirtualAudioDevice> _virtualOutputDevice; // Output device, when a virtual device is selected.
 		std::string _inputDeviceName = ""; // User readable name for the input device to be shown on the UI.
 		std::string _outputDeviceName = ""; // User readable name for the output device to be shown on the UI.
-		std::shared_ptr<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>> _inputBuffer; // Lockfree queue to store input audio data.
-		std::shared_ptr<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>> _outputBuffer; // Lockfree queue to store output audio data.
+		std::shared_ptr<AudioBuffer> _inputBuffer; // Lockfree queue to store input audio data.
+		std::shared_ptr<AudioBuffer> _outputBuffer; // Lockfree queue to store output audio data.
 	};
 }
 
@@ -0,0 +1,51 @@
+#include "audio_level.h"
+
+#include "rtp_packet.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Frames at or below this level, -50 dBov, are treated as containing no speech.
+    constexpr std::uint8_t VoiceActivityThreshold = 50;
+
+    Comms::AudioLevel ParseAudioLevel(std::uint8_t value) {
+        return Comms::AudioLevel{ static_cast<std::uint8_t>(value & 0x7F), (value & 0x80) != 0 };
+    }
+}
+
+namespace Comms {
+    AudioLevel MeasureAudioLevel(const std::int16_t* samples, std::size_t sampleCount) {
+        if (sampleCount == 0) {
+            return AudioLevel();
+        }
+
+        double sumOfSquares = 0.0;
+
+        for (std::size_t i = 0; i < sampleCount; i++) {
+            const double sample = samples[i] / 32768.0;
+            sumOfSquares += sample * sample;
+        }
+
+        const double rms = std::sqrt(sumOfSquares / sampleCount);
+
+        if (rms <= 0.0) {
+            return AudioLevel();
+        }
+
+        const double dBov = 20.0 * std::log10(rms);
+        const auto level = static_cast<std::uint8_t>(std::clamp(std::lround(-dBov), 0l, static_cast<long>(AudioLevel::Silence)));
+
+        return AudioLevel{ level, level < VoiceActivityThreshold };
+    }
+
+    std::optional<AudioLevel> ReadAudioLevel(const std::byte* packet, std::size_t size, int extensionId) {
+        const auto extension = FindRtpHeaderExtension(packet, size, extensionId);
+
+        if (!extension.has_value() || extension->second < 1) {
+            return std::nullopt;
+        }
+
+        return ParseAudioLevel(std::to_integer<std::uint8_t>(packet[extension->first]));
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace Comms {
+
+    // The URI identifying the client-to-mixer audio level RTP header extension (RFC 6464) in a session description.
+    inline constexpr const char* AudioLevelExtensionURI = "urn:ietf:params:rtp-hdrext:ssrc-audio-level";
+
+    // The extension id offered by clients for the audio level extension.
+    inline constexpr int AudioLevelExtensionId = 1;
+
+    /*
+    * The level of the audio in an RTP packet, as carried by the RFC 6464 header extension.
+    */
+    struct AudioLevel {
+        static constexpr std::uint8_t Silence = 127; // The quietest level, -127 dBov.
+
+        std::uint8_t _level = Silence; // The level in -dBov, from 0 (loudest) to 127 (silence).
+        bool _isVoiceActive = false; // Whether the sender believes the packet contains speech.
+    };
+
+    /*
+    * Measures the level of a frame of captured audio, as its RMS relative to full scale.
+    *
+    * @param samples The frame's samples.
+    * @param sampleCount The number of samples.
+    * @return The frame's level. Voice activity is estimated from the level alone.
+    */
+    AudioLevel MeasureAudioLevel(const std::int16_t* samples, std::size_t sampleCount);
+
+    /*
+    * Reads the audio level extension from an RTP packet, without touching its payload.
+    * Both the one-byte and two-byte header extension formats (RFC 8285) are understood.
+    *
+    * @param packet The RTP packet.
+    * @param size The size of the packet in bytes.
+    * @param extensionId The id the extension was negotiated with.
+    * @return The level, or std::nullopt if the packet does not carry the extension.
+    */
+    std::optional<AudioLevel> ReadAudioLevel(const std::byte* packet, std::size_t size, int extensionId);
+}
@@ -0,0 +1,211 @@
+#include "audio_mixer.h"
+
+#include <algorithm>
+
+#include "allocation_tracker.h"
+#include "audio_mixing.h"
+#include "opus_packet.h"
+
+namespace {
+    constexpr opus_int32 SampleRate = 48000;
+    constexpr int FrameSampleCount = 960; // 20 ms.
+    constexpr opus_int32 MaximumPacketSize = 1275; // The largest Opus packet of a single frame.
+
+    // Frames a participant may go without sending audio before their codecs are returned to the pool.
+    constexpr std::size_t CodecEvictionFrameCount = 50;
+
+    // Frames of lost packets concealed by the decoder before the participant is treated as silent.
+    constexpr std::size_t ConcealedFrameCount = 3;
+
+    // Frames each participant's jitter buffer holds before their audio is mixed, absorbing up to 60 ms of network jitter.
+    constexpr std::size_t JitterDelayFrames = 3;
+}
+
+namespace Comms {
+    AudioMixer::AudioMixer(int bitrate) :
+        _bitrate(bitrate),
+        _sum(FrameSampleCount),
+        _mix(FrameSampleCount),
+        _ownMix(FrameSampleCount) {
+        _sharedEncoder = AcquireEncoder();
+        _sharedEncoded.reserve(MaximumPacketSize);
+    }
+
+    void AudioMixer::AddParticipant(std::uint32_t participantId) {
+        Participant participant;
+        participant._id = participantId;
+        participant._jitterBuffer = std::make_unique<JitterBuffer>(JitterDelayFrames);
+        participant._silentFrameCount = CodecEvictionFrameCount;
+        participant._frame.resize(FrameSampleCount);
+        participant._encoded.reserve(MaximumPacketSize);
+
+        _participants.push_back(std::move(participant));
+    }
+
+    void AudioMixer::RemoveParticipant(std::uint32_t participantId) {
+        auto participant = std::find_if(_participants.begin(), _participants.end(), [participantId](const Participant& other) {
+            return other._id == participantId;
+        });
+
+        if (participant != _participants.end()) {
+            ReleaseCodecs(*participant, true);
+            _participants.erase(participant);
+        }
+    }
+
+    void AudioMixer::PushPacket(std::uint32_t participantId, const rtc::binary& packet) {
+        auto participant = std::find_if(_participants.begin(), _participants.end(), [participantId](const Participant& other) {
+            return other._id == participantId;
+        });
+
+        if (participant != _participants.end()) {
+            participant->_jitterBuffer->Push(packet);
+        }
+    }
+
+    void AudioMixer::Mix(const std::function<void(std::uint32_t participantId, const std::vector<std::byte>& packet)>& send) {
+        AllocationScope scope(AllocationTag::Mixer);
+        std::fill(_sum.begin(), _sum.end(), 0);
+
+        bool hasSharedListener = false;
+        bool isSharedEncoderCurrent = _hasSharedListener; // Whether the shared encoder encoded the last frame.
+
+        for (auto& participant : _participants) {
+            Decode(participant);
+
+            if (participant._isSpeaking) {
+                AccumulateFrame(_sum.data(), participant._frame.data(), FrameSampleCount);
+
+                // Forked before the shared encoder moves on to this frame, so the participant's stream continues unbroken.
+                if (participant._encoder == nullptr) {
+                    participant._encoder = AcquireEncoder();
+                    participant._encoder->CopyStateFrom(*_sharedEncoder);
+                }
+            }
+            else if (participant._encoder != nullptr && participant._silentFrameCount >= CodecEvictionFrameCount) {
+                // Back onto the shared stream. If no one heard it last frame, it takes over this participant's stream instead.
+                if (!isSharedEncoderCurrent) {
+                    _sharedEncoder->CopyStateFrom(*participant._encoder);
+                    isSharedEncoderCurrent = true;
+                }
+
+                _encoderPool.push_back(std::move(participant._encoder));
+            }
+
+            if (participant._encoder == nullptr) {
+                hasSharedListener = true;
+            }
+        }
+
+        // Everyone who is not speaking hears the whole sum. It is encoded once for all who have no encoder of their own.
+        SaturateFrame(_mix.data(), _sum.data(), FrameSampleCount);
+        _hasSharedListener = hasSharedListener;
+
+        if (hasSharedListener) {
+            Encode(*_sharedEncoder, _mix, _sharedEncoded);
+        }
+
+        for (auto& participant : _participants) {
+            if (participant._encoder == nullptr) {
+                send(participant._id, _sharedEncoded);
+            }
+            else if (participant._isSpeaking) {
+                MixMinusOne(_ownMix.data(), _sum.data(), participant._frame.data(), FrameSampleCount);
+                Encode(*participant._encoder, _ownMix, participant._encoded);
+                send(participant._id, participant._encoded);
+            }
+            else {
+                Encode(*participant._encoder, _mix, participant._encoded);
+                send(participant._id, participant._encoded);
+            }
+        }
+    }
+
+    std::size_t AudioMixer::GetParticipantCount() const {
+        return _participants.size();
+    }
+
+    std::size_t AudioMixer::GetActiveDecoderCount() const {
+        return std::count_if(_participants.begin(), _participants.end(), [](const Participant& participant) {
+            return participant._decoder != nullptr;
+        });
+    }
+
+    void AudioMixer::Decode(Participant& participant) {
+        const auto frame = participant._jitterBuffer->Pop(participant._packet);
+        const bool hasAudio = frame == JitterBuffer::Frame::Packet &&
+            !IsOpusSilence(reinterpret_cast<const std::byte*>(participant._packet.data()), participant._packet.size());
+
+        participant._isSpeaking = false;
+
+        if (hasAudio) {
+            if (participant._decoder == nullptr) {
+                participant._decoder = AcquireDecoder();
+            }
+
+            const auto sampleCount = participant._decoder->DecodeInto(participant._packet.data(), static_cast<opus_int32>(participant._packet.size()),
+                FrameSampleCount, false, participant._frame.data());
+            participant._isSpeaking = sampleCount == FrameSampleCount;
+            participant._silentFrameCount = 0;
+        }
+        else {
+            participant._silentFrameCount++;
+
+            // A missing packet straight after audio is more likely lost than the end of speech, so it is concealed.
+            if (frame == JitterBuffer::Frame::Lost && participant._decoder != nullptr && participant._silentFrameCount <= ConcealedFrameCount) {
+                const auto sampleCount = participant._decoder->DecodeInto(nullptr, 0, FrameSampleCount, false, participant._frame.data());
+                participant._isSpeaking = sampleCount == FrameSampleCount;
+            }
+            else if (participant._silentFrameCount >= CodecEvictionFrameCount) {
+                ReleaseCodecs(participant, false);
+            }
+        }
+    }
+
+    void AudioMixer::Encode(opus::Encoder& encoder, const std::vector<std::int16_t>& mix, std::vector<std::byte>& packet) {
+        packet.resize(MaximumPacketSize); // Within the capacity reserved when the participant joined.
+
+        const auto size = encoder.EncodeInto(mix.data(), FrameSampleCount, reinterpret_cast<unsigned char*>(packet.data()), MaximumPacketSize);
+        packet.resize(std::max(size, 0));
+    }
+
+    std::unique_ptr<opus::Decoder> AudioMixer::AcquireDecoder() {
+        if (_decoderPool.empty()) {
+            return std::make_unique<opus::Decoder>(SampleRate, 1);
+        }
+
+        // A pooled decoder still holds the state of the stream it last decoded, which would colour the new one's first frames.
+        auto decoder = std::move(_decoderPool.back());
+        _decoderPool.pop_back();
+        decoder->ResetState();
+
+        return decoder;
+    }
+
+    std::unique_ptr<opus::Encoder> AudioMixer::AcquireEncoder() {
+        if (_encoderPool.empty()) {
+            auto encoder = std::make_unique<opus::Encoder>(SampleRate, 1, OPUS_APPLICATION_VOIP);
+            encoder->SetBitrate(_bitrate);
+
+            return encoder;
+        }
+
+        auto encoder = std::move(_encoderPool.back());
+        _encoderPool.pop_back();
+        encoder->ResetState();
+
+        return encoder;
+    }
+
+    void AudioMixer::ReleaseCodecs(Participant& participant, bool isLeaving) {
+        if (participant._decoder != nullptr) {
+            _decoderPool.push_back(std::move(participant._decoder));
+        }
+
+        // A participant who stays keeps their encoder until Mix moves them back onto the shared stream, as their decoder
+        // follows its state.
+        if (isLeaving && participant._encoder != nullptr) {
+            _encoderPool.push_back(std::move(participant._encoder));
+        }
+    }
+}
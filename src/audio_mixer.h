@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+#include "opuscpp/opus_wrapper.h"
+
+#include "jitter_buffer.h"
+
+namespace Comms {
+
+    /*
+    * Decodes the Opus streams of a room's participants and encodes, for each of them, a mix of everyone else.
+    *
+    * Mixing is done one 20 ms frame at a time. The frames of the participants speaking in it are summed once, and each speaker's
+    * mix is the sum minus their own frame, so a frame costs O(N) however many participants there are.
+    * @see MixMinusOne
+    *
+    * Every participant who is not speaking hears the same mix, the whole sum, so it is encoded once and shared between those
+    * without an encoder of their own. An Opus decoder follows the state of the encoder of its stream, so a stream only moves
+    * between encoders whose states match or have converged: when a participant starts speaking, their own encoder starts
+    * from a copy of the shared encoder's state, and it encodes their mix while they speak and for a second after. By then it
+    * has been encoding the same whole sum as the shared encoder for that second, so the participant moves back onto the
+    * shared stream and their encoder returns to a pool. If no one heard the shared stream in the last frame, it takes a copy
+    * of their encoder's state instead. Either way each distinct mix is encoded once, however long the room runs.
+    *
+    * Each participant's packets pass through a JitterBuffer of their own, so a burst of packets is played out a frame at a
+    * time rather than dropped, and a packet that does not arrive in time is concealed.
+    *
+    * Decoders are only held by participants who are sending audio. Silent and DTX packets are recognised from their table
+    * of contents and never decoded, and a participant who has been silent for a second returns their decoder to a pool
+    * shared by the room, so a large room of mostly silent listeners holds only a few decoders.
+    *
+    * Frames are decoded and encoded into buffers held by each participant, so mixing does not allocate once every
+    * participant has joined and spoken.
+    *
+    * Not thread safe. A room's mixer is only used on its worker thread.
+    */
+    class AudioMixer {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param bitrate The bitrate mixes are encoded at, in bits per second.
+        */
+        AudioMixer(int bitrate);
+
+        /*
+        * Adds a participant. They hear the shared mix until they first speak.
+        */
+        void AddParticipant(std::uint32_t participantId);
+
+        /*
+        * Removes a participant, returning their codecs to the pool.
+        */
+        void RemoveParticipant(std::uint32_t participantId);
+
+        /*
+        * Buffers a participant's RTP packet, to be mixed into the frame of its sequence number.
+        *
+        * @param participantId The participant that sent the packet.
+        * @param packet The RTP packet, carrying Opus.
+        */
+        void PushPacket(std::uint32_t participantId, const rtc::binary& packet);
+
+        /*
+        * Mixes one frame and encodes each participant's mix.
+        *
+        * @param send Called with each participant's id and their encoded mix. Participants sharing a mix are given the same packet.
+        */
+        void Mix(const std::function<void(std::uint32_t participantId, const std::vector<std::byte>& packet)>& send);
+
+        /*
+        * @return The number of participants.
+        */
+        std::size_t GetParticipantCount() const;
+
+        /*
+        * @return The number of decoders held by participants, i.e. those sending audio recently.
+        */
+        std::size_t GetActiveDecoderCount() const;
+
+    private:
+        /*
+        * The mixing state of one participant.
+        */
+        struct Participant {
+            std::uint32_t _id; // Identifies the participant.
+            std::unique_ptr<JitterBuffer> _jitterBuffer; // The participant's packets, waiting to be mixed.
+            std::vector<unsigned char> _packet; // The Opus payload of the current frame.
+            std::unique_ptr<opus::Decoder> _decoder; // Decodes the participant's audio. Held only while they are sending audio.
+            std::unique_ptr<opus::Encoder> _encoder; // Encodes the participant's personal mix. Held from when they speak until they have been silent for a second.
+            std::vector<std::int16_t> _frame; // The participant's audio in the current frame. Always a whole frame long.
+            bool _isSpeaking = false; // Whether the participant's audio is in the current frame.
+            std::size_t _silentFrameCount = 0; // Frames since the participant last sent audio.
+            std::vector<std::byte> _encoded; // The participant's encoded personal mix.
+        };
+
+        /*
+        * Decodes a participant's next buffered packet into their frame, concealing a lost packet if they were just speaking.
+        */
+        void Decode(Participant& participant);
+
+        /*
+        * Encodes a frame of mixed audio into a packet, reusing the packet's storage.
+        */
+        void Encode(opus::Encoder& encoder, const std::vector<std::int16_t>& mix, std::vector<std::byte>& packet);
+
+        std::unique_ptr<opus::Decoder> AcquireDecoder();
+        std::unique_ptr<opus::Encoder> AcquireEncoder();
+
+        /*
+        * Returns a participant's decoder to the pool, and their encoder too if they are leaving. @see Mix
+        */
+        void ReleaseCodecs(Participant& participant, bool isLeaving);
+
+        const int _bitrate; // The bitrate mixes are encoded at.
+
+        std::vector<Participant> _participants; // The room's participants.
+        std::vector<std::unique_ptr<opus::Decoder>> _decoderPool; // Decoders not held by any participant.
+        std::vector<std::unique_ptr<opus::Encoder>> _encoderPool; // Encoders not held by any participant.
+
+        std::unique_ptr<opus::Encoder> _sharedEncoder; // Encodes the mix heard by every participant who is not speaking.
+        std::vector<std::byte> _sharedEncoded; // The encoded shared mix.
+        bool _hasSharedListener = false; // Whether anyone heard the shared mix in the last frame, so the shared encoder encoded it.
+
+        std::vector<std::int32_t> _sum; // The sum of the speakers' frames.
+        std::vector<std::int16_t> _mix; // The whole sum, saturated, heard by everyone not speaking.
+        std::vector<std::int16_t> _ownMix; // A speaker's mix, the sum without their own frame.
+    };
+}
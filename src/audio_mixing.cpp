@@ -0,0 +1,153 @@
+#include "audio_mixing.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX2__)
+#define COMMS_MIXING_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMMS_MIXING_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define COMMS_MIXING_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+    std::int16_t Saturate(std::int32_t sample) {
+        return static_cast<std::int16_t>(std::clamp<std::int32_t>(sample, std::numeric_limits<std::int16_t>::min(), std::numeric_limits<std::int16_t>::max()));
+    }
+
+#if defined(COMMS_MIXING_AVX2)
+    constexpr std::size_t VectorSampleCount = 16;
+
+    /*
+    * Packs two vectors of eight 32-bit samples into sixteen saturated 16-bit samples, in order.
+    */
+    __m256i Pack(__m256i low, __m256i high) {
+        // The pack interleaves the 128-bit lanes of its inputs, which the permute puts back in order.
+        return _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high), 0xD8);
+    }
+#elif defined(COMMS_MIXING_SSE2)
+    constexpr std::size_t VectorSampleCount = 8;
+
+    /*
+    * Sign extends the low or high four 16-bit samples of a vector to 32 bits.
+    */
+    __m128i WidenLow(__m128i samples) {
+        return _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    }
+
+    __m128i WidenHigh(__m128i samples) {
+        return _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+    }
+#elif defined(COMMS_MIXING_NEON)
+    constexpr std::size_t VectorSampleCount = 8;
+#else
+    constexpr std::size_t VectorSampleCount = 0;
+#endif
+}
+
+namespace Comms {
+    void AccumulateFrame(std::int32_t* sum, const std::int16_t* frame, std::size_t sampleCount) {
+        std::size_t i = 0;
+
+#if defined(COMMS_MIXING_AVX2)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(frame + i));
+            const __m256i low = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(samples));
+            const __m256i high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(samples, 1));
+
+            auto sumLow = reinterpret_cast<__m256i*>(sum + i);
+            auto sumHigh = reinterpret_cast<__m256i*>(sum + i + 8);
+            _mm256_storeu_si256(sumLow, _mm256_add_epi32(_mm256_loadu_si256(sumLow), low));
+            _mm256_storeu_si256(sumHigh, _mm256_add_epi32(_mm256_loadu_si256(sumHigh), high));
+        }
+#elif defined(COMMS_MIXING_SSE2)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i));
+
+            auto sumLow = reinterpret_cast<__m128i*>(sum + i);
+            auto sumHigh = reinterpret_cast<__m128i*>(sum + i + 4);
+            _mm_storeu_si128(sumLow, _mm_add_epi32(_mm_loadu_si128(sumLow), WidenLow(samples)));
+            _mm_storeu_si128(sumHigh, _mm_add_epi32(_mm_loadu_si128(sumHigh), WidenHigh(samples)));
+        }
+#elif defined(COMMS_MIXING_NEON)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const int16x8_t samples = vld1q_s16(frame + i);
+
+            vst1q_s32(sum + i, vaddw_s16(vld1q_s32(sum + i), vget_low_s16(samples)));
+            vst1q_s32(sum + i + 4, vaddw_s16(vld1q_s32(sum + i + 4), vget_high_s16(samples)));
+        }
+#endif
+
+        for (; i < sampleCount; i++) {
+            sum[i] += frame[i];
+        }
+    }
+
+    void SaturateFrame(std::int16_t* mix, const std::int32_t* sum, std::size_t sampleCount) {
+        std::size_t i = 0;
+
+#if defined(COMMS_MIXING_AVX2)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i));
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i + 8));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(mix + i), Pack(low, high));
+        }
+#elif defined(COMMS_MIXING_SSE2)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i + 4));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(mix + i), _mm_packs_epi32(low, high));
+        }
+#elif defined(COMMS_MIXING_NEON)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            vst1q_s16(mix + i, vcombine_s16(vqmovn_s32(vld1q_s32(sum + i)), vqmovn_s32(vld1q_s32(sum + i + 4))));
+        }
+#endif
+
+        for (; i < sampleCount; i++) {
+            mix[i] = Saturate(sum[i]);
+        }
+    }
+
+    void MixMinusOne(std::int16_t* mix, const std::int32_t* sum, const std::int16_t* own, std::size_t sampleCount) {
+        std::size_t i = 0;
+
+#if defined(COMMS_MIXING_AVX2)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(own + i));
+            const __m256i low = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i)),
+                _mm256_cvtepi16_epi32(_mm256_castsi256_si128(samples)));
+            const __m256i high = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + i + 8)),
+                _mm256_cvtepi16_epi32(_mm256_extracti128_si256(samples, 1)));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(mix + i), Pack(low, high));
+        }
+#elif defined(COMMS_MIXING_SSE2)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(own + i));
+            const __m128i low = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i)), WidenLow(samples));
+            const __m128i high = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + i + 4)), WidenHigh(samples));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(mix + i), _mm_packs_epi32(low, high));
+        }
+#elif defined(COMMS_MIXING_NEON)
+        for (; i + VectorSampleCount <= sampleCount; i += VectorSampleCount) {
+            const int16x8_t samples = vld1q_s16(own + i);
+            const int32x4_t low = vsubw_s16(vld1q_s32(sum + i), vget_low_s16(samples));
+            const int32x4_t high = vsubw_s16(vld1q_s32(sum + i + 4), vget_high_s16(samples));
+
+            vst1q_s16(mix + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+        }
+#endif
+
+        for (; i < sampleCount; i++) {
+            mix[i] = Saturate(sum[i] - own[i]);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Comms {
+
+    /*
+    * Kernels for mixing frames of 16-bit audio, vectorised with AVX2, SSE2 or NEON where the target supports them.
+    *
+    * A room's mix is built in 32-bit accumulators, so summing any number of participants cannot overflow. Each participant's
+    * personal mix, everyone but themselves, is then the room's sum minus their own frame, which costs O(N) for the whole room
+    * rather than O(N^2). Only the final conversion back to 16 bits saturates.
+    */
+
+    /*
+    * Adds a frame to a running sum.
+    *
+    * @param sum The running sum, with one accumulator per sample.
+    * @param frame The frame to add.
+    * @param sampleCount The number of samples in the frame.
+    */
+    void AccumulateFrame(std::int32_t* sum, const std::int16_t* frame, std::size_t sampleCount);
+
+    /*
+    * Converts a sum to 16-bit samples, saturating any that are out of range.
+    *
+    * @param mix Receives the mixed frame.
+    * @param sum The sum of the frames being mixed.
+    * @param sampleCount The number of samples in the frame.
+    */
+    void SaturateFrame(std::int16_t* mix, const std::int32_t* sum, std::size_t sampleCount);
+
+    /*
+    * Builds a participant's personal mix by removing their own frame from the sum of every frame, saturating the result.
+    *
+    * @param mix Receives the mixed frame.
+    * @param sum The sum of every participant's frame, including the participant's own.
+    * @param own The participant's own frame.
+    * @param sampleCount The number of samples in the frame.
+    */
+    void MixMinusOne(std::int16_t* mix, const std::int32_t* sum, const std::int16_t* own, std::size_t sampleCount);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "json/json.hpp"
+
+namespace Comms {
+
+    /*
+    * A reproducible performance measurement run by the CommsBenchmark tool.
+    * Results are reported as JSON so that runs can be stored and compared to track regressions over time.
+    */
+    class Benchmark {
+    public:
+        virtual ~Benchmark() = default;
+
+        /*
+        * Runs the benchmark to completion.
+        *
+        * @return The measured results.
+        */
+        virtual nlohmann::json Run() = 0;
+    };
+}
@@ -0,0 +1,435 @@
+#include "call_load_generator.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "loopback_signalling_client.h"
+#include "network_impairment.h"
+#include "network_impairment_options.h"
+#include "sample_statistics.h"
+#include "synthetic_speech.h"
+#include "web_rtc_peer_connection.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const char* LoadPassword = "load-password";
+
+    constexpr std::chrono::milliseconds FrameInterval(20);
+    constexpr std::chrono::milliseconds PollInterval(5);
+
+    // Time after a step ends for its last packets to arrive before they are counted.
+    constexpr std::chrono::seconds DeliveryGrace(1);
+
+    // Distinct speakers encoded before the run. Calls take turns using them.
+    constexpr std::size_t SpeakerCount = 8;
+
+    // Packets of each direction tracked until they arrive. Covers 5 seconds at 50 packets per second.
+    constexpr std::size_t InFlightCapacity = 256;
+
+    // Bits of a tracked packet's slot holding the time it was sent, below its sequence number.
+    constexpr int SendTimeBits = 48;
+    constexpr std::uint64_t SendTimeMask = (std::uint64_t{ 1 } << SendTimeBits) - 1;
+
+    /*
+    * @return The CPU time the whole process has used, in seconds.
+    */
+    double GetProcessCpuSeconds() {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+
+        const auto toSeconds = [](const FILETIME& time) {
+            return ((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+        };
+
+        return toSeconds(kernel) + toSeconds(user);
+#else
+        timespec time{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+
+        return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+    }
+
+    /*
+    * @return The memory the process has resident, in bytes.
+    */
+    std::size_t GetResidentBytes() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters{};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+
+        return counters.WorkingSetSize;
+#else
+        std::ifstream statm("/proc/self/statm");
+        std::size_t totalPages = 0;
+        std::size_t residentPages = 0;
+        statm >> totalPages >> residentPages;
+
+        return residentPages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    /*
+    * The period a step is measured over, in microseconds since the run started. Packets are only counted if they were sent
+    * within it, so packets still in flight when a step starts or ends are not counted as lost.
+    */
+    struct MeasurementWindow {
+        std::atomic<std::int64_t> _start = std::numeric_limits<std::int64_t>::max(); // When the window opened.
+        std::atomic<std::int64_t> _end = std::numeric_limits<std::int64_t>::max(); // When the window closed.
+
+        bool Contains(std::int64_t time) const {
+            return time >= _start && time < _end;
+        }
+    };
+
+    /*
+    * One direction of a call: the packets one peer sends and the other receives.
+    */
+    struct Direction {
+        const std::vector<Comms::SpeechFrame>* _speech = nullptr; // The frames sent, in a loop.
+        std::size_t _nextFrame = 0; // The frame sent next. Sender thread only.
+        std::optional<std::uint16_t> _nextSequenceNumber; // The sequence number the next frame will be sent with. Sender thread only.
+
+        // Packets sent but not yet received, each slot holding a sequence number and the time it was sent. Zero when empty.
+        std::array<std::atomic<std::uint64_t>, InFlightCapacity> _inFlight{};
+
+        std::atomic<std::uint64_t> _sentCount = 0; // Packets sent within the measurement window.
+        std::atomic<std::uint64_t> _receivedCount = 0; // Packets sent within the measurement window that have arrived.
+        Comms::SampleStatistics _latencies; // Latency of each packet counted in _receivedCount, in milliseconds.
+        std::mutex _latenciesMutex; // Mutex to control read and write access to _latencies.
+
+        /*
+        * Tracks a packet as sent at a time, replacing the packet sent InFlightCapacity packets before it.
+        */
+        void Track(std::uint16_t sequenceNumber, std::int64_t sentAt) {
+            _inFlight[sequenceNumber % InFlightCapacity] = (static_cast<std::uint64_t>(sequenceNumber) << SendTimeBits) |
+                (static_cast<std::uint64_t>(sentAt) & SendTimeMask);
+        }
+
+        /*
+        * Sends the next frame from one peer. The packet is tracked before it is sent wherever its sequence number is
+        * already known, so that it cannot arrive before it is tracked.
+        */
+        void Send(Comms::WebRTCPeerConnection& sender, std::int64_t now, const MeasurementWindow& window) {
+            const auto& frame = (*_speech)[_nextFrame++ % _speech->size()];
+
+            if (_nextSequenceNumber.has_value()) {
+                Track(*_nextSequenceNumber, now);
+            }
+
+            const auto sequenceNumber = sender.SendAudioData(frame._packet, frame._level);
+
+            if (sequenceNumber != _nextSequenceNumber) {
+                Track(sequenceNumber, now);
+            }
+
+            _nextSequenceNumber = static_cast<std::uint16_t>(sequenceNumber + 1);
+
+            if (window.Contains(now)) {
+                _sentCount++;
+            }
+        }
+
+        /*
+        * Matches an arriving packet to when it was sent. Packets that are no longer tracked are ignored.
+        */
+        void Receive(const rtc::binary& packet, std::int64_t now, const MeasurementWindow& window) {
+            if (packet.size() < 4) {
+                return;
+            }
+
+            const auto sequenceNumber = static_cast<std::uint16_t>((std::to_integer<std::uint16_t>(packet[2]) << 8) | std::to_integer<std::uint16_t>(packet[3]));
+            auto& slot = _inFlight[sequenceNumber % InFlightCapacity];
+            auto tracked = slot.load();
+
+            if (tracked == 0 || (tracked >> SendTimeBits) != sequenceNumber || !slot.compare_exchange_strong(tracked, 0)) {
+                return;
+            }
+
+            const auto sentAt = static_cast<std::int64_t>(tracked & SendTimeMask);
+
+            if (window.Contains(sentAt)) {
+                _receivedCount++;
+
+                std::lock_guard<std::mutex> lock(_latenciesMutex);
+                _latencies.Add((now - sentAt) / 1000.0);
+            }
+        }
+    };
+
+    /*
+    * A pair of peers connected to each other, each sending to the other.
+    */
+    struct Call {
+        Direction _offererToAnswerer; // Packets the offerer sends.
+        Direction _answererToOfferer; // Packets the answerer sends.
+        std::atomic<bool> _isConnected = false; // Whether packets are being sent. Cleared if sending fails.
+
+        // Declared after the directions, so they are closed before the directions their callbacks use are destroyed.
+        std::unique_ptr<Comms::WebRTCPeerConnection> _offerer; // The peer that made the offer.
+        std::unique_ptr<Comms::WebRTCPeerConnection> _answerer; // The peer that accepted it.
+    };
+
+    /*
+    * Parses the call count of each step, ascending, skipping values that are not positive integers.
+    */
+    std::vector<std::size_t> ParseCallCounts(const std::vector<std::string>& values) {
+        std::vector<std::size_t> counts;
+
+        for (const auto& value : values) {
+            try {
+                const auto count = std::stoll(value);
+
+                if (count > 0) {
+                    counts.push_back(static_cast<std::size_t>(count));
+                }
+            }
+            catch (const std::exception&) {
+            }
+        }
+
+        if (counts.empty()) {
+            counts = { 1, 10, 25, 50, 100 };
+        }
+
+        std::sort(counts.begin(), counts.end());
+        counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+
+        return counts;
+    }
+}
+
+namespace Comms {
+    CallLoadGenerator::CallLoadGenerator(const CommandLineOptions& options) :
+        _callCounts(ParseCallCounts(options.GetList("calls"))),
+        _durationSeconds(std::max(options.GetDouble("duration", 10.0), 0.1)),
+        _warmUpSeconds(std::max(options.GetDouble("warm-up", 2.0), 0.0)),
+        _senderThreadCount(std::max<std::int64_t>(options.GetInteger("sender-threads", 2), 1)),
+        _bitrate(static_cast<int>(options.GetInteger("bitrate", 32000))),
+        _connectTimeoutSeconds(std::max(options.GetDouble("connect-timeout", 10.0), 1.0)),
+        _impairment(ParseNetworkImpairment(options)) {
+    }
+
+    nlohmann::json CallLoadGenerator::Run() {
+        WebRTCPeerConnection::SetLogLevel(rtc::LogLevel::Warning);
+
+        std::vector<std::vector<SpeechFrame>> speech;
+
+        for (std::size_t speaker = 0; speaker < SpeakerCount; speaker++) {
+            speech.push_back(EncodeSpeech(speaker, _bitrate));
+        }
+
+        const auto runStart = Clock::now();
+        const auto getMicroseconds = [runStart]() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - runStart).count();
+        };
+
+        auto service = std::make_shared<LoopbackSignallingService>();
+        MeasurementWindow window;
+
+        // Every call is created before the senders see it, and never moved, so the senders can read the calls published
+        // so far without a lock.
+        std::vector<std::unique_ptr<Call>> calls(_callCounts.back());
+        std::atomic<std::size_t> publishedCallCount = 0;
+        std::atomic<bool> isStopping = false;
+        std::vector<std::thread> senders;
+
+        for (std::size_t t = 0; t < _senderThreadCount; t++) {
+            senders.emplace_back([&, t]() {
+                // Threads are offset within the frame interval, so their packets are spread out rather than sent in bursts.
+                Clock::time_point nextTick = Clock::now() + FrameInterval * static_cast<int>(t) / static_cast<int>(_senderThreadCount);
+
+                while (!isStopping) {
+                    std::this_thread::sleep_until(nextTick);
+
+                    const auto now = getMicroseconds();
+                    const auto count = publishedCallCount.load(std::memory_order_acquire);
+
+                    for (std::size_t i = t; i < count; i += _senderThreadCount) {
+                        auto& call = *calls[i];
+
+                        if (!call._isConnected) {
+                            continue;
+                        }
+
+                        try {
+                            call._offererToAnswerer.Send(*call._offerer, now, window);
+                            call._answererToOfferer.Send(*call._answerer, now, window);
+                        }
+                        catch (const std::exception&) {
+                            call._isConnected = false;
+                        }
+                    }
+
+                    // A thread that has fallen behind skips the frames it missed rather than sending them in a burst.
+                    nextTick = std::max(nextTick + FrameInterval, Clock::now());
+                }
+            });
+        }
+
+        const auto baselineResidentBytes = GetResidentBytes();
+        const auto connectTimeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(_connectTimeoutSeconds));
+        nlohmann::json steps = nlohmann::json::array();
+        std::size_t callCount = 0;
+
+        for (const auto targetCount : _callCounts) {
+            SampleStatistics connectTimes;
+            std::size_t failedCount = 0;
+
+            // Connect the step's new calls one at a time, so each connect time is not inflated by the others.
+            for (; callCount < targetCount; callCount++) {
+                const auto name = "load-call-" + std::to_string(callCount);
+                auto call = std::make_unique<Call>();
+                auto* rawCall = call.get();
+
+                call->_offererToAnswerer._speech = &speech[(2 * callCount) % SpeakerCount];
+                call->_answererToOfferer._speech = &speech[(2 * callCount + 1) % SpeakerCount];
+                call->_offerer = std::make_unique<WebRTCPeerConnection>(name, LoadPassword, std::make_shared<LoopbackSignallingClient>(service));
+                call->_answerer = std::make_unique<WebRTCPeerConnection>(name, LoadPassword, std::make_shared<LoopbackSignallingClient>(service));
+
+                if (_impairment.has_value()) {
+                    // Every direction of every call is seeded differently, and the same way each run.
+                    auto configuration = *_impairment;
+                    configuration._seed = _impairment->_seed + 2 * callCount;
+                    call->_offerer->SetMediaHandler(std::make_shared<NetworkImpairment>(configuration));
+                    configuration._seed++;
+                    call->_answerer->SetMediaHandler(std::make_shared<NetworkImpairment>(configuration));
+                }
+
+                call->_offerer->OnAudioData([rawCall, &window, &getMicroseconds](const rtc::binary& packet) {
+                    rawCall->_answererToOfferer.Receive(packet, getMicroseconds(), window);
+                });
+                call->_answerer->OnAudioData([rawCall, &window, &getMicroseconds](const rtc::binary& packet) {
+                    rawCall->_offererToAnswerer.Receive(packet, getMicroseconds(), window);
+                });
+
+                const auto connectStart = Clock::now();
+                const auto deadline = connectStart + connectTimeout;
+
+                // The offerer blocks until it is answered, so it connects on its own thread while the answerer waits for its offer.
+                std::thread offerer([rawCall]() { rawCall->_offerer->Connect(); });
+
+                while (!std::holds_alternative<std::string>(service->RetrieveOffer(name, LoadPassword)) && Clock::now() < deadline) {
+                    std::this_thread::sleep_for(PollInterval);
+                }
+
+                if (Clock::now() < deadline) {
+                    call->_answerer->Connect();
+                }
+
+                offerer.join();
+
+                while (Clock::now() < deadline && (call->_offerer->GetConnectionState() != rtc::PeerConnection::State::Connected ||
+                    call->_answerer->GetConnectionState() != rtc::PeerConnection::State::Connected)) {
+                    std::this_thread::sleep_for(PollInterval);
+                }
+
+                if (Clock::now() < deadline) {
+                    connectTimes.Add(std::chrono::duration<double, std::milli>(Clock::now() - connectStart).count());
+                    call->_isConnected = true;
+                }
+                else {
+                    failedCount++;
+                }
+
+                calls[callCount] = std::move(call);
+                publishedCallCount.store(callCount + 1, std::memory_order_release);
+            }
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(_warmUpSeconds));
+
+            // Measure the step.
+            const auto cpuStart = GetProcessCpuSeconds();
+            const auto measureStart = Clock::now();
+            window._start = getMicroseconds();
+
+            std::this_thread::sleep_for(std::chrono::duration<double>(_durationSeconds));
+
+            window._end = getMicroseconds();
+            const auto cpuSeconds = GetProcessCpuSeconds() - cpuStart;
+            const auto measuredSeconds = std::chrono::duration<double>(Clock::now() - measureStart).count();
+            const auto residentBytes = GetResidentBytes();
+
+            std::this_thread::sleep_for(DeliveryGrace);
+
+            std::uint64_t sentCount = 0;
+            std::uint64_t receivedCount = 0;
+            std::size_t connectedCount = 0;
+            SampleStatistics latencies;
+
+            for (std::size_t i = 0; i < callCount; i++) {
+                connectedCount += calls[i]->_isConnected ? 1 : 0;
+
+                for (auto* direction : { &calls[i]->_offererToAnswerer, &calls[i]->_answererToOfferer }) {
+                    sentCount += direction->_sentCount.exchange(0);
+                    receivedCount += direction->_receivedCount.exchange(0);
+
+                    std::lock_guard<std::mutex> lock(direction->_latenciesMutex);
+                    latencies.Merge(direction->_latencies);
+                    direction->_latencies = SampleStatistics();
+                }
+            }
+
+            window._start = std::numeric_limits<std::int64_t>::max();
+            window._end = std::numeric_limits<std::int64_t>::max();
+
+            const double expectedCount = 2.0 * connectedCount * measuredSeconds * (1000.0 / FrameInterval.count());
+
+            steps.push_back({
+                {"calls", callCount},
+                {"connected", connectedCount},
+                {"failed_connections", failedCount},
+                {"connect_ms", connectTimes.ToJson()},
+                {"cpu_percent", 100.0 * cpuSeconds / measuredSeconds},
+                {"cpu_percent_per_call", 100.0 * cpuSeconds / measuredSeconds / callCount},
+                {"memory_bytes_per_call", residentBytes > baselineResidentBytes ? static_cast<double>(residentBytes - baselineResidentBytes) / callCount : 0.0},
+                {"packets_sent", sentCount},
+                {"packets_received", receivedCount},
+                {"loss_percent", sentCount > 0 ? 100.0 * (sentCount - std::min(receivedCount, sentCount)) / sentCount : 0.0},
+                {"send_rate_percent", expectedCount > 0 ? 100.0 * sentCount / expectedCount : 0.0},
+                {"latency_ms", latencies.ToJson()}
+            });
+        }
+
+        isStopping = true;
+
+        for (auto& sender : senders) {
+            sender.join();
+        }
+
+        calls.clear();
+
+        return {
+            {"duration_s", _durationSeconds},
+            {"warm_up_s", _warmUpSeconds},
+            {"sender_threads", _senderThreadCount},
+            {"bitrate", _bitrate},
+            {"impairment", NetworkImpairmentToJson(_impairment)},
+            {"steps", steps}
+        };
+    }
+}
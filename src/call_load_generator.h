@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+#include "network_impairment.h"
+
+namespace Comms {
+
+    /*
+    * Measures how many calls one process can carry by connecting ever more pairs of WebRTCPeerConnections to each other over
+    * loopback, negotiated through an in-process LoopbackSignallingService, and streaming pre-encoded Opus both ways at 50
+    * packets per second, as a real call would.
+    *
+    * Calls are added step by step up to each count in --calls, and are kept up from one step to the next. Once a step's
+    * calls are connected and have warmed up, the step is measured for --duration seconds:
+    *   cpu_percent_per_call    Process CPU time over the step divided by the calls, as a percentage of one core.
+    *   memory_bytes_per_call   Growth of the resident set since before the first call, divided by the calls.
+    *   loss_percent            Packets sent during the step that did not arrive within the ring of 256 tracked packets.
+    *   latency_ms              Time from handing a packet to the connection to it being delivered to the remote peer.
+    *   send_rate_percent       Packets sent against the 50 per second each direction should send, which falls once the
+    *                           pacing threads cannot keep up.
+    * Encoding is done once before the run, so it does not count towards the CPU measured. libdatachannel logs warnings only.
+    *
+    * Options:
+    *   --calls <n,...>          Number of concurrent calls at each step. Default 1,10,25,50,100.
+    *   --duration <s>           Seconds each step is measured for. Default 10.
+    *   --warm-up <s>            Seconds each step runs before it is measured. Default 2.
+    *   --sender-threads <n>     Threads pacing the packets of every call. Default 2.
+    *   --bitrate <n>            Opus bitrate of the streamed speech. Default 32000.
+    *   --connect-timeout <s>    Seconds a call has to connect before it is counted as failed. Default 10.
+    *
+    * Every packet sent can be impaired by a NetworkImpairment, so that loss and latency are measured under reproducible
+    * network conditions. Loss and latency then include the impairment. No impairment by default.
+    *   --loss <percent>         Packets lost. Each independently, unless --loss-burst is given.
+    *   --loss-burst <packets>   Mean length of bursts of loss, by a Gilbert model with the mean loss of --loss.
+    *   --delay <ms>             One-way delay.
+    *   --jitter <ms>            Spread of random delay added to --delay.
+    *   --jitter-distribution    uniform or normal. Default uniform.
+    *   --reorder <percent>      Packets held back so that later packets overtake them.
+    *   --rate <bits/s>          Bandwidth limit of each direction of each call.
+    *   --seed <n>               Seeds the impairment of the first call. Default 1.
+    */
+    class CallLoadGenerator : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The load generator's command line options.
+        */
+        CallLoadGenerator(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const std::vector<std::size_t> _callCounts; // Number of concurrent calls at each step, ascending.
+        const double _durationSeconds; // Seconds each step is measured for.
+        const double _warmUpSeconds; // Seconds each step runs before it is measured.
+        const std::size_t _senderThreadCount; // Threads pacing the packets of every call.
+        const int _bitrate; // Opus bitrate of the streamed speech.
+        const double _connectTimeoutSeconds; // Seconds a call has to connect.
+        const std::optional<NetworkImpairment::Configuration> _impairment; // Applied to every packet sent, if given.
+    };
+}
@@ -0,0 +1,651 @@
+#include "call_manager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "allocation_tracker.h"
+#include "audio_mixing.h"
+#include "http_signalling_client.h"
+#include "metrics.h"
+#include "opus_packet.h"
+#include "pipeline_trace.h"
+#include "web_rtc_peer_connection.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr opus_int32 SampleRate = 48000;
+    constexpr int FrameSampleCount = 960; // 20 ms.
+    constexpr std::chrono::milliseconds FrameInterval(20);
+
+    // Frames buffered by each peer's jitter buffer before playout, absorbing up to 60 ms of network jitter.
+    constexpr std::size_t JitterDelayFrames = 3;
+
+    // Frames of lost packets concealed by the decoder before the peer is treated as silent.
+    constexpr std::size_t ConcealedFrameCount = 3;
+
+    // Frames left queued in either direction before the oldest are dropped, e.g. while a device is stopped, so that
+    // audio is never heard or sent late.
+    constexpr std::size_t MaximumBacklogFrames = 3;
+
+    constexpr std::size_t AudioBufferCapacity = 262144; // The capacity of an AudioBuffer.
+
+    constexpr std::size_t MaximumEncodedSize = 1275; // The largest Opus packet of one frame.
+
+    constexpr std::size_t ReservedCallCount = 8; // Calls the audio thread holds peer lists for before it has to grow.
+
+    // Bits per second the encoder's bitrate is rounded down to, so that it is not reset for every small change in the estimate.
+    constexpr int BitrateStep = 1000;
+
+    Comms::Counter& EncodedFramesTotal = Comms::Metrics::AddCounter("comms_codec_encoded_frames_total", "Frames encoded, once per call however many peers it has.");
+    Comms::Counter& EncodedBytesTotal = Comms::Metrics::AddCounter("comms_codec_encoded_bytes_total", "Bytes of Opus encoded.");
+    Comms::Histogram& EncodeSeconds = Comms::Metrics::AddHistogram("comms_codec_encode_seconds", "Time to encode a frame.", Comms::GetProcessingTimeBounds());
+    Comms::Counter& DecodedFramesTotal = Comms::Metrics::AddCounter("comms_codec_decoded_frames_total", "Frames decoded from packets received.");
+    Comms::Counter& ConcealedFramesTotal = Comms::Metrics::AddCounter("comms_codec_concealed_frames_total", "Frames of lost packets concealed by the decoder.");
+    Comms::Histogram& DecodeSeconds = Comms::Metrics::AddHistogram("comms_codec_decode_seconds", "Time to decode a frame.", Comms::GetProcessingTimeBounds());
+}
+
+namespace Comms {
+    CallManager::Peer::Peer(const std::string& connectionName, std::unique_ptr<AudioConnection> connection) :
+        _connectionName(connectionName),
+        _decoder(SampleRate, 1),
+        _jitterBuffer(JitterDelayFrames, connection->GetTraceId()),
+        _received(FrameSampleCount),
+        _connection(std::move(connection)) {
+        _payload.reserve(JitterBuffer::MaximumPayloadSize); // So that taking a packet from the jitter buffer never allocates.
+    }
+
+    CallManager::Peer::~Peer() {
+        if (_connectThread.joinable()) {
+            _connection->Close();
+            _connectThread.join();
+        }
+    }
+
+    CallManager::Call::Call(CallId id, const std::string& name, const std::string& password, int bitrate, const ConnectionFactory& connectionFactory) :
+        _id(id),
+        _name(name),
+        _password(password),
+        _connectionFactory(connectionFactory),
+        _encoder(SampleRate, 1, OPUS_APPLICATION_VOIP),
+        _peerList(std::make_shared<const PeerList>()),
+        _encoderBitrate(bitrate) {
+        _peers = _peerList.get();
+        _encoder.SetBitrate(bitrate);
+    }
+
+    std::shared_ptr<const CallManager::PeerList> CallManager::Call::GetPeers() {
+        std::lock_guard<std::mutex> lock(_peersMutex);
+        return _peerList;
+    }
+
+    void CallManager::Call::End() {
+        if (_mesh != nullptr) {
+            _mesh->Stop(); // Waits for the signalling thread, so no peer is added after those closed below.
+        }
+
+        const auto peers = GetPeers();
+
+        // Every connection is closed before any is waited for, so that the peers give up connecting together.
+        for (const auto& peer : *peers) {
+            peer->_connection->Close();
+        }
+
+        for (const auto& peer : *peers) {
+            if (peer->_connectThread.joinable()) {
+                peer->_connectThread.join();
+            }
+        }
+    }
+
+    CallManager::CallManager(std::shared_ptr<AudioBuffer> microphone, std::shared_ptr<AudioBuffer> speaker, int bitrate) :
+        CallManager(microphone, speaker, Configuration{ bitrate, {}, {}, {}, {} }) {
+    }
+
+    CallManager::CallManager(std::shared_ptr<AudioBuffer> microphone, std::shared_ptr<AudioBuffer> speaker, const Configuration& configuration) :
+        _bitrate(configuration._bitrate),
+        _signallingClientFactory(configuration._signallingClientFactory ? configuration._signallingClientFactory : []() -> std::shared_ptr<SignallingClient> {
+            return std::make_shared<HttpSignallingClient>();
+        }),
+        _connectionFactory(configuration._connectionFactory ? configuration._connectionFactory : [signallingClientFactory = _signallingClientFactory](const std::string& connectionName, const std::string& password) -> std::unique_ptr<AudioConnection> {
+            return std::make_unique<WebRTCPeerConnection>(connectionName, password, signallingClientFactory());
+        }),
+        _onFrameSent(configuration._onFrameSent),
+        _onFrameQueued(configuration._onFrameQueued),
+        _microphone(microphone),
+        _speaker(speaker),
+        _callList(std::make_shared<const CallList>()),
+        _captured(FrameSampleCount),
+        _sum(FrameSampleCount),
+        _playback(FrameSampleCount),
+        _transferred(FrameSampleCount),
+        _encoded(MaximumEncodedSize) {
+        _calls = _callList.get();
+        _peerLists.reserve(ReservedCallCount);
+
+        if (!configuration._isDriven) {
+            _thread = std::thread(&CallManager::Run, this);
+        }
+    }
+
+    CallManager::~CallManager() {
+        _isStopping = true;
+
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+
+        for (const auto& call : *GetCallList()) {
+            call->End();
+        }
+    }
+
+    CallManager::CallId CallManager::StartCall(const std::string& name, const std::string& password) {
+        return AddCall([this, &name, &password](CallId id) {
+            auto call = std::make_shared<Call>(id, name, password, _bitrate, _connectionFactory);
+            AddPeer(*call, name);
+            return call;
+        });
+    }
+
+    CallManager::CallId CallManager::StartMeshCall(const std::string& roomName, const std::string& password) {
+        return AddCall([this, &roomName, &password](CallId id) {
+            auto call = std::make_shared<Call>(id, roomName, password, _bitrate, _connectionFactory);
+
+            // Seats are taken on the service the pairs' connections signal through, where the offers made on them are found.
+            call->_mesh = std::make_unique<MeshSignalling>(roomName, password, _signallingClientFactory());
+
+            // The call outlives its mesh signalling, which stops before the rest of the call is destroyed.
+            call->_mesh->Start(
+                [this, call = call.get()](const std::string& connectionName) { AddPeer(*call, connectionName); },
+                [this, call = call.get()](const std::string& connectionName) { RemovePeer(*call, connectionName); });
+
+            return call;
+        });
+    }
+
+    CallManager::CallId CallManager::AddCall(const std::function<std::shared_ptr<Call>(CallId id)>& createCall) {
+        CallId id = 0;
+        {
+            std::lock_guard<std::mutex> lock(_callsMutex);
+            id = _nextCallId++;
+        }
+
+        auto call = createCall(id);
+
+        {
+            std::lock_guard<std::mutex> lock(_callsMutex);
+            auto calls = std::make_shared<CallList>(*_callList);
+            calls->push_back(call);
+            ReplaceList<CallList>(_calls, _callList, calls);
+        }
+
+        FreeRetiredLists();
+
+        return id;
+    }
+
+    std::shared_ptr<const CallManager::CallList> CallManager::GetCallList() const {
+        std::lock_guard<std::mutex> lock(_callsMutex);
+        return _callList;
+    }
+
+    void CallManager::EndCall(CallId id) {
+        std::shared_ptr<Call> ended;
+        {
+            std::lock_guard<std::mutex> lock(_callsMutex);
+            auto calls = std::make_shared<CallList>(*_callList);
+            auto call = std::find_if(calls->begin(), calls->end(), [id](const auto& call) { return call->_id == id; });
+
+            if (call == calls->end()) {
+                return;
+            }
+
+            ended = *call;
+            calls->erase(call);
+
+            if (auto other = FindCall(*calls, ended->_transferredTo)) {
+                other->_transferredTo = 0;
+                other->_isHeld = true;
+            }
+
+            ReplaceList<CallList>(_calls, _callList, calls);
+        }
+
+        // Wait for the frame being processed to finish with the previous list, so that it is never the one to close the
+        // connections, and the list can be freed.
+        WaitForFrame();
+        FreeRetiredLists();
+        ended->End();
+    }
+
+    void CallManager::AddPeer(Call& call, const std::string& connectionName) {
+        auto peer = std::make_shared<Peer>(connectionName, call._connectionFactory(connectionName, call._password));
+        peer->_connection->OnAudioData([jitterBuffer = &peer->_jitterBuffer](const rtc::binary& packet) {
+            jitterBuffer->Push(packet);
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(call._peersMutex);
+            auto peers = std::make_shared<PeerList>(*call._peerList);
+            peers->push_back(peer);
+            ReplaceList<PeerList>(call._peers, call._peerList, peers);
+        }
+
+        FreeRetiredLists();
+
+        // Connecting blocks until the peer answers. The peer outlives the thread, which it joins when the call ends.
+        peer->_connectThread = std::thread([connection = peer->_connection.get()]() { connection->Connect(); });
+    }
+
+    void CallManager::RemovePeer(Call& call, const std::string& connectionName) {
+        std::shared_ptr<Peer> peer;
+        {
+            std::lock_guard<std::mutex> lock(call._peersMutex);
+            auto peers = std::make_shared<PeerList>(*call._peerList);
+            auto removed = std::find_if(peers->begin(), peers->end(), [&connectionName](const auto& peer) { return peer->_connectionName == connectionName; });
+
+            if (removed == peers->end()) {
+                return;
+            }
+
+            peer = *removed;
+            peers->erase(removed);
+            ReplaceList<PeerList>(call._peers, call._peerList, peers);
+        }
+
+        // As when a call ends, the frame being processed is never the one to close the connection.
+        WaitForFrame();
+        FreeRetiredLists();
+        peer->_connection->Close();
+
+        if (peer->_connectThread.joinable()) {
+            peer->_connectThread.join();
+        }
+    }
+
+    template <typename List>
+    void CallManager::ReplaceList(std::atomic<const List*>& list, std::shared_ptr<const List>& owner, std::shared_ptr<const List> replacement) {
+        list = replacement.get();
+
+        // Read once the list is replaced, so a frame that had loaded the old one has ended by the time the count passes this.
+        const auto frameCount = _frameCount.load();
+
+        std::lock_guard<std::mutex> lock(_retiredListsMutex);
+        _retiredLists.push_back(RetiredList{ std::exchange(owner, std::move(replacement)), frameCount });
+    }
+
+    void CallManager::FreeRetiredLists() {
+        std::vector<std::shared_ptr<const void>> freed;
+        {
+            std::lock_guard<std::mutex> lock(_retiredListsMutex);
+
+            // A frame that starts after a list was replaced loads the new one, so one not being processed has none.
+            const bool isProcessing = _isProcessing;
+            const auto frameCount = _frameCount.load();
+
+            std::erase_if(_retiredLists, [&](RetiredList& retired) {
+                if (isProcessing && frameCount <= retired._frameCount) {
+                    return false;
+                }
+
+                freed.push_back(std::move(retired._list));
+                return true;
+            });
+        } // Freed once unlocked, as freeing a list can free the last reference to a call or peer.
+    }
+
+    void CallManager::WaitForFrame() {
+        const auto frameCount = _frameCount.load();
+
+        // A frame that starts after the list was replaced loads the new one, so only a frame already started is waited for.
+        while (_isProcessing && _frameCount == frameCount && !_isStopping) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void CallManager::SetHeld(CallId id, bool isHeld) {
+        if (auto call = FindCall(*GetCallList(), id)) {
+            call->_isHeld = isHeld;
+        }
+    }
+
+    void CallManager::SetMuted(CallId id, bool isMuted) {
+        if (auto call = FindCall(*GetCallList(), id)) {
+            call->_isMuted = isMuted;
+        }
+    }
+
+    bool CallManager::Transfer(CallId id, CallId targetId) {
+        std::lock_guard<std::mutex> lock(_callsMutex);
+        const auto& calls = _callList;
+        auto call = FindCall(*calls, id);
+        auto target = FindCall(*calls, targetId);
+
+        if (call == nullptr || target == nullptr || call == target || call->_transferredTo != 0 || target->_transferredTo != 0) {
+            return false;
+        }
+
+        call->_transferredTo = targetId;
+        target->_transferredTo = id;
+        call->_isHeld = false;
+        target->_isHeld = false;
+
+        return true;
+    }
+
+    std::vector<CallManager::CallStatus> CallManager::GetCalls() const {
+        std::vector<CallStatus> statuses;
+
+        for (const auto& call : *GetCallList()) {
+            const auto peers = call->GetPeers();
+            const CallId transferredTo = call->_transferredTo;
+
+            auto state = rtc::PeerConnection::State::New;
+            std::size_t connectedPeerCount = 0;
+            CallStats stats;
+            stats._encoderBitrate = call->_encoderBitrate;
+            stats._maximumEncoderBitrate = _bitrate;
+
+            for (const auto& peer : *peers) {
+                if (peer->_connection->GetConnectionState() == rtc::PeerConnection::State::Connected) {
+                    connectedPeerCount++;
+                }
+
+                const auto connection = peer->_connection->GetStats();
+
+                if (connection._roundTripTime.has_value()) {
+                    stats._roundTripTime = std::max(stats._roundTripTime.value_or(0.0), *connection._roundTripTime);
+                }
+
+                stats._jitter = std::max(stats._jitter, connection._jitter);
+                stats._sentLossFraction = std::max(stats._sentLossFraction, connection._sentLossFraction);
+                stats._sendBitrate += connection._sendBitrate;
+                stats._receiveBitrate += connection._receiveBitrate;
+                stats._sentPackets += connection._sentPackets;
+                stats._receivedPackets += connection._receivedPackets;
+                stats._lostPackets += peer->_jitterBuffer.GetLostCount();
+                stats._latePackets += peer->_jitterBuffer.GetLateCount();
+                stats._bufferedFrames = std::max(stats._bufferedFrames, peer->_jitterBuffer.GetBufferedCount());
+                stats._decodedFrames += peer->_decodedFrames;
+                stats._concealedFrames += peer->_concealedFrames;
+            }
+
+            if (connectedPeerCount > 0) {
+                state = rtc::PeerConnection::State::Connected;
+            }
+            else if (!peers->empty()) {
+                state = peers->front()->_connection->GetConnectionState();
+            }
+            else if (call->_mesh != nullptr && call->_mesh->IsRejected()) {
+                state = rtc::PeerConnection::State::Failed;
+            }
+
+            statuses.push_back({
+                call->_id,
+                call->_name,
+                call->_mesh != nullptr,
+                state,
+                peers->size(),
+                connectedPeerCount,
+                call->_isHeld,
+                call->_isMuted,
+                transferredTo != 0 ? std::optional<CallId>(transferredTo) : std::nullopt,
+                stats
+            });
+        }
+
+        return statuses;
+    }
+
+    void CallManager::Run() {
+        PipelineTrace::NameThread("Audio");
+
+        auto nextFrame = Clock::now();
+
+        while (!_isStopping) {
+            // A frame that has fallen behind is not caught up on in a burst. The backlog limits drop the audio it missed.
+            nextFrame = std::max(nextFrame + FrameInterval, Clock::now());
+            std::this_thread::sleep_until(nextFrame);
+
+            ProcessFrame();
+        }
+    }
+
+    void CallManager::ProcessFrame() {
+        _isProcessing = true;
+        {
+            const auto calls = _calls.load();
+            _peerLists.reserve(calls->size()); // Only grows past ReservedCallCount, before the frame is held to never allocating.
+
+            RealTimeScope realTimeScope("Audio thread"); // Nothing in a frame allocates, however many calls and peers.
+            ProcessCalls(*calls);
+        }
+        _frameCount++; // The lists the frame read can be freed from here on, by the thread that replaced them.
+        _isProcessing = false;
+    }
+
+    void CallManager::ProcessCalls(const CallList& calls) {
+        // Each call's list of peers is loaded once, so that every step of the frame sees the same peers.
+        for (const auto& call : calls) {
+            _peerLists.push_back(call->_peers.load());
+        }
+
+        // Capture one frame, shared by every call it is sent on.
+        while (_microphone->read_available() > MaximumBacklogFrames * FrameSampleCount) {
+            _microphoneRead += _microphone->pop(_captured.data(), FrameSampleCount);
+        }
+
+        const auto firstCapturedSample = _microphoneRead;
+        const bool isCaptured = _microphone->read_available() >= FrameSampleCount && _microphone->pop(_captured.data(), FrameSampleCount) == FrameSampleCount;
+
+        if (isCaptured) {
+            _microphoneRead += FrameSampleCount;
+        }
+
+        const auto level = isCaptured ? MeasureAudioLevel(_captured.data(), _captured.size()) : AudioLevel{};
+
+        for (const auto& peers : _peerLists) {
+            for (const auto& peer : *peers) {
+                Decode(*peer);
+            }
+        }
+
+        // Play every peer of every call being listened to.
+        bool isHeard = false;
+        std::fill(_sum.begin(), _sum.end(), 0);
+
+        for (std::size_t i = 0; i < calls.size(); i++) {
+            const auto& call = calls[i];
+
+            if (call->_isHeld || call->_transferredTo != 0) {
+                continue;
+            }
+
+            for (const auto& peer : *_peerLists[i]) {
+                if (peer->_hasReceived) {
+                    AccumulateFrame(_sum.data(), peer->_received.data(), FrameSampleCount);
+                    isHeard = true;
+                }
+            }
+        }
+
+        if (isHeard && _speaker->write_available() >= AudioBufferCapacity - MaximumBacklogFrames * FrameSampleCount) {
+            SaturateFrame(_playback.data(), _sum.data(), FrameSampleCount);
+            _speaker->push(_playback.data(), FrameSampleCount);
+
+            if (_onFrameQueued) {
+                for (std::size_t i = 0; i < calls.size(); i++) {
+                    if (calls[i]->_isHeld || calls[i]->_transferredTo != 0) {
+                        continue;
+                    }
+
+                    for (const auto& peer : *_peerLists[i]) {
+                        if (peer->_hasReceived && peer->_receivedSequenceNumber != PipelineTrace::NoSequenceNumber) {
+                            _onFrameQueued(static_cast<std::uint16_t>(peer->_receivedSequenceNumber), _speakerWritten, peer->_decodeMicroseconds);
+                        }
+                    }
+                }
+            }
+
+            _speakerWritten += FrameSampleCount;
+        }
+
+        // Send the microphone, or for a transferred call the other call's audio.
+        for (std::size_t i = 0; i < calls.size(); i++) {
+            const auto& call = calls[i];
+
+            if (call->_isHeld) {
+                continue;
+            }
+
+            if (const CallId transferredTo = call->_transferredTo; transferredTo != 0) {
+                const auto other = std::find_if(calls.begin(), calls.end(), [transferredTo](const auto& call) { return call->_id == transferredTo; });
+
+                if (other == calls.end()) {
+                    continue;
+                }
+
+                // Every peer of the other call is mixed into the one frame sent.
+                bool isReceived = false;
+                std::fill(_sum.begin(), _sum.end(), 0);
+
+                for (const auto& peer : *_peerLists[other - calls.begin()]) {
+                    if (peer->_hasReceived) {
+                        AccumulateFrame(_sum.data(), peer->_received.data(), FrameSampleCount);
+                        isReceived = true;
+                    }
+                }
+
+                if (isReceived) {
+                    SaturateFrame(_transferred.data(), _sum.data(), FrameSampleCount);
+                    Send(*call, *_peerLists[i], _transferred, MeasureAudioLevel(_transferred.data(), _transferred.size()));
+                }
+            }
+            else if (isCaptured && !call->_isMuted) {
+                const auto sequenceNumber = Send(*call, *_peerLists[i], _captured, level);
+
+                if (_onFrameSent && sequenceNumber != PipelineTrace::NoSequenceNumber) {
+                    _onFrameSent(static_cast<std::uint16_t>(sequenceNumber), firstCapturedSample, _encodeMicroseconds);
+                }
+            }
+        }
+
+        _peerLists.clear(); // Keeps the capacity for the next tick.
+    }
+
+    void CallManager::Decode(Peer& peer) {
+        AllocationScope scope(AllocationTag::Codec);
+        peer._hasReceived = false;
+        peer._receivedSequenceNumber = PipelineTrace::NoSequenceNumber;
+        std::uint16_t sequenceNumber = 0;
+
+        switch (peer._jitterBuffer.Pop(peer._payload, &sequenceNumber)) {
+            case JitterBuffer::Frame::Packet:
+                if (IsOpusSilence(reinterpret_cast<const std::byte*>(peer._payload.data()), peer._payload.size())) {
+                    peer._concealedCount = ConcealedFrameCount; // Nothing to conceal after silence.
+                }
+                else {
+                    TraceSpan span(TraceStage::Decode, sequenceNumber, peer._connection->GetTraceId());
+                    const auto decodeStart = PipelineTrace::Now();
+                    const int decodedCount = peer._decoder.DecodeInto(peer._payload.data(), static_cast<opus_int32>(peer._payload.size()), FrameSampleCount, false, peer._received.data());
+                    peer._decodeMicroseconds = PipelineTrace::Now() - decodeStart;
+                    DecodeSeconds.Observe(peer._decodeMicroseconds / 1e6);
+                    peer._hasReceived = decodedCount == FrameSampleCount;
+                    peer._receivedSequenceNumber = sequenceNumber;
+                    peer._concealedCount = 0;
+                    peer._decodedFrames++;
+                    DecodedFramesTotal.Increment();
+                }
+                break;
+            case JitterBuffer::Frame::Lost:
+                if (peer._concealedCount < ConcealedFrameCount) {
+                    TraceSpan span(TraceStage::Conceal, sequenceNumber, peer._connection->GetTraceId());
+                    const int concealedCount = peer._decoder.DecodeInto(nullptr, 0, FrameSampleCount, false, peer._received.data());
+                    peer._hasReceived = concealedCount == FrameSampleCount;
+                    peer._concealedCount++;
+                    peer._concealedFrames++;
+                    ConcealedFramesTotal.Increment();
+                }
+                break;
+            case JitterBuffer::Frame::Waiting:
+                break;
+        }
+    }
+
+    std::int32_t CallManager::Send(Call& call, const PeerList& peers, const std::vector<opus_int16>& frame, AudioLevel level) {
+        const auto isConnected = [](const auto& peer) { return peer->_connection->GetConnectionState() == rtc::PeerConnection::State::Connected; };
+
+        // Nothing is encoded for a call with no one to send to, so its encoder is not advanced past audio never sent.
+        if (std::none_of(peers.begin(), peers.end(), isConnected)) {
+            return PipelineTrace::NoSequenceNumber;
+        }
+
+        // Encoded at the bitrate the worst path to a peer can carry, as every peer is sent the same packet.
+        int bitrate = _bitrate;
+
+        for (const auto& peer : peers) {
+            if (isConnected(peer)) {
+                bitrate = std::min(bitrate, peer->_connection->GetTargetBitrate());
+            }
+        }
+
+        bitrate = bitrate / BitrateStep * BitrateStep;
+
+        if (bitrate != call._encoderBitrate) {
+            call._encoder.SetBitrate(bitrate);
+            call._encoderBitrate = bitrate;
+        }
+
+        AllocationScope scope(AllocationTag::Codec);
+        const auto encodeStart = PipelineTrace::Now();
+        _encoded.resize(MaximumEncodedSize); // Never allocates, as the buffer is kept at its largest size.
+        const int encodedSize = call._encoder.EncodeInto(frame.data(), FrameSampleCount, reinterpret_cast<unsigned char*>(_encoded.data()), MaximumEncodedSize);
+        const auto encodeEnd = PipelineTrace::Now();
+
+        if (encodedSize <= 0) {
+            return PipelineTrace::NoSequenceNumber;
+        }
+
+        _encoded.resize(static_cast<std::size_t>(encodedSize));
+        _encodeMicroseconds = encodeEnd - encodeStart;
+        EncodeSeconds.Observe(_encodeMicroseconds / 1e6);
+        EncodedFramesTotal.Increment();
+        EncodedBytesTotal.Increment(_encoded.size());
+
+        // The same packet goes to every peer. Each connection's packetizer writes its own RTP header around it.
+        AllocationScope sendScope(AllocationTag::Transport);
+        std::int32_t sentSequenceNumber = PipelineTrace::NoSequenceNumber; // The packet's sequence number to the first peer.
+        std::uint32_t sentTraceId = PipelineTrace::NoConnectionId; // The first peer's connection.
+
+        for (const auto& peer : peers) {
+            if (!isConnected(peer)) {
+                continue;
+            }
+
+            try {
+                const auto sequenceNumber = peer->_connection->SendAudioData(_encoded, level);
+
+                if (sentSequenceNumber == PipelineTrace::NoSequenceNumber) {
+                    sentSequenceNumber = sequenceNumber;
+                    sentTraceId = peer->_connection->GetTraceId();
+                }
+            }
+            catch (const std::exception&) {
+                // The connection closed between checking it and sending. The peer has left.
+            }
+        }
+
+        // Recorded once the packet's sequence number is known, so that encoding starts its journey.
+        PipelineTrace::Record(TraceStage::Encode, encodeStart, encodeEnd, sentSequenceNumber, sentTraceId);
+
+        return sentSequenceNumber;
+    }
+
+    std::shared_ptr<CallManager::Call> CallManager::FindCall(const CallList& calls, CallId id) {
+        auto call = std::find_if(calls.begin(), calls.end(), [id](const auto& call) { return call->_id == id; });
+
+        return call != calls.end() ? *call : nullptr;
+    }
+}
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "opuscpp/opus_wrapper.h"
+
+#include "audio_connection.h"
+#include "audio_input_output.h"
+#include "jitter_buffer.h"
+#include "mesh_signalling.h"
+#include "pipeline_trace.h"
+#include "signalling_client.h"
+
+namespace Comms {
+
+    /*
+    * Holds any number of concurrent calls, all sharing the one pair of microphone and speaker queues of an AudioInputOutput.
+    *
+    * A call is either with one peer, or a mesh: a small group in which every peer connects to every other directly, with no
+    * server. @see MeshSignalling
+    *
+    * Every 20 ms the manager's audio thread takes one frame from the microphone and hands that same frame to the encoder of
+    * each call it is sent on, so capture is never copied per call. Each call encodes the frame once, however many peers it
+    * has, at the lowest bitrate congestion control estimates the paths to its peers can carry, and the packet is sent to
+    * every peer with that peer's own RTP header. The thread then takes the next frame from each peer's jitter buffer,
+    * decodes it, and sums the peers being listened to into one frame for the speakers. The thread takes no locks: calls
+    * and their peers are read from immutable lists that are swapped whole when one is added or removed, through atomic
+    * pointers that are always lock-free, and packets reach the jitter buffers, and leave for each connection's pacer,
+    * through lock-free queues, so it never waits on the network. A list swapped out is freed by a thread changing the
+    * lists, once no frame can still be reading it, so the audio thread never holds the last reference to a call or peer.
+    * Each frame runs as real-time, and never allocates. @see RealTimeScope
+    *
+    * A call can be:
+    *   active       Heard on the speakers and sent the microphone. Several active calls are heard at once, e.g. to monitor
+    *                several channels.
+    *   muted        Heard, but not sent the microphone.
+    *   held         Neither heard nor sent anything, until it is resumed.
+    *   transferred  Connected to another call, each hearing the other, and neither heard nor sent the microphone.
+    *
+    * Peers are connected over WebRTCPeerConnections through the hosted signalling service, unless the manager is given
+    * another service or another way to connect them, e.g. a benchmark's connections over loopback. The peers of a group call
+    * meet, in a room or in seats, on the same service as their connections signal through. A manager can also be driven, with no audio
+    * thread of its own, so that a simulation on a VirtualClock ticks it. @see Configuration
+    */
+    class CallManager {
+    public:
+        using CallId = std::uint32_t;
+
+        /*
+        * Makes the connection to a peer, not yet connected.
+        *
+        * @param connectionName The name of the connection.
+        * @param password The password of the call.
+        */
+        using ConnectionFactory = std::function<std::unique_ptr<AudioConnection>(const std::string& connectionName, const std::string& password)>;
+
+        /*
+        * Makes a client of the signalling service that peers meet through.
+        */
+        using SignallingClientFactory = std::function<std::shared_ptr<SignallingClient>()>;
+
+        /*
+        * Called on the audio thread with a frame's RTP sequence number, the index of its first sample and the time the codec
+        * spent on it: among every sample taken from the microphone queue, dropped or not, and the time encoding it, for a
+        * frame sent, or among every sample written to the speaker queue, and the time decoding it, for a frame queued to be
+        * played. For measuring latency, so it must return quickly. The audio thread is real-time, so a handler that allocates
+        * does so in a RealTimeScope with no name, for its allocations not to be flagged as the frame's.
+        */
+        using FrameHandler = std::function<void(std::uint16_t sequenceNumber, std::uint64_t firstSample, std::int64_t codecMicroseconds)>;
+
+        struct Configuration {
+            int _bitrate = 32000; // The highest bitrate each call's audio is encoded at, in bits per second.
+            ConnectionFactory _connectionFactory; // Makes each peer's connection. WebRTCPeerConnections through _signallingClientFactory if not set.
+            // Makes the client each group call meets its peers with, and the client each default connection signals through.
+            // The hosted service if not set. Peers must meet on the service the connections signal through, for a peer to find
+            // the offers made to it, so a manager given a _connectionFactory for group calls is given this too.
+            SignallingClientFactory _signallingClientFactory;
+            FrameHandler _onFrameSent; // Called for each frame of the microphone sent, if set.
+            FrameHandler _onFrameQueued; // Called for each frame decoded from a packet and queued to be played, if set.
+            bool _isDriven = false; // Whether frames are only processed when ProcessFrame is called, rather than on an audio thread.
+        };
+
+        /*
+        * A snapshot of a call's audio and of the paths to its peers, for display while it runs. Read without taking a lock
+        * any thread sending, receiving or playing the audio does. A call with several peers reports its worst path, and its
+        * traffic summed over the peers.
+        */
+        struct CallStats {
+            std::optional<double> _roundTripTime; // The longest smoothed round trip time to a peer in milliseconds, if any is known.
+            double _jitter = 0.0; // The highest interarrival jitter of the audio received from a peer, in milliseconds.
+            double _sentLossFraction = 0.0; // The highest fraction of the packets sent that a peer reported lost, over about a second.
+            int _sendBitrate = 0; // Audio sent over the last second, headers included, in bits per second.
+            int _receiveBitrate = 0; // Audio received over the last second, headers included, in bits per second.
+            std::uint64_t _sentPackets = 0; // Audio packets sent.
+            std::uint64_t _receivedPackets = 0; // Audio packets received.
+            std::uint64_t _lostPackets = 0; // Received packets that did not arrive in time to be played.
+            std::uint64_t _latePackets = 0; // Received packets dropped because they arrived after their frame was played.
+            std::size_t _bufferedFrames = 0; // The most frames waiting in a peer's jitter buffer.
+            std::uint64_t _decodedFrames = 0; // Frames decoded from packets received.
+            std::uint64_t _concealedFrames = 0; // Frames of lost packets concealed by the decoder.
+            int _encoderBitrate = 0; // The bitrate the call's audio is encoded at, in bits per second.
+            int _maximumEncoderBitrate = 0; // The highest bitrate it is encoded at, whatever the paths can carry.
+        };
+
+        /*
+        * The state of a call, for display.
+        */
+        struct CallStatus {
+            CallId _id; // Identifies the call.
+            std::string _name; // The connection or room name the call was made with.
+            bool _isMesh; // Whether the call is with a group of peers.
+            rtc::PeerConnection::State _state; // Connected if any peer is, otherwise the state of the first peer's connection.
+            std::size_t _peerCount; // Peers the call has connections to, including those still connecting.
+            std::size_t _connectedPeerCount; // Peers the call is connected to.
+            bool _isHeld; // Whether the call is on hold.
+            bool _isMuted; // Whether the microphone is not sent on the call.
+            std::optional<CallId> _transferredTo; // The call it has been transferred to, if it has.
+            CallStats _stats; // The call's statistics.
+        };
+
+        /*
+        * Constructor. Starts the audio thread.
+        *
+        * @param microphone The queue the AudioInputOutput writes captured audio to. The manager is its only reader.
+        * @param speaker The queue the AudioInputOutput plays audio from. The manager is its only writer.
+        * @param bitrate The highest bitrate each call's audio is encoded at, in bits per second.
+        */
+        CallManager(std::shared_ptr<AudioBuffer> microphone, std::shared_ptr<AudioBuffer> speaker, int bitrate = 32000);
+
+        /*
+        * Constructor. Starts the audio thread, unless the manager is driven.
+        *
+        * @param microphone The queue the AudioInputOutput writes captured audio to. The manager is its only reader.
+        * @param speaker The queue the AudioInputOutput plays audio from. The manager is its only writer.
+        * @param configuration How calls are encoded and connected.
+        */
+        CallManager(std::shared_ptr<AudioBuffer> microphone, std::shared_ptr<AudioBuffer> speaker, const Configuration& configuration);
+
+        /*
+        * Destructor. Stops the audio thread, then ends every call, waiting for those still connecting to give up.
+        */
+        ~CallManager();
+
+        CallManager(const CallManager&) = delete;
+        CallManager& operator=(const CallManager&) = delete;
+
+        /*
+        * Starts a call with one peer, connecting in the background. The call is active as soon as it connects.
+        *
+        * @param name An identifier for the connection.
+        * @param password A password used to grant access to the connection.
+        * @return The id of the new call.
+        */
+        CallId StartCall(const std::string& name, const std::string& password);
+
+        /*
+        * Joins a group call, connecting to each peer in the room in the background, now and as they join.
+        *
+        * @param roomName The name of the room.
+        * @param password The password of the room, shared by every peer in it.
+        * @return The id of the new call.
+        */
+        CallId StartMeshCall(const std::string& roomName, const std::string& password);
+
+        /*
+        * Ends a call. A call it was transferred to is put on hold. Returns once the call's connections are closed, including
+        * any still connecting.
+        */
+        void EndCall(CallId id);
+
+        /*
+        * Puts a call on hold, or resumes it.
+        */
+        void SetHeld(CallId id, bool isHeld);
+
+        /*
+        * Stops or starts sending the microphone on a call.
+        */
+        void SetMuted(CallId id, bool isMuted);
+
+        /*
+        * Connects two calls to each other, so that each hears the other and neither hears the microphone.
+        * The calls stay with the manager until they are ended.
+        *
+        * @return False if either call does not exist, they are the same call, or either is already transferred.
+        */
+        bool Transfer(CallId id, CallId targetId);
+
+        /*
+        * @return The state and statistics of each call, in the order they were started.
+        */
+        std::vector<CallStatus> GetCalls() const;
+
+        /*
+        * Captures a frame from the microphone and sends it on each call, and plays each peer's next frame. The audio thread
+        * calls it every 20 ms. A driven manager is ticked by calling it instead, from one thread at a time.
+        */
+        void ProcessFrame();
+
+    private:
+        /*
+        * One remote peer of a call: its connection and the decoding of its audio.
+        */
+        struct Peer {
+            const std::string _connectionName; // The name of the connection to the peer.
+            opus::Decoder _decoder; // Decodes the audio received from the peer. Audio thread only.
+            JitterBuffer _jitterBuffer; // Packets received from the peer, waiting to be decoded.
+            std::vector<unsigned char> _payload; // The payload being decoded. Audio thread only.
+            std::vector<opus_int16> _received; // The frame decoded in the current tick. Audio thread only.
+            bool _hasReceived = false; // Whether a frame was decoded in the current tick. Audio thread only.
+            std::int32_t _receivedSequenceNumber = PipelineTrace::NoSequenceNumber; // The packet _received was decoded from, if not concealed. Audio thread only.
+            std::int64_t _decodeMicroseconds = 0; // The time decoding _received took. Audio thread only.
+            std::size_t _concealedCount = 0; // Consecutive lost frames concealed by the decoder. Audio thread only.
+            std::atomic<std::uint64_t> _decodedFrames = 0; // Frames decoded from packets. Written by the audio thread.
+            std::atomic<std::uint64_t> _concealedFrames = 0; // Frames of lost packets concealed. Written by the audio thread.
+
+            // Declared last, so the connection is closed before the jitter buffer its callback writes to is destroyed.
+            std::unique_ptr<AudioConnection> _connection; // The connection to the peer.
+            std::thread _connectThread; // Connects _connection, which blocks until the peer answers or it is closed.
+
+            /*
+            * Constructor.
+            *
+            * @param connectionName The name of the connection to the peer.
+            * @param connection The connection, not yet connected.
+            */
+            Peer(const std::string& connectionName, std::unique_ptr<AudioConnection> connection);
+
+            /*
+            * Destructor. Closes the connection if it is still connecting, and waits for the connecting thread.
+            */
+            ~Peer();
+        };
+
+        using PeerList = std::vector<std::shared_ptr<Peer>>;
+
+        /*
+        * One call, its peers and its encoder.
+        */
+        struct Call {
+            const CallId _id; // Identifies the call.
+            const std::string _name; // The connection or room name the call was made with.
+            const std::string _password; // The password of the connection or room.
+            const ConnectionFactory& _connectionFactory; // Makes the connection to each peer. The manager's, which outlives the call.
+
+            opus::Encoder _encoder; // Encodes the audio sent on the call, once for all of its peers. Audio thread only.
+            std::atomic<const PeerList*> _peers; // The call's peers, read by the audio thread. Replaced whole when one is added or removed.
+            std::shared_ptr<const PeerList> _peerList; // Owns the list _peers points to. Requires _peersMutex.
+            std::mutex _peersMutex; // Serialises changes to _peers and _peerList. Never taken by the audio thread.
+            std::atomic<int> _encoderBitrate; // The bitrate the encoder is set to. Written by the audio thread.
+
+            std::atomic<bool> _isHeld = false; // Whether the call is on hold.
+            std::atomic<bool> _isMuted = false; // Whether the microphone is not sent on the call.
+            std::atomic<CallId> _transferredTo = 0; // The call it has been transferred to, or 0.
+
+            // Declared last, so it stops adding peers before the rest of the call is destroyed. Null for a call with one peer.
+            std::unique_ptr<MeshSignalling> _mesh; // Finds the peers of a group call.
+
+            Call(CallId id, const std::string& name, const std::string& password, int bitrate, const ConnectionFactory& connectionFactory);
+
+            /*
+            * @return The call's peers. Never called on the audio thread, which reads _peers.
+            */
+            std::shared_ptr<const PeerList> GetPeers();
+
+            /*
+            * Stops finding peers, closes the connection to each, and waits for those still connecting to give up.
+            * Never called on the audio thread.
+            */
+            void End();
+        };
+
+        using CallList = std::vector<std::shared_ptr<Call>>;
+
+        /*
+        * A list of calls or peers swapped out, kept until no frame can still be reading it.
+        */
+        struct RetiredList {
+            std::shared_ptr<const void> _list; // The list.
+            std::uint64_t _frameCount; // The frames processed once it was swapped out. Freed once another has been.
+        };
+
+        static_assert(std::atomic<const CallList*>::is_always_lock_free && std::atomic<const PeerList*>::is_always_lock_free);
+
+        /*
+        * Adds a call to the list the audio thread reads.
+        *
+        * @return The call's id.
+        */
+        CallId AddCall(const std::function<std::shared_ptr<Call>(CallId id)>& createCall);
+
+        /*
+        * @return The calls. Never called on the audio thread, which reads _calls.
+        */
+        std::shared_ptr<const CallList> GetCallList() const;
+
+        /*
+        * Connects to a peer of a call in the background, and adds it to the call.
+        *
+        * @param connectionName The name of the connection to the peer.
+        */
+        void AddPeer(Call& call, const std::string& connectionName);
+
+        /*
+        * Removes a peer that has left a group call and closes its connection. Never called on the audio thread.
+        */
+        void RemovePeer(Call& call, const std::string& connectionName);
+
+        /*
+        * Points the audio thread at a new list of calls or peers, and retires the list it replaces. Requires the mutex
+        * serialising changes to the list.
+        *
+        * @param list The pointer the audio thread reads.
+        * @param owner Owns the list the pointer points to.
+        * @param replacement The new list.
+        */
+        template <typename List>
+        void ReplaceList(std::atomic<const List*>& list, std::shared_ptr<const List>& owner, std::shared_ptr<const List> replacement);
+
+        /*
+        * Frees the lists retired that no frame can still be reading: those retired before a frame that has since ended, or
+        * any, if no frame is being processed. Never called on the audio thread, nor with the mutex of a list held, as
+        * freeing a list can free the last reference to a call or peer.
+        */
+        void FreeRetiredLists();
+
+        /*
+        * Waits for the frame being processed, if any, to finish, and with it any list of calls or peers it read. Returns
+        * at once if no frame is being processed, e.g. when called between the ticks of a driven manager, or if the manager
+        * is stopping.
+        */
+        void WaitForFrame();
+
+        /*
+        * Processes one frame every 20 ms until stopped.
+        */
+        void Run();
+
+        /*
+        * Processes one frame for a list of calls. Audio thread only.
+        */
+        void ProcessCalls(const CallList& calls);
+
+        /*
+        * Decodes a peer's next frame into _received, concealing a lost packet. Audio thread only.
+        */
+        void Decode(Peer& peer);
+
+        /*
+        * Encodes a frame once and sends it to each of a call's connected peers. Audio thread only.
+        *
+        * @return The RTP sequence number the frame was sent to the first peer with, or NoSequenceNumber if it was not sent.
+        */
+        std::int32_t Send(Call& call, const PeerList& peers, const std::vector<opus_int16>& frame, AudioLevel level);
+
+        /*
+        * @return The call with an id in a list, or null.
+        */
+        static std::shared_ptr<Call> FindCall(const CallList& calls, CallId id);
+
+        const int _bitrate; // The highest bitrate each call's audio is encoded at.
+        const SignallingClientFactory _signallingClientFactory; // Makes the clients of the signalling service peers meet through.
+        const ConnectionFactory _connectionFactory; // Makes each peer's connection.
+        const FrameHandler _onFrameSent; // Called for each frame of the microphone sent, if set.
+        const FrameHandler _onFrameQueued; // Called for each frame decoded from a packet and queued to be played, if set.
+
+        std::shared_ptr<AudioBuffer> _microphone; // Captured audio, read only by the audio thread.
+        std::shared_ptr<AudioBuffer> _speaker; // Audio to play, written only by the audio thread.
+
+        std::atomic<const CallList*> _calls; // The calls, read by the audio thread. Replaced whole when one is added or removed.
+        std::shared_ptr<const CallList> _callList; // Owns the list _calls points to. Requires _callsMutex.
+        mutable std::mutex _callsMutex; // Serialises changes to _calls and _callList. Never taken by the audio thread.
+        CallId _nextCallId = 1; // The id of the next call started. Requires _callsMutex.
+        std::vector<RetiredList> _retiredLists; // Lists of calls and peers swapped out. Requires _retiredListsMutex.
+        std::mutex _retiredListsMutex; // Mutex to control read and write access to _retiredLists. Never taken by the audio thread.
+
+        std::vector<opus_int16> _captured; // The frame taken from the microphone in the current tick. Audio thread only.
+        std::vector<std::int32_t> _sum; // The sum of the frames being mixed. Audio thread only.
+        std::vector<std::int16_t> _playback; // The frame written to the speakers in the current tick. Audio thread only.
+        std::vector<opus_int16> _transferred; // The frame sent on a transferred call. Audio thread only.
+        std::vector<std::byte> _encoded; // The packet encoded for a call, sent to each of its peers. Audio thread only.
+        std::int64_t _encodeMicroseconds = 0; // The time encoding _encoded took. Audio thread only.
+        std::vector<const PeerList*> _peerLists; // Each call's peers, loaded for the current tick. Audio thread only.
+        std::uint64_t _microphoneRead = 0; // Samples taken from the microphone queue, including those dropped. Audio thread only.
+        std::uint64_t _speakerWritten = 0; // Samples written to the speaker queue. Audio thread only.
+
+        std::atomic<std::uint64_t> _frameCount = 0; // Frames processed, counted once each frame has finished with the lists it read.
+        std::atomic<bool> _isProcessing = false; // Set while a frame is being processed, from before its list of calls is loaded.
+        std::atomic<bool> _isStopping = false; // Set when the audio thread is stopping.
+        std::thread _thread; // The audio thread. Not started for a driven manager.
+    };
+}
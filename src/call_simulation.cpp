@@ -0,0 +1,354 @@
+#include "call_simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "allocation_tracker.h"
+#include "audio_connection.h"
+#include "audio_input_output.h"
+#include "call_manager.h"
+#include "network_impairment_options.h"
+#include "pipeline_trace.h"
+#include "rtp_audio_packetizer.h"
+#include "sample_statistics.h"
+#include "synthetic_speech.h"
+#include "virtual_clock.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const char* ConnectionPassword = "simulation-password";
+
+    constexpr int SampleRate = 48000;
+    constexpr std::size_t DevicePeriodSampleCount = 480; // 10 ms, a typical shared-mode device period.
+    constexpr std::chrono::milliseconds DevicePeriod(10);
+    constexpr std::chrono::milliseconds FrameInterval(20);
+
+    // The audio thread ticks halfway between device periods, so that neither waits on the other.
+    constexpr std::chrono::milliseconds FrameOffset(5);
+
+    constexpr std::uint8_t OpusPayloadType = 111;
+    constexpr int AudioLevelExtensionId = 1;
+    constexpr std::size_t MaximumPacketSize = 1500; // The largest audio packet, reserved up front so packetising never allocates.
+
+    constexpr std::uint64_t FnvOffsetBasis = 14695981039346656037ull;
+    constexpr std::uint64_t FnvPrime = 1099511628211ull;
+
+    /*
+    * @return The FNV-1a hash of the bytes, continuing from a previous hash.
+    */
+    std::uint64_t Hash(std::uint64_t hash, const void* data, std::size_t size) {
+        const auto bytes = static_cast<const unsigned char*>(data);
+
+        for (std::size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * FnvPrime;
+        }
+
+        return hash;
+    }
+
+    /*
+    * @return The hash as 16 hexadecimal digits. JSON numbers cannot hold every 64 bit value exactly.
+    */
+    std::string ToHex(std::uint64_t hash) {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+        return text;
+    }
+
+    /*
+    * One direction of a simulated call's network, as a CallManager's connection to the remote end: packets sent are wrapped
+    * in RTP, cross a NetworkImpairmentModel, and are handed to the remote end's connection at the virtual time they arrive.
+    * Connected from the start, and never estimates less than the manager's bitrate, as congestion control is not simulated.
+    */
+    class SimulatedConnection : public Comms::AudioConnection {
+    public:
+        SimulatedConnection(Comms::VirtualClock& clock, std::uint32_t ssrc, const Comms::NetworkImpairmentModel::Configuration& network) :
+            _clock(clock),
+            _packetizer(ssrc, OpusPayloadType, AudioLevelExtensionId),
+            _network(network) {
+            _packet.reserve(MaximumPacketSize);
+        }
+
+        void Connect() override {
+        }
+
+        void Close() override {
+        }
+
+        rtc::PeerConnection::State GetConnectionState() override {
+            return rtc::PeerConnection::State::Connected;
+        }
+
+        std::uint16_t SendAudioData(const std::vector<std::byte>& opusData, Comms::AudioLevel level) override {
+            _packetizer.Packetize(opusData, level, _packet); // On the manager's real-time frame, as WebRTCPeerConnection packetises.
+
+            const auto sequenceNumber = static_cast<std::uint16_t>((std::to_integer<std::uint16_t>(_packet[2]) << 8) | std::to_integer<std::uint16_t>(_packet[3]));
+
+            // The network is the simulation's, standing in for the pacer's thread, so it is not real-time and its allocations
+            // are not the frame's.
+            Comms::RealTimeScope scope(nullptr);
+            const auto allocations = Comms::AllocationCounter::GetThreadCounts();
+            const auto now = _clock.Now();
+            const auto arrivalTime = _network.Send(_packet.size(), now);
+            _sentCount++;
+
+            // The packet in flight is a copy, as a real connection's pacer takes one.
+            if (arrivalTime.has_value() && _remote != nullptr) {
+                _networkDelay.Add(std::chrono::duration<double, std::milli>(*arrivalTime - now).count());
+
+                _clock.Schedule(*arrivalTime, [remote = _remote, packet = _packet]() {
+                    remote->Receive(packet);
+                });
+            }
+
+            _networkAllocationCount += Comms::AllocationCounter::GetThreadCounts()._count - allocations._count;
+
+            return sequenceNumber;
+        }
+
+        void OnAudioData(std::function<void(const rtc::binary& packet)> callback) override {
+            _onAudioData = std::move(callback);
+        }
+
+        int GetTargetBitrate() const override {
+            return std::numeric_limits<int>::max();
+        }
+
+        Stats GetStats() const override {
+            return { std::nullopt, 0.0, 0.0, 0, 0, GetTargetBitrate(), _sentCount, _receivedCount };
+        }
+
+        std::uint32_t GetTraceId() const override {
+            return _traceId;
+        }
+
+        /*
+        * Connects the connection to the remote end's, which it sends to.
+        */
+        void SetRemote(SimulatedConnection* remote) {
+            _remote = remote;
+        }
+
+        const Comms::NetworkImpairmentModel& GetNetwork() const {
+            return _network;
+        }
+
+        const Comms::SampleStatistics& GetNetworkDelay() const {
+            return _networkDelay;
+        }
+
+        /*
+        * @return The heap allocations made carrying packets sent, on the thread that sent them.
+        */
+        std::uint64_t GetNetworkAllocationCount() const {
+            return _networkAllocationCount;
+        }
+
+    private:
+        /*
+        * Hands a packet that has crossed the network to the manager.
+        */
+        void Receive(const rtc::binary& packet) {
+            _receivedCount++;
+
+            if (_onAudioData) {
+                _onAudioData(packet);
+            }
+        }
+
+        Comms::VirtualClock& _clock; // The simulation's clock.
+        Comms::RtpAudioPacketizer _packetizer; // Wraps encoded frames in RTP.
+        rtc::binary _packet; // The packet being packetised, reused for every frame.
+        Comms::NetworkImpairmentModel _network; // The network from this end to the remote end.
+        SimulatedConnection* _remote = nullptr; // The remote end's connection.
+        std::function<void(const rtc::binary& packet)> _onAudioData; // The manager's jitter buffer.
+        std::uint64_t _sentCount = 0; // Packets sent.
+        std::uint64_t _receivedCount = 0; // Packets received.
+        Comms::SampleStatistics _networkDelay; // Time each packet sent took to arrive, in milliseconds.
+        std::uint64_t _networkAllocationCount = 0; // Heap allocations made carrying packets sent.
+        const std::uint32_t _traceId = Comms::PipelineTrace::NewConnectionId(); // Tags the connection's packets in a trace.
+    };
+
+    /*
+    * One end of a simulated call: its device, and a driven CallManager with the call to the remote end.
+    */
+    struct CallEnd {
+        CallEnd(Comms::VirtualClock& clock, std::size_t speaker, int bitrate, const Comms::NetworkImpairmentModel::Configuration& network) :
+            _speech(Comms::GenerateSpeech(speaker, SampleRate)),
+            _microphone(std::make_shared<Comms::AudioBuffer>()),
+            _speaker(std::make_shared<Comms::AudioBuffer>()) {
+            Comms::CallManager::Configuration configuration;
+            configuration._bitrate = bitrate;
+            configuration._isDriven = true;
+            configuration._connectionFactory = [this, &clock, speaker, network](const std::string&, const std::string&) -> std::unique_ptr<Comms::AudioConnection> {
+                auto connection = std::make_unique<SimulatedConnection>(clock, static_cast<std::uint32_t>(speaker + 1), network);
+                _connection = connection.get();
+                return connection;
+            };
+
+            _callManager = std::make_unique<Comms::CallManager>(_microphone, _speaker, configuration);
+        }
+
+        const std::vector<std::int16_t> _speech; // A second of speech, captured in a loop.
+        std::size_t _speechPosition = 0; // The next sample of _speech captured.
+
+        std::shared_ptr<Comms::AudioBuffer> _microphone; // Samples captured, waiting to be encoded.
+        std::shared_ptr<Comms::AudioBuffer> _speaker; // Samples decoded, waiting to be played.
+        std::unique_ptr<Comms::CallManager> _callManager; // The end's audio thread, ticked by the clock.
+        SimulatedConnection* _connection = nullptr; // The connection to the remote end, owned by the call manager.
+
+        std::vector<std::int16_t> _period = std::vector<std::int16_t>(DevicePeriodSampleCount); // The device period being captured or played.
+        bool _isPlaying = false; // Whether the speaker has played anything, after which an empty queue is an underrun.
+
+        std::uint64_t _underrunCount = 0; // Device periods that found the speaker queue empty once playing.
+        std::uint64_t _playedHash = FnvOffsetBasis; // Hash of every sample played.
+        std::uint64_t _frameCount = 0; // Ticks of the audio thread.
+        std::uint64_t _frameAllocationCount = 0; // Heap allocations made by those ticks.
+    };
+
+    /*
+    * One device period: captures a period of speech and plays a period of the speaker queue.
+    */
+    void RunDevicePeriod(CallEnd& end) {
+        Comms::RealTimeScope scope("Simulated device"); // A real device's period runs on its real-time thread.
+
+        for (auto& sample : end._period) {
+            sample = end._speech[end._speechPosition];
+            end._speechPosition = (end._speechPosition + 1) % end._speech.size();
+        }
+
+        {
+            Comms::AllocationScope captureScope(Comms::AllocationTag::Capture);
+            Comms::AudioInputOutput::CaptureSamples(*end._microphone, end._period.data(), DevicePeriodSampleCount);
+        }
+
+        if (end._speaker->read_available() >= DevicePeriodSampleCount) {
+            end._isPlaying = true;
+        }
+        else {
+            end._underrunCount += end._isPlaying ? 1 : 0;
+        }
+
+        {
+            Comms::AllocationScope playbackScope(Comms::AllocationTag::Playback);
+            Comms::AudioInputOutput::PlaySamples(*end._speaker, end._period.data(), DevicePeriodSampleCount);
+        }
+
+        end._playedHash = Hash(end._playedHash, end._period.data(), end._period.size() * sizeof(std::int16_t));
+    }
+}
+
+namespace Comms {
+    CallSimulation::CallSimulation(const CommandLineOptions& options) :
+        _callCount(static_cast<std::size_t>(std::max<std::int64_t>(options.GetInteger("calls", 1), 1))),
+        _durationSeconds(std::max(options.GetDouble("duration", 3600.0), 0.1)),
+        _bitrate(static_cast<int>(options.GetInteger("bitrate", 32000))),
+        _impairment(ParseNetworkImpairment(options)) {
+    }
+
+    nlohmann::json CallSimulation::Run() {
+        VirtualClock clock;
+        std::vector<std::unique_ptr<CallEnd>> ends;
+
+        for (std::size_t i = 0; i < 2 * _callCount; i++) {
+            // Each direction is seeded apart, as the calls scenario seeds each NetworkImpairment.
+            auto network = _impairment.value_or(NetworkImpairmentModel::Configuration{});
+            network._seed += i;
+
+            ends.push_back(std::make_unique<CallEnd>(clock, i, _bitrate, network));
+        }
+
+        for (std::size_t i = 0; i < ends.size(); i += 2) {
+            const auto name = "simulation-" + std::to_string(i / 2);
+            ends[i]->_callManager->StartCall(name, ConnectionPassword);
+            ends[i + 1]->_callManager->StartCall(name, ConnectionPassword);
+
+            ends[i]->_connection->SetRemote(ends[i + 1]->_connection);
+            ends[i + 1]->_connection->SetRemote(ends[i]->_connection);
+        }
+
+        for (auto& end : ends) {
+            // A device delivers its first period at the end of it.
+            clock.ScheduleRepeating(DevicePeriod, DevicePeriod, [end = end.get()]() { RunDevicePeriod(*end); });
+            clock.ScheduleRepeating(FrameOffset, FrameInterval, [end = end.get()]() {
+                const auto allocations = AllocationCounter::GetThreadCounts();
+                const auto networkAllocations = end->_connection->GetNetworkAllocationCount();
+                end->_callManager->ProcessFrame();
+                end->_frameAllocationCount += AllocationCounter::GetThreadCounts()._count - allocations._count -
+                    (end->_connection->GetNetworkAllocationCount() - networkAllocations);
+                end->_frameCount++;
+            });
+        }
+
+        const auto previousRealTimeAllocations = AllocationTracker::GetRealTimeAllocationCount();
+        const auto start = Clock::now();
+        clock.RunUntil(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double>(_durationSeconds)));
+        const double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const auto realTimeAllocations = AllocationTracker::GetRealTimeAllocationCount() - previousRealTimeAllocations;
+
+        nlohmann::json streams = nlohmann::json::array();
+        SampleStatistics networkDelay;
+        std::uint64_t fingerprint = FnvOffsetBasis;
+        std::uint64_t frameAllocationCount = 0;
+
+        for (std::size_t i = 0; i < ends.size(); i++) {
+            const auto& end = *ends[i];
+            const auto& received = *ends[i ^ 1];
+            const auto& network = end._connection->GetNetwork().GetStatistics();
+            const auto stats = received._callManager->GetCalls().front()._stats;
+
+            networkDelay.Merge(end._connection->GetNetworkDelay());
+            fingerprint = Hash(fingerprint, &received._playedHash, sizeof(received._playedHash));
+            frameAllocationCount += end._frameAllocationCount;
+
+            streams.push_back({
+                {"call", i / 2},
+                {"from", i % 2 == 0 ? "offerer" : "answerer"},
+                {"sent", end._connection->GetStats()._sentPackets},
+                {"network_lost", network._lostCount},
+                {"network_dropped", network._droppedCount},
+                {"network_reordered", network._reorderedCount},
+                {"jitter_buffer_lost", stats._lostPackets},
+                {"jitter_buffer_late", stats._latePackets},
+                {"decoded", stats._decodedFrames},
+                {"concealed", stats._concealedFrames},
+                {"underruns", received._underrunCount},
+                {"allocations_per_frame", end._frameCount > 0 ? static_cast<double>(end._frameAllocationCount) / end._frameCount : 0.0},
+                {"played_hash", ToHex(received._playedHash)}
+            });
+        }
+
+        nlohmann::json results = {
+            {"calls", _callCount},
+            {"simulated_s", _durationSeconds},
+            {"wall_s", wallSeconds},
+            {"speedup", wallSeconds > 0.0 ? _durationSeconds / wallSeconds : 0.0},
+            {"bitrate", _bitrate},
+            {"impairment", NetworkImpairmentToJson(_impairment)},
+            {"network_delay_ms", networkDelay.ToJson()},
+            {"streams", streams},
+            {"fingerprint", ToHex(fingerprint)},
+            {"allocations_hooked", AllocationTracker::IsHooked()},
+            {"realtime_allocations", realTimeAllocations}
+        };
+
+        if (realTimeAllocations > 0) {
+            results["realtime_allocation_report"] = AllocationTracker::RealTimeAllocationsToJson();
+        }
+
+        if (frameAllocationCount > 0) {
+            results["error"] = std::to_string(frameAllocationCount) + " heap allocations were made by ticks of the CallManagers";
+        }
+
+        return results;
+    }
+}
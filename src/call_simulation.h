@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+#include "network_impairment.h"
+
+namespace Comms {
+
+    /*
+    * Runs calls on a VirtualClock, faster than real time, through the audio thread of a live call: each end is a CallManager
+    * driven by the clock, with its capture queue, Opus encoding, RTP, jitter buffer, decoding, loss concealment and playback
+    * queue, and the network between them is a NetworkImpairmentModel. Hours of calls replay in minutes. Everything runs on
+    * the one thread, in virtual time, and the network draws the same losses and delays on every platform, so a run gives the
+    * same results each time it is run with the same options on the same build, and a change to any stage can be checked for
+    * regressions against a stored run.
+    *
+    * Each call has two ends, each speaking synthetic speech to the other. Each end has a simulated duplex device with a 10 ms
+    * period, which writes 480 samples of speech to the microphone queue and reads 480 samples from the speaker queue through
+    * AudioInputOutput's CaptureSamples and PlaySamples, the code ReadFromDevice and WriteToDevice run. Its CallManager is ticked every 20 ms, between device periods.
+    * Its connection to the other end wraps each packet in RTP, sends it across the network, and hands it to the other end's
+    * jitter buffer at the virtual time it arrives.
+    *
+    * The pacer, congestion control and SRTP of a WebRTCPeerConnection run on real threads and timers, so they are not part
+    * of the simulation. The call load generator and latency benchmarks cover them in real time.
+    *
+    * Each direction of each call reports the packets sent, lost on the network and in the jitter buffer, the frames concealed,
+    * the device periods that found the speaker queue empty, and an FNV-1a hash of every sample played. The fingerprint hashes
+    * every direction's hash, so two runs can be compared at a glance. The speedup is the simulated time over the wall time
+    * the run took, with every call running at once.
+    *
+    * Device periods run as real-time, as does each tick of the CallManager, as on its audio thread, so that the simulation
+    * enforces that capture, playback and every frame never allocate: any allocation in one is counted in
+    * realtime_allocations, with its stack in realtime_allocation_report, and fails the run. @see AllocationTracker
+    * Each direction also reports the heap allocations per tick of the CallManager, without those of the simulated network
+    * that carries its packets, which stands in for the pacer's thread. The run fails with an error if any tick allocated.
+    *
+    * Options:
+    *   --calls <n>              Number of calls. Default 1.
+    *   --duration <s>           Simulated seconds of each call. Default 3600.
+    *   --bitrate <n>            Opus bitrate. Default 32000.
+    * and the network impairment options of the calls scenario, applied to each direction of each call. @see ParseNetworkImpairment
+    */
+    class CallSimulation : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The simulation's command line options.
+        */
+        CallSimulation(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const std::size_t _callCount; // Number of calls.
+        const double _durationSeconds; // Simulated seconds of each call.
+        const int _bitrate; // Opus bitrate.
+        const std::optional<NetworkImpairmentModel::Configuration> _impairment; // The impairment of each direction, if any.
+    };
+}
@@ -0,0 +1,66 @@
+#include "cluster_key.h"
+
+#include <utility>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+namespace {
+    std::string ToHex(const std::uint8_t* data, std::size_t size) {
+        static const char* digits = "0123456789abcdef";
+        std::string text(size * 2, '0');
+
+        for (std::size_t i = 0; i < size; i++) {
+            text[2 * i] = digits[data[i] >> 4];
+            text[2 * i + 1] = digits[data[i] & 0xF];
+        }
+
+        return text;
+    }
+}
+
+namespace Comms {
+    ClusterKey::ClusterKey(std::string secret) :
+        _secret(std::move(secret)) {
+    }
+
+    bool ClusterKey::IsEmpty() const {
+        return _secret.empty();
+    }
+
+    ClusterKey::Signature ClusterKey::Sign(const void* data, std::size_t size) const {
+        Signature signature{};
+        unsigned int length = 0;
+
+        HMAC(EVP_sha256(), _secret.data(), static_cast<int>(_secret.size()), static_cast<const unsigned char*>(data), size, signature.data(), &length);
+
+        return signature;
+    }
+
+    std::string ClusterKey::SignToHex(std::string_view message) const {
+        const auto signature = Sign(message.data(), message.size());
+
+        return ToHex(signature.data(), signature.size());
+    }
+
+    bool ClusterKey::Verify(const void* data, std::size_t size, const std::uint8_t* signature, std::size_t length) const {
+        if (IsEmpty() || length == 0 || length > SignatureLength) {
+            return false;
+        }
+
+        const auto expected = Sign(data, size);
+
+        return CRYPTO_memcmp(expected.data(), signature, length) == 0;
+    }
+
+    bool ClusterKey::VerifyHex(std::string_view message, std::string_view signature) const {
+        if (IsEmpty()) {
+            return false;
+        }
+
+        const auto expected = SignToHex(message);
+
+        return signature.size() == expected.size() && CRYPTO_memcmp(expected.data(), signature.data(), expected.size()) == 0;
+    }
+}
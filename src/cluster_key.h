@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Comms {
+
+    /*
+    * A secret shared by the nodes of a cluster, which authenticates the messages they send each other.
+    *
+    * Messages are signed with HMAC-SHA256. A node only accepts a message from another node if it carries a valid
+    * signature, so a client that can reach a node's listener cannot pose as another node.
+    *
+    * Thread safe.
+    */
+    class ClusterKey {
+    public:
+        static constexpr std::size_t SignatureLength = 32; // Bytes in a signature.
+
+        using Signature = std::array<std::uint8_t, SignatureLength>;
+
+        /*
+        * Constructor.
+        *
+        * @param secret The shared secret. Every node of the cluster must be given the same one.
+        */
+        ClusterKey(std::string secret);
+
+        /*
+        * @return Whether the secret is empty, in which case nothing should be accepted as signed.
+        */
+        bool IsEmpty() const;
+
+        /*
+        * @return The signature of a message.
+        */
+        Signature Sign(const void* data, std::size_t size) const;
+
+        /*
+        * @return The signature of a message, in lower case hexadecimal.
+        */
+        std::string SignToHex(std::string_view message) const;
+
+        /*
+        * Checks a signature in constant time.
+        *
+        * @param signature The signature received, of which only the first length bytes are compared.
+        * @param length The bytes of the signature received, at most SignatureLength. Shorter truncated signatures are
+        *               weaker, so no fewer than 16 bytes should be sent.
+        * @return False if the key is empty or the signature does not match.
+        */
+        bool Verify(const void* data, std::size_t size, const std::uint8_t* signature, std::size_t length) const;
+
+        /*
+        * @return Whether a hexadecimal signature matches a message. False if the key is empty.
+        */
+        bool VerifyHex(std::string_view message, std::string_view signature) const;
+
+    private:
+        const std::string _secret; // The shared secret.
+    };
+}
@@ -0,0 +1,85 @@
+#include "command_line_options.h"
+
+#include <sstream>
+
+namespace Comms {
+    CommandLineOptions::CommandLineOptions(int argc, char** argv) {
+        for (int i = 1; i < argc; i++) {
+            const std::string argument(argv[i]);
+
+            if (argument.rfind("--", 0) != 0) {
+                _positionalArguments.push_back(argument);
+                continue;
+            }
+
+            const auto separator = argument.find('=');
+
+            if (separator != std::string::npos) {
+                _options[argument.substr(2, separator - 2)] = argument.substr(separator + 1);
+            }
+            else if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                _options[argument.substr(2)] = argv[++i];
+            }
+            else {
+                _options[argument.substr(2)] = "true";
+            }
+        }
+    }
+
+    const std::vector<std::string>& CommandLineOptions::GetPositionalArguments() const {
+        return _positionalArguments;
+    }
+
+    bool CommandLineOptions::Has(const std::string& name) const {
+        return _options.contains(name);
+    }
+
+    std::string CommandLineOptions::GetString(const std::string& name, const std::string& defaultValue) const {
+        auto option = _options.find(name);
+        return option != _options.end() ? option->second : defaultValue;
+    }
+
+    std::int64_t CommandLineOptions::GetInteger(const std::string& name, std::int64_t defaultValue) const {
+        auto option = _options.find(name);
+
+        if (option == _options.end()) {
+            return defaultValue;
+        }
+
+        try {
+            return std::stoll(option->second);
+        }
+        catch (const std::exception&) {
+            return defaultValue;
+        }
+    }
+
+    double CommandLineOptions::GetDouble(const std::string& name, double defaultValue) const {
+        auto option = _options.find(name);
+
+        if (option == _options.end()) {
+            return defaultValue;
+        }
+
+        try {
+            return std::stod(option->second);
+        }
+        catch (const std::exception&) {
+            return defaultValue;
+        }
+    }
+
+    std::vector<std::string> CommandLineOptions::GetList(const std::string& name) const {
+        std::vector<std::string> values{};
+        std::stringstream stream(GetString(name, ""));
+        std::string value;
+
+        while (std::getline(stream, value, ',')) {
+            if (!value.empty()) {
+                values.push_back(value);
+            }
+        }
+
+        return values;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Comms {
+
+    /*
+    * Parses the command line of the headless tools.
+    * Options are given as "--name value", "--name=value" or, for boolean flags, "--name".
+    * Any argument that is not an option or an option's value is a positional argument.
+    */
+    class CommandLineOptions {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param argc The number of arguments, including the program name.
+        * @param argv The arguments, including the program name.
+        */
+        CommandLineOptions(int argc, char** argv);
+
+        /*
+        * @return The arguments that are not options, in the order they were given.
+        */
+        const std::vector<std::string>& GetPositionalArguments() const;
+
+        /*
+        * @param name The option name, without the leading dashes.
+        * @return Whether the option was given.
+        */
+        bool Has(const std::string& name) const;
+
+        /*
+        * @param name The option name, without the leading dashes.
+        * @param defaultValue The value returned if the option was not given.
+        * @return The value of the option.
+        */
+        std::string GetString(const std::string& name, const std::string& defaultValue) const;
+
+        /*
+        * @param name The option name, without the leading dashes.
+        * @param defaultValue The value returned if the option was not given or is not an integer.
+        * @return The value of the option.
+        */
+        std::int64_t GetInteger(const std::string& name, std::int64_t defaultValue) const;
+
+        /*
+        * @param name The option name, without the leading dashes.
+        * @param defaultValue The value returned if the option was not given or is not a number.
+        * @return The value of the option.
+        */
+        double GetDouble(const std::string& name, double defaultValue) const;
+
+        /*
+        * Splits a comma separated option into its values, e.g. "--peers a:1,b:2".
+        *
+        * @param name The option name, without the leading dashes.
+        * @return The values of the option, empty if it was not given.
+        */
+        std::vector<std::string> GetList(const std::string& name) const;
+
+    private:
+        std::unordered_map<std::string, std::string> _options; // Option values keyed by name. Flags have the value "true".
+        std::vector<std::string> _positionalArguments; // Arguments that are not options.
+    };
+}
@@ -1,19 +1,29 @@
 #include <d3d11.h>
 #include <tchar.h>
+#include <cfloat>
+#include <chrono>
 #include <cstddef>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <utility>
 #include <thread>
+#include <vector>
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_win32.h"
 #include "imgui/imgui_impl_dx11.h"
 
-#include "web_rtc_peer_connection.h"
+#include "allocation_tracker.h"
+#include "call_manager.h"
 #include "connection_name_generator.h"
 #include "audio_input_output.h"
+#include "packet_capture.h"
+#include "pipeline_trace.h"
 
 // Dear Imgui Declarations
 static ID3D11Device* g_pd3dDevice = NULL;
@@ -26,6 +36,32 @@ void CleanupDeviceD3D();
 void CreateRenderTarget();
 void CleanupRenderTarget();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+const char* GetConnectionStateText(rtc::PeerConnection::State state);
+
+const char* TraceFileName = "comms_trace.json";
+const char* AllocationReportFileName = "comms_allocations.json";
+const char* CaptureFileName = "comms_capture.pcap";
+const char* LossCapturePathPrefix = "comms_capture_loss"; // Loss bursts are written to this followed by their time.
+const std::size_t LossBurstPacketCount = 5; // Packets lost within a second that make a loss burst.
+
+const std::size_t StatsHistorySize = 120; // Samples of each call's statistics plotted, a minute at two a second.
+const std::chrono::milliseconds StatsSampleInterval(500);
+
+/*
+* The recent statistics of one call, plotted by the Call Stats window. Each series is oldest first.
+*/
+struct CallStatsHistory {
+    std::vector<float> _roundTripTime; // Milliseconds, 0 until known.
+    std::vector<float> _jitter; // Milliseconds.
+    std::vector<float> _receivedLoss; // Percent of the packets due in each sample that were lost.
+    std::vector<float> _sendBitrate; // Kilobits per second.
+    std::vector<float> _receiveBitrate; // Kilobits per second.
+    std::vector<float> _bufferedFrames; // Frames in the fullest jitter buffer.
+    Comms::CallManager::CallStats _previous; // The last sample, to count the packets lost since.
+};
+
+void AddStatsSample(CallStatsHistory& history, const Comms::CallManager::CallStats& stats);
+void PlotStats(const char* label, const std::vector<float>& values, const char* format);
 
 struct Receiver {
     std::shared_ptr<rtc::PeerConnection> conn;
@@ -70,13 +106,21 @@ int main(int, char**)
     char sessionID[90] = "";
     char password[90] = "";
 
-    std::unique_ptr<Comms::WebRTCPeerConnection> connection;
     std::unique_ptr<Comms::ConnectionNameGenerator> connectionNameGenerator;
 
-    auto microphoneBuffer = std::make_shared<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>>();
-    auto speakerBuffer = std::make_shared<boost::lockfree::spsc_queue<std::int16_t, boost::lockfree::capacity<262144>>>();
+    auto microphoneBuffer = std::make_shared<Comms::AudioBuffer>();
+    auto speakerBuffer = std::make_shared<Comms::AudioBuffer>();
 
     auto audioInputOutput = std::make_unique<Comms::AudioInputOutput>(microphoneBuffer, speakerBuffer);
+    auto callManager = std::make_unique<Comms::CallManager>(microphoneBuffer, speakerBuffer);
+
+    std::optional<Comms::CallManager::CallId> transferringCallId; // The call chosen to be transferred, until a call to transfer it to is chosen.
+
+    std::string traceStatus; // The result of saving the trace, the capture or the allocation report, shown below the buttons.
+    bool isSavingLossBursts = false; // Whether the packet capture is saved on each loss burst.
+
+    std::map<Comms::CallManager::CallId, CallStatsHistory> statsHistories; // The recent statistics of each call.
+    auto nextStatsSample = std::chrono::steady_clock::now();
 
     int selectedInputDeviceIndex = 0;
     int selectedOutputDeviceIndex = 0;
@@ -114,28 +158,76 @@ int main(int, char**)
 
         ImGui::InputText("Password", password, sizeof(password));
 
-        if (ImGui::Button("Connect")) {
-            connection.reset(new Comms::WebRTCPeerConnection(std::string(sessionID), std::string(password)));
+        if (ImGui::Button("Call")) {
+            callManager->StartCall(std::string(sessionID), std::string(password));
+        }
 
-            std::thread connectionThread([&connection]() {
-                connection->Connect();
-                
-                while (connection->GetConnectionState() != rtc::PeerConnection::State::Connected) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-                }
-            });
+        ImGui::SameLine();
 
-            connectionThread.detach();
+        if (ImGui::Button("Join Room")) {
+            callManager->StartMeshCall(std::string(sessionID), std::string(password));
         }
 
-        if (connection != nullptr) {
-            switch (connection->GetConnectionState()) {
-                case rtc::PeerConnection::State::Connected: ImGui::Text("Connected"); break;
-                case rtc::PeerConnection::State::Disconnected: ImGui::Text("Disconnected"); break;
-                case rtc::PeerConnection::State::Failed: ImGui::Text("Failed"); break;
-                case rtc::PeerConnection::State::Closed: ImGui::Text("Closed"); break;
-                default: ImGui::Text("Connecting..."); break;
+        ImGui::Separator();
+
+        for (const auto& call : callManager->GetCalls()) {
+            ImGui::PushID(static_cast<int>(call._id));
+
+            if (call._isMesh) {
+                ImGui::Text("%s: %s, %zu of %zu peers%s", call._name.c_str(), GetConnectionStateText(call._state), call._connectedPeerCount, call._peerCount, call._isHeld ? " (On Hold)" : "");
+            }
+            else {
+                ImGui::Text("%s: %s%s", call._name.c_str(), GetConnectionStateText(call._state), call._isHeld ? " (On Hold)" : "");
+            }
+
+            if (ImGui::Button(call._isHeld ? "Resume" : "Hold")) {
+                callManager->SetHeld(call._id, !call._isHeld);
             }
+
+            ImGui::SameLine();
+
+            if (ImGui::Button(call._isMuted ? "Unmute" : "Mute")) {
+                callManager->SetMuted(call._id, !call._isMuted);
+            }
+
+            ImGui::SameLine();
+
+            if (call._transferredTo.has_value()) {
+                ImGui::Text("Transferred to call %u", *call._transferredTo);
+                ImGui::SameLine();
+            }
+            else if (transferringCallId == call._id) {
+                if (ImGui::Button("Cancel Transfer")) {
+                    transferringCallId.reset();
+                }
+
+                ImGui::SameLine();
+            }
+            else if (transferringCallId.has_value()) {
+                if (ImGui::Button("Transfer Here")) {
+                    callManager->Transfer(*transferringCallId, call._id);
+                    transferringCallId.reset();
+                }
+
+                ImGui::SameLine();
+            }
+            else {
+                if (ImGui::Button("Transfer")) {
+                    transferringCallId = call._id;
+                }
+
+                ImGui::SameLine();
+            }
+
+            if (ImGui::Button("End")) {
+                callManager->EndCall(call._id);
+
+                if (transferringCallId == call._id) {
+                    transferringCallId.reset();
+                }
+            }
+
+            ImGui::PopID();
         }
         
         ImGui::End();
@@ -183,6 +275,102 @@ int main(int, char**)
 
         ImGui::End();
 
+        ImGui::Begin("Trace");
+
+        bool isTracing = Comms::PipelineTrace::IsEnabled();
+
+        if (ImGui::Checkbox("Trace Audio Pipeline", &isTracing)) {
+            Comms::PipelineTrace::SetEnabled(isTracing);
+        }
+
+        // Opens in Perfetto (ui.perfetto.dev) or chrome://tracing.
+        if (ImGui::Button("Save Trace")) {
+            traceStatus = Comms::PipelineTrace::WriteChromeTrace(TraceFileName) ? std::string("Saved ") + TraceFileName : "Could not save the trace";
+        }
+
+        bool isCapturing = Comms::PacketCapture::IsEnabled();
+
+        if (ImGui::Checkbox("Capture Packets", &isCapturing)) {
+            Comms::PacketCapture::SetEnabled(isCapturing);
+        }
+
+        if (ImGui::Checkbox("Save Capture On Loss Burst", &isSavingLossBursts)) {
+            Comms::PacketCapture::SetLossTrigger(isSavingLossBursts ? LossBurstPacketCount : 0, LossCapturePathPrefix);
+        }
+
+        // Opens in Wireshark.
+        if (ImGui::Button("Save Capture")) {
+            traceStatus = Comms::PacketCapture::WritePcap(CaptureFileName) ? std::string("Saved ") + CaptureFileName : "Could not save the capture";
+        }
+
+        // Only a Debug build hooks operator new to catch allocations on the device threads.
+        if (Comms::AllocationTracker::IsHooked()) {
+            ImGui::Text("Real-time allocations: %llu", static_cast<unsigned long long>(Comms::AllocationTracker::GetRealTimeAllocationCount()));
+
+            if (ImGui::Button("Save Allocation Report")) {
+                std::ofstream file(AllocationReportFileName);
+                file << Comms::AllocationTracker::RealTimeAllocationsToJson().dump(2);
+                traceStatus = file.good() ? std::string("Saved ") + AllocationReportFileName : "Could not save the allocation report";
+            }
+        }
+
+        ImGui::TextUnformatted(traceStatus.c_str());
+
+        ImGui::End();
+
+        ImGui::Begin("Call Stats");
+
+        const auto calls = callManager->GetCalls();
+        const bool isSampling = std::chrono::steady_clock::now() >= nextStatsSample;
+
+        if (isSampling) {
+            nextStatsSample = std::chrono::steady_clock::now() + StatsSampleInterval;
+
+            // Forget the calls that have ended.
+            std::map<Comms::CallManager::CallId, CallStatsHistory> histories;
+
+            for (const auto& call : calls) {
+                auto& history = histories[call._id];
+                history = std::move(statsHistories[call._id]);
+                AddStatsSample(history, call._stats);
+            }
+
+            statsHistories = std::move(histories);
+        }
+
+        for (const auto& call : calls) {
+            const auto& stats = call._stats;
+            const auto& history = statsHistories[call._id];
+
+            ImGui::PushID(static_cast<int>(call._id));
+
+            if (ImGui::CollapsingHeader(call._name.c_str(), ImGuiTreeNodeFlags_DefaultOpen)) {
+                if (stats._roundTripTime.has_value()) {
+                    ImGui::Text("RTT %.1f ms, jitter %.1f ms, %.1f%% of sent packets lost", *stats._roundTripTime, stats._jitter, stats._sentLossFraction * 100.0);
+                }
+                else {
+                    ImGui::Text("RTT unknown, jitter %.1f ms", stats._jitter);
+                }
+
+                ImGui::Text("Sent %llu packets at %d kbps, received %llu at %d kbps", static_cast<unsigned long long>(stats._sentPackets), stats._sendBitrate / 1000,
+                    static_cast<unsigned long long>(stats._receivedPackets), stats._receiveBitrate / 1000);
+                ImGui::Text("Lost %llu, late %llu, %zu frames buffered", static_cast<unsigned long long>(stats._lostPackets), static_cast<unsigned long long>(stats._latePackets), stats._bufferedFrames);
+                ImGui::Text("Decoded %llu frames, concealed %llu", static_cast<unsigned long long>(stats._decodedFrames), static_cast<unsigned long long>(stats._concealedFrames));
+                ImGui::Text("Opus at %d of %d kbps, 20 ms frames", stats._encoderBitrate / 1000, stats._maximumEncoderBitrate / 1000);
+
+                PlotStats("RTT", history._roundTripTime, "%.1f ms");
+                PlotStats("Jitter", history._jitter, "%.1f ms");
+                PlotStats("Received Loss", history._receivedLoss, "%.1f%%");
+                PlotStats("Send Bitrate", history._sendBitrate, "%.0f kbps");
+                PlotStats("Receive Bitrate", history._receiveBitrate, "%.0f kbps");
+                PlotStats("Buffered Frames", history._bufferedFrames, "%.0f");
+            }
+
+            ImGui::PopID();
+        }
+
+        ImGui::End();
+
         // Rendering
         ImGui::Render();
         const float clear_color_with_alpha[4] = { clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w };
@@ -207,6 +395,57 @@ int main(int, char**)
 
 // Helper functions
 
+/*
+* Adds a call's statistics to its history, dropping the oldest sample once the history is full.
+*/
+void AddStatsSample(CallStatsHistory& history, const Comms::CallManager::CallStats& stats)
+{
+    const auto add = [](std::vector<float>& series, double value) {
+        if (series.size() == StatsHistorySize) {
+            series.erase(series.begin());
+        }
+
+        series.push_back(static_cast<float>(value));
+    };
+
+    const auto lost = stats._lostPackets - history._previous._lostPackets;
+    const auto received = stats._receivedPackets - history._previous._receivedPackets;
+
+    add(history._roundTripTime, stats._roundTripTime.value_or(0.0));
+    add(history._jitter, stats._jitter);
+    add(history._receivedLoss, lost + received > 0 ? 100.0 * lost / (lost + received) : 0.0);
+    add(history._sendBitrate, stats._sendBitrate / 1000.0);
+    add(history._receiveBitrate, stats._receiveBitrate / 1000.0);
+    add(history._bufferedFrames, static_cast<double>(stats._bufferedFrames));
+
+    history._previous = stats;
+}
+
+/*
+* Plots a series of statistics as a sparkline, labelled with its latest value.
+*/
+void PlotStats(const char* label, const std::vector<float>& values, const char* format)
+{
+    char latest[32] = "";
+
+    if (!values.empty()) {
+        std::snprintf(latest, sizeof(latest), format, values.back());
+    }
+
+    ImGui::PlotLines(label, values.data(), static_cast<int>(values.size()), 0, latest, 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+}
+
+const char* GetConnectionStateText(rtc::PeerConnection::State state)
+{
+    switch (state) {
+        case rtc::PeerConnection::State::Connected: return "Connected";
+        case rtc::PeerConnection::State::Disconnected: return "Disconnected";
+        case rtc::PeerConnection::State::Failed: return "Failed";
+        case rtc::PeerConnection::State::Closed: return "Closed";
+        default: return "Connecting...";
+    }
+}
+
 bool CreateDeviceD3D(HWND hWnd)
 {
     // Setup swap chain
@@ -0,0 +1,68 @@
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "command_line_options.h"
+#include "mcu_mixing_benchmark.h"
+#include "mesh_setup_benchmark.h"
+#include "mouth_to_ear_latency_benchmark.h"
+#include "opus_codec_benchmark.h"
+#include "sfu_relay_benchmark.h"
+#include "signalling_latency_benchmark.h"
+#include "udp_batching_benchmark.h"
+
+namespace {
+    using BenchmarkFactory = std::function<std::unique_ptr<Comms::Benchmark>(const Comms::CommandLineOptions&)>;
+
+    /*
+    * @return The available benchmarks keyed by the name used to select them on the command line.
+    */
+    const std::map<std::string, BenchmarkFactory>& GetBenchmarks() {
+        static const std::map<std::string, BenchmarkFactory> benchmarks = {
+            {"signalling-latency", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::SignallingLatencyBenchmark>(options); }},
+            {"mcu-mixing", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::McuMixingBenchmark>(options); }},
+            {"udp-batching", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::UdpBatchingBenchmark>(options); }},
+            {"mouth-to-ear", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::MouthToEarLatencyBenchmark>(options); }},
+            {"opus-codec", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::OpusCodecBenchmark>(options); }},
+            {"mesh-setup", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::MeshSetupBenchmark>(options); }},
+            {"sfu-relay", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::SfuRelayBenchmark>(options); }}
+        };
+
+        return benchmarks;
+    }
+}
+
+/*
+* Runs a single benchmark and writes its results to stdout as JSON.
+*
+* Usage: CommsBenchmark <benchmark> [--option value ...]
+*/
+int main(int argc, char** argv)
+{
+    Comms::CommandLineOptions options(argc, argv);
+
+    const auto& arguments = options.GetPositionalArguments();
+    const auto& benchmarks = GetBenchmarks();
+
+    if (arguments.empty() || !benchmarks.contains(arguments.front())) {
+        std::cerr << "Usage: CommsBenchmark <benchmark> [--option value ...]" << std::endl << "Benchmarks:" << std::endl;
+
+        for (const auto& [name, factory] : benchmarks) {
+            std::cerr << "  " << name << std::endl;
+        }
+
+        return 1;
+    }
+
+    auto benchmark = benchmarks.at(arguments.front())(options);
+    nlohmann::json results = {
+        {"benchmark", arguments.front()},
+        {"results", benchmark->Run()}
+    };
+
+    std::cout << results.dump(2) << std::endl;
+
+    return results["results"].contains("error") ? 1 : 0;
+}
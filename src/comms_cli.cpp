@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "json/json.hpp"
+
+#include "allocation_tracker.h"
+#include "audio_input_output.h"
+#include "call_manager.h"
+#include "command_line_options.h"
+#include "metrics_server.h"
+#include "packet_capture.h"
+#include "pipeline_trace.h"
+#include "web_rtc_peer_connection.h"
+#include "web_socket_signalling_client.h"
+
+namespace {
+    const char* WavInputDeviceName = "WAV file (virtual)";
+    const char* WavOutputDeviceName = "WAV recording (virtual)";
+
+    std::atomic<bool> IsInterrupted = false; // Set by Ctrl+C or a termination request.
+
+    void OnSignal(int) {
+        IsInterrupted = true;
+    }
+
+    const char* GetConnectionStateName(rtc::PeerConnection::State state) {
+        switch (state) {
+            case rtc::PeerConnection::State::New: return "new";
+            case rtc::PeerConnection::State::Connecting: return "connecting";
+            case rtc::PeerConnection::State::Connected: return "connected";
+            case rtc::PeerConnection::State::Disconnected: return "disconnected";
+            case rtc::PeerConnection::State::Failed: return "failed";
+            case rtc::PeerConnection::State::Closed: return "closed";
+            default: return "unknown";
+        }
+    }
+
+    void PrintUsage() {
+        std::cerr << "Usage: CommsCli --name <name> --password <password> [--option value ...]" << std::endl
+            << "  --mesh                  Join the room <name> as a group call, rather than call one peer." << std::endl
+            << "  --signalling-url <url>  The HTTP API of the signalling server. Defaults to " << Comms::WebSocketSignallingClient::DefaultServiceURL << "." << std::endl
+            << "  --signalling-socket-url <url>  Its WebSocket push channel. Defaults to " << Comms::WebSocketSignallingClient::DefaultSocketURL << "." << std::endl
+            << "  --wav <path>            Send a WAV file instead of the input device." << std::endl
+            << "  --loop                  Send the WAV file again from the start when it ends." << std::endl
+            << "  --record <path>         Write the call's audio to a WAV file instead of the output device." << std::endl
+            << "  --null-audio            Use the null audio backend: a silent input and a discarded output." << std::endl
+            << "  --input-device <name>   The input device to capture from. Defaults to the first." << std::endl
+            << "  --output-device <name>  The output device to play to. Defaults to the first." << std::endl
+            << "  --list-devices          Print the available devices and exit." << std::endl
+            << "  --bitrate <bps>         The highest bitrate audio is encoded at. Defaults to 32000." << std::endl
+            << "  --duration <seconds>    End the call after this long. Defaults to running until interrupted." << std::endl
+            << "  --stats-interval <ms>   How often stats are printed. Defaults to 1000." << std::endl
+            << "  --trace <path>          Trace each stage of the audio pipeline, and write it as Chrome trace JSON on exit." << std::endl
+            << "  --capture <path>        Capture the RTP and RTCP packets, and write them as a pcap file on exit." << std::endl
+            << "  --capture-on-loss <n>   Write the capture whenever n packets are lost within a second: beside <path>, or as capture_<time>.pcap without --capture." << std::endl
+            << "  --metrics-port <port>   Serve Prometheus metrics on this port at /metrics." << std::endl
+            << "  --metrics-bind <addr>   The address metrics are served on. Defaults to 0.0.0.0." << std::endl;
+    }
+}
+
+/*
+* Makes a call without a UI, for servers and automated tests, and streams the call's stats to stdout as one JSON object
+* per line.
+*
+* Usage: CommsCli --name <name> --password <password> [--option value ...]
+*/
+int main(int argc, char** argv)
+{
+    Comms::CommandLineOptions options(argc, argv);
+    Comms::WebRTCPeerConnection::SetLogLevel(rtc::LogLevel::Warning); // Keeps stdout to the JSON stats.
+
+    const auto backend = options.Has("null-audio") ? Comms::AudioInputOutput::Backend::Null : Comms::AudioInputOutput::Backend::System;
+    auto microphoneBuffer = std::make_shared<Comms::AudioBuffer>();
+    auto speakerBuffer = std::make_shared<Comms::AudioBuffer>();
+
+    if (options.Has("list-devices")) {
+        Comms::AudioInputOutput audioInputOutput(microphoneBuffer, speakerBuffer, backend);
+        nlohmann::json devices = {
+            {"input", audioInputOutput.GetInputDeviceNames()},
+            {"output", audioInputOutput.GetOutputDeviceNames()}
+        };
+
+        std::cout << devices.dump(2) << std::endl;
+
+        return 0;
+    }
+
+    const std::string name = options.GetString("name", "");
+    const std::string password = options.GetString("password", "");
+
+    if (name.empty() || password.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    Comms::AudioInputOutput audioInputOutput(microphoneBuffer, speakerBuffer, backend);
+
+    // WAV files take the place of the devices, as virtual devices.
+    try {
+        if (options.Has("wav")) {
+            Comms::VirtualAudioDevice::Configuration input;
+            input._name = WavInputDeviceName;
+            input._path = options.GetString("wav", "");
+            input._isLooping = options.Has("loop");
+
+            audioInputOutput.AddVirtualDevice(input);
+            audioInputOutput.SetInputDevice(WavInputDeviceName);
+        }
+        else if (options.Has("input-device")) {
+            audioInputOutput.SetInputDevice(options.GetString("input-device", ""));
+        }
+
+        if (options.Has("record")) {
+            Comms::VirtualAudioDevice::Configuration output;
+            output._name = WavOutputDeviceName;
+            output._isInput = false;
+            output._path = options.GetString("record", "");
+
+            audioInputOutput.AddVirtualDevice(output);
+            audioInputOutput.SetOutputDevice(WavOutputDeviceName);
+        }
+        else if (options.Has("output-device")) {
+            audioInputOutput.SetOutputDevice(options.GetString("output-device", ""));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<Comms::MetricsServer> metricsServer;
+
+    if (options.Has("metrics-port")) {
+        metricsServer = std::make_unique<Comms::MetricsServer>(options.GetString("metrics-bind", "0.0.0.0"), static_cast<int>(options.GetInteger("metrics-port", 0)));
+
+        if (!metricsServer->Start()) {
+            std::cerr << "Could not serve metrics on port " << options.GetInteger("metrics-port", 0) << std::endl;
+            return 1;
+        }
+    }
+
+    Comms::CallManager::Configuration configuration;
+    configuration._bitrate = static_cast<int>(options.GetInteger("bitrate", 32000));
+    configuration._signallingClientFactory = [serviceURL = options.GetString("signalling-url", Comms::WebSocketSignallingClient::DefaultServiceURL),
+        socketURL = options.GetString("signalling-socket-url", Comms::WebSocketSignallingClient::DefaultSocketURL)]() -> std::shared_ptr<Comms::SignallingClient> {
+        return std::make_shared<Comms::WebSocketSignallingClient>(serviceURL, socketURL);
+    };
+
+    Comms::CallManager callManager(microphoneBuffer, speakerBuffer, configuration);
+
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+
+    Comms::PipelineTrace::SetEnabled(options.Has("trace"));
+    Comms::PacketCapture::SetEnabled(options.Has("capture") || options.Has("capture-on-loss"));
+
+    if (options.Has("capture-on-loss")) {
+        // Each loss burst is written beside the capture written on exit, e.g. call.pcap and call_1700000000123.pcap, or
+        // without one as capture_1700000000123.pcap.
+        auto pathPrefix = options.GetString("capture", "capture");
+
+        if (pathPrefix.size() > 5 && pathPrefix.ends_with(".pcap")) {
+            pathPrefix.resize(pathPrefix.size() - 5);
+        }
+
+        Comms::PacketCapture::SetLossTrigger(static_cast<std::size_t>(std::max<std::int64_t>(options.GetInteger("capture-on-loss", 0), 0)), pathPrefix);
+    }
+
+    audioInputOutput.StartAudioStreams();
+
+    const auto callId = options.Has("mesh") ? callManager.StartMeshCall(name, password) : callManager.StartCall(name, password);
+    const auto start = std::chrono::steady_clock::now();
+    const auto duration = std::chrono::duration<double>(options.GetDouble("duration", 0.0));
+    const auto statsInterval = std::chrono::milliseconds(options.GetInteger("stats-interval", 1000));
+    auto nextStatsTime = start + statsInterval;
+
+    while (!IsInterrupted && (duration.count() <= 0.0 || std::chrono::steady_clock::now() - start < duration)) {
+        std::this_thread::sleep_until(nextStatsTime);
+        nextStatsTime += statsInterval;
+
+        for (const auto& call : callManager.GetCalls()) {
+            nlohmann::json stats = {
+                {"time", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()},
+                {"call", call._id},
+                {"name", call._name},
+                {"state", GetConnectionStateName(call._state)},
+                {"peers", call._peerCount},
+                {"connectedPeers", call._connectedPeerCount},
+                {"rttMs", call._stats._roundTripTime.has_value() ? nlohmann::json(*call._stats._roundTripTime) : nlohmann::json()},
+                {"jitterMs", call._stats._jitter},
+                {"sentLoss", call._stats._sentLossFraction},
+                {"sendBitrate", call._stats._sendBitrate},
+                {"receiveBitrate", call._stats._receiveBitrate},
+                {"sentPackets", call._stats._sentPackets},
+                {"receivedPackets", call._stats._receivedPackets},
+                {"lostPackets", call._stats._lostPackets},
+                {"latePackets", call._stats._latePackets},
+                {"bufferedFrames", call._stats._bufferedFrames},
+                {"decodedFrames", call._stats._decodedFrames},
+                {"concealedFrames", call._stats._concealedFrames},
+                {"encoderBitrate", call._stats._encoderBitrate}
+            };
+
+            std::cout << stats.dump() << std::endl;
+        }
+
+        if (audioInputOutput.IsInputFinished()) {
+            break;
+        }
+    }
+
+    callManager.EndCall(callId);
+    audioInputOutput.StopAudioStreams();
+
+    if (options.Has("trace") && !Comms::PipelineTrace::WriteChromeTrace(options.GetString("trace", ""))) {
+        std::cerr << "Could not write the trace to " << options.GetString("trace", "") << std::endl;
+        return 1;
+    }
+
+    if (options.Has("capture") && !Comms::PacketCapture::WritePcap(options.GetString("capture", ""))) {
+        std::cerr << "Could not write the capture to " << options.GetString("capture", "") << std::endl;
+        return 1;
+    }
+
+    // A Debug build hooks operator new, and reports any allocation on the device threads with the stack it was made from.
+    if (Comms::AllocationTracker::GetRealTimeAllocationCount() > 0) {
+        std::cerr << "Allocations were made on a real-time thread:" << std::endl
+            << Comms::AllocationTracker::RealTimeAllocationsToJson().dump(2) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "call_load_generator.h"
+#include "call_simulation.h"
+#include "command_line_options.h"
+#include "signalling_load_generator.h"
+
+namespace {
+    using ScenarioFactory = std::function<std::unique_ptr<Comms::Benchmark>(const Comms::CommandLineOptions&)>;
+
+    /*
+    * @return The available load scenarios keyed by the name used to select them on the command line.
+    */
+    const std::map<std::string, ScenarioFactory>& GetScenarios() {
+        static const std::map<std::string, ScenarioFactory> scenarios = {
+            {"signalling", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::SignallingLoadGenerator>(options); }},
+            {"calls", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::CallLoadGenerator>(options); }},
+            {"simulated-calls", [](const Comms::CommandLineOptions& options) { return std::make_unique<Comms::CallSimulation>(options); }}
+        };
+
+        return scenarios;
+    }
+}
+
+/*
+* Runs a single load scenario and writes its results to stdout as JSON.
+*
+* Usage: CommsLoadGenerator <scenario> [--option value ...]
+*/
+int main(int argc, char** argv)
+{
+    Comms::CommandLineOptions options(argc, argv);
+
+    const auto& arguments = options.GetPositionalArguments();
+    const auto& scenarios = GetScenarios();
+
+    if (arguments.empty() || !scenarios.contains(arguments.front())) {
+        std::cerr << "Usage: CommsLoadGenerator <scenario> [--option value ...]" << std::endl << "Scenarios:" << std::endl;
+
+        for (const auto& [name, factory] : scenarios) {
+            std::cerr << "  " << name << std::endl;
+        }
+
+        return 1;
+    }
+
+    auto scenario = scenarios.at(arguments.front())(options);
+    nlohmann::json results = {
+        {"scenario", arguments.front()},
+        {"results", scenario->Run()}
+    };
+
+    std::cout << results.dump(2) << std::endl;
+
+    // A scenario that runs real-time work, e.g. the simulated device periods and codec, fails if any of it allocated.
+    if (results["results"].value("realtime_allocations", 0) > 0) {
+        std::cerr << "Allocations were made on a real-time thread." << std::endl;
+        return 2;
+    }
+
+    return results["results"].contains("error") ? 1 : 0;
+}
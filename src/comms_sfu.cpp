@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "command_line_options.h"
+#include "sfu_server.h"
+
+/*
+* Runs a headless Selective Forwarding Unit until the process is terminated.
+*
+* Usage: CommsSfu [--option value ...]
+*
+* Options:
+*   --bind <address>        Address the HTTP API listens on. Default 0.0.0.0.
+*   --port <n>              HTTP API port. Default 8080.
+*   --threads <n>           HTTP worker threads. Default 16.
+*   --workers <n>           Forwarding or mixing workers, each pinned to a core. Default one per hardware thread.
+*   --slots <n>             Most senders each participant can hear. Default 16.
+*   --last-n <n>            Loudest speakers forwarded to each participant. 0 forwards everyone, up to --slots. Default 5.
+*   --mix                   Decode and mix each room, sending every participant a single stream (MCU mode).
+*   --mix-bitrate <n>       Bitrate mixes are encoded at, in bits per second. Default 32000.
+*   --media-bind <address>  Address ICE binds to. Default any.
+*   --port-begin <n>        First UDP port for media. Default any.
+*   --port-end <n>          Last UDP port for media. Default any.
+*   --udp-mux               Share one UDP port between all participants. Recommended for large numbers of participants.
+*   --ice-servers <url,...> STUN or TURN servers used to discover the SFU's public address.
+*   --cert <file>           PEM certificate. Enables HTTPS when given with --key.
+*   --key <file>            PEM private key for the certificate.
+*   --node-id <n>           Identifies the node within a cascade, 0 to 255. Must be unique among the nodes. Default 0.
+*   --relay-port <n>        UDP port of the relay link to other nodes. Enables cascading. 0 selects any free port.
+*   --relay-peers <h:p,...> The other nodes' relay endpoints. Only one of each pair of nodes needs to list the other.
+*
+* For example, three cascaded nodes on one host:
+*   CommsSfu --port 8081 --node-id 1 --relay-port 9001
+*   CommsSfu --port 8082 --node-id 2 --relay-port 9002 --relay-peers 127.0.0.1:9001
+*   CommsSfu --port 8083 --node-id 3 --relay-port 9003 --relay-peers 127.0.0.1:9001,127.0.0.1:9002
+* GET /status on any node shows the others, the rooms each shares and the packets relayed each way.
+*
+* Cascading also requires the secret shared by every node, which signs the relayed datagrams, in the COMMS_CLUSTER_KEY
+* environment variable. It is not taken as an option, so that it does not appear in process listings.
+*/
+int main(int argc, char** argv)
+{
+    Comms::CommandLineOptions options(argc, argv);
+
+    Comms::SfuServer::Configuration configuration;
+    configuration._bindAddress = options.GetString("bind", configuration._bindAddress);
+    configuration._httpPort = static_cast<int>(options.GetInteger("port", configuration._httpPort));
+    configuration._httpThreadCount = options.GetInteger("threads", configuration._httpThreadCount);
+    configuration._workerCount = options.GetInteger("workers", configuration._workerCount);
+    configuration._slotCount = options.GetInteger("slots", configuration._slotCount);
+    configuration._lastN = options.GetInteger("last-n", configuration._lastN);
+    configuration._isMixing = options.Has("mix");
+    configuration._mixBitrate = static_cast<int>(options.GetInteger("mix-bitrate", configuration._mixBitrate));
+    configuration._portRangeBegin = static_cast<std::uint16_t>(options.GetInteger("port-begin", configuration._portRangeBegin));
+    configuration._portRangeEnd = static_cast<std::uint16_t>(options.GetInteger("port-end", configuration._portRangeEnd));
+    configuration._enableIceUdpMux = options.Has("udp-mux");
+    configuration._iceServers = options.GetList("ice-servers");
+
+    configuration._nodeId = static_cast<std::uint8_t>(options.GetInteger("node-id", configuration._nodeId));
+    configuration._relayPeers = options.GetList("relay-peers");
+
+    if (options.Has("relay-port")) {
+        configuration._relayPort = static_cast<std::uint16_t>(options.GetInteger("relay-port", 0));
+
+        const char* relayKey = std::getenv("COMMS_CLUSTER_KEY");
+
+        if (relayKey == nullptr || *relayKey == '\0') {
+            std::cerr << "Cascading requires the COMMS_CLUSTER_KEY environment variable" << std::endl;
+            return 1;
+        }
+
+        configuration._relayKey = relayKey;
+    }
+
+    if (options.Has("media-bind")) {
+        configuration._mediaBindAddress = options.GetString("media-bind", "");
+    }
+
+    if (options.Has("cert") && options.Has("key")) {
+        configuration._certificatePemFile = options.GetString("cert", "");
+        configuration._keyPemFile = options.GetString("key", "");
+    }
+
+    Comms::SfuServer server(configuration);
+
+    if (!server.Start()) {
+        std::cerr << "Failed to start the SFU on " << configuration._bindAddress << ":" << configuration._httpPort << std::endl;
+        return 1;
+    }
+
+    std::cout << (configuration._isMixing ? "MCU" : "SFU") << " listening on " << configuration._bindAddress << ":" << server.GetHttpPort()
+        << " with " << configuration._workerCount << " workers" << std::endl;
+
+    if (server.GetRelayPort() != 0) {
+        std::cout << "Node " << static_cast<int>(configuration._nodeId) << " relaying on UDP port " << server.GetRelayPort() << std::endl;
+    }
+
+    server.Wait();
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "command_line_options.h"
+#include "signalling_server.h"
+
+/*
+* Runs a self-hosted signalling server until the process is terminated.
+*
+* Usage: CommsSignallingServer [--option value ...]
+*
+* Options:
+*   --bind <address>     Address to listen on. Default 0.0.0.0.
+*   --port <n>           HTTP API port. Default 8000.
+*   --ws-port <n>        WebSocket push channel port. Default 8001.
+*   --shards <n>         Room store shards. Default 64.
+*   --threads <n>        HTTP worker threads. Default four per hardware thread, and at least 32.
+*   --ttl-seconds <n>    Seconds a room is kept after it was last published to. Default 1800.
+*   --cert <file>        PEM certificate. Enables HTTPS and WSS when given with --key.
+*   --key <file>         PEM private key for the certificate.
+*   --cluster-host <h>   Host other nodes use to reach this one. Enables clustering.
+*   --peers <url,...>    Base URLs of nodes to join the cluster through.
+*
+* Clustering also requires the secret shared by every node, which signs the requests between them, in the
+* COMMS_CLUSTER_KEY environment variable. It is not taken as an option, so that it does not appear in process listings.
+*/
+int main(int argc, char** argv)
+{
+    Comms::CommandLineOptions options(argc, argv);
+
+    Comms::SignallingServer::Configuration configuration;
+    configuration._bindAddress = options.GetString("bind", configuration._bindAddress);
+    configuration._httpPort = static_cast<int>(options.GetInteger("port", configuration._httpPort));
+    configuration._webSocketPort = static_cast<std::uint16_t>(options.GetInteger("ws-port", configuration._webSocketPort));
+    configuration._shardCount = options.GetInteger("shards", configuration._shardCount);
+    configuration._threadCount = options.GetInteger("threads", std::max<std::size_t>(std::thread::hardware_concurrency() * 4, configuration._threadCount));
+    configuration._roomTimeToLive = std::chrono::seconds(options.GetInteger("ttl-seconds", configuration._roomTimeToLive.count()));
+
+    if (options.Has("cert") && options.Has("key")) {
+        configuration._certificatePemFile = options.GetString("cert", "");
+        configuration._keyPemFile = options.GetString("key", "");
+    }
+
+    if (options.Has("cluster-host")) {
+        configuration._clusterHost = options.GetString("cluster-host", "");
+        configuration._clusterSeedURLs = options.GetList("peers");
+
+        const char* clusterKey = std::getenv("COMMS_CLUSTER_KEY");
+
+        if (clusterKey == nullptr || *clusterKey == '\0') {
+            std::cerr << "Clustering requires the COMMS_CLUSTER_KEY environment variable" << std::endl;
+            return 1;
+        }
+
+        configuration._clusterKey = clusterKey;
+    }
+
+    Comms::SignallingServer server(configuration);
+
+    if (!server.Start()) {
+        std::cerr << "Failed to start the signalling server on " << configuration._bindAddress << ":" << configuration._httpPort << std::endl;
+        return 1;
+    }
+
+    std::cout << "Signalling server listening on " << configuration._bindAddress
+        << " (HTTP " << server.GetHttpPort() << ", WebSocket " << server.GetWebSocketPort() << ")" << std::endl;
+
+    server.Wait();
+
+    return 0;
+}
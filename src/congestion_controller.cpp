@@ -0,0 +1,299 @@
+#include "congestion_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "metrics.h"
+
+namespace {
+    constexpr std::int64_t BurstTime = 5000; // Microseconds within which packets sent are grouped as one burst.
+
+    constexpr double SmoothingCoefficient = 0.9; // Weight of the previous smoothed delay.
+    constexpr std::size_t TrendWindowSize = 20; // Groups the trendline is fitted over.
+    constexpr double TrendGain = 4.0; // Scales the trend before it is compared to the threshold.
+    constexpr std::size_t TrendFullWeightDeltas = 60; // Delay changes measured before the trend is fully weighted.
+
+    constexpr double OveruseTime = 10.0; // Milliseconds the trend must stay over the threshold for the path to be overused.
+    constexpr double ThresholdIncreaseRate = 0.0087; // How fast the threshold rises towards a trend above it.
+    constexpr double ThresholdDecreaseRate = 0.039; // How fast the threshold falls towards a trend below it.
+    constexpr double ThresholdOutlier = 15.0; // Trends further than this over the threshold do not adapt it.
+    constexpr double MinimumThreshold = 6.0;
+    constexpr double MaximumThreshold = 600.0;
+
+    constexpr double DecreaseFactor = 0.85; // The share of the acknowledged bitrate the target drops to when overused.
+    constexpr double IncreaseFactor = 1.08; // The growth of the target over a second while the path is normal.
+    constexpr double AcknowledgedHeadroom = 1.5; // The target is kept within this multiple of the acknowledged bitrate...
+    constexpr double AcknowledgedMargin = 10000.0; // ...plus this many bits per second.
+    constexpr std::int64_t DecreaseInterval = 200000; // Microseconds between decreases, so one queue is not reacted to twice.
+
+    constexpr double HighLossFraction = 0.1; // Loss above which the target is cut.
+
+    constexpr std::int64_t AcknowledgedWindow = 500000; // Microseconds of arrivals the acknowledged bitrate is measured over.
+    constexpr std::int64_t MinimumAcknowledgedSpan = 250000; // Microseconds of arrivals needed to measure it.
+
+    constexpr double RoundTripTimeGain = 0.125; // The weight of each round trip time measured (RFC 6298).
+    constexpr double LossGain = 0.1; // The weight of each feedback's loss, about a second's worth at one every 100 ms.
+
+    Comms::Histogram& RoundTripSeconds = Comms::Metrics::AddHistogram("comms_transport_round_trip_seconds", "Round trip times measured from transport-cc feedback.", Comms::GetNetworkTimeBounds());
+    Comms::Counter& ReportedLostPacketsTotal = Comms::Metrics::AddCounter("comms_transport_reported_lost_packets_total", "Packets sent that the receiver reported lost.");
+
+    /*
+    * @return The slope of the least squares line through points.
+    */
+    std::optional<double> FitSlope(const std::deque<std::pair<double, double>>& points) {
+        double sumX = 0.0;
+        double sumY = 0.0;
+
+        for (const auto& [x, y] : points) {
+            sumX += x;
+            sumY += y;
+        }
+
+        const double meanX = sumX / points.size();
+        const double meanY = sumY / points.size();
+        double numerator = 0.0;
+        double denominator = 0.0;
+
+        for (const auto& [x, y] : points) {
+            numerator += (x - meanX) * (y - meanY);
+            denominator += (x - meanX) * (x - meanX);
+        }
+
+        if (denominator == 0.0) {
+            return std::nullopt;
+        }
+
+        return numerator / denominator;
+    }
+}
+
+namespace Comms {
+    CongestionController::CongestionController(int minimumBitrate, int maximumBitrate) :
+        _minimumBitrate(minimumBitrate),
+        _maximumBitrate(maximumBitrate),
+        _target(maximumBitrate),
+        _targetBitrate(maximumBitrate) {
+    }
+
+    void CongestionController::OnPacketSent(std::uint16_t sequenceNumber, std::size_t size, std::int64_t sendTime) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        const std::int64_t unwrapped = _highestSent >= 0 ?
+            _highestSent + static_cast<std::int16_t>(sequenceNumber - static_cast<std::uint16_t>(_highestSent)) : sequenceNumber;
+
+        _sentPackets[unwrapped % _sentPackets.size()] = { unwrapped, size, sendTime };
+        _highestSent = std::max(_highestSent, unwrapped);
+    }
+
+    void CongestionController::OnTransportFeedback(const std::vector<PacketArrival>& packets, std::int64_t now) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_highestSent < 0) {
+            return;
+        }
+
+        std::size_t receivedCount = 0;
+        std::size_t lostCount = 0;
+        std::optional<std::int64_t> newestSendTime; // When the newest packet that arrived was sent.
+
+        for (const auto& packet : packets) {
+            const std::int64_t unwrapped = _highestSent + static_cast<std::int16_t>(packet._sequenceNumber - static_cast<std::uint16_t>(_highestSent));
+
+            if (unwrapped < 0 || _sentPackets[unwrapped % _sentPackets.size()]._sequenceNumber != unwrapped) {
+                continue; // Sent too long ago to still be tracked.
+            }
+
+            const auto& sent = _sentPackets[unwrapped % _sentPackets.size()];
+
+            if (!packet._arrivalTime.has_value()) {
+                lostCount++;
+                continue;
+            }
+
+            receivedCount++;
+            newestSendTime = std::max(newestSendTime.value_or(sent._sendTime), sent._sendTime);
+            _acknowledged.emplace_back(*packet._arrivalTime, sent._size);
+            OnPacketArrival(sent._sendTime, *packet._arrivalTime);
+        }
+
+        if (receivedCount + lostCount == 0) {
+            return;
+        }
+
+        ReportedLostPacketsTotal.Increment(lostCount);
+
+        const double lossFraction = static_cast<double>(lostCount) / (receivedCount + lostCount);
+        const double previousLossFraction = _lossFraction.load(std::memory_order_relaxed);
+        _lossFraction.store(previousLossFraction + (lossFraction - previousLossFraction) * LossGain, std::memory_order_relaxed);
+
+        if (newestSendTime.has_value()) {
+            const double roundTripTime = (now - *newestSendTime) / 1000.0;
+            RoundTripSeconds.Observe(roundTripTime / 1000.0);
+            const double previousRoundTripTime = _roundTripTime.load(std::memory_order_relaxed);
+
+            _roundTripTime.store(previousRoundTripTime < 0.0 ? roundTripTime :
+                previousRoundTripTime + (roundTripTime - previousRoundTripTime) * RoundTripTimeGain, std::memory_order_relaxed);
+        }
+
+        while (!_acknowledged.empty() && _acknowledged.front().first < _acknowledged.back().first - AcknowledgedWindow) {
+            _acknowledged.pop_front();
+        }
+
+        UpdateTarget(lossFraction, now);
+    }
+
+    int CongestionController::GetTargetBitrate() const {
+        return _targetBitrate;
+    }
+
+    std::optional<double> CongestionController::GetRoundTripTime() const {
+        const double roundTripTime = _roundTripTime.load(std::memory_order_relaxed);
+
+        return roundTripTime >= 0.0 ? std::optional<double>(roundTripTime) : std::nullopt;
+    }
+
+    double CongestionController::GetLossFraction() const {
+        return _lossFraction.load(std::memory_order_relaxed);
+    }
+
+    void CongestionController::OnPacketArrival(std::int64_t sendTime, std::int64_t arrivalTime) {
+        if (!_currentGroup.has_value()) {
+            _currentGroup = PacketGroup{ sendTime, sendTime, arrivalTime };
+            return;
+        }
+
+        if (sendTime < _currentGroup->_firstSendTime) {
+            return; // Reordered, and already accounted for by the group it was sent in.
+        }
+
+        if (sendTime - _currentGroup->_firstSendTime <= BurstTime) {
+            _currentGroup->_lastSendTime = std::max(_currentGroup->_lastSendTime, sendTime);
+            _currentGroup->_lastArrivalTime = std::max(_currentGroup->_lastArrivalTime, arrivalTime);
+            return;
+        }
+
+        if (_previousGroup.has_value()) {
+            UpdateTrend((_currentGroup->_lastSendTime - _previousGroup->_lastSendTime) / 1000.0,
+                (_currentGroup->_lastArrivalTime - _previousGroup->_lastArrivalTime) / 1000.0, _currentGroup->_lastArrivalTime);
+        }
+
+        _previousGroup = _currentGroup;
+        _currentGroup = PacketGroup{ sendTime, sendTime, arrivalTime };
+    }
+
+    void CongestionController::UpdateTrend(double sendDelta, double arrivalDelta, std::int64_t arrivalTime) {
+        _deltaCount = std::min(_deltaCount + 1, TrendFullWeightDeltas);
+        _accumulatedDelay += arrivalDelta - sendDelta;
+        _smoothedDelay = SmoothingCoefficient * _smoothedDelay + (1.0 - SmoothingCoefficient) * _accumulatedDelay;
+
+        if (!_firstArrivalTime.has_value()) {
+            _firstArrivalTime = arrivalTime;
+        }
+
+        _trendPoints.emplace_back((arrivalTime - *_firstArrivalTime) / 1000.0, _smoothedDelay);
+
+        if (_trendPoints.size() > TrendWindowSize) {
+            _trendPoints.pop_front();
+        }
+
+        double trend = _previousTrend;
+
+        if (_trendPoints.size() == TrendWindowSize) {
+            trend = FitSlope(_trendPoints).value_or(_previousTrend);
+        }
+
+        const double modifiedTrend = std::min(_deltaCount, TrendFullWeightDeltas) * trend * TrendGain;
+
+        if (modifiedTrend > _threshold) {
+            _overuseTime = _overuseTime < 0.0 ? sendDelta / 2.0 : _overuseTime + sendDelta;
+            _overuseCount++;
+
+            // The usage is left as it was until the trend has been over the threshold for long enough, and is still rising.
+            if (_overuseTime > OveruseTime && _overuseCount > 1 && trend >= _previousTrend) {
+                _usage = Usage::Overusing;
+                _overuseTime = 0.0;
+                _overuseCount = 0;
+            }
+        }
+        else if (modifiedTrend < -_threshold) {
+            _overuseTime = -1.0;
+            _overuseCount = 0;
+            _usage = Usage::Underusing;
+        }
+        else {
+            _overuseTime = -1.0;
+            _overuseCount = 0;
+            _usage = Usage::Normal;
+        }
+
+        _previousTrend = trend;
+        UpdateThreshold(modifiedTrend, arrivalTime);
+    }
+
+    void CongestionController::UpdateThreshold(double trend, std::int64_t now) {
+        if (!_lastThresholdUpdate.has_value()) {
+            _lastThresholdUpdate = now;
+        }
+
+        const double magnitude = std::abs(trend);
+
+        if (magnitude > _threshold + ThresholdOutlier) {
+            _lastThresholdUpdate = now; // A spike, e.g. a route change, which should not raise the threshold.
+            return;
+        }
+
+        const double rate = magnitude < _threshold ? ThresholdDecreaseRate : ThresholdIncreaseRate;
+        const double elapsed = std::min((now - *_lastThresholdUpdate) / 1000.0, 100.0);
+
+        _threshold = std::clamp(_threshold + rate * (magnitude - _threshold) * elapsed, MinimumThreshold, MaximumThreshold);
+        _lastThresholdUpdate = now;
+    }
+
+    void CongestionController::UpdateTarget(double lossFraction, std::int64_t now) {
+        const double elapsed = _lastUpdate.has_value() ? std::min((now - *_lastUpdate) / 1e6, 1.0) : 0.0;
+        const auto acknowledged = GetAcknowledgedBitrate();
+        const bool canDecrease = !_lastDecrease.has_value() || now - *_lastDecrease >= DecreaseInterval;
+
+        if (_usage == Usage::Overusing && canDecrease) {
+            _target = DecreaseFactor * acknowledged.value_or(_target);
+            _lastDecrease = now;
+        }
+        else if (lossFraction > HighLossFraction && canDecrease) {
+            _target *= 1.0 - 0.5 * lossFraction;
+            _lastDecrease = now;
+        }
+        else if (_usage == Usage::Normal) {
+            _target *= std::pow(IncreaseFactor, elapsed);
+
+            if (acknowledged.has_value()) {
+                _target = std::min(_target, AcknowledgedHeadroom * *acknowledged + AcknowledgedMargin);
+            }
+        }
+
+        // Held while underused, until the queues the path built have drained.
+        _target = std::clamp(_target, static_cast<double>(_minimumBitrate), static_cast<double>(_maximumBitrate));
+        _targetBitrate = static_cast<int>(std::lround(_target));
+        _lastUpdate = now;
+    }
+
+    std::optional<double> CongestionController::GetAcknowledgedBitrate() const {
+        if (_acknowledged.size() < 2) {
+            return std::nullopt;
+        }
+
+        const std::int64_t span = _acknowledged.back().first - _acknowledged.front().first;
+
+        if (span < MinimumAcknowledgedSpan) {
+            return std::nullopt;
+        }
+
+        // The first packet's bytes arrived before the span began.
+        std::size_t bytes = 0;
+
+        for (auto packet = std::next(_acknowledged.begin()); packet != _acknowledged.end(); packet++) {
+            bytes += packet->second;
+        }
+
+        return bytes * 8.0 / (span / 1e6);
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "transport_feedback.h"
+
+namespace Comms {
+
+    /*
+    * Estimates the bitrate a connection can send at from transport-cc feedback, backing off as soon as queues start to
+    * build on the path rather than once they overflow and packets are lost.
+    *
+    * Follows Google Congestion Control (draft-ietf-rmcat-gcc-02):
+    *   Packets sent within 5 ms of each other are grouped, as a burst, and the change in one-way delay from one group to
+    *   the next is accumulated. A trendline fitted to the smoothed accumulated delay over the last 20 groups gives the rate
+    *   queues are growing at.
+    *   The trend is compared to a threshold that adapts to it, so that the estimator is not starved by competing loss-based
+    *   flows. Above the threshold the path is overused, below its negative underused, and normal otherwise.
+    *   The target bitrate drops to 85% of the bitrate the receiver acknowledged when the path is overused, holds while
+    *   queues drain, and grows by 8% a second while it is normal, to at most 1.5 times the acknowledged bitrate.
+    *   Heavy loss also cuts the target, as a path losing packets without building a queue would not show in the delay.
+    */
+    class CongestionController {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param minimumBitrate The lowest target, in bits per second.
+        * @param maximumBitrate The highest target, and the target until the first feedback, in bits per second.
+        */
+        CongestionController(int minimumBitrate, int maximumBitrate);
+
+        /*
+        * Records a packet being sent, so that feedback about it can be matched to when it was sent.
+        *
+        * @param sequenceNumber The packet's transport-wide sequence number.
+        * @param size The size of the packet in bytes.
+        * @param sendTime When it was sent, in microseconds.
+        */
+        void OnPacketSent(std::uint16_t sequenceNumber, std::size_t size, std::int64_t sendTime);
+
+        /*
+        * Updates the target bitrate from transport-cc feedback.
+        *
+        * @param packets The packets reported.
+        * @param now The time the feedback arrived, in microseconds on the same clock as the send times.
+        */
+        void OnTransportFeedback(const std::vector<PacketArrival>& packets, std::int64_t now);
+
+        /*
+        * @return The bitrate the connection should send at, in bits per second.
+        */
+        int GetTargetBitrate() const;
+
+        /*
+        * @return The round trip time to the receiver, smoothed, in milliseconds, or nothing until the first feedback. Measured
+        *         to the newest packet each feedback reports, as the receiver sends feedback when such a packet arrives.
+        */
+        std::optional<double> GetRoundTripTime() const;
+
+        /*
+        * @return The fraction of packets the receiver reported lost, smoothed over about the last second of feedback.
+        */
+        double GetLossFraction() const;
+
+    private:
+        enum class Usage {
+            Normal,
+            Overusing,
+            Underusing
+        };
+
+        /*
+        * A packet sent, waiting for feedback.
+        */
+        struct SentPacket {
+            std::int64_t _sequenceNumber = -1; // The packet's transport-wide sequence number, or -1 if the slot is empty.
+            std::size_t _size = 0; // The size of the packet in bytes.
+            std::int64_t _sendTime = 0; // When it was sent, in microseconds.
+        };
+
+        /*
+        * Packets sent within a burst, whose delay is measured together.
+        */
+        struct PacketGroup {
+            std::int64_t _firstSendTime = 0; // When the group's first packet was sent, in microseconds.
+            std::int64_t _lastSendTime = 0; // When its last packet was sent, in microseconds.
+            std::int64_t _lastArrivalTime = 0; // When its last packet arrived, in microseconds on the receiver's clock.
+        };
+
+        /*
+        * Adds a packet that arrived to its group, updating the trend each time a group is complete. Requires _mutex.
+        */
+        void OnPacketArrival(std::int64_t sendTime, std::int64_t arrivalTime);
+
+        /*
+        * Updates the trend with the change in delay from one group to the next, and detects the path's usage. Requires _mutex.
+        */
+        void UpdateTrend(double sendDelta, double arrivalDelta, std::int64_t arrivalTime);
+
+        /*
+        * Adapts the threshold the trend is compared to. Requires _mutex.
+        */
+        void UpdateThreshold(double trend, std::int64_t now);
+
+        /*
+        * Updates the target bitrate from the path's usage and loss. Requires _mutex.
+        */
+        void UpdateTarget(double lossFraction, std::int64_t now);
+
+        /*
+        * @return The bitrate the receiver acknowledged over the last half second, or nothing if it is not known. Requires _mutex.
+        */
+        std::optional<double> GetAcknowledgedBitrate() const;
+
+        const int _minimumBitrate; // The lowest target.
+        const int _maximumBitrate; // The highest target.
+
+        std::array<SentPacket, 1024> _sentPackets; // Packets sent, by sequence number modulo their count. Requires _mutex.
+        std::int64_t _highestSent = -1; // The highest unwrapped sequence number sent. Requires _mutex.
+
+        std::optional<PacketGroup> _currentGroup; // The group packets are being added to. Requires _mutex.
+        std::optional<PacketGroup> _previousGroup; // The last complete group. Requires _mutex.
+
+        double _accumulatedDelay = 0.0; // The delay accumulated over every group, in milliseconds. Requires _mutex.
+        double _smoothedDelay = 0.0; // _accumulatedDelay smoothed exponentially. Requires _mutex.
+        std::deque<std::pair<double, double>> _trendPoints; // Arrival time and smoothed delay of recent groups, in milliseconds. Requires _mutex.
+        std::optional<std::int64_t> _firstArrivalTime; // When the first group arrived, the origin of the trend points. Requires _mutex.
+        std::size_t _deltaCount = 0; // Delay changes measured, up to the count that fully weights the trend. Requires _mutex.
+
+        double _threshold = 12.5; // The trend the path is overused above. Requires _mutex.
+        std::optional<std::int64_t> _lastThresholdUpdate; // When the threshold last adapted. Requires _mutex.
+        double _previousTrend = 0.0; // The trend of the previous group. Requires _mutex.
+        double _overuseTime = -1.0; // Milliseconds the trend has been over the threshold, or -1 if it is not. Requires _mutex.
+        int _overuseCount = 0; // Groups the trend has been over the threshold. Requires _mutex.
+        Usage _usage = Usage::Normal; // The path's usage. Requires _mutex.
+
+        std::deque<std::pair<std::int64_t, std::size_t>> _acknowledged; // Arrival time and size of recently acknowledged packets. Requires _mutex.
+
+        std::optional<std::int64_t> _lastUpdate; // When the target was last updated. Requires _mutex.
+        std::optional<std::int64_t> _lastDecrease; // When the target was last decreased. Requires _mutex.
+        double _target; // The target bitrate. Requires _mutex.
+        std::atomic<int> _targetBitrate; // _target, rounded, for readers on any thread.
+        std::atomic<double> _roundTripTime = -1.0; // The smoothed round trip time in milliseconds, or -1 until the first feedback.
+        std::atomic<double> _lossFraction = 0.0; // The smoothed fraction of packets reported lost.
+        mutable std::mutex _mutex; // Mutex to control access to the controller's state.
+    };
+}
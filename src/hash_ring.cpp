@@ -0,0 +1,89 @@
+#include "hash_ring.h"
+
+#include <algorithm>
+
+namespace {
+    const std::string NoOwner;
+
+    constexpr std::uint64_t FnvOffsetBasis = 14695981039346656037ull;
+    constexpr std::uint64_t FnvPrime = 1099511628211ull;
+}
+
+namespace Comms {
+    HashRing::HashRing(std::size_t virtualNodeCount) :
+        _virtualNodeCount(std::max<std::size_t>(virtualNodeCount, 1)) {
+    }
+
+    bool HashRing::AddNode(const std::string& node) {
+        if (!_nodes.insert(node).second) {
+            return false;
+        }
+
+        PlaceNode(node);
+
+        return true;
+    }
+
+    bool HashRing::RemoveNode(const std::string& node) {
+        if (_nodes.erase(node) == 0) {
+            return false;
+        }
+
+        // The ring is rebuilt rather than erased from, so that points the removed node won on a collision go back to the other node.
+        _ring.clear();
+
+        for (const auto& other : _nodes) {
+            PlaceNode(other);
+        }
+
+        return true;
+    }
+
+    const std::string& HashRing::GetOwner(const std::string& key) const {
+        if (_ring.empty()) {
+            return NoOwner;
+        }
+
+        // The owner is the first point clockwise from the key, wrapping around to the start of the ring.
+        auto point = _ring.lower_bound(Hash(key));
+
+        if (point == _ring.end()) {
+            point = _ring.begin();
+        }
+
+        return point->second;
+    }
+
+    std::vector<std::string> HashRing::GetNodes() const {
+        return std::vector<std::string>(_nodes.begin(), _nodes.end());
+    }
+
+    std::uint64_t HashRing::Hash(const std::string& value) {
+        std::uint64_t hash = FnvOffsetBasis;
+
+        for (const unsigned char character : value) {
+            hash ^= character;
+            hash *= FnvPrime;
+        }
+
+        // FNV-1a alone leaves keys that differ only in their last character close together.
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+
+        return hash;
+    }
+
+    void HashRing::PlaceNode(const std::string& node) {
+        for (std::size_t i = 0; i < _virtualNodeCount; i++) {
+            // On the rare collision the lower node name keeps the point, so every node resolves it the same way.
+            auto [position, inserted] = _ring.emplace(Hash(node + "#" + std::to_string(i)), node);
+
+            if (!inserted && node < position->second) {
+                position->second = node;
+            }
+        }
+    }
+}
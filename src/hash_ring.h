@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Comms {
+
+    /*
+    * A consistent hash ring mapping keys onto a set of nodes.
+    *
+    * Each node is placed on the ring at several points (virtual nodes) so that keys are spread evenly, and adding or
+    * removing a node only moves the keys between it and its neighbours. The hash is stable across processes and
+    * platforms, so every node in a cluster computes the same owner for a key.
+    *
+    * Not thread safe.
+    */
+    class HashRing {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param virtualNodeCount The number of points each node occupies on the ring.
+        */
+        HashRing(std::size_t virtualNodeCount = 128);
+
+        /*
+        * Adds a node to the ring.
+        *
+        * @return False if the node was already on the ring.
+        */
+        bool AddNode(const std::string& node);
+
+        /*
+        * Removes a node from the ring.
+        *
+        * @return False if the node was not on the ring.
+        */
+        bool RemoveNode(const std::string& node);
+
+        /*
+        * @return The node owning a key, or an empty string if the ring is empty.
+        */
+        const std::string& GetOwner(const std::string& key) const;
+
+        /*
+        * @return Every node on the ring, in order.
+        */
+        std::vector<std::string> GetNodes() const;
+
+        /*
+        * @return A 64 bit FNV-1a hash of a value, with a final avalanche so that similar values land far apart.
+        */
+        static std::uint64_t Hash(const std::string& value);
+
+    private:
+        /*
+        * Adds a node's virtual nodes to the ring.
+        */
+        void PlaceNode(const std::string& node);
+
+        const std::size_t _virtualNodeCount; // The number of points each node occupies on the ring.
+        std::map<std::uint64_t, std::string> _ring; // Ring positions to the node placed there.
+        std::set<std::string> _nodes; // The nodes on the ring.
+    };
+}
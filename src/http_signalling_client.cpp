@@ -0,0 +1,111 @@
+#include "http_signalling_client.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "json/json.hpp"
+
+#include "persistent_http_client.h"
+
+namespace {
+    const char* SignallingServiceURL = "https://australia-southeast1-comms-link.cloudfunctions.net";
+
+    constexpr std::chrono::minutes MaximumPollingDuration(30);
+}
+
+using json = nlohmann::json;
+
+namespace Comms {
+    HttpSignallingClient::HttpSignallingClient(std::string serviceURL) :
+        _serviceURL(serviceURL),
+        _httpClient(PersistentHttpClient::ForURL(serviceURL)) {
+    }
+
+    HttpSignallingClient::HttpSignallingClient() :
+        HttpSignallingClient(SignallingServiceURL) {
+    }
+
+    void HttpSignallingClient::PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) {
+        const auto typeString = type == SDPType::Offer ? "offer" : "answer";
+        const auto pathName = type == SDPType::Offer ? "/connectionOffer" : "/connectionAnswer";
+
+        json httpBody = {
+            {"connectionName", connectionName},
+            {"password", password},
+            {typeString, sdp}
+        };
+
+        _httpClient->Post(pathName, httpBody.dump(), "application/json");
+    }
+
+    std::variant<std::monostate, bool, std::string> HttpSignallingClient::RetrieveOffer(const std::string& connectionName, const std::string& password) {
+        httplib::Params httpParams = {
+            {"connectionName", connectionName},
+            {"password", password}
+        };
+
+        auto response = _httpClient->Get("/getOffer", httpParams);
+
+        if (response && response->status == 200) {
+            return json::parse(response->body).value("data", "");
+        }
+        else if (response && response->status == 403) {
+            return false;
+        }
+
+        return std::monostate();
+    }
+
+    std::optional<std::string> HttpSignallingClient::RetrieveAnswer(const std::string& connectionName) {
+        return PollForAnswer(connectionName, std::chrono::steady_clock::now() + MaximumPollingDuration);
+    }
+
+    std::optional<std::string> HttpSignallingClient::PollForAnswer(const std::string& connectionName, std::chrono::steady_clock::time_point deadline) {
+        httplib::Params httpParams = {
+            {"connectionName", connectionName}
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        std::chrono::seconds pollingInterval(1);
+
+        while (!IsCancelled()) {
+            auto response = _httpClient->Get("/getAnswer", httpParams);
+
+            if (response && response->status == 200) {
+                return json::parse(response->body).value("data", "");
+            }
+
+            // No answer yet, or the request failed. Either way, wait and try again.
+            const auto now = std::chrono::steady_clock::now();
+
+            if (now >= deadline) {
+                return std::nullopt;
+            }
+
+            if (now - start >= std::chrono::minutes(5)) {
+                pollingInterval = std::chrono::seconds(30);
+            }
+            else if (now - start >= std::chrono::seconds(30)) {
+                pollingInterval = std::chrono::seconds(5);
+            }
+
+            std::unique_lock<std::mutex> lock(_cancelMutex);
+            _cancelledCondition.wait_until(lock, std::min(now + pollingInterval, deadline), [this]() { return _isCancelled; });
+        }
+
+        return std::nullopt;
+    }
+
+    void HttpSignallingClient::Cancel() {
+        {
+            std::lock_guard<std::mutex> lock(_cancelMutex);
+            _isCancelled = true;
+        }
+        _cancelledCondition.notify_all();
+    }
+
+    bool HttpSignallingClient::IsCancelled() const {
+        std::lock_guard<std::mutex> lock(_cancelMutex);
+        return _isCancelled;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "signalling_client.h"
+
+namespace Comms {
+
+    class PersistentHttpClient;
+
+    /*
+    * Signalling over the HTTP API of the signalling service.
+    * Offers and answers are published with POST requests to /connectionOffer and /connectionAnswer,
+    * and retrieved with GET requests to /getOffer and /getAnswer.
+    *
+    * All clients for the same service share one kept-alive connection, so polling does not pay a handshake per request.
+    * @see PersistentHttpClient
+    */
+    class HttpSignallingClient : public SignallingClient {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param serviceURL The base URL of the signalling service.
+        */
+        HttpSignallingClient(std::string serviceURL);
+
+        /*
+        * Constructor using the hosted signalling service.
+        */
+        HttpSignallingClient();
+
+        void PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) override;
+
+        std::variant<std::monostate, bool, std::string> RetrieveOffer(const std::string& connectionName, const std::string& password) override;
+
+        /*
+        * Polls the signalling service for an answer.
+        *
+        * For the first 30 seconds of attempting connection, the service will be polled every second.
+        * The polling interval is then increased to 5 seconds until 5 minutes of polling has elapsed.
+        * Finally the polling interval is increased to 30 seconds until the maximum polling duration of 30 minutes has elapsed.
+        */
+        std::optional<std::string> RetrieveAnswer(const std::string& connectionName) override;
+
+        /*
+        * Stops polling. A request already sent is waited for.
+        */
+        void Cancel() override;
+
+    protected:
+        /*
+        * Polls the signalling service for an answer, on the schedule of RetrieveAnswer, until a deadline.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param deadline The time polling gives up at.
+        * @return The answer SDP if it was retrieved before the deadline.
+        */
+        std::optional<std::string> PollForAnswer(const std::string& connectionName, std::chrono::steady_clock::time_point deadline);
+
+        /*
+        * @return Whether the client has been cancelled.
+        */
+        bool IsCancelled() const;
+
+        const std::string _serviceURL; // The base URL of the signalling service.
+        std::shared_ptr<PersistentHttpClient> _httpClient; // The process wide connection to the signalling service.
+
+    private:
+        bool _isCancelled = false; // Set when the client is cancelled.
+        mutable std::mutex _cancelMutex; // Mutex to control read and write access to _isCancelled.
+        std::condition_variable _cancelledCondition; // Notified when the client is cancelled, waking polling.
+    };
+}
@@ -0,0 +1,152 @@
+#include "jitter_buffer.h"
+
+#include <algorithm>
+
+#include "metrics.h"
+#include "pipeline_trace.h"
+#include "rtp_packet.h"
+
+namespace {
+    // Consecutive frames without a packet after which the stream is treated as stopped and the buffer resets. Half a second.
+    constexpr std::size_t ResetFrameCount = 25;
+
+    Comms::Counter& LostPacketsTotal = Comms::Metrics::AddCounter("comms_jitter_buffer_lost_packets_total", "Packets that did not arrive in time to be played.");
+    Comms::Counter& LatePacketsTotal = Comms::Metrics::AddCounter("comms_jitter_buffer_late_packets_total", "Packets dropped because they arrived after their frame was played.");
+
+    std::int32_t ReadSequenceNumber(const rtc::binary& packet) {
+        return (std::to_integer<std::int32_t>(packet[2]) << 8) | std::to_integer<std::int32_t>(packet[3]);
+    }
+
+    /*
+    * @return How far a sequence number is ahead of another, negative if it is behind, allowing for wrap around.
+    */
+    std::int32_t GetSequenceDistance(std::int32_t from, std::int32_t to) {
+        return static_cast<std::int16_t>(static_cast<std::uint16_t>(to - from));
+    }
+}
+
+namespace Comms {
+    JitterBuffer::JitterBuffer(std::size_t delayFrames, std::uint32_t traceId) :
+        _delayFrames(std::clamp<std::size_t>(delayFrames, 1, Capacity / 2)),
+        _traceId(traceId) {
+    }
+
+    bool JitterBuffer::Push(const rtc::binary& packet) {
+        const auto payload = GetRtpPayload(packet.data(), packet.size());
+
+        if (!payload.has_value() || payload->second > MaximumPayloadSize) {
+            return false;
+        }
+
+        const auto sequenceNumber = ReadSequenceNumber(packet);
+        TraceSpan span(TraceStage::JitterBufferPush, sequenceNumber, _traceId);
+        auto nextSequenceNumber = _nextSequenceNumber.load();
+
+        // The first packet since the buffer reset decides where playout starts.
+        if (nextSequenceNumber < 0 && _nextSequenceNumber.compare_exchange_strong(nextSequenceNumber, sequenceNumber)) {
+            nextSequenceNumber = sequenceNumber;
+        }
+
+        const auto distance = GetSequenceDistance(nextSequenceNumber, sequenceNumber);
+
+        if (distance < 0) {
+            _lateCount++;
+            LatePacketsTotal.Increment();
+            return false;
+        }
+
+        auto& slot = _slots[sequenceNumber % Capacity];
+
+        if (distance >= static_cast<std::int32_t>(Capacity) || slot._sequenceNumber.load(std::memory_order_relaxed) == sequenceNumber) {
+            return false;
+        }
+
+        std::copy_n(reinterpret_cast<const unsigned char*>(packet.data()) + payload->first, payload->second, slot._payload.begin());
+        slot._size = payload->second;
+        slot._sequenceNumber.store(sequenceNumber, std::memory_order_release);
+
+        return true;
+    }
+
+    JitterBuffer::Frame JitterBuffer::Pop(std::vector<unsigned char>& payload, std::uint16_t* sequenceNumber) {
+        const auto nextSequenceNumber = _nextSequenceNumber.load();
+
+        if (nextSequenceNumber < 0) {
+            return Frame::Waiting;
+        }
+
+        // Playout starts once a packet at least the delay ahead of the first has arrived.
+        if (!_isPlaying) {
+            for (std::size_t i = _delayFrames - 1; i < Capacity && !_isPlaying; i++) {
+                const auto aheadSequenceNumber = static_cast<std::int32_t>((nextSequenceNumber + i) & 0xFFFF);
+                _isPlaying = _slots[aheadSequenceNumber % Capacity]._sequenceNumber.load(std::memory_order_acquire) == aheadSequenceNumber;
+            }
+
+            if (!_isPlaying) {
+                return Frame::Waiting;
+            }
+        }
+
+        TraceSpan span(TraceStage::JitterBufferPop, nextSequenceNumber, _traceId);
+        const auto& slot = _slots[nextSequenceNumber % Capacity];
+        auto frame = Frame::Lost;
+
+        if (sequenceNumber != nullptr) {
+            *sequenceNumber = static_cast<std::uint16_t>(nextSequenceNumber);
+        }
+
+        if (slot._sequenceNumber.load(std::memory_order_acquire) == nextSequenceNumber) {
+            payload.assign(slot._payload.begin(), slot._payload.begin() + slot._size);
+            frame = Frame::Packet;
+
+            // Frames missed before this one were lost rather than the end of the stream.
+            _lostCount += _missingCount;
+            LostPacketsTotal.Increment(_missingCount);
+            _missingCount = 0;
+        }
+        else {
+            _missingCount++;
+        }
+
+        // Only published once the slot has been read, so the pushing thread cannot overwrite it while it is being copied.
+        if (_missingCount < ResetFrameCount) {
+            _nextSequenceNumber.store((nextSequenceNumber + 1) & 0xFFFF);
+        }
+        else {
+            _nextSequenceNumber.store(-1);
+            _isPlaying = false;
+            _missingCount = 0;
+        }
+
+        return frame;
+    }
+
+    std::uint64_t JitterBuffer::GetLostCount() const {
+        return _lostCount;
+    }
+
+    std::uint64_t JitterBuffer::GetLateCount() const {
+        return _lateCount;
+    }
+
+    std::size_t JitterBuffer::GetBufferedCount() const {
+        const auto nextSequenceNumber = _nextSequenceNumber.load();
+
+        if (nextSequenceNumber < 0) {
+            return 0;
+        }
+
+        // A snapshot while packets are pushed and popped, so it may be a frame out.
+        std::size_t count = 0;
+
+        for (std::size_t i = 0; i < Capacity; i++) {
+            const auto sequenceNumber = static_cast<std::int32_t>((nextSequenceNumber + i) & 0xFFFF);
+
+            if (_slots[sequenceNumber % Capacity]._sequenceNumber.load(std::memory_order_relaxed) == sequenceNumber) {
+                count = i + 1;
+            }
+        }
+
+        return count;
+    }
+}
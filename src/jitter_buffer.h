@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+#include "pipeline_trace.h"
+
+namespace Comms {
+
+    /*
+    * Reorders the RTP packets of one audio stream and releases their payloads one 20 ms frame at a time, after a fixed delay
+    * that absorbs network jitter.
+    *
+    * Packets are pushed by one thread, the connection's, and popped by another, the playout thread, without either taking a
+    * lock. Each packet is copied into the slot of its sequence number, and the slot is only published once it is complete, so
+    * the playout thread never sees a partly written packet. The pushing thread never writes a slot the playout thread has not
+    * finished with, because it drops packets more than Capacity ahead of the next frame to be played.
+    *
+    * Playout starts once the delay has been buffered. A packet that has not arrived by the time its frame is played is reported
+    * as lost, so it can be concealed, and dropped if it arrives later. After half a second with no packets, e.g. while the remote
+    * peer is on hold, the buffer resets and buffers the delay again when the stream resumes.
+    */
+    class JitterBuffer {
+    public:
+        static constexpr std::size_t Capacity = 64; // Frames that can be buffered, 1.28 seconds.
+        static constexpr std::size_t MaximumPayloadSize = 1500; // Largest payload that can be buffered.
+
+        /*
+        * What Pop found for the next frame.
+        */
+        enum class Frame {
+            Waiting, // Playout has not started, nothing should be played.
+            Packet, // The frame's packet.
+            Lost // The frame's packet did not arrive in time.
+        };
+
+        /*
+        * Constructor.
+        *
+        * @param delayFrames Frames buffered before playout starts.
+        * @param traceId The connection the packets are received on, which they are tagged with in a PipelineTrace.
+        */
+        JitterBuffer(std::size_t delayFrames, std::uint32_t traceId = PipelineTrace::NoConnectionId);
+
+        /*
+        * Buffers a received RTP packet. Pushing thread only.
+        *
+        * @return False if the packet was dropped: malformed, too large, a duplicate, too late or too far ahead.
+        */
+        bool Push(const rtc::binary& packet);
+
+        /*
+        * Takes the next frame to play. Playout thread only, called every 20 ms.
+        *
+        * @param payload Receives the frame's payload if a packet is returned.
+        * @param sequenceNumber Receives the frame's sequence number if a packet is returned or reported lost, unless null.
+        */
+        Frame Pop(std::vector<unsigned char>& payload, std::uint16_t* sequenceNumber = nullptr);
+
+        /*
+        * @return Packets that did not arrive in time to be played.
+        */
+        std::uint64_t GetLostCount() const;
+
+        /*
+        * @return Packets dropped because they arrived after their frame was played.
+        */
+        std::uint64_t GetLateCount() const;
+
+        /*
+        * @return Frames buffered from the next to be played on, including any gaps before the last one. Any thread.
+        */
+        std::size_t GetBufferedCount() const;
+
+    private:
+        /*
+        * A buffered packet.
+        */
+        struct Slot {
+            std::atomic<std::int32_t> _sequenceNumber = -1; // The packet's sequence number, published once the slot is written.
+            std::size_t _size = 0; // The size of the payload.
+            std::array<unsigned char, MaximumPayloadSize> _payload; // The payload.
+        };
+
+        const std::size_t _delayFrames; // Frames buffered before playout starts.
+        const std::uint32_t _traceId; // The connection the packets are received on, in a PipelineTrace.
+
+        std::array<Slot, Capacity> _slots; // Packets indexed by sequence number modulo Capacity.
+        std::atomic<std::int32_t> _nextSequenceNumber = -1; // The sequence number of the next frame to play, or -1 until the first packet.
+        bool _isPlaying = false; // Whether the delay has been buffered. Playout thread only.
+        std::size_t _missingCount = 0; // Consecutive frames without a packet, counted as lost once a later packet is played. Playout thread only.
+
+        std::atomic<std::uint64_t> _lostCount = 0; // Packets that did not arrive in time to be played.
+        std::atomic<std::uint64_t> _lateCount = 0; // Packets that arrived after their frame was played.
+    };
+}
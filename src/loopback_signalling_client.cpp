@@ -0,0 +1,164 @@
+#include "loopback_signalling_client.h"
+
+namespace {
+    const char* LoopbackAddress = "127.0.0.1";
+
+    constexpr std::chrono::seconds MaximumAnswerWait(30);
+}
+
+namespace Comms {
+    LoopbackSignallingService::LoopbackSignallingService(bool hasRooms) :
+        _hasRooms(hasRooms) {
+    }
+
+    void LoopbackSignallingService::PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) {
+        {
+            std::lock_guard<std::mutex> lock(_connectionsMutex);
+
+            if (type == SDPType::Offer) {
+                _connections[connectionName] = Connection{ password, sdp, std::nullopt };
+            }
+            else {
+                auto connection = _connections.find(connectionName);
+
+                if (connection == _connections.end() || connection->second._password != password) {
+                    return;
+                }
+
+                connection->second._answer = sdp;
+            }
+        }
+        _answerPublishedCondition.notify_all();
+    }
+
+    std::variant<std::monostate, bool, std::string> LoopbackSignallingService::RetrieveOffer(const std::string& connectionName, const std::string& password) const {
+        std::lock_guard<std::mutex> lock(_connectionsMutex);
+
+        auto connection = _connections.find(connectionName);
+
+        if (connection == _connections.end()) {
+            return std::monostate();
+        }
+        else if (connection->second._password != password) {
+            return false;
+        }
+
+        return connection->second._offer;
+    }
+
+    std::optional<std::string> LoopbackSignallingService::WaitForAnswer(const std::string& connectionName, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(_connectionsMutex);
+
+        std::optional<std::string> answer = std::nullopt;
+
+        _answerPublishedCondition.wait_for(lock, timeout, [&]() {
+            auto connection = _connections.find(connectionName);
+
+            if (connection != _connections.end() && connection->second._answer.has_value()) {
+                answer = connection->second._answer;
+            }
+
+            return answer.has_value();
+        });
+
+        return answer;
+    }
+
+    RoomJoinResult LoopbackSignallingService::JoinRoom(const std::string& roomName, const std::string& password, const std::string& token, SignallingClient::MembersHandler onMembers) {
+        if (!_hasRooms) {
+            return RoomJoinResult::Unsupported;
+        }
+
+        std::lock_guard<std::mutex> lock(_roomsMutex);
+
+        auto [room, isCreated] = _rooms.try_emplace(roomName, Room{ password, {} });
+
+        if (!isCreated && room->second._password != password) {
+            return RoomJoinResult::Rejected;
+        }
+
+        room->second._members.push_back(Member{ token, onMembers });
+        NotifyMembers(room->second);
+
+        return RoomJoinResult::Joined;
+    }
+
+    void LoopbackSignallingService::LeaveRoom(const std::string& roomName, const std::string& token) {
+        std::lock_guard<std::mutex> lock(_roomsMutex);
+
+        auto room = _rooms.find(roomName);
+
+        if (room == _rooms.end()) {
+            return;
+        }
+
+        auto& members = room->second._members;
+        std::erase_if(members, [&token](const Member& member) { return member._token == token; });
+
+        if (members.empty()) {
+            _rooms.erase(room);
+        }
+        else {
+            NotifyMembers(room->second);
+        }
+    }
+
+    void LoopbackSignallingService::NotifyMembers(const Room& room) {
+        std::vector<std::string> tokens;
+
+        for (const auto& member : room._members) {
+            tokens.push_back(member._token);
+        }
+
+        for (const auto& member : room._members) {
+            member._onMembers(tokens);
+        }
+    }
+
+    LoopbackSignallingClient::LoopbackSignallingClient(std::shared_ptr<LoopbackSignallingService> service) :
+        _service(service) {
+    }
+
+    LoopbackSignallingClient::~LoopbackSignallingClient() {
+        LeaveRoom();
+    }
+
+    void LoopbackSignallingClient::ConfigureIce(rtc::Configuration& config) const {
+        config.iceServers.clear();
+        config.bindAddress = LoopbackAddress;
+    }
+
+    void LoopbackSignallingClient::PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) {
+        _service->PublishSDP(connectionName, password, type, sdp);
+    }
+
+    std::variant<std::monostate, bool, std::string> LoopbackSignallingClient::RetrieveOffer(const std::string& connectionName, const std::string& password) {
+        return _service->RetrieveOffer(connectionName, password);
+    }
+
+    std::optional<std::string> LoopbackSignallingClient::RetrieveAnswer(const std::string& connectionName) {
+        return _service->WaitForAnswer(connectionName, MaximumAnswerWait);
+    }
+
+    RoomJoinResult LoopbackSignallingClient::JoinRoom(const std::string& roomName, const std::string& password, const std::string& token, MembersHandler onMembers) {
+        LeaveRoom();
+
+        const auto result = _service->JoinRoom(roomName, password, token, onMembers);
+
+        if (result == RoomJoinResult::Joined) {
+            std::lock_guard<std::mutex> lock(_roomMutex);
+            _room = std::make_pair(roomName, token);
+        }
+
+        return result;
+    }
+
+    void LoopbackSignallingClient::LeaveRoom() {
+        std::lock_guard<std::mutex> lock(_roomMutex);
+
+        if (_room.has_value()) {
+            _service->LeaveRoom(_room->first, _room->second);
+            _room.reset();
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "signalling_client.h"
+
+namespace Comms {
+
+    /*
+    * An in-process stand-in for the signalling service.
+    * Stores offers and answers in memory so that peers in the same process can negotiate without a network.
+    * A single instance is shared between all of the LoopbackSignallingClients that should be able to find each other.
+    * Rooms tell each member of every member as they join and leave, unless disabled to stand in for a service without them.
+    */
+    class LoopbackSignallingService {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param hasRooms Whether peers can join rooms. Otherwise every join is Unsupported.
+        */
+        LoopbackSignallingService(bool hasRooms = true);
+
+        /*
+        * Stores an offer or answer for a connection.
+        * Publishing an offer replaces any existing offer and answer for the connection.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        * @param type The offer/answer type of the SDP being published.
+        * @param sdp The session description.
+        */
+        void PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp);
+
+        /*
+        * @return The offer SDP string, false if the password is incorrect, or std::monostate if there is no offer.
+        */
+        std::variant<std::monostate, bool, std::string> RetrieveOffer(const std::string& connectionName, const std::string& password) const;
+
+        /*
+        * Blocks until an answer is published for a connection.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param timeout The maximum time to wait.
+        * @return The answer SDP if it was published before the timeout elapsed.
+        */
+        std::optional<std::string> WaitForAnswer(const std::string& connectionName, std::chrono::milliseconds timeout);
+
+        /*
+        * Adds a member to a room, creating the room if it has none, and tells every member of the room's members.
+        * Members are told while the rooms are locked, so each is told of every change in order.
+        *
+        * @param roomName The name of the room.
+        * @param password The password of the room.
+        * @param token Identifies the member.
+        * @param onMembers Called with the room's members each time they change, until the member leaves.
+        * @return Whether the member joined.
+        */
+        RoomJoinResult JoinRoom(const std::string& roomName, const std::string& password, const std::string& token, SignallingClient::MembersHandler onMembers);
+
+        /*
+        * Removes a member from a room, and tells the remaining members. The room is removed with its last member.
+        */
+        void LeaveRoom(const std::string& roomName, const std::string& token);
+
+    private:
+        /*
+        * The signalling state of a single connection.
+        */
+        struct Connection {
+            std::string _password; // The password the offer was published with.
+            std::string _offer; // The offer SDP.
+            std::optional<std::string> _answer; // The answer SDP, once published.
+        };
+
+        /*
+        * A member of a room.
+        */
+        struct Member {
+            std::string _token; // Identifies the member.
+            SignallingClient::MembersHandler _onMembers; // Called with the room's members each time they change.
+        };
+
+        /*
+        * A room of several peers.
+        */
+        struct Room {
+            std::string _password; // The password the room was created with.
+            std::vector<Member> _members; // The members, in the order they joined.
+        };
+
+        /*
+        * Tells every member of a room of its members. Requires _roomsMutex.
+        */
+        static void NotifyMembers(const Room& room);
+
+        std::unordered_map<std::string, Connection> _connections; // Connections keyed by name.
+        mutable std::mutex _connectionsMutex; // Mutex to control read and write access to _connections.
+        std::condition_variable _answerPublishedCondition; // Notified whenever an answer is published.
+
+        const bool _hasRooms; // Whether peers can join rooms.
+        std::unordered_map<std::string, Room> _rooms; // Rooms keyed by name.
+        std::mutex _roomsMutex; // Mutex to control read and write access to _rooms, held while members are told of changes.
+    };
+
+    /*
+    * Signalling through a LoopbackSignallingService in the same process.
+    * Peers are restricted to host candidates on the loopback interface and no STUN server is used,
+    * so connection setup is deterministic and does not require a network.
+    * This is intended for benchmarks and offline testing of connection setup and the media path.
+    */
+    class LoopbackSignallingClient : public SignallingClient {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param service The in-process service shared by the peers that should be able to find each other.
+        */
+        LoopbackSignallingClient(std::shared_ptr<LoopbackSignallingService> service);
+
+        /*
+        * Destructor. Leaves the room joined.
+        */
+        ~LoopbackSignallingClient() override;
+
+        /*
+        * Binds ICE to the loopback interface and clears the STUN server.
+        */
+        void ConfigureIce(rtc::Configuration& config) const override;
+
+        void PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) override;
+
+        std::variant<std::monostate, bool, std::string> RetrieveOffer(const std::string& connectionName, const std::string& password) override;
+
+        std::optional<std::string> RetrieveAnswer(const std::string& connectionName) override;
+
+        RoomJoinResult JoinRoom(const std::string& roomName, const std::string& password, const std::string& token, MembersHandler onMembers) override;
+
+        void LeaveRoom() override;
+
+    private:
+        std::shared_ptr<LoopbackSignallingService> _service; // The shared in-process service.
+        std::optional<std::pair<std::string, std::string>> _room; // The name of the room joined and the token joined as.
+        std::mutex _roomMutex; // Mutex to control read and write access to _room.
+    };
+}
@@ -0,0 +1,109 @@
+#include "mcu_mixing_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "audio_mixer.h"
+#include "audio_mixing.h"
+#include "rtp_audio_packetizer.h"
+#include "sample_statistics.h"
+#include "sfu_worker.h"
+#include "synthetic_speech.h"
+
+namespace {
+    constexpr int FrameSampleCount = 960;
+
+    constexpr std::uint8_t OpusPayloadType = 111;
+
+    // A DTX packet: the table of contents of a 20 ms SILK wideband frame, with no audio.
+    const std::vector<std::byte> DtxPacket = { std::byte(0x48) };
+
+    double GetElapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+namespace Comms {
+    McuMixingBenchmark::McuMixingBenchmark(const CommandLineOptions& options) :
+        _participantCount(std::max<std::int64_t>(options.GetInteger("participants", 50), 1)),
+        _speakerCount(std::min<std::size_t>(std::max<std::int64_t>(options.GetInteger("speakers", 3), 0), _participantCount)),
+        _frameCount(options.GetInteger("frames", 1500)),
+        _bitrate(static_cast<int>(options.GetInteger("bitrate", 32000))) {
+    }
+
+    nlohmann::json McuMixingBenchmark::Run() {
+        std::vector<std::vector<SpeechFrame>> speech;
+
+        for (std::size_t speaker = 0; speaker < _speakerCount; speaker++) {
+            speech.push_back(EncodeSpeech(speaker, _bitrate));
+        }
+
+        AudioMixer mixer(_bitrate);
+        std::vector<RtpAudioPacketizer> packetizers;
+
+        for (std::uint32_t participant = 0; participant < _participantCount; participant++) {
+            mixer.AddParticipant(participant);
+            packetizers.emplace_back(participant, OpusPayloadType, std::nullopt);
+        }
+
+        SampleStatistics frameTimes{};
+        std::size_t encodedBytes = 0;
+
+        for (std::size_t frame = 0; frame < _frameCount; frame++) {
+            for (std::uint32_t participant = 0; participant < _participantCount; participant++) {
+                const auto& packet = participant < _speakerCount ? speech[participant][frame % SpeechFrameCount]._packet : DtxPacket;
+                mixer.PushPacket(participant, packetizers[participant].Packetize(packet, AudioLevel()));
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            mixer.Mix([&encodedBytes](std::uint32_t, const std::vector<std::byte>& packet) { encodedBytes += packet.size(); });
+            frameTimes.Add(GetElapsedMicroseconds(start));
+        }
+
+        // The kernels alone: summing the speakers, removing each speaker from the sum and saturating the shared mix.
+        std::vector<std::vector<std::int16_t>> frames(std::max<std::size_t>(_speakerCount, 1), std::vector<std::int16_t>(FrameSampleCount));
+        std::mt19937 random(0);
+
+        for (auto& frame : frames) {
+            std::generate(frame.begin(), frame.end(), [&random]() { return static_cast<std::int16_t>(random()); });
+        }
+
+        std::vector<std::int32_t> sum(FrameSampleCount);
+        std::vector<std::int16_t> mix(FrameSampleCount);
+        SampleStatistics kernelTimes{};
+
+        for (std::size_t frame = 0; frame < _frameCount; frame++) {
+            const auto start = std::chrono::steady_clock::now();
+
+            std::fill(sum.begin(), sum.end(), 0);
+
+            for (const auto& speakerFrame : frames) {
+                AccumulateFrame(sum.data(), speakerFrame.data(), FrameSampleCount);
+            }
+
+            for (const auto& speakerFrame : frames) {
+                MixMinusOne(mix.data(), sum.data(), speakerFrame.data(), FrameSampleCount);
+            }
+
+            SaturateFrame(mix.data(), sum.data(), FrameSampleCount);
+
+            kernelTimes.Add(GetElapsedMicroseconds(start));
+        }
+
+        const double frameMicroseconds = std::chrono::duration<double, std::micro>(SfuWorker::TickInterval).count();
+
+        return {
+            {"participants", _participantCount},
+            {"speakers", _speakerCount},
+            {"frames", _frameCount},
+            {"bitrate", _bitrate},
+            {"mix_us", frameTimes.ToJson()},
+            {"kernel_us", kernelTimes.ToJson()},
+            {"core_utilisation_percent", 100.0 * frameTimes.GetMean() / frameMicroseconds},
+            {"participants_per_core", _participantCount * frameMicroseconds / frameTimes.GetMean()},
+            {"decoders_held", mixer.GetActiveDecoderCount()},
+            {"encoded_bytes_per_frame", static_cast<double>(encodedBytes) / std::max<std::size_t>(_frameCount, 1)}
+        };
+    }
+}
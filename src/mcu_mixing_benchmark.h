@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Measures how many MCU participants one core can mix in real time, by running an AudioMixer over a room of synthetic
+    * participants for a number of 20 ms frames.
+    *
+    * A few participants speak, sending Opus encoded speech-like audio, and the rest are silent, sending DTX packets.
+    * Participants per core is the room size scaled by the fraction of each 20 ms frame the mix takes. The mixing kernels
+    * are also timed alone, without decoding or encoding, to show their share of the cost.
+    *
+    * Options:
+    *   --participants <n>  Participants in the room. Default 50.
+    *   --speakers <n>      Participants speaking at once. Default 3.
+    *   --frames <n>        Frames mixed. Default 1500, 30 seconds of audio.
+    *   --bitrate <n>       Bitrate mixes are encoded at, in bits per second. Default 32000.
+    */
+    class McuMixingBenchmark : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The benchmark's command line options.
+        */
+        McuMixingBenchmark(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const std::size_t _participantCount; // Participants in the room.
+        const std::size_t _speakerCount; // Participants speaking at once.
+        const std::size_t _frameCount; // Frames mixed.
+        const int _bitrate; // Bitrate mixes are encoded at.
+    };
+}
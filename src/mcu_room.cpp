@@ -0,0 +1,70 @@
+#include "mcu_room.h"
+
+#include <algorithm>
+
+#include "sfu_room.h"
+
+namespace {
+    constexpr std::uint8_t OpusPayloadType = 111;
+}
+
+namespace Comms {
+    McuRoom::McuRoom(std::string name, std::string password, SfuWorker& worker, int bitrate) :
+        MediaRoom(name, password, worker),
+        _mixer(bitrate) {
+    }
+
+    void McuRoom::AddParticipant(std::shared_ptr<SfuParticipant> participant) {
+        // The mix carries no client-to-mixer audio level, which only describes a single speaker.
+        _participants.push_back(Participant{ participant, std::make_unique<RtpAudioPacketizer>(SfuParticipant::GetSlotSSRC(0), OpusPayloadType, std::nullopt) });
+        _mixer.AddParticipant(participant->GetId());
+    }
+
+    void McuRoom::RemoveParticipant(std::uint32_t participantId) {
+        auto participant = std::find_if(_participants.begin(), _participants.end(), [participantId](const Participant& other) {
+            return other._participant->GetId() == participantId;
+        });
+
+        if (participant == _participants.end()) {
+            return;
+        }
+
+        participant->_participant->Disconnect();
+        _participants.erase(participant);
+        _mixer.RemoveParticipant(participantId);
+    }
+
+    void McuRoom::Close() {
+        auto participants = std::move(_participants);
+        _participants.clear();
+
+        for (const auto& participant : participants) {
+            participant._participant->Disconnect();
+            _mixer.RemoveParticipant(participant._participant->GetId());
+        }
+    }
+
+    void McuRoom::Receive(std::uint32_t senderId, const rtc::binary& packet) {
+        _mixer.PushPacket(senderId, packet);
+    }
+
+    void McuRoom::Tick() {
+        if (_participants.empty()) {
+            return;
+        }
+
+        // Participants are few enough that finding each one's packetizer linearly costs nothing next to encoding their mix.
+        _mixer.Mix([this](std::uint32_t participantId, const std::vector<std::byte>& packet) {
+            auto participant = std::find_if(_participants.begin(), _participants.end(), [participantId](const Participant& other) {
+                return other._participant->GetId() == participantId;
+            });
+
+            if (participant == _participants.end() || packet.empty() || !participant->_participant->GetTrack()->isOpen()) {
+                return;
+            }
+
+            participant->_packetizer->Packetize(packet, AudioLevel(), _packet);
+            participant->_participant->GetTrack()->send(_packet.data(), _packet.size());
+        });
+    }
+}
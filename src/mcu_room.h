@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio_mixer.h"
+#include "media_room.h"
+#include "rtp_audio_packetizer.h"
+
+namespace Comms {
+
+    /*
+    * A room of participants whose audio is decoded and mixed by the server, for clients that cannot decode a stream per speaker.
+    *
+    * Every participant receives a single stream, a mix of everyone but themselves, on the first SSRC slot of their session
+    * description. Packets are buffered as they arrive and mixed once per SfuWorker::TickInterval.
+    * @see AudioMixer
+    */
+    class McuRoom : public MediaRoom {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param name The name identifying the room.
+        * @param password The password required to join the room.
+        * @param worker The worker the room is pinned to. The room must be registered with SfuWorker::AddTickingRoom.
+        * @param bitrate The bitrate mixes are encoded at, in bits per second.
+        */
+        McuRoom(std::string name, std::string password, SfuWorker& worker, int bitrate);
+
+        void AddParticipant(std::shared_ptr<SfuParticipant> participant) override;
+        void RemoveParticipant(std::uint32_t participantId) override;
+        void Close() override;
+
+        /*
+        * Buffers a packet to be mixed into the frame of its sequence number.
+        */
+        void Receive(std::uint32_t senderId, const rtc::binary& packet) override;
+
+        /*
+        * Mixes a frame and sends each participant their mix.
+        */
+        void Tick() override;
+
+    private:
+        /*
+        * A participant and the RTP state of the mix sent to them.
+        */
+        struct Participant {
+            std::shared_ptr<SfuParticipant> _participant; // The participant.
+            std::unique_ptr<RtpAudioPacketizer> _packetizer; // Wraps the participant's mix in RTP.
+        };
+
+        std::vector<Participant> _participants; // The participants, in the order they joined.
+        AudioMixer _mixer; // Mixes the participants' audio.
+        rtc::binary _packet; // Each mix's RTP packet, reused so that a tick only allocates to grow it.
+    };
+}
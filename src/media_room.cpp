@@ -0,0 +1,21 @@
+#include "media_room.h"
+
+namespace Comms {
+    MediaRoom::MediaRoom(std::string name, std::string password, SfuWorker& worker) :
+        _name(name),
+        _password(password),
+        _worker(worker) {
+    }
+
+    const std::string& MediaRoom::GetName() const {
+        return _name;
+    }
+
+    const std::string& MediaRoom::GetPassword() const {
+        return _password;
+    }
+
+    SfuWorker& MediaRoom::GetWorker() const {
+        return _worker;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    class SfuParticipant;
+    class SfuWorker;
+
+    /*
+    * A room of participants connected to the SfuServer, which either forwards their audio to each other (SfuRoom) or mixes
+    * it (McuRoom).
+    *
+    * A room is pinned to one SfuWorker, and all methods other than the accessors must be called on that worker's thread.
+    */
+    class MediaRoom {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param name The name identifying the room.
+        * @param password The password required to join the room.
+        * @param worker The worker the room is pinned to.
+        */
+        MediaRoom(std::string name, std::string password, SfuWorker& worker);
+
+        virtual ~MediaRoom() = default;
+
+        MediaRoom(const MediaRoom&) = delete;
+        MediaRoom& operator=(const MediaRoom&) = delete;
+
+        /*
+        * @return The name identifying the room.
+        */
+        const std::string& GetName() const;
+
+        /*
+        * @return The password required to join the room.
+        */
+        const std::string& GetPassword() const;
+
+        /*
+        * @return The worker the room is pinned to.
+        */
+        SfuWorker& GetWorker() const;
+
+        /*
+        * Adds a participant to the room.
+        */
+        virtual void AddParticipant(std::shared_ptr<SfuParticipant> participant) = 0;
+
+        /*
+        * Removes a participant and closes its peer connection. @see SfuParticipant::Disconnect
+        */
+        virtual void RemoveParticipant(std::uint32_t participantId) = 0;
+
+        /*
+        * Removes every participant and closes their peer connections. Once it returns, no callback of a participant runs.
+        */
+        virtual void Close() = 0;
+
+        /*
+        * Handles an RTP packet received from a participant.
+        *
+        * @param senderId The participant that sent the packet.
+        * @param packet The packet.
+        */
+        virtual void Receive(std::uint32_t senderId, const rtc::binary& packet) = 0;
+
+        /*
+        * Handles an RTP packet relayed from another SFU node. Rooms that do not take part in cascading ignore them.
+        *
+        * @param senderId The participant, connected to the other node, that sent the packet.
+        * @param audioLevelExtensionId The id the sender negotiated the audio level extension with, if it did.
+        * @param packet The packet.
+        */
+        virtual void ReceiveRelayed([[maybe_unused]] std::uint32_t senderId, [[maybe_unused]] std::optional<int> audioLevelExtensionId, [[maybe_unused]] const rtc::binary& packet) {}
+
+        /*
+        * Sends whatever the room batched while handling a run of packets. Called by the worker after each run it drains.
+        */
+        virtual void Flush() {}
+
+        /*
+        * Called every SfuWorker::TickInterval for rooms registered with SfuWorker::AddTickingRoom.
+        */
+        virtual void Tick() {}
+
+    private:
+        const std::string _name; // The name identifying the room.
+        const std::string _password; // The password required to join the room.
+        SfuWorker& _worker; // The worker the room is pinned to.
+    };
+}
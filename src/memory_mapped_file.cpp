@@ -0,0 +1,84 @@
+#include "memory_mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Comms {
+#ifdef _WIN32
+    MemoryMappedFile::MemoryMappedFile(const std::string& path) {
+        _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (_file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Could not open " + path);
+        }
+
+        LARGE_INTEGER size{};
+        GetFileSizeEx(_file, &size);
+        _size = static_cast<std::size_t>(size.QuadPart);
+
+        // An empty file cannot be mapped.
+        _mapping = _size > 0 ? CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        _data = _mapping != nullptr ? MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+        if (_data == nullptr) {
+            if (_mapping != nullptr) {
+                CloseHandle(_mapping);
+            }
+
+            CloseHandle(_file);
+            throw std::runtime_error("Could not map " + path);
+        }
+    }
+
+    MemoryMappedFile::~MemoryMappedFile() {
+        UnmapViewOfFile(_data);
+        CloseHandle(_mapping);
+        CloseHandle(_file);
+    }
+#else
+    MemoryMappedFile::MemoryMappedFile(const std::string& path) {
+        const int file = open(path.c_str(), O_RDONLY);
+
+        if (file < 0) {
+            throw std::runtime_error("Could not open " + path);
+        }
+
+        struct stat status {};
+        fstat(file, &status);
+        _size = static_cast<std::size_t>(status.st_size);
+
+        // An empty file cannot be mapped. The mapping keeps the file open, so the descriptor is not needed once it is made.
+        void* data = _size > 0 ? mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+        close(file);
+
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("Could not map " + path);
+        }
+
+        _data = data;
+    }
+
+    MemoryMappedFile::~MemoryMappedFile() {
+        munmap(const_cast<void*>(_data), _size);
+    }
+#endif
+
+    const void* MemoryMappedFile::GetData() const {
+        return _data;
+    }
+
+    std::size_t MemoryMappedFile::GetSize() const {
+        return _size;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Comms {
+
+    /*
+    * A file mapped read-only into memory, so that it can be read without copying it and without blocking on disk reads once
+    * its pages are resident.
+    */
+    class MemoryMappedFile {
+    public:
+        /*
+        * Constructor. Maps the whole file.
+        *
+        * @param path The path of the file.
+        * @throws std::runtime_error If the file cannot be opened or mapped, or is empty.
+        */
+        MemoryMappedFile(const std::string& path);
+
+        /*
+        * Destructor. Unmaps the file.
+        */
+        ~MemoryMappedFile();
+
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+        /*
+        * @return The file's contents.
+        */
+        const void* GetData() const;
+
+        /*
+        * @return The file's size in bytes.
+        */
+        std::size_t GetSize() const;
+
+    private:
+        const void* _data = nullptr; // The mapped contents.
+        std::size_t _size = 0; // The size of the mapping in bytes.
+#ifdef _WIN32
+        void* _file = nullptr; // The file's handle.
+        void* _mapping = nullptr; // The file mapping's handle.
+#endif
+    };
+}
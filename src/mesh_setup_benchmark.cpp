@@ -0,0 +1,115 @@
+#include "mesh_setup_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_input_output.h"
+#include "call_manager.h"
+#include "loopback_signalling_client.h"
+#include "mesh_signalling.h"
+#include "sample_statistics.h"
+#include "web_rtc_peer_connection.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const char* RoomName = "mesh-setup";
+    const char* RoomPassword = "mesh-setup-password";
+
+    constexpr std::chrono::milliseconds PollInterval(10);
+
+    /*
+    * @return The peers a manager's one call is connected to.
+    */
+    std::size_t GetConnectedPeerCount(const Comms::CallManager& callManager) {
+        const auto calls = callManager.GetCalls();
+
+        return calls.empty() ? 0 : calls.front()._connectedPeerCount;
+    }
+}
+
+namespace Comms {
+    MeshSetupBenchmark::MeshSetupBenchmark(const CommandLineOptions& options) :
+        _peerCount(std::clamp<std::int64_t>(options.GetInteger("peers", 4), 2, MeshSignalling::MaximumSeats)),
+        _timeoutSeconds(std::max(options.GetDouble("timeout", 30.0), 1.0)),
+        _isSeated(options.Has("seats")) {
+    }
+
+    nlohmann::json MeshSetupBenchmark::Run() {
+        WebRTCPeerConnection::SetLogLevel(rtc::LogLevel::Warning);
+
+        // The room and connections both signal through the one service, as they would through one signalling server.
+        auto service = std::make_shared<LoopbackSignallingService>(!_isSeated);
+
+        CallManager::Configuration configuration;
+        configuration._signallingClientFactory = [service]() -> std::shared_ptr<SignallingClient> {
+            return std::make_shared<LoopbackSignallingClient>(service);
+        };
+
+        // Nothing is captured, so the peers only connect, and send no audio.
+        std::vector<std::unique_ptr<CallManager>> peers;
+
+        for (std::size_t i = 0; i < _peerCount; i++) {
+            peers.push_back(std::make_unique<CallManager>(std::make_shared<AudioBuffer>(), std::make_shared<AudioBuffer>(), configuration));
+        }
+
+        const auto start = Clock::now();
+        const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(_timeoutSeconds));
+
+        for (auto& peer : peers) {
+            peer->StartMeshCall(RoomName, RoomPassword);
+        }
+
+        // When each peer was first connected to every other.
+        std::vector<std::optional<Clock::time_point>> meshedAt(_peerCount);
+        std::size_t meshedCount = 0;
+
+        while (meshedCount < _peerCount && Clock::now() < deadline) {
+            std::this_thread::sleep_for(PollInterval);
+
+            for (std::size_t i = 0; i < _peerCount; i++) {
+                if (!meshedAt[i].has_value() && GetConnectedPeerCount(*peers[i]) == _peerCount - 1) {
+                    meshedAt[i] = Clock::now();
+                    meshedCount++;
+                }
+            }
+        }
+
+        std::vector<std::size_t> connectedPeerCounts;
+
+        for (const auto& peer : peers) {
+            connectedPeerCounts.push_back(GetConnectedPeerCount(*peer));
+        }
+
+        // Ending the calls closes every connection, and leaves the room or empties every seat.
+        peers.clear();
+
+        SampleStatistics meshSeconds;
+
+        for (const auto& time : meshedAt) {
+            if (time.has_value()) {
+                meshSeconds.Add(std::chrono::duration<double>(*time - start).count());
+            }
+        }
+
+        nlohmann::json results = {
+            {"peers", _peerCount},
+            {"seats", _isSeated},
+            {"meshed_peers", meshedCount},
+            {"connected_peers", connectedPeerCounts},
+            {"mesh_s", meshSeconds.ToJson()}
+        };
+
+        if (meshedCount < _peerCount) {
+            results["error"] = std::to_string(_peerCount - meshedCount) + " of " + std::to_string(_peerCount) + " peers did not connect to every other";
+        }
+
+        return results;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Measures how long a room of peers takes to connect in a full mesh, and checks that every pair connects. Each peer is a
+    * CallManager joining the same room at once with StartMeshCall, its room and its pairs' WebRTCPeerConnections both
+    * signalling through one in-process LoopbackSignallingService, so the run needs no network. With --seats the service has
+    * no rooms, so the peers meet in seats, as they do through the hosted service.
+    *
+    * Reports the time from joining to each peer being connected to every other, and fails with an error if any peer is not
+    * connected to every other within --timeout.
+    *
+    * Options:
+    *   --peers <n>      Peers in the room. Default 4.
+    *   --timeout <s>    Seconds every peer has to connect to every other. Default 30.
+    *   --seats          Meet in seats rather than the service's room.
+    */
+    class MeshSetupBenchmark : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The benchmark's command line options.
+        */
+        MeshSetupBenchmark(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const std::size_t _peerCount; // Peers in the room.
+        const double _timeoutSeconds; // Seconds every peer has to connect to every other.
+        const bool _isSeated; // Whether the peers meet in seats rather than the service's room.
+    };
+}
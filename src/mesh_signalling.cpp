@@ -0,0 +1,435 @@
+#include "mesh_signalling.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <utility>
+
+namespace {
+    // Time between reading the seats, to find peers that have joined or left and to check the local peer's own seat.
+    constexpr std::chrono::seconds PollInterval(1);
+
+    // Time between looking for the offers of peers that joined the room later. Shorter than PollInterval, as the offer is
+    // only looked for while one is awaited, and the peer that made it is waiting for the answer.
+    constexpr std::chrono::milliseconds OfferPollInterval(200);
+
+    // Time between republishing the local peer's seat, so that the other peers know it is still there.
+    constexpr std::chrono::seconds HeartbeatInterval(5);
+
+    // Time a seat's heartbeat can stand still before its peer is taken to have gone and the seat is emptied.
+    constexpr std::chrono::seconds SeatExpiry(20);
+
+    // Polls in a row a paired peer is found in no seat before it is taken to have left. More than one, as a peer moving
+    // on from a seat it lost to a lower token sits in none until it takes the next.
+    constexpr std::size_t LeavePollCount = 3;
+
+    // Empty seats read past the last occupied one. More than one, as peers joining at once can end up a seat or two past
+    // the first empty seat. Any further are found on the next poll, once the seats before them have been.
+    constexpr std::size_t TrailingEmptySeats = 2;
+
+    /*
+    * @return A random token identifying one join of a room.
+    */
+    std::string GenerateToken() {
+        std::random_device random;
+        std::uniform_int_distribution<int> digit(0, 15);
+        std::string token;
+
+        for (int i = 0; i < 16; i++) {
+            token += "0123456789abcdef"[digit(random)];
+        }
+
+        return token;
+    }
+}
+
+namespace Comms {
+    MeshSignalling::MeshSignalling(std::string roomName, std::string password, std::shared_ptr<SignallingClient> signallingClient) :
+        _roomName(roomName),
+        _password(password),
+        _token(GenerateToken()),
+        _signallingClient(signallingClient) {
+    }
+
+    MeshSignalling::~MeshSignalling() {
+        Stop();
+    }
+
+    void MeshSignalling::Start(PairHandler onPair, PairHandler onLeave) {
+        _onPair = onPair;
+        _onLeave = onLeave;
+        _thread = std::thread(&MeshSignalling::Run, this);
+    }
+
+    void MeshSignalling::Stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isStopping = true;
+        }
+        _changedCondition.notify_all();
+
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    std::optional<std::size_t> MeshSignalling::GetSeat() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _seat;
+    }
+
+    bool MeshSignalling::IsRejected() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _isRejected;
+    }
+
+    void MeshSignalling::Run() {
+        const auto result = JoinRoom();
+
+        if (result == RoomJoinResult::Joined) {
+            RunRoom();
+        }
+        else if (result == RoomJoinResult::Unsupported) {
+            RunSeats(); // The service has no rooms, as the hosted service has not, so the peers meet in seats.
+        }
+        else {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isRejected = true;
+        }
+    }
+
+    RoomJoinResult MeshSignalling::JoinRoom() {
+        return _signallingClient->JoinRoom(_roomName, _password, _token, [this](std::optional<std::vector<std::string>> members) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _pushedMembers = std::move(members); // Each push holds every member, so only the last is needed.
+                _isMembersPushed = true;
+            }
+            _changedCondition.notify_all();
+        });
+    }
+
+    void MeshSignalling::RunRoom() {
+        bool isRoomLost = false;
+
+        while (true) {
+            const auto interval = _pendingPairs.empty() ? std::chrono::milliseconds(PollInterval) : OfferPollInterval;
+            std::optional<std::vector<std::string>> members;
+            bool isMembersPushed = false;
+
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _changedCondition.wait_for(lock, interval, [this]() { return _isStopping || _isMembersPushed; });
+
+                if (_isStopping) {
+                    break;
+                }
+
+                isMembersPushed = std::exchange(_isMembersPushed, false);
+                members = std::move(_pushedMembers);
+            }
+
+            if (isMembersPushed && members.has_value()) {
+                if (!UpdateMembers(*members)) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _seat.reset();
+                    _isRejected = true;
+                    break;
+                }
+            }
+            else if (isMembersPushed) {
+                isRoomLost = true; // Pairs are kept, and those whose peer left meanwhile are ended once the room is joined again.
+            }
+
+            if (isRoomLost && JoinRoom() == RoomJoinResult::Joined) {
+                isRoomLost = false;
+            }
+
+            FindOffers();
+        }
+
+        _signallingClient->LeaveRoom();
+        ClearPairOffers();
+    }
+
+    bool MeshSignalling::UpdateMembers(const std::vector<std::string>& members) {
+        const auto local = std::find(members.begin(), members.end(), _token);
+
+        if (local == members.end()) {
+            return true; // Not yet among the members pushed.
+        }
+
+        const auto seat = static_cast<std::size_t>(local - members.begin());
+
+        if (seat >= MaximumSeats) {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _seat = seat;
+        }
+
+        std::set<std::string> memberTokens;
+
+        for (std::size_t otherSeat = 0; otherSeat < std::min(members.size(), MaximumSeats); otherSeat++) {
+            const auto& otherToken = members[otherSeat];
+
+            if (otherToken == _token) {
+                continue;
+            }
+
+            memberTokens.insert(otherToken);
+
+            if (auto pair = _pairs.find(otherToken); pair != _pairs.end()) {
+                pair->second._seat = otherSeat;
+            }
+            else if (otherSeat < seat) {
+                // The peer that joined later offers, so the local peer makes the pair at once and the other answers.
+                const auto pairName = GetPairName(otherToken);
+                _pairs[otherToken] = Pair{ pairName, otherSeat, 0 };
+                _onPair(pairName);
+            }
+            else {
+                _pendingPairs[otherToken] = otherSeat;
+            }
+        }
+
+        for (auto pair = _pairs.begin(); pair != _pairs.end();) {
+            if (memberTokens.contains(pair->first)) {
+                ++pair;
+            }
+            else {
+                EndPair(pair->second);
+                pair = _pairs.erase(pair);
+            }
+        }
+
+        std::erase_if(_pendingPairs, [&memberTokens](const auto& pending) { return !memberTokens.contains(pending.first); });
+
+        return true;
+    }
+
+    void MeshSignalling::FindOffers() {
+        for (auto pending = _pendingPairs.begin(); pending != _pendingPairs.end();) {
+            const auto pairName = GetPairName(pending->first);
+            const auto offer = _signallingClient->RetrieveOffer(pairName, _password);
+
+            if (std::holds_alternative<std::string>(offer) && !std::get<std::string>(offer).empty()) {
+                _pairs[pending->first] = Pair{ pairName, pending->second, 0 };
+                _onPair(pairName);
+                pending = _pendingPairs.erase(pending);
+            }
+            else {
+                ++pending;
+            }
+        }
+    }
+
+    void MeshSignalling::RunSeats() {
+        if (!TakeSeat()) {
+            return;
+        }
+
+        do {
+            if (!KeepSeat() && !TakeSeat()) {
+                return;
+            }
+
+            FindPeers();
+        } while (Wait(PollInterval));
+
+        // Emptied on leaving, so that the seat can be taken at once and the other peers soon find the local peer gone.
+        const auto seat = *GetSeat();
+        const auto token = ReadSeat(seat);
+
+        if (std::holds_alternative<std::string>(token) && std::get<std::string>(token) == _token) {
+            _signallingClient->PublishSDP(GetSeatName(seat), _password, SDPType::Offer, "");
+        }
+
+        ClearPairOffers();
+    }
+
+    bool MeshSignalling::TakeSeat() {
+        for (std::size_t seat = 0; seat < MaximumSeats; seat++) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                if (_isStopping) {
+                    return false;
+                }
+            }
+
+            const auto token = ReadSeat(seat);
+
+            if (std::holds_alternative<bool>(token)) {
+                break; // The room has a different password.
+            }
+
+            if (std::holds_alternative<std::string>(token)) {
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _seat = seat;
+            }
+
+            PublishSeat();
+
+            // Read back at once. A peer that published to the seat since is ordered against the local peer by token.
+            if (KeepSeat()) {
+                return true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _seat.reset();
+        _isRejected = true;
+        return false;
+    }
+
+    bool MeshSignalling::KeepSeat() {
+        const auto token = ReadSeat(*GetSeat());
+
+        if (std::holds_alternative<std::string>(token)) {
+            const auto& seatedToken = std::get<std::string>(token);
+
+            if (seatedToken < _token) {
+                return false; // A peer with a lower token published to the seat at the same time, and keeps it.
+            }
+
+            if (seatedToken == _token && Clock::now() - _lastHeartbeatAt < HeartbeatInterval) {
+                return true;
+            }
+        }
+
+        // The heartbeat is due, or a peer with a higher token published over the seat and moves on once it reads it back.
+        PublishSeat();
+        return true;
+    }
+
+    void MeshSignalling::FindPeers() {
+        const auto seat = *GetSeat();
+        std::set<std::string> seatedTokens;
+
+        // Paired peers are always read, even past empty seats left by peers that have gone.
+        std::size_t lastOccupiedSeat = seat;
+
+        for (const auto& [otherToken, pair] : _pairs) {
+            lastOccupiedSeat = std::max(lastOccupiedSeat, pair._seat);
+        }
+
+        for (std::size_t otherSeat = 0; otherSeat < MaximumSeats && otherSeat <= lastOccupiedSeat + TrailingEmptySeats; otherSeat++) {
+            if (otherSeat == seat) {
+                continue;
+            }
+
+            const auto token = ReadSeat(otherSeat);
+
+            if (!std::holds_alternative<std::string>(token)) {
+                continue;
+            }
+
+            lastOccupiedSeat = std::max(lastOccupiedSeat, otherSeat);
+
+            if (std::get<std::string>(token) == _token) {
+                continue;
+            }
+
+            const auto& otherToken = std::get<std::string>(token);
+            seatedTokens.insert(otherToken);
+
+            if (auto pair = _pairs.find(otherToken); pair != _pairs.end()) {
+                pair->second._seat = otherSeat;
+                continue;
+            }
+
+            const auto pairName = GetPairName(otherToken);
+
+            // The peer in the later seat offers, so the one in the earlier seat waits until it finds the offer to answer.
+            // An empty offer is one emptied when a peer left, as when the other was taken to have left between two polls.
+            const auto offer = otherSeat < seat ? std::variant<std::monostate, bool, std::string>() : _signallingClient->RetrieveOffer(pairName, _password);
+
+            if (otherSeat < seat || (std::holds_alternative<std::string>(offer) && !std::get<std::string>(offer).empty())) {
+                _pairs[otherToken] = Pair{ pairName, otherSeat, 0 };
+                _onPair(pairName);
+            }
+        }
+
+        for (auto pair = _pairs.begin(); pair != _pairs.end();) {
+            pair->second._missedPollCount = seatedTokens.contains(pair->first) ? 0 : pair->second._missedPollCount + 1;
+
+            if (pair->second._missedPollCount >= LeavePollCount) {
+                EndPair(pair->second);
+                pair = _pairs.erase(pair);
+            }
+            else {
+                ++pair;
+            }
+        }
+    }
+
+    void MeshSignalling::EndPair(const Pair& pair) {
+        _onLeave(pair._connectionName);
+
+        // Emptied, so that the offer of a peer that has gone is not left for the service to keep until it expires.
+        _signallingClient->PublishSDP(pair._connectionName, _password, SDPType::Offer, "");
+    }
+
+    void MeshSignalling::ClearPairOffers() {
+        for (const auto& [otherToken, pair] : _pairs) {
+            _signallingClient->PublishSDP(pair._connectionName, _password, SDPType::Offer, "");
+        }
+    }
+
+    void MeshSignalling::PublishSeat() {
+        _signallingClient->PublishSDP(GetSeatName(*GetSeat()), _password, SDPType::Offer, _token + " " + std::to_string(++_heartbeat));
+        _lastHeartbeatAt = Clock::now();
+    }
+
+    std::variant<std::monostate, bool, std::string> MeshSignalling::ReadSeat(std::size_t seat) {
+        const auto offer = _signallingClient->RetrieveOffer(GetSeatName(seat), _password);
+
+        if (std::holds_alternative<bool>(offer)) {
+            return false;
+        }
+
+        const auto content = std::holds_alternative<std::string>(offer) ? std::get<std::string>(offer) : std::string();
+        const auto now = Clock::now();
+        auto& observed = _observedSeats[seat];
+
+        if (content != observed._content || observed._changedAt == Clock::time_point()) {
+            observed._content = content;
+            observed._changedAt = now;
+        }
+
+        if (content.empty()) {
+            return std::monostate();
+        }
+
+        if (now - observed._changedAt >= SeatExpiry) {
+            // Its peer has stopped beating. Emptied, so that the seat can be taken again.
+            _signallingClient->PublishSDP(GetSeatName(seat), _password, SDPType::Offer, "");
+            observed._content.clear();
+            observed._changedAt = now;
+            return std::monostate();
+        }
+
+        return content.substr(0, content.find(' '));
+    }
+
+    bool MeshSignalling::Wait(std::chrono::milliseconds duration) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return !_changedCondition.wait_for(lock, duration, [this]() { return _isStopping; });
+    }
+
+    std::string MeshSignalling::GetSeatName(std::size_t seat) const {
+        return _roomName + "-seat-" + std::to_string(seat);
+    }
+
+    std::string MeshSignalling::GetPairName(const std::string& otherToken) const {
+        // Ordered by token, not seat, so that both peers name the pair alike whichever seats they end up in.
+        return _token < otherToken ? _roomName + "-" + _token + "-" + otherToken : _roomName + "-" + otherToken + "-" + _token;
+    }
+}
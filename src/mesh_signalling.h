@@ -0,0 +1,226 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "signalling_client.h"
+
+namespace Comms {
+
+    /*
+    * Lets several peers meet in one room name and connect to each other in a full mesh, using the service's rooms where it
+    * has them, and otherwise only the one offer and one answer per connection name that every SignallingClient supports.
+    *
+    * Where the service has rooms, each peer joins the room and is told of every member as they join and leave, in the order
+    * they joined, so that it need not poll for them. @see SignallingClient::JoinRoom. A peer's place in that order stands
+    * in for a seat below. A peer that loses the room, e.g. because its connection to the service dropped, joins it again.
+    *
+    * Otherwise, as with the hosted service, a room is a row of seats, each a connection name whose offer holds the random token of the peer sitting in it and a
+    * heartbeat count: "<room>-seat-0", "<room>-seat-1", and so on. A peer joins by taking the first empty seat. Two peers
+    * that take the same seat at once are told apart by their tokens: the lower token keeps the seat, republishing it if
+    * the other's overwrote it, and the higher moves on to the next empty seat.
+    *
+    * Every pair of peers then has a connection name of its own, "<room>-<lower token>-<higher token>". The peer in the later
+    * seat offers on it, and the peer in the earlier seat answers once it finds the offer, polling only for the offers it is
+    * still waiting on. Tokens are new for each join, so an offer left behind by an earlier meeting in the same room is never
+    * mistaken for a new one. A pair's offer is emptied by the peer that stays once the other has left, and by a peer
+    * leaving for each of its pairs.
+    *
+    * Seats are polled, so each seated peer reads the seats every second. A seated peer republishes its seat every few seconds with the next heartbeat count. It empties its seat when it
+    * stops, and a seat whose heartbeat has not moved for 20 seconds, e.g. because its peer crashed, is emptied by the
+    * first peer to notice. Either way the seat can be taken again, and every peer paired with the one that left is told.
+    *
+    * Meant for small groups, about 3 to 6 peers, where each peer can afford to send its audio to every other.
+    */
+    class MeshSignalling {
+    public:
+        static constexpr std::size_t MaximumSeats = 16; // Seats in a room, and so the most peers in it at once.
+
+        /*
+        * Called with the connection name of a pair the local peer is part of. Called on the signalling thread.
+        */
+        using PairHandler = std::function<void(const std::string& connectionName)>;
+
+        /*
+        * Constructor.
+        *
+        * @param roomName The name of the room.
+        * @param password The password of the room, shared by every peer in it.
+        * @param signallingClient Used to join the room, or take a seat, and to find the offers made to the local peer.
+        */
+        MeshSignalling(std::string roomName, std::string password, std::shared_ptr<SignallingClient> signallingClient);
+
+        /*
+        * Destructor. Stops the signalling thread.
+        */
+        ~MeshSignalling();
+
+        MeshSignalling(const MeshSignalling&) = delete;
+        MeshSignalling& operator=(const MeshSignalling&) = delete;
+
+        /*
+        * Joins the room, or takes a seat, and connects to every other peer in it, now and as they join, on a background thread.
+        *
+        * @param onPair Called with each pair's connection name. The connection should be made with the room's password, and
+        *               will offer or answer as appropriate.
+        * @param onLeave Called with the connection name of a pair once its other peer has left the room, so that the
+        *                connection can be closed. Never called for a pair before onPair.
+        */
+        void Start(PairHandler onPair, PairHandler onLeave);
+
+        /*
+        * Stops looking for peers joining or leaving the room, and leaves it, emptying the seat taken and the offers of the
+        * pairs made. Connections already made are unaffected.
+        */
+        void Stop();
+
+        /*
+        * @return The seat taken, or the local peer's place in the room's order of joining, once the room has been joined.
+        */
+        std::optional<std::size_t> GetSeat() const;
+
+        /*
+        * @return Whether the room could not be joined, because its password is different or it already has MaximumSeats peers.
+        */
+        bool IsRejected() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        /*
+        * What the signalling thread last read from a seat.
+        */
+        struct ObservedSeat {
+            std::string _content; // The seat's offer: a token and a heartbeat count, or empty.
+            Clock::time_point _changedAt; // When the content was first read as it is.
+        };
+
+        /*
+        * A pair the local peer is part of.
+        */
+        struct Pair {
+            std::string _connectionName; // The pair's connection name.
+            std::size_t _seat; // The seat the other peer was last found in.
+            std::size_t _missedPollCount; // Polls in a row the other peer has been found in no seat.
+        };
+
+        /*
+        * Joins the room, falling back to seats where the service has no rooms.
+        */
+        void Run();
+
+        /*
+        * Joins the room, with a handler that hands the members pushed to the signalling thread.
+        */
+        RoomJoinResult JoinRoom();
+
+        /*
+        * Pairs with the room's members as they are pushed, until stopped, then leaves the room.
+        */
+        void RunRoom();
+
+        /*
+        * Pairs with the members pushed not yet paired with, and ends the pairs of those that have left.
+        *
+        * @return False if the local peer has no seat in the room, as MaximumSeats peers joined before it.
+        */
+        bool UpdateMembers(const std::vector<std::string>& members);
+
+        /*
+        * Looks for the offers of the pairs whose other peer joined later, pairing with each peer that has made one.
+        */
+        void FindOffers();
+
+        /*
+        * Takes a seat, then pairs with the peers in the other seats and keeps the seat until stopped.
+        */
+        void RunSeats();
+
+        /*
+        * Takes the first empty seat.
+        *
+        * @return False if the room could not be joined or the thread is stopping.
+        */
+        bool TakeSeat();
+
+        /*
+        * Checks that the local peer still has its seat, and republishes it when its heartbeat is due or a peer with a
+        * higher token published over it.
+        *
+        * @return False if a peer with a lower token took the seat at the same time, so that another must be taken.
+        */
+        bool KeepSeat();
+
+        /*
+        * Reads the other seats, pairing with peers not yet paired with and telling of those that have left. Peers take the
+        * first empty seat, so the seats fill from the first, and reading stops a few empty seats past the last occupied one.
+        */
+        void FindPeers();
+
+        /*
+        * Tells of a pair whose other peer has left, and empties the pair's offer.
+        */
+        void EndPair(const Pair& pair);
+
+        /*
+        * Empties the offer of every pair, as the local peer leaves.
+        */
+        void ClearPairOffers();
+
+        /*
+        * Publishes the local peer's token to its seat, with the next heartbeat count.
+        */
+        void PublishSeat();
+
+        /*
+        * Reads a seat, records what it holds and empties it if its heartbeat has stopped.
+        *
+        * @return The token of the peer sitting in the seat, std::monostate if it is empty, or false if the password is wrong.
+        */
+        std::variant<std::monostate, bool, std::string> ReadSeat(std::size_t seat);
+
+        /*
+        * Waits for a time, or until the thread is stopping.
+        *
+        * @return False if the thread is stopping.
+        */
+        bool Wait(std::chrono::milliseconds duration);
+
+        std::string GetSeatName(std::size_t seat) const;
+        std::string GetPairName(const std::string& otherToken) const;
+
+        const std::string _roomName; // The name of the room.
+        const std::string _password; // The password of the room.
+        const std::string _token; // Identifies the local peer's seat for this join, and orders it against peers taking the same seat.
+        std::shared_ptr<SignallingClient> _signallingClient; // Takes a seat and finds offers.
+
+        PairHandler _onPair; // Called with each pair's connection name.
+        PairHandler _onLeave; // Called with the connection name of each pair whose other peer has left.
+        std::map<std::string, Pair> _pairs; // The pairs made, keyed by the other peer's token. Signalling thread only.
+        std::map<std::string, std::size_t> _pendingPairs; // The seats of the room's members whose offer is awaited, keyed by token. Signalling thread only.
+        std::array<ObservedSeat, MaximumSeats> _observedSeats; // What each seat last held. Signalling thread only.
+        std::uint64_t _heartbeat = 0; // The heartbeat count last published. Signalling thread only.
+        Clock::time_point _lastHeartbeatAt; // When the seat was last published. Signalling thread only.
+
+        std::optional<std::size_t> _seat; // The seat taken, once one has been.
+        bool _isRejected = false; // Whether the room could not be joined.
+        bool _isStopping = false; // Set when the signalling thread is stopping.
+        std::optional<std::vector<std::string>> _pushedMembers; // The room's members last pushed, or std::nullopt if the room was lost.
+        bool _isMembersPushed = false; // Whether _pushedMembers has been pushed since the signalling thread last took it.
+        mutable std::mutex _mutex; // Mutex to control read and write access to _seat, _isRejected, _isStopping and the members pushed.
+        std::condition_variable _changedCondition; // Notified when the thread is stopping or the room's members are pushed.
+        std::thread _thread; // Joins the room or takes a seat, and finds peers.
+    };
+}
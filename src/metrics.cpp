@@ -0,0 +1,198 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+
+namespace {
+    /*
+    * One series of a metric: its labels and the counter or histogram recording it.
+    */
+    struct Series {
+        std::string _labels;
+        std::unique_ptr<Comms::Counter> _counter; // Null for a histogram.
+        std::unique_ptr<Comms::Histogram> _histogram; // Null for a counter.
+    };
+
+    /*
+    * A metric and its series, written together under one HELP and TYPE.
+    */
+    struct Family {
+        std::string _name;
+        std::string _help;
+        bool _isHistogram;
+        std::deque<Series> _series;
+    };
+
+    std::mutex RegistryMutex; // Taken when a metric is registered, and when the metrics are scraped.
+
+    /*
+    * @return Every metric, in the order registered. Requires RegistryMutex. Constructed on first use, as metrics are
+    *         registered by the statics of other modules, which may be initialised first.
+    */
+    std::deque<Family>& GetFamilies() {
+        static std::deque<Family> families;
+
+        return families;
+    }
+
+    std::atomic<std::size_t> NextShard = 0; // The shard of the next thread to record a metric.
+    thread_local const std::size_t ThreadShard = NextShard++ % Comms::MetricShardCount; // The calling thread's shard.
+
+    /*
+    * @return The series of a name and labels, registering it if it is not. Requires RegistryMutex.
+    */
+    Series& FindSeries(const std::string& name, const std::string& help, bool isHistogram, const std::string& labels) {
+        auto& families = GetFamilies();
+        auto family = std::find_if(families.begin(), families.end(), [&name](const auto& family) { return family._name == name; });
+
+        if (family == families.end()) {
+            family = families.insert(families.end(), Family{ name, help, isHistogram, {} });
+        }
+
+        auto series = std::find_if(family->_series.begin(), family->_series.end(), [&labels](const auto& series) { return series._labels == labels; });
+
+        if (series == family->_series.end()) {
+            series = family->_series.insert(family->_series.end(), Series{ labels, nullptr, nullptr });
+        }
+
+        return *series;
+    }
+
+    std::string FormatNumber(double value) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.15g", value);
+
+        return text;
+    }
+
+    /*
+    * @return Labels in braces, with a further label added, or nothing if there are none.
+    */
+    std::string FormatLabels(const std::string& labels, const std::string& extraLabel = "") {
+        if (labels.empty() && extraLabel.empty()) {
+            return "";
+        }
+
+        return "{" + labels + (!labels.empty() && !extraLabel.empty() ? "," : "") + extraLabel + "}";
+    }
+}
+
+namespace Comms {
+    void Counter::Increment(std::uint64_t amount) {
+        _shards[ThreadShard]._value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Counter::GetValue() const {
+        std::uint64_t value = 0;
+
+        for (const auto& shard : _shards) {
+            value += shard._value.load(std::memory_order_relaxed);
+        }
+
+        return value;
+    }
+
+    Histogram::Histogram(std::vector<double> bounds) :
+        _bounds(std::move(bounds)) {
+        for (auto& shard : _shards) {
+            shard._counts = std::make_unique<std::atomic<std::uint64_t>[]>(_bounds.size() + 1);
+        }
+    }
+
+    void Histogram::Observe(double value) {
+        auto& shard = _shards[ThreadShard];
+        const auto bucket = std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin();
+
+        shard._counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        shard._sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    const std::vector<double>& Histogram::GetBounds() const {
+        return _bounds;
+    }
+
+    Histogram::Snapshot Histogram::GetSnapshot() const {
+        Snapshot snapshot;
+        snapshot._counts.resize(_bounds.size() + 1, 0);
+
+        for (const auto& shard : _shards) {
+            for (std::size_t i = 0; i < snapshot._counts.size(); i++) {
+                snapshot._counts[i] += shard._counts[i].load(std::memory_order_relaxed);
+            }
+
+            snapshot._sum += shard._sum.load(std::memory_order_relaxed);
+        }
+
+        return snapshot;
+    }
+
+    Counter& Metrics::AddCounter(const std::string& name, const std::string& help, const std::string& labels) {
+        std::lock_guard<std::mutex> lock(RegistryMutex);
+        auto& series = FindSeries(name, help, false, labels);
+
+        if (series._counter == nullptr) {
+            series._counter = std::make_unique<Counter>();
+        }
+
+        return *series._counter;
+    }
+
+    Histogram& Metrics::AddHistogram(const std::string& name, const std::string& help, const std::vector<double>& bounds, const std::string& labels) {
+        std::lock_guard<std::mutex> lock(RegistryMutex);
+        auto& series = FindSeries(name, help, true, labels);
+
+        if (series._histogram == nullptr) {
+            series._histogram = std::make_unique<Histogram>(bounds);
+        }
+
+        return *series._histogram;
+    }
+
+    std::string Metrics::ToPrometheusText() {
+        std::lock_guard<std::mutex> lock(RegistryMutex);
+        std::string text;
+
+        for (const auto& family : GetFamilies()) {
+            text += "# HELP " + family._name + " " + family._help + "\n";
+            text += "# TYPE " + family._name + (family._isHistogram ? " histogram\n" : " counter\n");
+
+            for (const auto& series : family._series) {
+                if (series._counter != nullptr) {
+                    text += family._name + FormatLabels(series._labels) + " " + std::to_string(series._counter->GetValue()) + "\n";
+                    continue;
+                }
+
+                const auto& bounds = series._histogram->GetBounds();
+                const auto snapshot = series._histogram->GetSnapshot();
+                std::uint64_t count = 0;
+
+                // Prometheus buckets are cumulative: each counts every observation at most its bound.
+                for (std::size_t i = 0; i < snapshot._counts.size(); i++) {
+                    count += snapshot._counts[i];
+                    const auto bound = i < bounds.size() ? FormatNumber(bounds[i]) : "+Inf";
+
+                    text += family._name + "_bucket" + FormatLabels(series._labels, "le=\"" + bound + "\"") + " " + std::to_string(count) + "\n";
+                }
+
+                text += family._name + "_sum" + FormatLabels(series._labels) + " " + FormatNumber(snapshot._sum) + "\n";
+                text += family._name + "_count" + FormatLabels(series._labels) + " " + std::to_string(count) + "\n";
+            }
+        }
+
+        return text;
+    }
+
+    const std::vector<double>& GetProcessingTimeBounds() {
+        static const std::vector<double> bounds = { 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.02 };
+
+        return bounds;
+    }
+
+    const std::vector<double>& GetNetworkTimeBounds() {
+        static const std::vector<double> bounds = { 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0 };
+
+        return bounds;
+    }
+}
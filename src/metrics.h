@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Comms {
+
+    constexpr std::size_t MetricShardCount = 16; // Copies of each metric, spread over the threads recording it.
+
+    /*
+    * A count that only goes up, e.g. of packets sent.
+    *
+    * Sharded so that recording never contends: each thread adds to one of MetricShardCount copies, each on its own cache
+    * line, with a relaxed atomic add, and the copies are only summed when the metrics are scraped.
+    */
+    class Counter {
+    public:
+        /*
+        * Adds to the count. Any thread.
+        */
+        void Increment(std::uint64_t amount = 1);
+
+        /*
+        * @return The count, summed over the shards.
+        */
+        std::uint64_t GetValue() const;
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<std::uint64_t> _value = 0;
+        };
+
+        std::array<Shard, MetricShardCount> _shards; // The thread-spread copies of the count.
+    };
+
+    /*
+    * Counts observations, e.g. of how long a frame took to encode, into buckets of fixed upper bounds, and sums them.
+    *
+    * Sharded as a Counter is: an observation is a search of the bounds and two relaxed atomic adds to the recording
+    * thread's shard.
+    */
+    class Histogram {
+    public:
+        /*
+        * The buckets of a histogram, summed over its shards.
+        */
+        struct Snapshot {
+            std::vector<std::uint64_t> _counts; // Observations at most each bound and above the one before, then above the last.
+            double _sum = 0.0; // The sum of the observations.
+        };
+
+        /*
+        * Constructor.
+        *
+        * @param bounds The upper bound of each bucket, ascending. A last bucket holds everything above them.
+        */
+        Histogram(std::vector<double> bounds);
+
+        /*
+        * Records an observation. Any thread.
+        */
+        void Observe(double value);
+
+        /*
+        * @return The upper bound of each bucket.
+        */
+        const std::vector<double>& GetBounds() const;
+
+        /*
+        * @return The buckets, summed over the shards. Observations made while it is taken may be half counted.
+        */
+        Snapshot GetSnapshot() const;
+
+    private:
+        struct alignas(64) Shard {
+            std::unique_ptr<std::atomic<std::uint64_t>[]> _counts; // One per bucket.
+            std::atomic<double> _sum = 0.0;
+        };
+
+        const std::vector<double> _bounds; // The upper bound of each bucket.
+        std::array<Shard, MetricShardCount> _shards; // The thread-spread copies of the buckets.
+    };
+
+    /*
+    * The process's metrics, served in the Prometheus text exposition format for a monitoring system to scrape.
+    * @see MetricsServer, SfuServer, SignallingServer
+    *
+    * Metrics are registered once, typically as statics of the module recording them, and recorded through the reference
+    * registration returns, so that recording never looks a metric up or takes a lock. Registering a metric of a name and
+    * labels already registered returns the existing one, so several modules can share it.
+    *
+    * Names follow the Prometheus conventions: comms_<layer>_<what>_<unit>, with _total for counters. Labels are written as
+    * given, e.g. direction="sent", and so must be escaped by the caller if they are not plain text.
+    */
+    class Metrics {
+    public:
+        static constexpr const char* ContentType = "text/plain; version=0.0.4; charset=utf-8";
+
+        /*
+        * Registers a counter.
+        *
+        * @param name The metric's name.
+        * @param help A description of the metric.
+        * @param labels The labels of this series of the metric, if it has several.
+        * @return The counter, which lives as long as the process.
+        */
+        static Counter& AddCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+
+        /*
+        * Registers a histogram. @see AddCounter
+        *
+        * @param bounds The upper bound of each bucket, ascending. Ignored if the histogram is already registered.
+        */
+        static Histogram& AddHistogram(const std::string& name, const std::string& help, const std::vector<double>& bounds, const std::string& labels = "");
+
+        /*
+        * @return Every metric registered, in the Prometheus text exposition format.
+        */
+        static std::string ToPrometheusText();
+    };
+
+    /*
+    * Histogram bounds in seconds, for the durations of work done within a frame, from 10 microseconds to 20 ms.
+    */
+    const std::vector<double>& GetProcessingTimeBounds();
+
+    /*
+    * Histogram bounds in seconds, for network round trips and request latencies, from 1 ms to 10 s.
+    */
+    const std::vector<double>& GetNetworkTimeBounds();
+}
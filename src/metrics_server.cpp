@@ -0,0 +1,51 @@
+#include "metrics_server.h"
+
+#include "metrics.h"
+
+namespace Comms {
+    MetricsServer::MetricsServer(std::string bindAddress, int port) :
+        _bindAddress(std::move(bindAddress)),
+        _port(port) {
+        AddRoute(_httpServer);
+    }
+
+    MetricsServer::~MetricsServer() {
+        Stop();
+    }
+
+    bool MetricsServer::Start() {
+        if (_port == 0) {
+            _port = _httpServer.bind_to_any_port(_bindAddress);
+        }
+        else if (!_httpServer.bind_to_port(_bindAddress, _port)) {
+            _port = -1;
+        }
+
+        if (_port < 0) {
+            return false;
+        }
+
+        _httpThread = std::thread([this]() { _httpServer.listen_after_bind(); });
+        _httpServer.wait_until_ready();
+
+        return true;
+    }
+
+    void MetricsServer::Stop() {
+        _httpServer.stop();
+
+        if (_httpThread.joinable()) {
+            _httpThread.join();
+        }
+    }
+
+    int MetricsServer::GetPort() const {
+        return _port;
+    }
+
+    void MetricsServer::AddRoute(httplib::Server& server) {
+        server.Get("/metrics", [](const httplib::Request&, httplib::Response& response) {
+            response.set_content(Metrics::ToPrometheusText(), Metrics::ContentType);
+        });
+    }
+}
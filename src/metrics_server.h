@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "cpp-httplib/httplib.h"
+
+namespace Comms {
+
+    /*
+    * Serves the process's metrics over HTTP, for a process with no HTTP API of its own to add them to, e.g. a headless
+    * client. @see Metrics
+    *   GET /metrics  200 in the Prometheus text exposition format.
+    */
+    class MetricsServer {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param bindAddress The address to listen on.
+        * @param port The port to listen on. 0 selects any free port.
+        */
+        MetricsServer(std::string bindAddress, int port);
+
+        /*
+        * Destructor. Stops the server if it is running.
+        */
+        ~MetricsServer();
+
+        MetricsServer(const MetricsServer&) = delete;
+        MetricsServer& operator=(const MetricsServer&) = delete;
+
+        /*
+        * Binds the port and starts serving on a background thread.
+        *
+        * @return False if the port could not be bound.
+        */
+        bool Start();
+
+        /*
+        * Stops serving.
+        */
+        void Stop();
+
+        /*
+        * @return The port the server is listening on.
+        */
+        int GetPort() const;
+
+        /*
+        * Adds the /metrics route to a server.
+        */
+        static void AddRoute(httplib::Server& server);
+
+    private:
+        const std::string _bindAddress; // The address to listen on.
+        int _port; // The port to listen on, and once bound the port listened on.
+
+        httplib::Server _httpServer; // The HTTP listener.
+        std::thread _httpThread; // Runs the HTTP accept loop.
+    };
+}
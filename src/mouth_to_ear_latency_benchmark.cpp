@@ -0,0 +1,461 @@
+#include "mouth_to_ear_latency_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "allocation_tracker.h"
+#include "audio_connection.h"
+#include "audio_input_output.h"
+#include "call_manager.h"
+#include "loopback_signalling_client.h"
+#include "sample_statistics.h"
+#include "web_rtc_peer_connection.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const char* ConnectionName = "mouth-to-ear";
+    const char* ConnectionPassword = "mouth-to-ear-password";
+
+    constexpr int SampleRate = 48000;
+    constexpr std::size_t DevicePeriodSampleCount = 480; // 10 ms, a typical shared-mode device period.
+    constexpr std::chrono::milliseconds DevicePeriod(10);
+
+    constexpr std::size_t ChirpSampleCount = 480; // 10 ms.
+    constexpr double ChirpStartFrequency = 500.0;
+    constexpr double ChirpEndFrequency = 4000.0;
+    constexpr double ChirpAmplitude = 16000.0;
+
+    // The normalised correlation a match must reach for a chirp to count as heard.
+    constexpr double DetectionThreshold = 0.5;
+
+    // Time after the measurement for the last chirp to be played.
+    constexpr std::chrono::milliseconds PlayoutGrace(200);
+
+    constexpr std::chrono::milliseconds PollInterval(5);
+
+    /*
+    * @return A linear chirp, shaped by a Hann window so that it starts and ends without a click.
+    */
+    std::vector<std::int16_t> GenerateChirp() {
+        constexpr double Pi = 3.14159265358979323846;
+        constexpr double Duration = static_cast<double>(ChirpSampleCount) / SampleRate;
+
+        std::vector<std::int16_t> chirp(ChirpSampleCount);
+
+        for (std::size_t i = 0; i < ChirpSampleCount; i++) {
+            const double time = static_cast<double>(i) / SampleRate;
+            const double phase = 2.0 * Pi * (ChirpStartFrequency * time + (ChirpEndFrequency - ChirpStartFrequency) * time * time / (2.0 * Duration));
+            const double window = 0.5 - 0.5 * std::cos(2.0 * Pi * i / (ChirpSampleCount - 1));
+
+            chirp[i] = static_cast<std::int16_t>(ChirpAmplitude * window * std::sin(phase));
+        }
+
+        return chirp;
+    }
+
+    /*
+    * Finds a chirp in recorded playback by normalised cross-correlation.
+    *
+    * @param recording The samples played.
+    * @param chirp The chirp.
+    * @param start The first sample the chirp could start at.
+    * @param lagCount The number of start positions searched from there.
+    * @return The lag from start of the best match, and its normalised correlation.
+    */
+    std::pair<std::size_t, double> FindChirp(const std::vector<std::int16_t>& recording, const std::vector<std::int16_t>& chirp,
+        std::size_t start, std::size_t lagCount) {
+        double chirpEnergy = 0.0;
+
+        for (const auto sample : chirp) {
+            chirpEnergy += static_cast<double>(sample) * sample;
+        }
+
+        std::pair<std::size_t, double> best = { 0, 0.0 };
+
+        for (std::size_t lag = 0; lag < lagCount && start + lag + chirp.size() <= recording.size(); lag++) {
+            double product = 0.0;
+            double energy = 0.0;
+
+            for (std::size_t i = 0; i < chirp.size(); i++) {
+                const double sample = recording[start + lag + i];
+                product += sample * chirp[i];
+                energy += sample * sample;
+            }
+
+            if (energy > 0.0) {
+                const double correlation = product / std::sqrt(chirpEnergy * energy);
+
+                if (correlation > best.second) {
+                    best = { lag, correlation };
+                }
+            }
+        }
+
+        return best;
+    }
+
+    /*
+    * When one frame passed each stage, in microseconds since the run started, or -1 until it has.
+    */
+    struct FrameTiming {
+        std::uint64_t _firstSample = 0; // The index of the frame's first captured sample.
+        std::int64_t _captured = -1; // The frame's first sample was captured.
+        std::int64_t _encoding = -1; // The microseconds encoding the frame took.
+        std::int64_t _sent = -1; // The frame was encoded and handed to the connection.
+        std::int64_t _received = -1; // The packet arrived at the remote peer.
+        std::int64_t _decoding = -1; // The microseconds decoding the frame took.
+        std::int64_t _queued = -1; // The packet was taken from the jitter buffer, decoded and queued to be played.
+        std::int64_t _played = -1; // The frame's first sample was played.
+    };
+
+    /*
+    * The timings of the frames in flight, keyed by RTP sequence number, and those of the frames played.
+    * Each stage fills in its own time. Stages can run in any order for a frame, as a packet may arrive before the sender
+    * has recorded it.
+    */
+    class FrameTimings {
+    public:
+        /*
+        * Records a stage of a frame.
+        */
+        template <typename Record>
+        void Update(std::uint16_t sequenceNumber, Record record) {
+            Comms::RealTimeScope scope(nullptr); // The benchmark's bookkeeping, not the audio thread's, when called from it.
+            std::lock_guard<std::mutex> lock(_mutex);
+            record(_inFlight[sequenceNumber]);
+        }
+
+        /*
+        * Records a frame as played, completing it.
+        */
+        void Play(std::uint16_t sequenceNumber, std::int64_t time) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto frame = _inFlight.find(sequenceNumber);
+
+            if (frame == _inFlight.end()) {
+                return;
+            }
+
+            frame->second._played = time;
+            _played.push_back(frame->second);
+            _inFlight.erase(frame);
+        }
+
+        /*
+        * @return The frames played. Only called once the pipeline has stopped.
+        */
+        const std::vector<FrameTiming>& GetPlayed() const {
+            return _played;
+        }
+
+    private:
+        std::unordered_map<std::uint16_t, FrameTiming> _inFlight; // Frames not yet played. Requires _mutex.
+        std::vector<FrameTiming> _played; // Frames played, in order. Requires _mutex.
+        std::mutex _mutex; // Mutex to control access to the timings.
+    };
+
+    /*
+    * A WebRTCPeerConnection on loopback that records when each packet is sent and when each arrives.
+    */
+    class TimedConnection : public Comms::AudioConnection {
+    public:
+        TimedConnection(std::unique_ptr<Comms::WebRTCPeerConnection> connection, FrameTimings& timings, std::function<std::int64_t()> getMicroseconds) :
+            _connection(std::move(connection)),
+            _timings(timings),
+            _getMicroseconds(std::move(getMicroseconds)) {
+        }
+
+        void Connect() override {
+            _connection->Connect();
+        }
+
+        void Close() override {
+            _connection->Close();
+        }
+
+        rtc::PeerConnection::State GetConnectionState() override {
+            return _connection->GetConnectionState();
+        }
+
+        std::uint16_t SendAudioData(const std::vector<std::byte>& opusData, Comms::AudioLevel level) override {
+            const auto sequenceNumber = _connection->SendAudioData(opusData, level);
+            const auto sent = _getMicroseconds();
+            _timings.Update(sequenceNumber, [sent](FrameTiming& frame) { frame._sent = sent; });
+
+            return sequenceNumber;
+        }
+
+        void OnAudioData(std::function<void(const rtc::binary& packet)> callback) override {
+            _connection->OnAudioData([this, callback](const rtc::binary& packet) {
+                if (packet.size() >= 4) {
+                    const auto received = _getMicroseconds();
+                    const auto sequenceNumber = static_cast<std::uint16_t>((std::to_integer<std::uint16_t>(packet[2]) << 8) | std::to_integer<std::uint16_t>(packet[3]));
+                    _timings.Update(sequenceNumber, [received](FrameTiming& frame) { frame._received = received; });
+                }
+
+                callback(packet);
+            });
+        }
+
+        int GetTargetBitrate() const override {
+            return _connection->GetTargetBitrate();
+        }
+
+        Stats GetStats() const override {
+            return _connection->GetStats();
+        }
+
+        std::uint32_t GetTraceId() const override {
+            return _connection->GetTraceId();
+        }
+
+    private:
+        std::unique_ptr<Comms::WebRTCPeerConnection> _connection; // The connection timed.
+        FrameTimings& _timings; // Where the times are recorded.
+        const std::function<std::int64_t()> _getMicroseconds; // The time since the run started.
+    };
+
+    /*
+    * @return Whether the first call of a manager is connected.
+    */
+    bool IsConnected(const Comms::CallManager& callManager) {
+        const auto calls = callManager.GetCalls();
+
+        return !calls.empty() && calls.front()._state == rtc::PeerConnection::State::Connected;
+    }
+}
+
+namespace Comms {
+    MouthToEarLatencyBenchmark::MouthToEarLatencyBenchmark(const CommandLineOptions& options) :
+        _durationSeconds(std::max(options.GetDouble("duration", 10.0), 1.0)),
+        _warmUpSeconds(std::max(options.GetDouble("warm-up", 2.0), 0.0)),
+        _chirpIntervalMilliseconds(std::max(options.GetDouble("chirp-interval", 500.0), 50.0)),
+        _maximumLatencyMilliseconds(std::clamp(options.GetDouble("max-latency", 400.0), 20.0, _chirpIntervalMilliseconds - 20.0)),
+        _bitrate(static_cast<int>(options.GetInteger("bitrate", 32000))),
+        _connectTimeoutSeconds(std::max(options.GetDouble("connect-timeout", 10.0), 1.0)) {
+    }
+
+    nlohmann::json MouthToEarLatencyBenchmark::Run() {
+        WebRTCPeerConnection::SetLogLevel(rtc::LogLevel::Warning);
+
+        const auto runStart = Clock::now();
+        const auto getMicroseconds = [runStart]() -> std::int64_t {
+            return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - runStart).count();
+        };
+
+        // The chirps and the samples the device runs for, including time for the last chirp to be played.
+        const auto measureStartSample = static_cast<std::uint64_t>(_warmUpSeconds * SampleRate);
+        const auto measureEndSample = measureStartSample + static_cast<std::uint64_t>(_durationSeconds * SampleRate);
+        const auto chirpIntervalSamples = static_cast<std::uint64_t>(_chirpIntervalMilliseconds * SampleRate / 1000.0);
+        const auto maximumLatencySamples = static_cast<std::size_t>(_maximumLatencyMilliseconds * SampleRate / 1000.0);
+        const auto deviceSampleCount = measureEndSample + maximumLatencySamples + PlayoutGrace.count() * SampleRate / 1000;
+        const auto chirp = GenerateChirp();
+
+        std::vector<std::uint64_t> chirpStarts;
+
+        for (auto start = measureStartSample; start + ChirpSampleCount <= measureEndSample; start += chirpIntervalSamples) {
+            chirpStarts.push_back(start);
+        }
+
+        auto microphone = std::make_shared<AudioBuffer>();
+        auto speaker = std::make_shared<AudioBuffer>();
+        FrameTimings timings;
+
+        // When each device period's captured samples were delivered, in microseconds, so that captured samples can be timed.
+        std::vector<std::atomic<std::int64_t>> deliveryTimes(deviceSampleCount / DevicePeriodSampleCount + 1);
+
+        // Frames queued to be played, by the index of their first sample in the speaker queue.
+        std::deque<std::pair<std::uint64_t, std::uint16_t>> queuedFrames;
+        std::mutex queuedFramesMutex;
+
+        // Each end of the call is a CallManager with its own audio thread, connected over loopback, so that the latency
+        // measured is a call's. The sender captures the device's microphone, and the receiver plays to its speaker.
+        auto service = std::make_shared<LoopbackSignallingService>();
+        const auto makeConnection = [service, &timings, &getMicroseconds](const std::string& connectionName, const std::string& password) -> std::unique_ptr<AudioConnection> {
+            auto connection = std::make_unique<WebRTCPeerConnection>(connectionName, password, std::make_shared<LoopbackSignallingClient>(service));
+            return std::make_unique<TimedConnection>(std::move(connection), timings, getMicroseconds);
+        };
+
+        CallManager::Configuration senderConfiguration;
+        senderConfiguration._bitrate = _bitrate;
+        senderConfiguration._connectionFactory = makeConnection;
+        senderConfiguration._onFrameSent = [&timings, &deliveryTimes](std::uint16_t sequenceNumber, std::uint64_t firstSample, std::int64_t encodeMicroseconds) {
+            // A captured sample was delivered at the end of its period, so it was captured the rest of the period before.
+            const auto captureTime = deliveryTimes[firstSample / DevicePeriodSampleCount].load() -
+                static_cast<std::int64_t>((DevicePeriodSampleCount - firstSample % DevicePeriodSampleCount) * 1000000 / SampleRate);
+
+            timings.Update(sequenceNumber, [firstSample, captureTime, encodeMicroseconds](FrameTiming& frame) {
+                frame._firstSample = firstSample;
+                frame._captured = captureTime;
+                frame._encoding = encodeMicroseconds;
+            });
+        };
+
+        CallManager::Configuration receiverConfiguration;
+        receiverConfiguration._bitrate = _bitrate;
+        receiverConfiguration._connectionFactory = makeConnection;
+        receiverConfiguration._onFrameQueued = [&](std::uint16_t sequenceNumber, std::uint64_t firstSample, std::int64_t decodeMicroseconds) {
+            const auto queued = getMicroseconds();
+            timings.Update(sequenceNumber, [queued, decodeMicroseconds](FrameTiming& frame) {
+                frame._queued = queued;
+                frame._decoding = decodeMicroseconds;
+            });
+
+            RealTimeScope scope(nullptr); // The benchmark's bookkeeping, not the audio thread's.
+            std::lock_guard<std::mutex> lock(queuedFramesMutex);
+            queuedFrames.emplace_back(firstSample, sequenceNumber);
+        };
+
+        // The receiver's microphone and the sender's speaker are never used, so the audio only goes one way.
+        auto sender = std::make_unique<CallManager>(microphone, std::make_shared<AudioBuffer>(), senderConfiguration);
+        auto receiver = std::make_unique<CallManager>(std::make_shared<AudioBuffer>(), speaker, receiverConfiguration);
+
+        // The sender offers, and the receiver answers once the offer is there.
+        const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(_connectTimeoutSeconds));
+        sender->StartCall(ConnectionName, ConnectionPassword);
+
+        while (!std::holds_alternative<std::string>(service->RetrieveOffer(ConnectionName, ConnectionPassword)) && Clock::now() < deadline) {
+            std::this_thread::sleep_for(PollInterval);
+        }
+
+        if (Clock::now() < deadline) {
+            receiver->StartCall(ConnectionName, ConnectionPassword);
+        }
+
+        while (Clock::now() < deadline && (!IsConnected(*sender) || !IsConnected(*receiver))) {
+            std::this_thread::sleep_for(PollInterval);
+        }
+
+        if (Clock::now() >= deadline) {
+            return {
+                {"error", "The call did not connect"}
+            };
+        }
+
+        // The simulated duplex device: each period delivers the samples captured over it, and takes the samples to play over
+        // the next one.
+        std::vector<std::int16_t> recording(deviceSampleCount, 0);
+
+        std::thread device([&]() {
+            std::vector<std::int16_t> input(DevicePeriodSampleCount);
+            std::uint64_t speakerRead = 0; // Samples taken from the speaker queue.
+            std::size_t nextChirp = 0;
+            const auto deviceStart = Clock::now();
+
+            for (std::uint64_t period = 0; (period + 1) * DevicePeriodSampleCount <= deviceSampleCount; period++) {
+                std::this_thread::sleep_until(deviceStart + DevicePeriod * (period + 1));
+
+                const auto now = getMicroseconds();
+                const auto firstSample = period * DevicePeriodSampleCount;
+
+                std::fill(input.begin(), input.end(), 0);
+
+                for (std::size_t i = 0; i < DevicePeriodSampleCount; i++) {
+                    const auto sample = firstSample + i;
+
+                    while (nextChirp < chirpStarts.size() && sample >= chirpStarts[nextChirp] + ChirpSampleCount) {
+                        nextChirp++;
+                    }
+
+                    if (nextChirp < chirpStarts.size() && sample >= chirpStarts[nextChirp]) {
+                        input[i] = chirp[sample - chirpStarts[nextChirp]];
+                    }
+                }
+
+                deliveryTimes[period] = now;
+                AudioInputOutput::CaptureSamples(*microphone, input.data(), DevicePeriodSampleCount);
+
+                const auto played = AudioInputOutput::PlaySamples(*speaker, recording.data() + firstSample, DevicePeriodSampleCount);
+
+                // The first sample of each frame that started playing this period is played as many samples into it.
+                {
+                    std::lock_guard<std::mutex> lock(queuedFramesMutex);
+
+                    while (!queuedFrames.empty() && queuedFrames.front().first < speakerRead + played) {
+                        const auto offset = queuedFrames.front().first - speakerRead;
+                        timings.Play(queuedFrames.front().second, now + static_cast<std::int64_t>(offset * 1000000 / SampleRate));
+                        queuedFrames.pop_front();
+                    }
+                }
+
+                speakerRead += played;
+            }
+        });
+
+        device.join();
+
+        const auto received = receiver->GetCalls().front()._stats;
+
+        // Ending the calls stops both audio threads, so nothing records a timing after this.
+        receiver.reset();
+        sender.reset();
+
+        // End-to-end latency of each chirp.
+        SampleStatistics endToEnd;
+        std::size_t detectedCount = 0;
+
+        for (const auto start : chirpStarts) {
+            const auto [lag, correlation] = FindChirp(recording, chirp, static_cast<std::size_t>(start), maximumLatencySamples);
+
+            if (correlation >= DetectionThreshold) {
+                detectedCount++;
+
+                // A sample is played one period after the sample captured at the same position in the shared sample clock.
+                endToEnd.Add(1000.0 * (lag + DevicePeriodSampleCount) / SampleRate);
+            }
+        }
+
+        // Stage latencies of each frame captured while measuring.
+        SampleStatistics capture, encode, network, jitter, decode, playout, total;
+
+        for (const auto& frame : timings.GetPlayed()) {
+            if (frame._firstSample < measureStartSample || frame._firstSample >= measureEndSample || frame._captured < 0 ||
+                frame._encoding < 0 || frame._sent < 0 || frame._received < 0 || frame._decoding < 0 || frame._queued < 0) {
+                continue;
+            }
+
+            // The packet is handed to the connection as soon as it is encoded, and queued to be played once decoded.
+            capture.Add((frame._sent - frame._encoding - frame._captured) / 1000.0);
+            encode.Add(frame._encoding / 1000.0);
+            network.Add((frame._received - frame._sent) / 1000.0);
+            jitter.Add((frame._queued - frame._decoding - frame._received) / 1000.0);
+            decode.Add(frame._decoding / 1000.0);
+            playout.Add((frame._played - frame._queued) / 1000.0);
+            total.Add((frame._played - frame._captured) / 1000.0);
+        }
+
+        return {
+            {"duration_s", _durationSeconds},
+            {"warm_up_s", _warmUpSeconds},
+            {"bitrate", _bitrate},
+            {"chirps", chirpStarts.size()},
+            {"chirps_detected", detectedCount},
+            {"end_to_end_ms", endToEnd.ToJson()},
+            {"frames_measured", total.GetCount()},
+            {"frames_lost", received._lostPackets},
+            {"frames_late", received._latePackets},
+            {"stage_total_ms", total.ToJson()},
+            {"stages_ms", {
+                {"capture", capture.ToJson()},
+                {"encode", encode.ToJson()},
+                {"network", network.ToJson()},
+                {"jitter_buffer", jitter.ToJson()},
+                {"decode", decode.ToJson()},
+                {"playout", playout.ToJson()}
+            }}
+        };
+    }
+}
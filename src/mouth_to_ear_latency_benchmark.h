@@ -0,0 +1,58 @@
+#pragma once
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Measures mouth-to-ear latency: the time from a sound reaching the microphone to it leaving the speaker, through a call
+    * between two CallManagers connected by WebRTCPeerConnections on loopback. Each runs its own audio thread, so every stage
+    * is the call's own: capture queue, Opus encoding, RTP, pacing, jitter buffer, decoding and playback queue.
+    *
+    * A simulated duplex device stands in for the sound card, with a 10 ms period. Each period it hands 480 captured samples to
+    * the sender's microphone queue and takes 480 samples from the receiver's speaker queue, through AudioInputOutput's
+    * CaptureSamples and PlaySamples as a real device's callbacks do, so capture and playback share one sample clock. The captured audio is silence with a
+    * 10 ms chirp every --chirp-interval, and everything played is recorded.
+    *
+    * End-to-end latency is found by cross-correlating each chirp with the recorded playback: the lag of the best match, plus
+    * the device period, is the chirp's latency. It includes Opus' algorithmic delay, which no stage below sees.
+    *
+    * Every frame is also timed at each stage by its RTP sequence number, as the managers report frames sent and queued:
+    *   capture        From the frame's first sample being captured to it being encoded: framing and queueing.
+    *   encode         Encoding the frame with Opus.
+    *   network        From handing the packet to the connection to it arriving at the remote peer: pacing, SRTP and loopback.
+    *   jitter_buffer  From arriving to being decoded: the jitter buffer's delay.
+    *   decode         Decoding the frame with Opus.
+    *   playout        From the decoded frame being queued to its first sample being played.
+    * Their sum, stage_total, is each frame's latency without the codec's algorithmic delay. The device's own buffering is not
+    * simulated, so a real device adds its input and output latency on top.
+    *
+    * Options:
+    *   --duration <s>          Seconds measured. Default 10.
+    *   --warm-up <s>           Seconds the call runs before it is measured, so the jitter buffer and encoder settle. Default 2.
+    *   --chirp-interval <ms>   Time between chirps. Default 500.
+    *   --max-latency <ms>      The longest latency searched for, less than the chirp interval. Default 400.
+    *   --bitrate <n>           Opus bitrate. Default 32000.
+    *   --connect-timeout <s>   Seconds the call has to connect. Default 10.
+    */
+    class MouthToEarLatencyBenchmark : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The benchmark's command line options.
+        */
+        MouthToEarLatencyBenchmark(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const double _durationSeconds; // Seconds measured.
+        const double _warmUpSeconds; // Seconds the call runs before it is measured.
+        const double _chirpIntervalMilliseconds; // Time between chirps.
+        const double _maximumLatencyMilliseconds; // The longest latency searched for.
+        const int _bitrate; // Opus bitrate.
+        const double _connectTimeoutSeconds; // Seconds the call has to connect.
+    };
+}
@@ -0,0 +1,215 @@
+#include "network_impairment.h"
+
+#include <algorithm>
+
+namespace {
+    // Mixed into the seed of the delay generator, so that it draws a different sequence from the loss generator.
+    constexpr std::uint64_t DelaySeedMix = 0x9e3779b97f4a7c15;
+
+    // Uniform draws summed for each normal draw. Twelve have a variance of 1, so their sum less 6 is very nearly standard
+    // normal, cut off at 6 standard deviations.
+    constexpr int NormalDrawCount = 12;
+}
+
+namespace Comms {
+    NetworkImpairmentModel::NetworkImpairmentModel(const Configuration& configuration) :
+        _configuration(configuration),
+        _lossRandom(configuration._seed),
+        _delayRandom(configuration._seed ^ DelaySeedMix),
+        _tokens(static_cast<double>(configuration._burstBytes)) {
+    }
+
+    std::optional<std::chrono::microseconds> NetworkImpairmentModel::Send(std::size_t size, std::chrono::microseconds now) {
+        _statistics._packetCount++;
+
+        if (IsLost()) {
+            _statistics._lostCount++;
+            return std::nullopt;
+        }
+
+        const auto sendTime = Shape(size, now);
+
+        if (!sendTime.has_value()) {
+            _statistics._droppedCount++;
+            return std::nullopt;
+        }
+
+        auto arrivalTime = *sendTime + SampleDelay();
+
+        if (_configuration._reorderProbability > 0.0 && Uniform(_delayRandom) < _configuration._reorderProbability) {
+            arrivalTime += _configuration._reorderDelay;
+            _statistics._reorderedCount++;
+        }
+
+        return arrivalTime;
+    }
+
+    const NetworkImpairmentModel::Configuration& NetworkImpairmentModel::GetConfiguration() const {
+        return _configuration;
+    }
+
+    const NetworkImpairmentModel::Statistics& NetworkImpairmentModel::GetStatistics() const {
+        return _statistics;
+    }
+
+    bool NetworkImpairmentModel::IsLost() {
+        switch (_configuration._lossModel) {
+            case LossModel::Bernoulli:
+                return Uniform(_lossRandom) < _configuration._lossProbability;
+            case LossModel::GilbertElliott:
+                if (Uniform(_lossRandom) < (_isBad ? _configuration._badToGoodProbability : _configuration._goodToBadProbability)) {
+                    _isBad = !_isBad;
+                }
+
+                return Uniform(_lossRandom) < (_isBad ? _configuration._badLossProbability : _configuration._goodLossProbability);
+            case LossModel::None:
+                break;
+        }
+
+        return false;
+    }
+
+    std::optional<std::chrono::microseconds> NetworkImpairmentModel::Shape(std::size_t size, std::chrono::microseconds now) {
+        if (_configuration._rateBitsPerSecond <= 0) {
+            return now;
+        }
+
+        const double bytesPerSecond = _configuration._rateBitsPerSecond / 8.0;
+
+        // The bucket starts full, so it has nothing to catch up on before the first packet.
+        _tokens = std::min(_tokens + bytesPerSecond * std::chrono::duration<double>(now - _tokensTime.value_or(now)).count(), static_cast<double>(_configuration._burstBytes));
+        _tokensTime = now;
+
+        // Bytes queued ahead of the packet are the tokens the bucket owes.
+        if (_tokens < 0.0 && -_tokens + size > _configuration._queueBytes) {
+            return std::nullopt;
+        }
+
+        _tokens -= static_cast<double>(size);
+
+        if (_tokens >= 0.0) {
+            return now;
+        }
+
+        return now + std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::duration<double>(-_tokens / bytesPerSecond));
+    }
+
+    std::chrono::microseconds NetworkImpairmentModel::SampleDelay() {
+        const double delay = static_cast<double>(_configuration._delay.count());
+        const double jitter = static_cast<double>(_configuration._jitter.count());
+        double offset = 0.0;
+
+        if (jitter > 0.0) {
+            switch (_configuration._delayDistribution) {
+                case DelayDistribution::Uniform:
+                    offset = jitter * (2.0 * Uniform(_delayRandom) - 1.0);
+                    break;
+                case DelayDistribution::Normal: {
+                    // Summed rather than by Box-Muller, as std::log and std::cos may round differently between standard
+                    // libraries, while addition rounds the same everywhere.
+                    double sum = 0.0;
+
+                    for (int i = 0; i < NormalDrawCount; i++) {
+                        sum += Uniform(_delayRandom);
+                    }
+
+                    offset = jitter * (sum - NormalDrawCount / 2.0);
+                    break;
+                }
+            }
+        }
+
+        return std::chrono::microseconds(static_cast<std::int64_t>(std::max(delay + offset, 0.0)));
+    }
+
+    double NetworkImpairmentModel::Uniform(std::mt19937_64& random) {
+        return static_cast<double>(random() >> 11) * 0x1.0p-53; // The top 53 bits fill a double's mantissa exactly.
+    }
+
+    NetworkImpairment::NetworkImpairment(const Configuration& configuration) :
+        _start(Clock::now()),
+        _model(configuration) {
+        _thread = std::thread(&NetworkImpairment::Run, this);
+    }
+
+    NetworkImpairment::~NetworkImpairment() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _isStopping = true;
+        }
+        _delayedCondition.notify_all();
+
+        _thread.join();
+    }
+
+    rtc::message_ptr NetworkImpairment::incoming(rtc::message_ptr message) {
+        return message;
+    }
+
+    rtc::message_ptr NetworkImpairment::outgoing(rtc::message_ptr message) {
+        if (message == nullptr || message->type == rtc::Message::Control) {
+            return message;
+        }
+
+        const auto now = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const auto arrivalTime = _model.Send(message->size(), std::chrono::duration_cast<std::chrono::microseconds>(now - _start));
+
+            if (!arrivalTime.has_value()) {
+                return nullptr;
+            }
+
+            const auto releaseTime = _start + *arrivalTime;
+
+            if (releaseTime > now) {
+                _delayed.push({ releaseTime, _nextOrder++, message });
+                message = nullptr;
+            }
+        }
+
+        if (message == nullptr) {
+            _delayedCondition.notify_all();
+        }
+
+        return message;
+    }
+
+    NetworkImpairment::Statistics NetworkImpairment::GetStatistics() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _model.GetStatistics();
+    }
+
+    void NetworkImpairment::Run() {
+        std::vector<rtc::message_ptr> released;
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (!_isStopping) {
+            if (_delayed.empty()) {
+                _delayedCondition.wait(lock);
+                continue;
+            }
+
+            if (_delayedCondition.wait_until(lock, _delayed.top()._releaseTime) == std::cv_status::no_timeout) {
+                continue; // A packet may have been delayed less than the one waited for.
+            }
+
+            const auto now = Clock::now();
+
+            while (!_delayed.empty() && _delayed.top()._releaseTime <= now) {
+                released.push_back(_delayed.top()._message);
+                _delayed.pop();
+            }
+
+            // Sent without the lock, so libdatachannel's threads are not held up handing over new packets.
+            lock.unlock();
+
+            for (auto& message : released) {
+                outgoingCallback(std::move(message));
+            }
+
+            released.clear();
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    /*
+    * Decides what a poor network does to each packet sent across it: whether it is lost, and if not when it arrives. Holds
+    * no clock and no packets, so that the same network can impair a live track in real time (NetworkImpairment) or a
+    * simulated call in virtual time (CallSimulation).
+    *
+    * Each packet, in order:
+    *   1. May be lost, by the loss model.
+    *   2. Joins a token bucket of the bandwidth limit, which holds it until there are tokens to send it, and drops it if
+    *      the bytes queued ahead of it would overflow the bucket's queue.
+    *   3. Is delayed by the base delay plus a random jitter, and by the reorder delay if it is chosen to be reordered.
+    *      Jitter can reorder packets on its own, as it would on a real network.
+    *
+    * Random draws come from a std::mt19937_64 seeded by the configuration and are turned into probabilities and delays with
+    * nothing but arithmetic, rather than the standard distributions or std::log, whose results differ between standard
+    * libraries. The packets lost and the delay of each are therefore the same on every platform for the same seed and
+    * sequence of packets. Loss and delay draw from separate generators, so changing the delay does not change which packets
+    * are lost.
+    */
+    class NetworkImpairmentModel {
+    public:
+        enum class LossModel {
+            None, // No packets are lost.
+            Bernoulli, // Each packet is lost independently, with _lossProbability.
+            GilbertElliott // Packets are lost in bursts, by a two-state Markov chain. @see Configuration
+        };
+
+        enum class DelayDistribution {
+            Uniform, // Jitter is uniform between -_jitter and +_jitter.
+            Normal // Jitter is normal with a standard deviation of _jitter, cut off at 6 standard deviations.
+        };
+
+        struct Configuration {
+            LossModel _lossModel = LossModel::None; // How packets are chosen to be lost.
+            double _lossProbability = 0.0; // The chance each packet is lost, for the Bernoulli model.
+
+            // The Gilbert-Elliott model is in a good or a bad state, moving between them before each packet, and loses
+            // packets with the probability of its state. The mean burst spent in the bad state is 1 / _badToGoodProbability.
+            double _goodToBadProbability = 0.0; // The chance of moving from the good state to the bad state.
+            double _badToGoodProbability = 1.0; // The chance of moving from the bad state to the good state.
+            double _goodLossProbability = 0.0; // The chance a packet is lost in the good state.
+            double _badLossProbability = 1.0; // The chance a packet is lost in the bad state.
+
+            std::chrono::microseconds _delay{ 0 }; // The one-way delay every packet is given.
+            std::chrono::microseconds _jitter{ 0 }; // The spread of the random delay added to _delay. Never makes it negative.
+            DelayDistribution _delayDistribution = DelayDistribution::Uniform; // How the jitter is distributed.
+
+            double _reorderProbability = 0.0; // The chance a packet is held back, so that later packets overtake it.
+            std::chrono::microseconds _reorderDelay{ 40000 }; // The time a packet chosen to be reordered is held back.
+
+            std::int64_t _rateBitsPerSecond = 0; // The bandwidth limit, or 0 for none.
+            std::size_t _burstBytes = 3000; // The bytes the bucket can send at once after being idle.
+            std::size_t _queueBytes = 65536; // The bytes that can wait for tokens before packets are dropped.
+
+            std::uint64_t _seed = 1; // Seeds every random draw.
+        };
+
+        /*
+        * Counts of the packets handled, since the model was created.
+        */
+        struct Statistics {
+            std::uint64_t _packetCount = 0; // Packets sent across the network.
+            std::uint64_t _lostCount = 0; // Packets lost by the loss model.
+            std::uint64_t _droppedCount = 0; // Packets dropped because the bandwidth limit's queue was full.
+            std::uint64_t _reorderedCount = 0; // Packets held back to be reordered.
+        };
+
+        /*
+        * Constructor.
+        */
+        NetworkImpairmentModel(const Configuration& configuration);
+
+        /*
+        * Sends a packet across the network.
+        *
+        * @param size The size of the packet in bytes.
+        * @param now The time it is sent, on any clock that only moves forward.
+        * @return The time it arrives on the same clock, or nothing if it is lost or dropped.
+        */
+        std::optional<std::chrono::microseconds> Send(std::size_t size, std::chrono::microseconds now);
+
+        /*
+        * @return The impairments applied.
+        */
+        const Configuration& GetConfiguration() const;
+
+        /*
+        * @return Counts of the packets handled.
+        */
+        const Statistics& GetStatistics() const;
+
+    private:
+        /*
+        * @return Whether the next packet is lost, advancing the loss model.
+        */
+        bool IsLost();
+
+        /*
+        * Takes a packet through the token bucket.
+        *
+        * @return When the bucket sends the packet, or nothing if its queue is full.
+        */
+        std::optional<std::chrono::microseconds> Shape(std::size_t size, std::chrono::microseconds now);
+
+        /*
+        * @return The delay of the next packet, jitter included.
+        */
+        std::chrono::microseconds SampleDelay();
+
+        /*
+        * @return A uniform random number in [0, 1).
+        */
+        static double Uniform(std::mt19937_64& random);
+
+        const Configuration _configuration; // The impairments applied.
+
+        std::mt19937_64 _lossRandom; // Draws for the loss model.
+        std::mt19937_64 _delayRandom; // Draws for jitter and reordering.
+        bool _isBad = false; // Whether the Gilbert-Elliott model is in its bad state.
+
+        double _tokens; // Bytes the bucket can send now. Negative while packets wait for tokens.
+        std::optional<std::chrono::microseconds> _tokensTime; // When _tokens was last brought up to date, unset until the first packet.
+
+        Statistics _statistics; // Counts of the packets handled.
+    };
+
+    /*
+    * A media handler that makes a track's outgoing packets behave as if they crossed a poor network: lost, delayed,
+    * reordered and limited in bandwidth, as decided by a NetworkImpairmentModel. Set on a track with
+    * WebRTCPeerConnection::SetMediaHandler, so that the jitter buffer, loss concealment and rate control can be measured
+    * over loopback against the same conditions every run.
+    *
+    * Only packets sent are impaired, and received packets pass through untouched. Setting a handler on both peers of a
+    * connection impairs both directions. Control messages are never impaired.
+    */
+    class NetworkImpairment : public rtc::MediaHandler {
+    public:
+        using LossModel = NetworkImpairmentModel::LossModel;
+        using DelayDistribution = NetworkImpairmentModel::DelayDistribution;
+        using Configuration = NetworkImpairmentModel::Configuration;
+        using Statistics = NetworkImpairmentModel::Statistics;
+
+        /*
+        * Constructor. Starts the thread that sends delayed packets.
+        */
+        NetworkImpairment(const Configuration& configuration);
+
+        /*
+        * Destructor. Stops the thread. Packets still delayed are never sent.
+        */
+        ~NetworkImpairment();
+
+        NetworkImpairment(const NetworkImpairment&) = delete;
+        NetworkImpairment& operator=(const NetworkImpairment&) = delete;
+
+        rtc::message_ptr incoming(rtc::message_ptr message) override;
+        rtc::message_ptr outgoing(rtc::message_ptr message) override;
+
+        Statistics GetStatistics() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        /*
+        * A packet waiting to be sent.
+        */
+        struct DelayedPacket {
+            Clock::time_point _releaseTime; // When the packet is sent.
+            std::uint64_t _order; // Orders packets released at the same time by when they were sent.
+            rtc::message_ptr _message; // The packet.
+
+            bool operator>(const DelayedPacket& other) const {
+                return _releaseTime != other._releaseTime ? _releaseTime > other._releaseTime : _order > other._order;
+            }
+        };
+
+        /*
+        * Sends delayed packets as they are released, until stopped.
+        */
+        void Run();
+
+        const Clock::time_point _start; // The origin of the model's clock.
+        NetworkImpairmentModel _model; // Decides what happens to each packet. Requires _mutex.
+
+        std::priority_queue<DelayedPacket, std::vector<DelayedPacket>, std::greater<DelayedPacket>> _delayed; // Packets waiting to be sent, soonest first. Requires _mutex.
+        std::uint64_t _nextOrder = 0; // The order of the next packet delayed. Requires _mutex.
+
+        bool _isStopping = false; // Set when the thread is stopping. Requires _mutex.
+        mutable std::mutex _mutex; // Mutex to control access to the handler's state, taken by libdatachannel's threads and Run.
+        std::condition_variable _delayedCondition; // Notified when a packet is delayed, or the thread is stopping.
+        std::thread _thread; // Sends delayed packets.
+    };
+}
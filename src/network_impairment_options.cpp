@@ -0,0 +1,64 @@
+#include "network_impairment_options.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Comms {
+    std::optional<NetworkImpairmentModel::Configuration> ParseNetworkImpairment(const CommandLineOptions& options) {
+        NetworkImpairmentModel::Configuration configuration;
+
+        const double loss = std::clamp(options.GetDouble("loss", 0.0), 0.0, 100.0) / 100.0;
+        const double lossBurst = std::max(options.GetDouble("loss-burst", 1.0), 1.0);
+
+        if (loss > 0.0 && lossBurst > 1.0) {
+            // A Gilbert model, losing every packet in the bad state, with the mean loss and mean burst length asked for.
+            configuration._lossModel = NetworkImpairmentModel::LossModel::GilbertElliott;
+            configuration._badToGoodProbability = 1.0 / lossBurst;
+            configuration._goodToBadProbability = loss < 1.0 ? std::min(configuration._badToGoodProbability * loss / (1.0 - loss), 1.0) : 1.0;
+        }
+        else if (loss > 0.0) {
+            configuration._lossModel = NetworkImpairmentModel::LossModel::Bernoulli;
+            configuration._lossProbability = loss;
+        }
+
+        const auto toMicroseconds = [](double milliseconds) {
+            return std::chrono::microseconds(static_cast<std::int64_t>(std::max(milliseconds, 0.0) * 1000.0));
+        };
+
+        configuration._delay = toMicroseconds(options.GetDouble("delay", 0.0));
+        configuration._jitter = toMicroseconds(options.GetDouble("jitter", 0.0));
+        configuration._delayDistribution = options.GetString("jitter-distribution", "uniform") == "normal" ?
+            NetworkImpairmentModel::DelayDistribution::Normal : NetworkImpairmentModel::DelayDistribution::Uniform;
+        configuration._reorderProbability = std::clamp(options.GetDouble("reorder", 0.0), 0.0, 100.0) / 100.0;
+        configuration._rateBitsPerSecond = std::max<std::int64_t>(options.GetInteger("rate", 0), 0);
+        configuration._seed = static_cast<std::uint64_t>(options.GetInteger("seed", 1));
+
+        if (configuration._lossModel == NetworkImpairmentModel::LossModel::None && configuration._delay.count() == 0 &&
+            configuration._jitter.count() == 0 && configuration._reorderProbability == 0.0 && configuration._rateBitsPerSecond == 0) {
+            return std::nullopt;
+        }
+
+        return configuration;
+    }
+
+    nlohmann::json NetworkImpairmentToJson(const std::optional<NetworkImpairmentModel::Configuration>& configuration) {
+        if (!configuration.has_value()) {
+            return nullptr;
+        }
+
+        const char* lossModels[] = { "none", "bernoulli", "gilbert_elliott" };
+
+        return {
+            {"loss_model", lossModels[static_cast<int>(configuration->_lossModel)]},
+            {"loss_probability", configuration->_lossProbability},
+            {"good_to_bad_probability", configuration->_goodToBadProbability},
+            {"bad_to_good_probability", configuration->_badToGoodProbability},
+            {"delay_ms", configuration->_delay.count() / 1000.0},
+            {"jitter_ms", configuration->_jitter.count() / 1000.0},
+            {"jitter_distribution", configuration->_delayDistribution == NetworkImpairmentModel::DelayDistribution::Normal ? "normal" : "uniform"},
+            {"reorder_probability", configuration->_reorderProbability},
+            {"rate_bps", configuration->_rateBitsPerSecond},
+            {"seed", configuration->_seed}
+        };
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <optional>
+
+#include "json/json.hpp"
+
+#include "command_line_options.h"
+#include "network_impairment.h"
+
+namespace Comms {
+
+    /*
+    * Parses the network impairment options shared by the tools that run calls over an impaired network:
+    *   --loss <percent>         Packets lost. Each independently, unless --loss-burst is given.
+    *   --loss-burst <packets>   Mean length of bursts of loss, by a Gilbert model with the mean loss of --loss.
+    *   --delay <ms>             One-way delay.
+    *   --jitter <ms>            Spread of random delay added to --delay.
+    *   --jitter-distribution    uniform or normal. Default uniform.
+    *   --reorder <percent>      Packets held back so that later packets overtake them.
+    *   --rate <bits/s>          Bandwidth limit of each direction of each call.
+    *   --seed <n>               Seeds the impairment of the first direction. Default 1.
+    *
+    * @return Nothing if no impairment was asked for.
+    */
+    std::optional<NetworkImpairmentModel::Configuration> ParseNetworkImpairment(const CommandLineOptions& options);
+
+    /*
+    * @return The impairment applied, for a tool's results, or null if there is none.
+    */
+    nlohmann::json NetworkImpairmentToJson(const std::optional<NetworkImpairmentModel::Configuration>& configuration);
+}
@@ -0,0 +1,242 @@
+#include "opus_codec_benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include "opuscpp/opus_wrapper.h"
+
+#include "allocation_counter.h"
+#include "sample_statistics.h"
+#include "synthetic_speech.h"
+
+namespace {
+    constexpr int SampleRate = 48000;
+    constexpr int MaximumComplexity = 10;
+    constexpr double Pi = 3.14159265358979;
+
+    // Every frame size Opus encodes, in milliseconds.
+    const std::vector<double> FrameSizes = { 2.5, 5.0, 10.0, 20.0, 40.0, 60.0, 80.0, 100.0, 120.0 };
+
+    /*
+    * Generates music-like audio: a four chord progression of notes with harmonics, struck on each beat and decaying, over a
+    * noise burst on every beat like a hi-hat, so that the encoder sees tonal, wideband audio rather than speech.
+    */
+    std::vector<std::int16_t> GenerateMusic(std::size_t sampleCount) {
+        constexpr double BeatsPerSecond = 2.0;
+        constexpr std::size_t BeatsPerChord = 4;
+        constexpr int HarmonicCount = 4;
+
+        const std::array<std::array<double, 3>, 4> chords = { {
+            { 220.00, 277.18, 329.63 }, // A major.
+            { 196.00, 246.94, 293.66 }, // G major.
+            { 174.61, 220.00, 261.63 }, // F major.
+            { 164.81, 207.65, 246.94 }  // E major.
+        } };
+
+        std::mt19937 random(0);
+        std::uniform_real_distribution<double> noise(-1.0, 1.0);
+        std::vector<std::int16_t> samples(sampleCount);
+
+        for (std::size_t i = 0; i < sampleCount; i++) {
+            const double time = i / static_cast<double>(SampleRate);
+            const auto beat = static_cast<std::size_t>(time * BeatsPerSecond);
+            const double sinceBeat = time - beat / BeatsPerSecond;
+            const auto& chord = chords[(beat / BeatsPerChord) % chords.size()];
+
+            double tone = 0.0;
+
+            for (const double frequency : chord) {
+                for (int harmonic = 1; harmonic <= HarmonicCount; harmonic++) {
+                    tone += std::sin(2.0 * Pi * frequency * harmonic * time) / harmonic;
+                }
+            }
+
+            const double notes = 2500.0 * std::exp(-3.0 * sinceBeat) * tone / chord.size();
+            const double hiHat = 6000.0 * std::exp(-40.0 * sinceBeat) * noise(random);
+
+            samples[i] = static_cast<std::int16_t>(std::clamp(notes + hiHat, -32768.0, 32767.0));
+        }
+
+        return samples;
+    }
+
+    /*
+    * The time and allocations of one stage of coding, frame by frame.
+    */
+    class StageMeasurement {
+    public:
+        /*
+        * Runs and measures a stage's work on one frame.
+        */
+        template <typename Function>
+        void Measure(Function&& function) {
+            const auto allocations = Comms::AllocationCounter::GetThreadCounts();
+            const auto start = std::chrono::steady_clock::now();
+
+            function();
+
+            const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            const auto laterAllocations = Comms::AllocationCounter::GetThreadCounts();
+
+            _frameTimes.Add(elapsed);
+            _totalMicroseconds += elapsed;
+            _allocationCount += laterAllocations._count - allocations._count;
+            _allocatedBytes += laterAllocations._bytes - allocations._bytes;
+        }
+
+        /*
+        * @param frameMilliseconds The duration of each frame.
+        */
+        nlohmann::json ToJson(double frameMilliseconds) const {
+            const auto frameCount = static_cast<double>(std::max<std::size_t>(_frameTimes.GetCount(), 1));
+            const double totalSeconds = std::max(_totalMicroseconds, 1.0) / 1e6;
+
+            return {
+                {"frames_per_second", _frameTimes.GetCount() / totalSeconds},
+                {"realtime_factor", _frameTimes.GetCount() * frameMilliseconds / 1000.0 / totalSeconds},
+                {"frame_us", _frameTimes.ToJson()},
+                {"allocations_per_frame", _allocationCount / frameCount},
+                {"allocated_bytes_per_frame", _allocatedBytes / frameCount}
+            };
+        }
+
+    private:
+        Comms::SampleStatistics _frameTimes; // Microseconds each frame took.
+        double _totalMicroseconds = 0.0; // The sum of _frameTimes.
+        std::uint64_t _allocationCount = 0; // Allocations made by the stage.
+        std::uint64_t _allocatedBytes = 0; // Bytes they requested.
+    };
+
+    std::vector<double> ParseDoubles(const std::vector<std::string>& values) {
+        std::vector<double> parsed;
+
+        for (const auto& value : values) {
+            parsed.push_back(std::stod(value));
+        }
+
+        return parsed;
+    }
+}
+
+namespace Comms {
+    OpusCodecBenchmark::OpusCodecBenchmark(const CommandLineOptions& options) :
+        _seconds(std::max(options.GetDouble("seconds", 10.0), 0.2)),
+        _bitrate(static_cast<int>(options.GetInteger("bitrate", 32000))),
+        _frameSizes(options.Has("frame-sizes") ? ParseDoubles(options.GetList("frame-sizes")) : FrameSizes),
+        _corpora(options.Has("corpora") ? options.GetList("corpora") : std::vector<std::string>{ "speech", "music" }),
+        _lossPercent(static_cast<int>(std::clamp<std::int64_t>(options.GetInteger("loss", 10), 1, 100))),
+        _application(options.GetString("application", "voip")) {
+        if (options.Has("complexities")) {
+            for (const auto& complexity : ParseDoubles(options.GetList("complexities"))) {
+                _complexities.push_back(std::clamp(static_cast<int>(complexity), 0, MaximumComplexity));
+            }
+        }
+        else {
+            for (int complexity = 0; complexity <= MaximumComplexity; complexity++) {
+                _complexities.push_back(complexity);
+            }
+        }
+    }
+
+    nlohmann::json OpusCodecBenchmark::Run() {
+        const auto application = _application == "audio" ? OPUS_APPLICATION_AUDIO : OPUS_APPLICATION_VOIP;
+        const auto sampleCount = static_cast<std::size_t>(_seconds * SampleRate);
+        nlohmann::json configurations = nlohmann::json::array();
+
+        for (const auto& corpus : _corpora) {
+            if (corpus != "speech" && corpus != "music") {
+                continue;
+            }
+
+            const auto samples = corpus == "music" ? GenerateMusic(sampleCount) : GenerateSpeech(0, sampleCount);
+
+            for (const double frameMilliseconds : _frameSizes) {
+                const auto frameSampleCount = static_cast<int>(std::lround(frameMilliseconds * SampleRate / 1000.0));
+                const auto frameCount = frameSampleCount > 0 ? samples.size() / frameSampleCount : 0;
+
+                if (frameCount == 0) {
+                    continue;
+                }
+
+                for (const int complexity : _complexities) {
+                    for (const bool isVariableBitrate : { true, false }) {
+                        for (const bool isFec : { false, true }) {
+                            opus::Encoder encoder(SampleRate, 1, application, isFec ? _lossPercent : 0);
+                            encoder.SetBitrate(_bitrate);
+                            encoder.SetVariableBitrate(isVariableBitrate ? 1 : 0);
+                            encoder.SetComplexity(complexity);
+
+                            nlohmann::json configuration = {
+                                {"corpus", corpus},
+                                {"frame_ms", frameMilliseconds},
+                                {"complexity", complexity},
+                                {"vbr", isVariableBitrate},
+                                {"fec", isFec}
+                            };
+
+                            if (!encoder.valid()) {
+                                configuration["error"] = "The encoder rejected the configuration";
+                                configurations.push_back(std::move(configuration));
+                                continue;
+                            }
+
+                            // The frame's samples are copied in outside the measurement, so only the codec's work is counted.
+                            std::vector<opus_int16> frame(frameSampleCount);
+                            std::vector<std::vector<unsigned char>> packets;
+                            packets.reserve(frameCount);
+                            std::size_t encodedBytes = 0;
+                            StageMeasurement encode;
+
+                            for (std::size_t i = 0; i < frameCount; i++) {
+                                std::copy_n(samples.begin() + i * frameSampleCount, frameSampleCount, frame.begin());
+                                std::vector<std::vector<unsigned char>> encoded;
+
+                                encode.Measure([&]() { encoded = encoder.Encode(frame, frameSampleCount); });
+
+                                packets.push_back(encoded.empty() ? std::vector<unsigned char>() : std::move(encoded.front()));
+                                encodedBytes += packets.back().size();
+                            }
+
+                            opus::Decoder decoder(SampleRate, 1);
+                            std::vector<opus_int16> decoded;
+                            StageMeasurement decode;
+
+                            for (const auto& packet : packets) {
+                                decode.Measure([&]() { decoded = decoder.Decode(packet, frameSampleCount, false); });
+                            }
+
+                            configuration["bitrate"] = encodedBytes * 8.0 / (frameCount * frameMilliseconds / 1000.0);
+                            configuration["encode"] = encode.ToJson(frameMilliseconds);
+                            configuration["decode"] = decode.ToJson(frameMilliseconds);
+
+                            // Recovers each frame from the FEC data of the packet after it, as a receiver does for a lost packet.
+                            if (isFec) {
+                                opus::Decoder fecDecoder(SampleRate, 1);
+                                StageMeasurement fecDecode;
+
+                                for (std::size_t i = 1; i < packets.size(); i++) {
+                                    fecDecode.Measure([&]() { decoded = fecDecoder.Decode(packets[i], frameSampleCount, true); });
+                                }
+
+                                configuration["fec_decode"] = fecDecode.ToJson(frameMilliseconds);
+                            }
+
+                            configurations.push_back(std::move(configuration));
+                        }
+                    }
+                }
+            }
+        }
+
+        return {
+            {"seconds", _seconds},
+            {"bitrate", _bitrate},
+            {"application", _application == "audio" ? "audio" : "voip"},
+            {"loss_percent", _lossPercent},
+            {"configurations", configurations}
+        };
+    }
+}
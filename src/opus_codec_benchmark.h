@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Measures the cost of Opus as wrapped by opuscpp's opus::Encoder and opus::Decoder, as a baseline for tracking
+    * regressions and the effect of changes to the wrapper.
+    *
+    * Each configuration encodes and then decodes the same seconds of a corpus, timing every frame:
+    *   speech  The synthetic speech the load generators send. @see GenerateSpeech
+    *   music   A synthetic chord progression of harmonic-rich notes over a noise-burst beat, tonal and wideband.
+    * Both are generated from fixed seeds, so every run codes the same audio.
+    *
+    * Configurations cover every Opus frame size, complexity 0 to 10, and VBR and in-band FEC each on and off. With FEC on, the
+    * encoder expects --loss percent loss, and the decoder's recovery of each frame from the packet after it is also timed.
+    *
+    * Each stage reports frames per second, its realtime factor (seconds of audio coded per second of processing), per-frame
+    * times in microseconds, and the heap allocations made per frame through operator new. @see AllocationCounter
+    *
+    * Options:
+    *   --seconds <s>             Seconds of each corpus coded per configuration. Default 10.
+    *   --bitrate <n>             Bitrate in bits per second. Default 32000.
+    *   --frame-sizes <ms,...>    Frame sizes. Default 2.5,5,10,20,40,60,80,100,120.
+    *   --complexities <n,...>    Complexities. Default 0 to 10.
+    *   --corpora <name,...>      Corpora. Default speech,music.
+    *   --loss <percent>          Loss the encoder expects with FEC on. Default 10.
+    *   --application <name>      voip or audio. Default voip, as calls are encoded.
+    */
+    class OpusCodecBenchmark : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The benchmark's command line options.
+        */
+        OpusCodecBenchmark(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const double _seconds; // Seconds of each corpus coded per configuration.
+        const int _bitrate; // Bitrate in bits per second.
+        std::vector<double> _frameSizes; // Frame sizes in milliseconds.
+        std::vector<int> _complexities; // Complexities.
+        std::vector<std::string> _corpora; // Corpus names.
+        const int _lossPercent; // Loss the encoder expects with FEC on.
+        const std::string _application; // voip or audio.
+    };
+}
@@ -0,0 +1,122 @@
+#include "opus_packet.h"
+
+namespace {
+    // Frame sizes in samples at 48 kHz, indexed by the low bits of the configuration number.
+    constexpr std::uint32_t SilkFrameSampleCounts[] = { 480, 960, 1920, 2880 }; // 10, 20, 40 and 60 ms.
+    constexpr std::uint32_t HybridFrameSampleCounts[] = { 480, 960 }; // 10 and 20 ms.
+    constexpr std::uint32_t CeltFrameSampleCounts[] = { 120, 240, 480, 960 }; // 2.5, 5, 10 and 20 ms.
+
+    constexpr std::uint32_t NarrowBandwidth = 4000;
+    constexpr std::uint32_t MediumBandwidth = 6000;
+    constexpr std::uint32_t WideBandwidth = 8000;
+    constexpr std::uint32_t SuperWideBandwidth = 12000;
+    constexpr std::uint32_t FullBandwidth = 20000;
+}
+
+namespace Comms {
+    std::optional<OpusTableOfContents> ParseOpusTableOfContents(const std::byte* payload, std::size_t size) {
+        if (size == 0) {
+            return std::nullopt;
+        }
+
+        const auto toc = std::to_integer<std::uint8_t>(payload[0]);
+        const std::uint8_t configuration = toc >> 3;
+        const std::uint8_t frameCountCode = toc & 0x03;
+
+        OpusTableOfContents tableOfContents{};
+        tableOfContents._isStereo = (toc & 0x04) != 0;
+
+        if (configuration < 12) {
+            constexpr std::uint32_t bandwidths[] = { NarrowBandwidth, MediumBandwidth, WideBandwidth };
+
+            tableOfContents._mode = OpusMode::Silk;
+            tableOfContents._bandwidth = bandwidths[configuration / 4];
+            tableOfContents._frameSampleCount = SilkFrameSampleCounts[configuration % 4];
+        }
+        else if (configuration < 16) {
+            tableOfContents._mode = OpusMode::Hybrid;
+            tableOfContents._bandwidth = configuration < 14 ? SuperWideBandwidth : FullBandwidth;
+            tableOfContents._frameSampleCount = HybridFrameSampleCounts[configuration % 2];
+        }
+        else {
+            constexpr std::uint32_t bandwidths[] = { NarrowBandwidth, WideBandwidth, SuperWideBandwidth, FullBandwidth };
+
+            tableOfContents._mode = OpusMode::Celt;
+            tableOfContents._bandwidth = bandwidths[(configuration - 16) / 4];
+            tableOfContents._frameSampleCount = CeltFrameSampleCounts[configuration % 4];
+        }
+
+        // Code 0 is one frame, codes 1 and 2 are two frames, and code 3 gives the count in the low six bits of the next byte.
+        if (frameCountCode == 0) {
+            tableOfContents._frameCount = 1;
+        }
+        else if (frameCountCode < 3) {
+            tableOfContents._frameCount = 2;
+        }
+        else if (size >= 2) {
+            tableOfContents._frameCount = std::to_integer<std::uint8_t>(payload[1]) & 0x3F;
+        }
+        else {
+            return std::nullopt;
+        }
+
+        return tableOfContents;
+    }
+
+    bool IsOpusSilence(const std::byte* payload, std::size_t size) {
+        const auto tableOfContents = ParseOpusTableOfContents(payload, size);
+
+        if (!tableOfContents.has_value() || tableOfContents->_frameCount == 0) {
+            return false; // Not a valid packet, so not known to be silent.
+        }
+
+        // The frames are empty if the packet ends where their data would start. RFC 6716 section 3.2.
+        switch (std::to_integer<std::uint8_t>(payload[0]) & 0x03) {
+            case 0: // One frame, taking the rest of the packet.
+            case 1: // Two frames, splitting the rest of the packet equally.
+                return size == 1;
+            case 2: // Two frames, the first's length given by the next byte. A length of 0 is that one byte.
+                return size == 2 && payload[1] == std::byte{ 0 };
+        }
+
+        // Code 3: the frame count byte, then any padding length bytes, then in VBR the lengths of all frames but the last.
+        const auto frameCountByte = std::to_integer<std::uint8_t>(payload[1]);
+        const bool isVariableBitrate = (frameCountByte & 0x80) != 0;
+        const bool hasPadding = (frameCountByte & 0x40) != 0;
+        std::size_t offset = 2;
+        std::size_t paddingSize = 0;
+
+        while (hasPadding) {
+            if (offset >= size) {
+                return false;
+            }
+
+            const auto paddingByte = std::to_integer<std::uint8_t>(payload[offset++]);
+            paddingSize += paddingByte == 255 ? 254 : paddingByte; // 255 adds 254 bytes and continues with the next byte.
+
+            if (paddingByte != 255) {
+                break;
+            }
+        }
+
+        if (isVariableBitrate) {
+            for (std::uint32_t frame = 1; frame < tableOfContents->_frameCount; frame++) {
+                if (offset >= size || payload[offset++] != std::byte{ 0 }) {
+                    return false; // A frame with data.
+                }
+            }
+        }
+
+        return offset + paddingSize == size;
+    }
+
+    std::uint32_t GetOpusSampleCount(const std::byte* payload, std::size_t size) {
+        const auto tableOfContents = ParseOpusTableOfContents(payload, size);
+
+        if (!tableOfContents.has_value()) {
+            return 0;
+        }
+
+        return tableOfContents->_frameSampleCount * tableOfContents->_frameCount;
+    }
+}
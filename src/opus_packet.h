@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace Comms {
+
+    /*
+    * The coding mode of an Opus packet.
+    */
+    enum class OpusMode {
+        Silk, // Linear prediction, used for speech at lower bitrates.
+        Hybrid, // Linear prediction below 8 kHz and MDCT above.
+        Celt // MDCT, used for music and at higher bitrates.
+    };
+
+    /*
+    * The fields of an Opus packet's table of contents byte, as defined in RFC 6716 section 3.1.
+    */
+    struct OpusTableOfContents {
+        OpusMode _mode; // The coding mode.
+        std::uint32_t _bandwidth; // The audio bandwidth in Hz.
+        std::uint32_t _frameSampleCount; // Samples per channel in each frame at 48 kHz.
+        std::uint32_t _frameCount; // The number of frames in the packet.
+        bool _isStereo; // Whether the frames are coded in stereo.
+    };
+
+    /*
+    * Parses the table of contents of an Opus packet, without decoding any audio.
+    *
+    * @param payload The Opus packet, i.e. the payload of an RTP packet.
+    * @param size The size of the packet in bytes.
+    * @return The table of contents, or std::nullopt if the packet is too short to hold one.
+    */
+    std::optional<OpusTableOfContents> ParseOpusTableOfContents(const std::byte* payload, std::size_t size);
+
+    /*
+    * Whether an Opus packet carries no audio: every frame its table of contents declares is empty. Encoders send such
+    * packets, usually a lone table of contents byte, for discontinuous transmission (DTX) while the speaker is quiet.
+    *
+    * @param payload The Opus packet.
+    * @param size The size of the packet in bytes.
+    * @return Whether the packet carries no audio.
+    */
+    bool IsOpusSilence(const std::byte* payload, std::size_t size);
+
+    /*
+    * @return The samples per channel at 48 kHz covered by an Opus packet, or 0 if it could not be parsed.
+    */
+    std::uint32_t GetOpusSampleCount(const std::byte* payload, std::size_t size);
+}
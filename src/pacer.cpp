@@ -0,0 +1,119 @@
+#include "pacer.h"
+
+#include <algorithm>
+
+#include "allocation_tracker.h"
+#include "pipeline_trace.h"
+
+namespace {
+    constexpr double MaximumBudgetSeconds = 0.04; // The most the budget holds, so that an idle pacer cannot burst.
+    constexpr std::size_t MaximumQueuedPackets = 5; // 100 ms of 20 ms frames. Older audio would arrive too late to play.
+
+    // The longest the thread sleeps waiting for budget before checking whether it is stopping or the bitrate has changed.
+    constexpr std::chrono::milliseconds MaximumBudgetWait(10);
+}
+
+namespace Comms {
+    Pacer::Pacer(SendFunction send, int pacingBitrate) :
+        _send(send),
+        _bytesPerSecond(pacingBitrate / 8.0),
+        _budgetTime(Clock::now()) {
+        _budget = _bytesPerSecond * MaximumBudgetSeconds;
+        _packet.reserve(MaximumPacketSize);
+        _thread = std::thread(&Pacer::Run, this);
+    }
+
+    Pacer::~Pacer() {
+        _isStopping = true;
+        _queued.release();
+
+        _thread.join();
+    }
+
+    bool Pacer::Send(const rtc::binary& packet) {
+        if (packet.size() > MaximumPacketSize) {
+            return false;
+        }
+
+        const auto written = _written.load(std::memory_order_relaxed);
+
+        // Only full if the pacer's thread has fallen far behind. It drops the oldest packets once it catches up.
+        if (written - _read.load(std::memory_order_acquire) >= SlotCount) {
+            return false;
+        }
+
+        auto& slot = _slots[written % SlotCount];
+        std::copy(packet.begin(), packet.end(), slot._data.begin());
+        slot._size = packet.size();
+
+        _written.store(written + 1, std::memory_order_release); // Publishes the slot.
+        _queued.release();
+
+        return true;
+    }
+
+    void Pacer::SetPacingBitrate(int bitsPerSecond) {
+        _bytesPerSecond = bitsPerSecond / 8.0;
+    }
+
+    void Pacer::Run() {
+        PipelineTrace::NameThread("Pacer");
+        AllocationScope scope(AllocationTag::Transport);
+
+        while (true) {
+            _queued.acquire();
+
+            if (_isStopping) {
+                return;
+            }
+
+            auto read = _read.load(std::memory_order_relaxed);
+            const auto written = _written.load(std::memory_order_acquire);
+
+            // The packet this release was for has already been taken, as a packet dropped before its release was made.
+            if (read == written) {
+                continue;
+            }
+
+            // Older audio would be too late to play. Each packet dropped takes its release, if it has been made yet.
+            while (written - read > MaximumQueuedPackets) {
+                read++;
+                static_cast<void>(_queued.try_acquire());
+            }
+
+            // Copied out, so that the slot is free again while the packet waits for budget.
+            const auto& slot = _slots[read % SlotCount];
+            _packet.assign(slot._data.begin(), slot._data.begin() + slot._size);
+            _read.store(read + 1, std::memory_order_release);
+
+            FillBudget(Clock::now());
+
+            while (_budget <= 0.0 && !_isStopping) {
+                const auto refill = std::chrono::duration<double>(-_budget / _bytesPerSecond + 0.001);
+                std::this_thread::sleep_for(std::min<std::chrono::duration<double>>(refill, MaximumBudgetWait));
+                FillBudget(Clock::now());
+            }
+
+            if (_isStopping) {
+                return;
+            }
+
+            _budget -= static_cast<double>(_packet.size());
+
+            try {
+                _send(_packet);
+            }
+            catch (const std::exception&) {
+                // The connection closed while the packet was queued.
+            }
+        }
+    }
+
+    void Pacer::FillBudget(Clock::time_point now) {
+        const double bytesPerSecond = _bytesPerSecond;
+        const double elapsed = std::chrono::duration<double>(now - _budgetTime).count();
+
+        _budget = std::min(_budget + bytesPerSecond * elapsed, bytesPerSecond * MaximumBudgetSeconds);
+        _budgetTime = now;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <semaphore>
+#include <thread>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    /*
+    * Spaces the packets a connection sends at a pacing bitrate, so that a burst is spread out rather than handed to the
+    * network at once, where it would fill the queue of the bottleneck link and delay every packet behind it.
+    *
+    * Packets are handed to the pacer's thread through a ring of fixed-size slots, one producer and one consumer, so the
+    * caller, usually the audio thread, neither takes a lock nor allocates, and never waits on the network: every packet is
+    * sent from the pacer's thread. The pacer has a byte budget that fills at the pacing bitrate, up to 40 ms worth, and that
+    * each packet sent spends. A packet is sent as soon as the thread wakes while the budget lasts, so an unpaced stream only
+    * sees the time to wake the thread. Otherwise it waits for the budget to refill, and packets are sent in order.
+    */
+    class Pacer {
+    public:
+        static constexpr std::size_t MaximumPacketSize = 1500; // The largest packet that can be sent.
+
+        /*
+        * Sends a packet. Called on the pacer's thread, in the order packets were given to the pacer.
+        */
+        using SendFunction = std::function<void(rtc::binary& packet)>;
+
+        /*
+        * Constructor. Starts the thread that sends packets.
+        *
+        * @param send Sends a packet.
+        * @param pacingBitrate The bitrate packets are spaced at, in bits per second.
+        */
+        Pacer(SendFunction send, int pacingBitrate);
+
+        /*
+        * Destructor. Stops the thread. Packets still queued are never sent.
+        */
+        ~Pacer();
+
+        Pacer(const Pacer&) = delete;
+        Pacer& operator=(const Pacer&) = delete;
+
+        /*
+        * Queues a copy of a packet to be sent. Called on one thread at a time. Never blocks or allocates. Once more than a
+        * few frames of packets are queued the oldest are dropped, as they would be too late to play.
+        *
+        * @return False if the packet was dropped, as it is larger than MaximumPacketSize or every slot is full.
+        */
+        bool Send(const rtc::binary& packet);
+
+        /*
+        * Sets the bitrate packets are spaced at. Any thread.
+        */
+        void SetPacingBitrate(int bitsPerSecond);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::size_t SlotCount = 8; // Packets that can be queued, more than are kept before the oldest are dropped.
+
+        /*
+        * A queued packet.
+        */
+        struct Slot {
+            std::size_t _size = 0; // The size of the packet.
+            std::array<std::byte, MaximumPacketSize> _data; // The packet.
+        };
+
+        /*
+        * Sends queued packets as the budget allows, until stopped.
+        */
+        void Run();
+
+        /*
+        * Fills the budget for the time since it was last filled. Pacer thread only.
+        */
+        void FillBudget(Clock::time_point now);
+
+        SendFunction _send; // Sends a packet.
+
+        std::atomic<double> _bytesPerSecond; // The pacing bitrate, in bytes.
+        double _budget = 0.0; // Bytes that can be sent now. Negative after a packet overspends it. Pacer thread only.
+        Clock::time_point _budgetTime; // When the budget was last filled. Pacer thread only.
+
+        std::array<Slot, SlotCount> _slots; // Queued packets, indexed by their count modulo SlotCount.
+        std::atomic<std::size_t> _written = 0; // Packets queued since the pacer started. Written by the sending thread.
+        std::atomic<std::size_t> _read = 0; // Packets sent or dropped since the pacer started. Written by the pacer thread.
+        std::counting_semaphore<> _queued{ 0 }; // Released once per packet queued, and when stopping, to wake the thread.
+        rtc::binary _packet; // The packet being sent, reserved at its largest size. Pacer thread only.
+
+        std::atomic<bool> _isStopping = false; // Set when the thread is stopping.
+        std::thread _thread; // Sends queued packets.
+    };
+}
@@ -0,0 +1,320 @@
+#include "packet_capture.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::chrono::seconds LossBurstWindow(1); // Losses this close together are one burst.
+    constexpr std::chrono::seconds LossTriggerInterval(10); // The least time between the writes of loss bursts.
+    constexpr std::uint16_t MaximumSequenceGap = 1000; // A jump further ahead than this is the peer restarting, not loss.
+
+    constexpr std::uint32_t PcapMagic = 0xa1b2c3d4; // Microsecond timestamps, in the writer's byte order.
+    constexpr std::uint32_t LinkTypeRaw = 101; // Packets start at their IP header.
+    constexpr std::size_t HeadersSize = 28; // A 20 byte IPv4 header and an 8 byte UDP header.
+    constexpr std::uint16_t Port = 5004; // The UDP port both ends are given, the usual one for RTP.
+
+    /*
+    * A packet recorded. The version makes the slot a seqlock: odd while a packet is being written, and 2 (n + 1) once the
+    * nth packet recorded has been, so that a reader copying it can tell if it was overwritten meanwhile.
+    */
+    struct CapturedPacket {
+        std::atomic<std::uint64_t> _version = 0; // The slot's version.
+        std::int64_t _time; // When the packet was sent or received, in microseconds since the Unix epoch.
+        std::uint32_t _connectionId; // The connection it was sent or received on.
+        std::uint32_t _size; // Its size in bytes.
+        bool _isSent; // Whether it was sent, rather than received.
+        std::array<std::byte, Comms::PacketCapture::SnapLength> _data; // Its first bytes.
+    };
+
+    /*
+    * A copy of a packet recorded, taken to write.
+    */
+    struct PacketCopy {
+        std::int64_t _time;
+        std::uint32_t _connectionId;
+        std::uint32_t _size;
+        bool _isSent;
+        std::array<std::byte, Comms::PacketCapture::SnapLength> _data;
+    };
+
+    std::atomic<bool> IsCapturing = false; // Whether packets are recorded.
+    std::atomic<std::uint64_t> WrittenCount = 0; // Packets ever recorded, each claiming the slot of its index.
+    std::atomic<std::uint64_t> EnabledCount = 0; // Packets recorded when capture was last enabled. Earlier ones are not written.
+    std::array<CapturedPacket, Comms::PacketCapture::RingCapacity> Ring; // The latest packets, the oldest overwritten first.
+
+    std::mutex TriggerMutex; // Taken to count losses and to set the trigger.
+    std::size_t TriggerLostCount = 0; // Packets lost within LossBurstWindow that make a burst, or 0. Requires TriggerMutex.
+    std::string TriggerPathPrefix; // Where bursts are written. Requires TriggerMutex.
+    Clock::time_point WindowStart; // When the current window of losses started. Requires TriggerMutex.
+    std::size_t WindowLostCount = 0; // Packets lost in it. Requires TriggerMutex.
+    std::optional<Clock::time_point> LastTriggerTime; // When a burst was last written, if one has been. Requires TriggerMutex.
+
+    std::atomic<std::uint32_t> NextConnectionId = 1; // The id of the next connection captured.
+
+    std::int64_t GetUnixMicroseconds() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /*
+    * @return The packets recorded since capture was enabled, without those overwritten while they were copied.
+    */
+    std::vector<PacketCopy> CopyPackets() {
+        const auto writtenCount = WrittenCount.load(std::memory_order_acquire);
+        const auto first = std::max(EnabledCount.load(), writtenCount > Ring.size() ? writtenCount - Ring.size() : 0);
+
+        std::vector<PacketCopy> packets;
+        packets.reserve(static_cast<std::size_t>(writtenCount - std::min(first, writtenCount)));
+
+        for (auto i = first; i < writtenCount; i++) {
+            const auto& slot = Ring[i % Ring.size()];
+            const auto version = slot._version.load(std::memory_order_acquire);
+
+            if (version != 2 * (i + 1)) {
+                continue; // Still being written, or already overwritten.
+            }
+
+            PacketCopy packet;
+            packet._time = slot._time;
+            packet._connectionId = slot._connectionId;
+            packet._size = slot._size;
+            packet._isSent = slot._isSent;
+            std::memcpy(packet._data.data(), slot._data.data(), std::min<std::size_t>(packet._size, packet._data.size()));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (slot._version.load(std::memory_order_relaxed) == version) {
+                packets.push_back(packet);
+            }
+        }
+
+        // Threads claim slots a moment before they read the clock, so neighbouring packets may be slightly out of order.
+        std::stable_sort(packets.begin(), packets.end(), [](const auto& first, const auto& second) { return first._time < second._time; });
+
+        return packets;
+    }
+
+    void WriteUint16(std::byte* data, std::uint16_t value) {
+        data[0] = static_cast<std::byte>(value >> 8);
+        data[1] = static_cast<std::byte>(value);
+    }
+
+    void WriteUint32(std::byte* data, std::uint32_t value) {
+        WriteUint16(data, static_cast<std::uint16_t>(value >> 16));
+        WriteUint16(data + 2, static_cast<std::uint16_t>(value));
+    }
+
+    /*
+    * Writes the IPv4 and UDP headers a packet is given in the capture.
+    *
+    * @param headers The HeadersSize bytes to write them to.
+    * @param packet The packet.
+    * @param id The IPv4 identification.
+    */
+    void WriteHeaders(std::byte* headers, const PacketCopy& packet, std::uint16_t id) {
+        const std::uint32_t localAddress = 0x0a000001; // 10.0.0.1
+        const std::uint32_t remoteAddress = 0x0a010000 | (packet._connectionId & 0xffff); // 10.1.x.y
+        const auto ipSize = static_cast<std::uint16_t>(std::min<std::size_t>(HeadersSize + packet._size, 0xffff));
+
+        std::memset(headers, 0, HeadersSize);
+        headers[0] = std::byte{ 0x45 }; // Version 4, a 5 word header.
+        WriteUint16(headers + 2, ipSize);
+        WriteUint16(headers + 4, id);
+        headers[6] = std::byte{ 0x40 }; // Don't fragment.
+        headers[8] = std::byte{ 64 }; // Time to live.
+        headers[9] = std::byte{ 17 }; // UDP.
+        WriteUint32(headers + 12, packet._isSent ? localAddress : remoteAddress);
+        WriteUint32(headers + 16, packet._isSent ? remoteAddress : localAddress);
+
+        std::uint32_t checksum = 0;
+
+        for (std::size_t i = 0; i < 20; i += 2) {
+            checksum += (std::to_integer<std::uint32_t>(headers[i]) << 8) | std::to_integer<std::uint32_t>(headers[i + 1]);
+        }
+
+        checksum = (checksum & 0xffff) + (checksum >> 16);
+        checksum += checksum >> 16;
+        WriteUint16(headers + 10, static_cast<std::uint16_t>(~checksum));
+
+        // The UDP checksum is left 0, which marks it as not computed.
+        WriteUint16(headers + 20, Port);
+        WriteUint16(headers + 22, Port);
+        WriteUint16(headers + 24, static_cast<std::uint16_t>(ipSize - 20));
+    }
+
+    template <typename T>
+    void WriteNative(std::ofstream& file, T value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
+
+namespace Comms {
+    void PacketCapture::SetEnabled(bool isEnabled) {
+        if (isEnabled) {
+            EnabledCount = WrittenCount.load();
+        }
+
+        IsCapturing.store(isEnabled, std::memory_order_relaxed);
+    }
+
+    bool PacketCapture::IsEnabled() {
+        return IsCapturing.load(std::memory_order_relaxed);
+    }
+
+    void PacketCapture::SetLossTrigger(std::size_t lostCount, const std::string& pathPrefix) {
+        std::lock_guard<std::mutex> lock(TriggerMutex);
+        TriggerLostCount = lostCount;
+        TriggerPathPrefix = pathPrefix;
+        WindowLostCount = 0;
+    }
+
+    void PacketCapture::Record(std::uint32_t connectionId, bool isSent, const std::byte* data, std::size_t size) {
+        if (!IsEnabled()) {
+            return;
+        }
+
+        const auto index = WrittenCount.fetch_add(1, std::memory_order_relaxed);
+        auto& slot = Ring[index % Ring.size()];
+
+        slot._version.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot._time = GetUnixMicroseconds();
+        slot._connectionId = connectionId;
+        slot._size = static_cast<std::uint32_t>(size);
+        slot._isSent = isSent;
+        std::memcpy(slot._data.data(), data, std::min(size, slot._data.size()));
+
+        slot._version.store(2 * (index + 1), std::memory_order_release);
+    }
+
+    void PacketCapture::OnPacketsLost(std::size_t count) {
+        if (!IsEnabled()) {
+            return;
+        }
+
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(TriggerMutex);
+
+            if (TriggerLostCount == 0) {
+                return;
+            }
+
+            const auto now = Clock::now();
+
+            if (now - WindowStart > LossBurstWindow) {
+                WindowStart = now;
+                WindowLostCount = 0;
+            }
+
+            WindowLostCount += count;
+
+            if (WindowLostCount < TriggerLostCount || (LastTriggerTime.has_value() && now - *LastTriggerTime < LossTriggerInterval)) {
+                return;
+            }
+
+            LastTriggerTime = now;
+            WindowLostCount = 0;
+            path = TriggerPathPrefix + "_" + std::to_string(GetUnixMicroseconds() / 1000) + ".pcap";
+        }
+
+        // Written off the receiving thread, which must not wait on the disk. The ring is static, so it outlives the thread.
+        std::thread([path]() { WritePcap(path); }).detach();
+    }
+
+    bool PacketCapture::WritePcap(const std::string& path) {
+        const auto packets = CopyPackets();
+        std::ofstream file(path, std::ios::binary);
+
+        if (!file) {
+            return false;
+        }
+
+        WriteNative<std::uint32_t>(file, PcapMagic);
+        WriteNative<std::uint16_t>(file, 2); // Version 2.4.
+        WriteNative<std::uint16_t>(file, 4);
+        WriteNative<std::int32_t>(file, 0); // Timestamps are UTC.
+        WriteNative<std::uint32_t>(file, 0);
+        WriteNative<std::uint32_t>(file, static_cast<std::uint32_t>(HeadersSize + SnapLength));
+        WriteNative<std::uint32_t>(file, LinkTypeRaw);
+
+        std::array<std::byte, HeadersSize> headers;
+
+        for (std::size_t i = 0; i < packets.size(); i++) {
+            const auto& packet = packets[i];
+            const auto capturedSize = std::min<std::size_t>(packet._size, SnapLength);
+
+            WriteNative<std::uint32_t>(file, static_cast<std::uint32_t>(packet._time / 1000000));
+            WriteNative<std::uint32_t>(file, static_cast<std::uint32_t>(packet._time % 1000000));
+            WriteNative<std::uint32_t>(file, static_cast<std::uint32_t>(HeadersSize + capturedSize));
+            WriteNative<std::uint32_t>(file, static_cast<std::uint32_t>(HeadersSize + packet._size));
+
+            WriteHeaders(headers.data(), packet, static_cast<std::uint16_t>(i));
+            file.write(reinterpret_cast<const char*>(headers.data()), headers.size());
+            file.write(reinterpret_cast<const char*>(packet._data.data()), static_cast<std::streamsize>(capturedSize));
+        }
+
+        return file.good();
+    }
+
+    PacketCaptureHandler::PacketCaptureHandler(std::shared_ptr<rtc::MediaHandler> next) :
+        _connectionId(NextConnectionId++),
+        _next(std::move(next)) {
+        if (_next) {
+            // The wrapped handler's own sends, e.g. of delayed packets, go out through this one's callback.
+            _next->onOutgoing([this](rtc::message_ptr message) { outgoingCallback(std::move(message)); });
+        }
+    }
+
+    PacketCaptureHandler::~PacketCaptureHandler() {
+        if (_next) {
+            _next->onOutgoing(nullptr);
+        }
+    }
+
+    rtc::message_ptr PacketCaptureHandler::incoming(rtc::message_ptr message) {
+        if (!PacketCapture::IsEnabled()) {
+            _nextSequenceNumber = -1; // Gaps are only counted between packets captured.
+        }
+        else if (message != nullptr && message->type != rtc::Message::Control) {
+            PacketCapture::Record(_connectionId, false, message->data(), message->size());
+
+            // RTCP packet types are 192 to 223, which no RTP payload type and marker bit make (RFC 5761).
+            const auto packetType = message->size() >= 4 ? std::to_integer<int>((*message)[1]) : 0;
+
+            if (message->size() >= 12 && (packetType < 192 || packetType > 223)) {
+                const auto sequenceNumber = static_cast<std::uint16_t>((std::to_integer<std::uint16_t>((*message)[2]) << 8) | std::to_integer<std::uint16_t>((*message)[3]));
+                const auto gap = static_cast<std::uint16_t>(sequenceNumber - _nextSequenceNumber);
+
+                // A packet behind the one expected is late or reordered, and was counted lost when the gap was seen.
+                if (_nextSequenceNumber < 0 || gap < 0x8000) {
+                    if (_nextSequenceNumber >= 0 && gap > 0 && gap <= MaximumSequenceGap) {
+                        PacketCapture::OnPacketsLost(gap);
+                    }
+
+                    _nextSequenceNumber = static_cast<std::uint16_t>(sequenceNumber + 1);
+                }
+            }
+        }
+
+        return _next ? _next->incoming(std::move(message)) : message;
+    }
+
+    rtc::message_ptr PacketCaptureHandler::outgoing(rtc::message_ptr message) {
+        if (message != nullptr && message->type != rtc::Message::Control) {
+            PacketCapture::Record(_connectionId, true, message->data(), message->size());
+        }
+
+        return _next ? _next->outgoing(std::move(message)) : message;
+    }
+}
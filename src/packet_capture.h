@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    /*
+    * Records the RTP and RTCP packets every connection sends and receives, so that an audio problem in the field can be
+    * diagnosed from the packets themselves. Written out as a pcap file, which Wireshark opens.
+    *
+    * Packets are recorded by a PacketCaptureHandler on each connection's media track, so received packets are seen once
+    * SRTP has decrypted them and sent packets before it encrypts them. Every thread records into one fixed ring of the
+    * latest RingCapacity packets without locks or allocation: a packet costs a clock read, an atomic add to claim its slot,
+    * and a copy of its first SnapLength bytes. While capture is off, it costs a relaxed load.
+    *
+    * The file is written on demand, or when a loss burst is seen, to keep the packets around it. As only the RTP and RTCP
+    * are captured, each packet is given made up IPv4 and UDP headers: this end is 10.0.0.1 and the peer of connection n is
+    * 10.1.x.y with n = 256x + y, both on port 5004. Wireshark decodes them as RTP with Decode As, or with its rtp_udp
+    * heuristic enabled.
+    */
+    class PacketCapture {
+    public:
+        static constexpr std::size_t RingCapacity = 4096; // Packets kept. About 40 s of a call with one peer.
+        static constexpr std::size_t SnapLength = 512; // Bytes kept of each packet. Longer packets are truncated.
+
+        /*
+        * Turns capture on or off. Turning it on discards the packets recorded before.
+        */
+        static void SetEnabled(bool isEnabled);
+
+        /*
+        * @return Whether capture is on.
+        */
+        static bool IsEnabled();
+
+        /*
+        * Sets the capture to be written whenever lostCount packets, or more, are lost within a second of each other. Writes
+        * are at least 10 s apart, so that a long burst is written once, and are made on a thread of their own.
+        *
+        * @param lostCount The packets lost that make a burst, or 0 to write on no burst.
+        * @param pathPrefix Each file is written to this path followed by the time of the burst, e.g. capture_1700000000123.pcap.
+        */
+        static void SetLossTrigger(std::size_t lostCount, const std::string& pathPrefix);
+
+        /*
+        * Records a packet. Does nothing while capture is off. Any thread.
+        *
+        * @param connectionId The connection it was sent or received on. @see PacketCaptureHandler
+        * @param isSent Whether it was sent, rather than received.
+        * @param data The packet, from its RTP or RTCP header.
+        * @param size Its size in bytes.
+        */
+        static void Record(std::uint32_t connectionId, bool isSent, const std::byte* data, std::size_t size);
+
+        /*
+        * Counts packets lost, writing the capture if they complete a burst. @see SetLossTrigger
+        */
+        static void OnPacketsLost(std::size_t count);
+
+        /*
+        * Writes the packets recorded since capture was enabled to a pcap file, oldest first.
+        *
+        * @return False if the file cannot be written.
+        */
+        static bool WritePcap(const std::string& path);
+    };
+
+    /*
+    * The media handler that records a track's packets in the PacketCapture, and counts the gaps in the RTP sequence
+    * numbers it receives as losses, to trigger it. Passes packets on unchanged to the handler it wraps, if any, so that it
+    * can sit in front of another, e.g. a NetworkImpairment: sent packets are recorded before they are impaired.
+    */
+    class PacketCaptureHandler : public rtc::MediaHandler {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param next The handler packets are passed on to, or null.
+        */
+        PacketCaptureHandler(std::shared_ptr<rtc::MediaHandler> next = nullptr);
+
+        /*
+        * Destructor. Clears the wrapped handler's outgoing callback, waiting for a packet it is sending through this one.
+        */
+        ~PacketCaptureHandler();
+
+        PacketCaptureHandler(const PacketCaptureHandler&) = delete;
+        PacketCaptureHandler& operator=(const PacketCaptureHandler&) = delete;
+
+        rtc::message_ptr incoming(rtc::message_ptr message) override;
+        rtc::message_ptr outgoing(rtc::message_ptr message) override;
+
+    private:
+        const std::uint32_t _connectionId; // Identifies the connection's packets in the capture.
+        const std::shared_ptr<rtc::MediaHandler> _next; // The handler packets are passed on to, or null.
+        std::int32_t _nextSequenceNumber = -1; // The RTP sequence number expected next, or -1 before the first. Receiving thread only.
+    };
+}
@@ -0,0 +1,140 @@
+#include "persistent_http_client.h"
+
+#include <unordered_map>
+
+namespace {
+    constexpr time_t KeepAliveReadTimeoutSeconds = 30;
+
+    /*
+    * @return The OpenSSL ex_data index used to associate an SSL_CTX with the PersistentHttpClient that owns it.
+    */
+    int ClientDataIndex() {
+        static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+
+    /*
+    * @return The OpenSSL ex_data index used to mark a connection whose initial handshake is in progress.
+    */
+    int HandshakePendingIndex() {
+        static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+    }
+}
+
+namespace Comms {
+    std::shared_ptr<PersistentHttpClient> PersistentHttpClient::ForURL(const std::string& url) {
+        static std::unordered_map<std::string, std::shared_ptr<PersistentHttpClient>> clients;
+        static std::mutex clientsMutex;
+
+        std::lock_guard<std::mutex> lock(clientsMutex);
+
+        auto& client = clients[url];
+
+        if (client == nullptr) {
+            client = std::make_shared<PersistentHttpClient>(url);
+        }
+
+        return client;
+    }
+
+    PersistentHttpClient::PersistentHttpClient(std::string url, bool keepAlive) :
+        _httpClient(url),
+        _session(nullptr, SSL_SESSION_free) {
+        _httpClient.set_keep_alive(keepAlive);
+        _httpClient.set_tcp_nodelay(true); // Request headers and body are written separately, which Nagle's algorithm would hold back.
+        _httpClient.set_read_timeout(KeepAliveReadTimeoutSeconds, 0);
+
+        if (SSL_CTX* context = _httpClient.ssl_context()) {
+            // Sessions are stored by this client rather than OpenSSL's internal cache, which is not consulted by clients.
+            SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_set_ex_data(context, ClientDataIndex(), this);
+            SSL_CTX_sess_set_new_cb(context, OnNewSession);
+            SSL_CTX_set_info_callback(context, OnHandshakeInfo);
+        }
+    }
+
+    PersistentHttpClient::~PersistentHttpClient() {
+        _httpClient.stop();
+
+        if (SSL_CTX* context = _httpClient.ssl_context()) {
+            SSL_CTX_set_ex_data(context, ClientDataIndex(), nullptr);
+        }
+    }
+
+    httplib::Result PersistentHttpClient::Get(const std::string& path, const httplib::Params& params, const httplib::Headers& headers) {
+        return _httpClient.Get(path, params, headers);
+    }
+
+    httplib::Result PersistentHttpClient::Post(const std::string& path, const std::string& body, const std::string& contentType, const httplib::Headers& headers) {
+        return _httpClient.Post(path, headers, body, contentType);
+    }
+
+    void PersistentHttpClient::SetTimeouts(std::chrono::milliseconds connectionTimeout, std::chrono::milliseconds readTimeout) {
+        _httpClient.set_connection_timeout(connectionTimeout);
+        _httpClient.set_read_timeout(readTimeout);
+    }
+
+    void PersistentHttpClient::DisableCertificateVerification() {
+        _httpClient.enable_server_certificate_verification(false);
+    }
+
+    std::size_t PersistentHttpClient::GetFullHandshakeCount() const {
+        return _fullHandshakeCount.load();
+    }
+
+    std::size_t PersistentHttpClient::GetResumedHandshakeCount() const {
+        return _resumedHandshakeCount.load();
+    }
+
+    int PersistentHttpClient::OnNewSession(SSL* ssl, SSL_SESSION* session) {
+        auto client = FromSSL(ssl);
+
+        if (client == nullptr) {
+            return 0; // OpenSSL keeps ownership and frees the session.
+        }
+
+        std::lock_guard<std::mutex> lock(client->_sessionMutex);
+        client->_session.reset(session);
+
+        return 1;
+    }
+
+    void PersistentHttpClient::OnHandshakeInfo(const SSL* ssl, int where, [[maybe_unused]] int result) {
+        auto client = FromSSL(ssl);
+
+        if (client == nullptr) {
+            return;
+        }
+
+        // TLS 1.3 also reports post-handshake exchanges such as session tickets as handshakes,
+        // so only the handshake that starts from the initial state is acted on.
+        auto mutableSSL = const_cast<SSL*>(ssl);
+
+        if ((where & SSL_CB_HANDSHAKE_START) && SSL_in_before(ssl)) {
+            // cpp-httplib gives no hook between creating the SSL object and connecting,
+            // so the stored session is offered here, before the ClientHello is written.
+            std::lock_guard<std::mutex> lock(client->_sessionMutex);
+
+            if (client->_session != nullptr) {
+                SSL_set_session(mutableSSL, client->_session.get());
+            }
+
+            SSL_set_ex_data(mutableSSL, HandshakePendingIndex(), client);
+        }
+        else if ((where & SSL_CB_HANDSHAKE_DONE) && SSL_get_ex_data(ssl, HandshakePendingIndex()) != nullptr) {
+            SSL_set_ex_data(mutableSSL, HandshakePendingIndex(), nullptr);
+
+            if (SSL_session_reused(ssl)) {
+                client->_resumedHandshakeCount++;
+            }
+            else {
+                client->_fullHandshakeCount++;
+            }
+        }
+    }
+
+    PersistentHttpClient* PersistentHttpClient::FromSSL(const SSL* ssl) {
+        return static_cast<PersistentHttpClient*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ClientDataIndex()));
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "cpp-httplib/httplib.h"
+
+namespace Comms {
+
+    /*
+    * A long lived HTTP(S) client that reuses its connection across requests.
+    * The connection is kept alive between requests so that repeated calls, such as polling, do not pay a fresh TCP and TLS handshake.
+    * When the server closes the connection, the TLS session ticket from the previous connection is offered on the next handshake
+    * so the session is resumed rather than renegotiated.
+    *
+    * Requests are serialised by the underlying client, so a single instance can be shared between threads.
+    * HTTP functionality is provided by the cpp-httplib library and TLS by OpenSSL.
+    */
+    class PersistentHttpClient {
+    public:
+        /*
+        * Returns the process wide client for a service, creating it on first use.
+        * All callers using the same base URL share one connection.
+        *
+        * @param url The base URL of the service, including the scheme.
+        * @return The shared client.
+        */
+        static std::shared_ptr<PersistentHttpClient> ForURL(const std::string& url);
+
+        /*
+        * Constructor.
+        *
+        * @param url The base URL of the service, including the scheme.
+        * @param keepAlive Whether to keep the connection open between requests.
+        */
+        PersistentHttpClient(std::string url, bool keepAlive = true);
+
+        /*
+        * Destructor. Releases any stored TLS session.
+        */
+        ~PersistentHttpClient();
+
+        PersistentHttpClient(const PersistentHttpClient&) = delete;
+        PersistentHttpClient& operator=(const PersistentHttpClient&) = delete;
+
+        /*
+        * Sends a GET request.
+        *
+        * @param path The path of the resource.
+        * @param params Query parameters.
+        * @param headers Additional request headers.
+        * @return The result of the request.
+        */
+        httplib::Result Get(const std::string& path, const httplib::Params& params, const httplib::Headers& headers = {});
+
+        /*
+        * Sends a POST request.
+        *
+        * @param path The path of the resource.
+        * @param body The request body.
+        * @param contentType The MIME type of the body.
+        * @param headers Additional request headers.
+        * @return The result of the request.
+        */
+        httplib::Result Post(const std::string& path, const std::string& body, const std::string& contentType, const httplib::Headers& headers = {});
+
+        /*
+        * Sets how long to wait for a connection to be established and for a response to be read.
+        * Lower than the defaults for callers that must notice an unresponsive server quickly.
+        */
+        void SetTimeouts(std::chrono::milliseconds connectionTimeout, std::chrono::milliseconds readTimeout);
+
+        /*
+        * Disables verification of the server's certificate.
+        * Only intended for local stand-in servers using self-signed certificates.
+        */
+        void DisableCertificateVerification();
+
+        /*
+        * @return The number of TLS handshakes that negotiated a new session.
+        */
+        std::size_t GetFullHandshakeCount() const;
+
+        /*
+        * @return The number of TLS handshakes that resumed a previous session.
+        */
+        std::size_t GetResumedHandshakeCount() const;
+
+    private:
+        /*
+        * OpenSSL callback invoked when the server issues a session ticket.
+        * The most recent session is kept so that it can be offered on the next connection.
+        *
+        * @return 1 as ownership of the session is taken.
+        */
+        static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+
+        /*
+        * OpenSSL callback invoked as a handshake progresses.
+        * Offers the stored session when a handshake starts, and counts whether it was resumed when the handshake completes.
+        */
+        static void OnHandshakeInfo(const SSL* ssl, int where, int result);
+
+        /*
+        * @return The client that owns a TLS connection.
+        */
+        static PersistentHttpClient* FromSSL(const SSL* ssl);
+
+        httplib::Client _httpClient; // The underlying client. Holds the open connection between requests.
+
+        std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> _session; // The most recent TLS session issued by the server.
+        std::mutex _sessionMutex; // Mutex to control read and write access to _session.
+
+        std::atomic<std::size_t> _fullHandshakeCount = 0; // Number of handshakes that negotiated a new session.
+        std::atomic<std::size_t> _resumedHandshakeCount = 0; // Number of handshakes that resumed a session.
+    };
+}
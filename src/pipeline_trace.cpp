@@ -0,0 +1,376 @@
+#include "pipeline_trace.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "allocation_tracker.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Events each thread keeps. At the audio thread's rate of a few events per peer every 20 ms, minutes of a call.
+    constexpr std::size_t RingCapacity = 16384;
+
+    // Rings kept ready for real-time threads while tracing is on: a capture and a playback device's, and both again once reopened.
+    constexpr std::size_t ReservedRingCount = 4;
+
+    // Events of the same packet further apart than this are of different packets, once its sequence number has wrapped.
+    constexpr std::int64_t FlowGapMicroseconds = 10000000;
+
+    /*
+    * One stage that ran.
+    */
+    struct TraceEvent {
+        std::int64_t _start; // When the stage started, in microseconds on the trace's clock.
+        std::int32_t _duration; // How long it ran, in microseconds.
+        std::int32_t _sequenceNumber; // The packet it handled, or NoSequenceNumber.
+        std::uint32_t _connectionId; // The connection the packet was sent or received on, or NoConnectionId.
+        Comms::TraceStage _stage; // The stage.
+    };
+
+    /*
+    * The latest events of one thread. Written only by that thread, and read by any while it writes.
+    */
+    struct TraceRing {
+        std::array<TraceEvent, RingCapacity> _events; // The events, the oldest overwritten first.
+        std::atomic<std::uint64_t> _writtenCount = 0; // Events ever written. Published after each event is.
+        std::atomic<std::uint64_t> _firstCount = 0; // The count the thread using the ring started at. Earlier events were another's.
+        std::atomic<const char*> _threadName = nullptr; // The thread's name in the trace, set when the thread takes the ring.
+        std::uint32_t _threadId = 0; // The thread's id in the trace.
+    };
+
+    const Clock::time_point Epoch = Clock::now(); // The origin of the trace's clock.
+
+    std::atomic<bool> IsTracing = false; // Whether events are recorded.
+    std::atomic<std::int64_t> EnabledTime = 0; // When tracing was last enabled. Older events are not written.
+
+    std::atomic<std::uint32_t> NextConnectionId = 1; // The id the next connection is tagged with.
+
+    std::mutex RingsMutex; // Taken when a ring is made, and when the trace is written.
+    std::vector<std::shared_ptr<TraceRing>> Rings; // Every ring ever made. Requires RingsMutex.
+    std::vector<TraceRing*> FreeRings; // Rings of threads that have exited, taken before another is made. Requires RingsMutex.
+    std::array<std::atomic<TraceRing*>, ReservedRingCount> ReservedRings{}; // Rings no real-time thread has taken yet, or null.
+
+    /*
+    * A thread's ring, freed for another thread when the thread exits.
+    */
+    struct ThreadRingOwner {
+        TraceRing* _ring = nullptr; // The thread's ring, once it has recorded an event.
+
+        ~ThreadRingOwner() {
+            if (_ring != nullptr) {
+                std::lock_guard<std::mutex> lock(RingsMutex);
+                FreeRings.push_back(_ring);
+            }
+        }
+    };
+
+    thread_local const char* ThreadName = nullptr; // The calling thread's name, if it was given one.
+    thread_local ThreadRingOwner ThreadRing; // The calling thread's ring.
+
+    const char* GetStageName(Comms::TraceStage stage) {
+        switch (stage) {
+            case Comms::TraceStage::Capture: return "capture";
+            case Comms::TraceStage::Encode: return "encode";
+            case Comms::TraceStage::Packetize: return "packetize";
+            case Comms::TraceStage::Pace: return "pace";
+            case Comms::TraceStage::Receive: return "receive";
+            case Comms::TraceStage::JitterBufferPush: return "jitter_buffer_push";
+            case Comms::TraceStage::JitterBufferPop: return "jitter_buffer_pop";
+            case Comms::TraceStage::Decode: return "decode";
+            case Comms::TraceStage::Conceal: return "conceal";
+            case Comms::TraceStage::Playback: return "playback";
+        }
+
+        return "unknown";
+    }
+
+    /*
+    * @return Whether a stage handles packets being sent, rather than received, so that its flow is the sending one.
+    */
+    bool IsSendingStage(Comms::TraceStage stage) {
+        return stage == Comms::TraceStage::Encode || stage == Comms::TraceStage::Packetize || stage == Comms::TraceStage::Pace;
+    }
+
+    /*
+    * Takes the ring of a thread that has exited, dropping its events, or makes a ring and keeps it for the trace.
+    * Requires RingsMutex.
+    */
+    TraceRing* MakeRing() {
+        if (!FreeRings.empty()) {
+            auto* ring = FreeRings.back();
+            FreeRings.pop_back();
+            ring->_threadName.store(nullptr, std::memory_order_relaxed);
+            ring->_firstCount.store(ring->_writtenCount.load(std::memory_order_relaxed), std::memory_order_release);
+
+            return ring;
+        }
+
+        auto ring = std::make_shared<TraceRing>();
+
+        ring->_threadId = static_cast<std::uint32_t>(Rings.size() + 1);
+        Rings.push_back(ring);
+
+        return ring.get();
+    }
+
+    /*
+    * Fills the reserved rings that real-time threads have taken.
+    */
+    void ReserveRings() {
+        std::lock_guard<std::mutex> lock(RingsMutex);
+
+        for (auto& reserved : ReservedRings) {
+            if (reserved.load(std::memory_order_relaxed) == nullptr) {
+                reserved.store(MakeRing(), std::memory_order_release);
+            }
+        }
+    }
+
+    TraceRing& GetThreadRing() {
+        auto*& ring = ThreadRing._ring;
+
+        if (ring == nullptr) {
+            // A real-time thread takes a reserved ring, without allocating or locking, unless they have all been taken.
+            if (Comms::AllocationTracker::IsRealTimeThread()) {
+                for (std::size_t i = 0; i < ReservedRings.size() && ring == nullptr; i++) {
+                    ring = ReservedRings[i].exchange(nullptr, std::memory_order_acquire);
+                }
+            }
+
+            if (ring == nullptr) {
+                std::lock_guard<std::mutex> lock(RingsMutex);
+                ring = MakeRing();
+            }
+
+            ring->_threadName.store(ThreadName, std::memory_order_release);
+        }
+
+        return *ring;
+    }
+
+    /*
+    * @return The events a ring holds, oldest first, without those overwritten while they were copied.
+    */
+    std::vector<TraceEvent> CopyEvents(const TraceRing& ring) {
+        const auto writtenCount = ring._writtenCount.load(std::memory_order_acquire);
+        auto first = std::max(writtenCount > RingCapacity ? writtenCount - RingCapacity : 0, ring._firstCount.load(std::memory_order_acquire));
+
+        std::vector<TraceEvent> events;
+        events.reserve(static_cast<std::size_t>(writtenCount - first));
+
+        for (auto i = first; i < writtenCount; i++) {
+            events.push_back(ring._events[i % RingCapacity]);
+        }
+
+        // The thread may have carried on writing, over the oldest events copied and the one after those it has published.
+        const auto laterCount = ring._writtenCount.load(std::memory_order_acquire);
+        const auto overwritten = laterCount + 1 > RingCapacity ? laterCount + 1 - RingCapacity : 0;
+
+        if (overwritten > first) {
+            events.erase(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(std::min(overwritten - first, writtenCount - first)));
+        }
+
+        return events;
+    }
+}
+
+namespace Comms {
+    void PipelineTrace::SetEnabled(bool isEnabled) {
+        if (isEnabled) {
+            EnabledTime = Now();
+            ReserveRings(); // Before any real-time thread can record its first event.
+        }
+
+        IsTracing.store(isEnabled, std::memory_order_relaxed);
+    }
+
+    void PipelineTrace::ReserveThreadRings() {
+        if (IsEnabled()) {
+            ReserveRings();
+        }
+    }
+
+    std::uint32_t PipelineTrace::NewConnectionId() {
+        return NextConnectionId++;
+    }
+
+    bool PipelineTrace::IsEnabled() {
+        return IsTracing.load(std::memory_order_relaxed);
+    }
+
+    void PipelineTrace::NameThread(const char* name) {
+        ThreadName = name;
+    }
+
+    std::int64_t PipelineTrace::Now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - Epoch).count();
+    }
+
+    void PipelineTrace::Record(TraceStage stage, std::int64_t start, std::int64_t end, std::int32_t sequenceNumber, std::uint32_t connectionId) {
+        if (!IsEnabled()) {
+            return;
+        }
+
+        auto& ring = GetThreadRing();
+        const auto writtenCount = ring._writtenCount.load(std::memory_order_relaxed);
+
+        ring._events[writtenCount % RingCapacity] = { start, static_cast<std::int32_t>(end - start), sequenceNumber, connectionId, stage };
+        ring._writtenCount.store(writtenCount + 1, std::memory_order_release);
+    }
+
+    nlohmann::json PipelineTrace::ToChromeTrace() {
+        std::vector<std::shared_ptr<TraceRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(RingsMutex);
+            rings = Rings;
+        }
+
+        const auto enabledTime = EnabledTime.load();
+        std::vector<std::pair<std::uint32_t, TraceEvent>> events; // Each event with its thread's id.
+        nlohmann::json traceEvents = nlohmann::json::array();
+
+        for (const auto& ring : rings) {
+            const auto* threadName = ring->_threadName.load(std::memory_order_acquire);
+
+            for (const auto& event : CopyEvents(*ring)) {
+                if (event._start >= enabledTime) {
+                    events.emplace_back(ring->_threadId, event);
+                }
+            }
+
+            // A ring with no events since its thread took it, e.g. one reserved that no thread has taken yet, is left out.
+            if (ring->_writtenCount.load(std::memory_order_acquire) > ring->_firstCount.load(std::memory_order_acquire)) {
+                traceEvents.push_back({
+                    {"ph", "M"},
+                    {"name", "thread_name"},
+                    {"pid", 1},
+                    {"tid", ring->_threadId},
+                    {"args", {{"name", threadName != nullptr ? std::string(threadName) : "Thread " + std::to_string(ring->_threadId)}}}
+                });
+            }
+        }
+
+        // Stages that start together are ordered outermost first, as a stage nested in another ends first and is recorded first.
+        std::stable_sort(events.begin(), events.end(), [](const auto& first, const auto& second) {
+            return first.second._start != second.second._start ? first.second._start < second.second._start : first.second._duration > second.second._duration;
+        });
+
+        // Chains the events of each packet, sending and receiving apart, into flows. Each event gets its flow's id.
+        std::map<std::tuple<bool, std::uint32_t, std::int32_t>, std::size_t> openFlows; // The latest flow of each packet of each connection.
+        std::vector<std::int64_t> flowEnds; // When each flow's latest event started.
+        std::vector<std::size_t> flowSizes; // The events in each flow.
+        std::vector<std::size_t> eventFlows(events.size());
+
+        for (std::size_t i = 0; i < events.size(); i++) {
+            const auto& event = events[i].second;
+
+            if (event._sequenceNumber == NoSequenceNumber) {
+                continue;
+            }
+
+            const auto key = std::make_tuple(IsSendingStage(event._stage), event._connectionId, event._sequenceNumber);
+            auto flow = openFlows.find(key);
+
+            if (flow == openFlows.end() || event._start - flowEnds[flow->second] > FlowGapMicroseconds) {
+                flow = openFlows.insert_or_assign(key, flowEnds.size()).first;
+                flowEnds.push_back(0);
+                flowSizes.push_back(0);
+            }
+
+            eventFlows[i] = flow->second;
+            flowEnds[flow->second] = event._start;
+            flowSizes[flow->second]++;
+        }
+
+        std::vector<std::size_t> flowPositions(flowSizes.size(), 0); // The events of each flow written so far.
+
+        for (std::size_t i = 0; i < events.size(); i++) {
+            const auto& [threadId, event] = events[i];
+            nlohmann::json traceEvent = {
+                {"ph", "X"},
+                {"name", GetStageName(event._stage)},
+                {"cat", "audio"},
+                {"pid", 1},
+                {"tid", threadId},
+                {"ts", event._start},
+                {"dur", event._duration}
+            };
+
+            if (event._sequenceNumber == NoSequenceNumber) {
+                traceEvents.push_back(std::move(traceEvent));
+                continue;
+            }
+
+            traceEvent["args"] = { {"seq", event._sequenceNumber}, {"connection", event._connectionId} };
+            traceEvents.push_back(std::move(traceEvent));
+
+            const auto flow = eventFlows[i];
+            const auto position = flowPositions[flow]++;
+
+            if (flowSizes[flow] < 2) {
+                continue;
+            }
+
+            // Each step binds to the event it starts within, so the arrows join the stages of the packet in order.
+            nlohmann::json flowEvent = {
+                {"ph", position == 0 ? "s" : position + 1 == flowSizes[flow] ? "f" : "t"},
+                {"name", IsSendingStage(event._stage) ? "sent packet" : "received packet"},
+                {"cat", "packet"},
+                {"id", flow},
+                {"pid", 1},
+                {"tid", threadId},
+                {"ts", event._start}
+            };
+
+            if (position + 1 == flowSizes[flow]) {
+                flowEvent["bp"] = "e";
+            }
+
+            traceEvents.push_back(std::move(flowEvent));
+        }
+
+        return {
+            {"traceEvents", traceEvents},
+            {"displayTimeUnit", "ms"}
+        };
+    }
+
+    bool PipelineTrace::WriteChromeTrace(const std::string& path) {
+        std::ofstream file(path);
+
+        if (!file) {
+            return false;
+        }
+
+        file << ToChromeTrace().dump();
+
+        return file.good();
+    }
+
+    TraceSpan::TraceSpan(TraceStage stage, std::int32_t sequenceNumber, std::uint32_t connectionId) :
+        _stage(stage),
+        _start(PipelineTrace::IsEnabled() ? PipelineTrace::Now() : -1),
+        _sequenceNumber(sequenceNumber),
+        _connectionId(connectionId) {
+    }
+
+    TraceSpan::~TraceSpan() {
+        if (_start >= 0) {
+            PipelineTrace::Record(_stage, _start, PipelineTrace::Now(), _sequenceNumber, _connectionId);
+        }
+    }
+
+    void TraceSpan::SetSequenceNumber(std::uint16_t sequenceNumber) {
+        _sequenceNumber = sequenceNumber;
+    }
+}
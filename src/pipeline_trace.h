@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "json/json.hpp"
+
+namespace Comms {
+
+    /*
+    * A stage of the audio pipeline, from the microphone of one end of a call to the speaker of the other.
+    */
+    enum class TraceStage : std::uint8_t {
+        Capture, // A device period of captured audio written to the microphone queue.
+        Encode, // A frame encoded, tagged with the sequence number it was sent to the first peer with.
+        Packetize, // An encoded frame wrapped in RTP and handed to a connection's pacer.
+        Pace, // A packet leaving the pacer for the media track.
+        Receive, // A packet received from the media track.
+        JitterBufferPush, // A received packet stored in the jitter buffer.
+        JitterBufferPop, // A packet taken from the jitter buffer to be decoded.
+        Decode, // A packet decoded.
+        Conceal, // A lost packet concealed by the decoder.
+        Playback // A device period of audio to play read from the speaker queue.
+    };
+
+    /*
+    * Records when each stage of the audio pipeline ran, so that a glitch can be traced to the stage that was late. Written
+    * out as Chrome trace-event JSON, which Perfetto and chrome://tracing open.
+    *
+    * Each thread records into its own ring of the latest events, written without locks or allocation once the ring exists:
+    * a trace point costs a clock read and a few stores, and nothing but a relaxed load while tracing is off. A real-time
+    * thread, such as an audio device's, takes a ring reserved for it while tracing is on, so that even its first event
+    * neither allocates nor locks. Events tagged with an RTP sequence number and the connection it was sent or received on
+    * are linked by flow arrows, one chain for a packet being sent and one for it being received, so a single packet's
+    * journey can be followed through the stages, with each connection's packets apart from the others'. The ring of a
+    * thread that exits is taken by the next thread to need one, so rings are only ever made for threads running at once.
+    *
+    * Tracing is off until enabled, and can be turned on and off while a call runs. Only events recorded since it was last
+    * enabled are written.
+    */
+    class PipelineTrace {
+    public:
+        static constexpr std::int32_t NoSequenceNumber = -1; // Tags an event that is not about one packet.
+        static constexpr std::uint32_t NoConnectionId = 0; // Tags an event that is not about one connection's packet.
+
+        /*
+        * Turns tracing on or off. Turning it on discards the events recorded before, and reserves rings for real-time threads.
+        * @see ReserveThreadRings
+        */
+        static void SetEnabled(bool isEnabled);
+
+        /*
+        * @return Whether tracing is on.
+        */
+        static bool IsEnabled();
+
+        /*
+        * Names the calling thread in the trace. Takes effect if called before the thread's first event is recorded.
+        *
+        * @param name The name, which must outlive the thread, e.g. a string literal.
+        */
+        static void NameThread(const char* name);
+
+        /*
+        * Makes rings ready, while tracing is on, for real-time threads that have none yet to take on their first event.
+        * Called off the real-time path before devices are started, as a device's thread is not created by us.
+        */
+        static void ReserveThreadRings();
+
+        /*
+        * @return A new id to tag a connection's events with, so that its packets are told apart from those of another
+        *         connection with the same sequence numbers.
+        */
+        static std::uint32_t NewConnectionId();
+
+        /*
+        * @return The time on the trace's clock, in microseconds.
+        */
+        static std::int64_t Now();
+
+        /*
+        * Records a stage that ran on the calling thread. Does nothing while tracing is off.
+        *
+        * @param stage The stage.
+        * @param start When the stage started. @see Now
+        * @param end When the stage ended.
+        * @param sequenceNumber The RTP sequence number of the packet the stage handled, or NoSequenceNumber.
+        * @param connectionId The connection the packet was sent or received on, or NoConnectionId. @see NewConnectionId
+        */
+        static void Record(TraceStage stage, std::int64_t start, std::int64_t end, std::int32_t sequenceNumber = NoSequenceNumber,
+            std::uint32_t connectionId = NoConnectionId);
+
+        /*
+        * @return Every thread's events since tracing was enabled, as a Chrome trace-event JSON object.
+        */
+        static nlohmann::json ToChromeTrace();
+
+        /*
+        * Writes the trace to a file. @see ToChromeTrace
+        *
+        * @return False if the file cannot be written.
+        */
+        static bool WriteChromeTrace(const std::string& path);
+    };
+
+    /*
+    * Records a stage from its construction to its destruction, on the constructing thread.
+    */
+    class TraceSpan {
+    public:
+        /*
+        * Constructor. Starts timing the stage, if tracing is on.
+        *
+        * @param stage The stage.
+        * @param sequenceNumber The RTP sequence number of the packet the stage handles, if it is already known.
+        * @param connectionId The connection the packet is sent or received on.
+        */
+        TraceSpan(TraceStage stage, std::int32_t sequenceNumber = PipelineTrace::NoSequenceNumber,
+            std::uint32_t connectionId = PipelineTrace::NoConnectionId);
+
+        /*
+        * Destructor. Records the stage.
+        */
+        ~TraceSpan();
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        /*
+        * Tags the stage with the packet it handled, once that is known.
+        */
+        void SetSequenceNumber(std::uint16_t sequenceNumber);
+
+    private:
+        const TraceStage _stage; // The stage.
+        const std::int64_t _start; // When the stage started, or -1 if tracing was off.
+        std::int32_t _sequenceNumber; // The RTP sequence number of the packet the stage handled, or NoSequenceNumber.
+        const std::uint32_t _connectionId; // The connection the packet is sent or received on, or NoConnectionId.
+    };
+}
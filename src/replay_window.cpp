@@ -0,0 +1,31 @@
+#include "replay_window.h"
+
+#include <chrono>
+
+namespace Comms {
+    std::uint64_t ReplayWindow::GetInitialCounter() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    bool ReplayWindow::Accept(std::uint64_t counter) {
+        if (counter > _highest) {
+            const auto advance = counter - _highest;
+
+            _seen = advance < Size ? _seen << advance : std::bitset<Size>();
+            _seen.set(0);
+            _highest = counter;
+
+            return true;
+        }
+
+        const auto behind = _highest - counter;
+
+        if (behind >= Size || _seen.test(behind)) {
+            return false;
+        }
+
+        _seen.set(behind);
+
+        return true;
+    }
+}
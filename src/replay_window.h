@@ -0,0 +1,41 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace Comms {
+
+    /*
+    * Rejects the messages of one sender that have been seen before, so that a signed message captured on the network
+    * cannot be replayed while its signature is still valid.
+    *
+    * The sender numbers its messages with a counter it increments for each one, and signs the counter with the message.
+    * Messages may arrive out of order, so the window remembers which of the latest Size counters have been seen. A counter
+    * further behind the highest seen than that is rejected, as it can no longer be told whether it was.
+    *
+    * Not thread safe.
+    */
+    class ReplayWindow {
+    public:
+        static constexpr std::size_t Size = 1024; // Counters remembered behind the highest seen.
+
+        /*
+        * @return The counter a sender numbers its first message with: the time in microseconds since the epoch, so that a
+        *         sender that restarts carries on above the counters it sent before, provided it sent fewer than a million
+        *         messages a second and its clock has not gone back.
+        */
+        static std::uint64_t GetInitialCounter();
+
+        /*
+        * Records a message's counter. Only called once the message's signature has been verified.
+        *
+        * @return False if the counter has been seen before, or is too far behind the highest seen.
+        */
+        bool Accept(std::uint64_t counter);
+
+    private:
+        std::uint64_t _highest = 0; // The highest counter seen.
+        std::bitset<Size> _seen; // Whether each counter behind _highest has been seen, by how far behind it is.
+    };
+}
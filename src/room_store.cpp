@@ -0,0 +1,165 @@
+#include "room_store.h"
+
+#include <algorithm>
+
+#include <openssl/sha.h>
+
+namespace Comms {
+    RoomStore::RoomStore(std::size_t shardCount, std::chrono::seconds timeToLive) :
+        _rooms(shardCount),
+        _timeToLive(timeToLive) {
+    }
+
+    bool RoomStore::PublishOffer(const std::string& connectionName, const std::string& password, const std::string& offer) {
+        const auto passwordHash = HashPassword(connectionName, password); // Hashed before the shard is locked.
+
+        return _rooms.WithShard(connectionName, [&](auto& rooms) {
+            auto room = rooms.find(connectionName);
+
+            if (room != rooms.end() && room->second._expiry >= Clock::now() && room->second._passwordHash != passwordHash) {
+                return false; // Another peer's room, which only its password can replace.
+            }
+
+            rooms[connectionName] = Room{ passwordHash, offer, std::nullopt, Clock::now() + _timeToLive, {} };
+
+            return true;
+        });
+    }
+
+    bool RoomStore::PublishAnswer(const std::string& connectionName, const std::string& password, const std::string& answer) {
+        const auto passwordHash = HashPassword(connectionName, password);
+
+        return _rooms.WithShard(connectionName, [&](auto& rooms) {
+            auto room = rooms.find(connectionName);
+
+            if (room == rooms.end() || room->second._expiry < Clock::now() || room->second._passwordHash != passwordHash) {
+                return false;
+            }
+
+            room->second._answer = answer;
+            room->second._expiry = Clock::now() + _timeToLive;
+
+            return true;
+        });
+    }
+
+    std::variant<std::monostate, bool, std::string> RoomStore::GetOffer(const std::string& connectionName, const std::string& password) const {
+        const auto passwordHash = HashPassword(connectionName, password);
+
+        return _rooms.WithShard(connectionName, [&](const auto& rooms) -> std::variant<std::monostate, bool, std::string> {
+            auto room = rooms.find(connectionName);
+
+            if (room == rooms.end() || room->second._expiry < Clock::now()) {
+                return std::monostate();
+            }
+            else if (room->second._passwordHash != passwordHash) {
+                return false;
+            }
+
+            return room->second._offer;
+        });
+    }
+
+    std::optional<std::string> RoomStore::GetAnswer(const std::string& connectionName) const {
+        return _rooms.WithShard(connectionName, [&](const auto& rooms) -> std::optional<std::string> {
+            auto room = rooms.find(connectionName);
+
+            if (room == rooms.end() || room->second._expiry < Clock::now()) {
+                return std::nullopt;
+            }
+
+            return room->second._answer;
+        });
+    }
+
+    bool RoomStore::IsPasswordCorrect(const std::string& connectionName, const std::string& passwordHash) const {
+        return _rooms.WithShard(connectionName, [&](const auto& rooms) {
+            auto room = rooms.find(connectionName);
+            return room != rooms.end() && room->second._expiry >= Clock::now() && room->second._passwordHash == passwordHash;
+        });
+    }
+
+    bool RoomStore::AddRemoteSubscriber(const std::string& connectionName, const std::string& nodeURL) {
+        return _rooms.WithShard(connectionName, [&](auto& rooms) {
+            auto room = rooms.find(connectionName);
+
+            if (room == rooms.end()) {
+                return false;
+            }
+
+            auto& subscribers = room->second._remoteSubscribers;
+
+            if (std::find(subscribers.begin(), subscribers.end(), nodeURL) == subscribers.end()) {
+                subscribers.push_back(nodeURL);
+            }
+
+            return true;
+        });
+    }
+
+    std::vector<std::string> RoomStore::GetRemoteSubscribers(const std::string& connectionName) const {
+        return _rooms.WithShard(connectionName, [&](const auto& rooms) {
+            auto room = rooms.find(connectionName);
+            return room != rooms.end() ? room->second._remoteSubscribers : std::vector<std::string>();
+        });
+    }
+
+    std::vector<std::pair<std::string, RoomStore::Room>> RoomStore::ExtractRooms(const std::function<bool(const std::string& connectionName)>& predicate) {
+        std::vector<std::pair<std::string, Room>> extracted;
+
+        _rooms.ForEachShard([&](auto& rooms) {
+            for (auto room = rooms.begin(); room != rooms.end();) {
+                if (predicate(room->first)) {
+                    extracted.emplace_back(room->first, std::move(room->second));
+                    room = rooms.erase(room);
+                }
+                else {
+                    room++;
+                }
+            }
+        });
+
+        return extracted;
+    }
+
+    void RoomStore::InsertRoom(const std::string& connectionName, Room room) {
+        _rooms.WithShard(connectionName, [&](auto& rooms) {
+            auto [existing, inserted] = rooms.try_emplace(connectionName, room);
+
+            if (!inserted && existing->second._expiry < room._expiry) {
+                existing->second = std::move(room);
+            }
+        });
+    }
+
+    std::size_t RoomStore::ExpireRooms() {
+        std::size_t expiredCount = 0;
+
+        _rooms.ForEachShard([&](auto& rooms) {
+            const auto now = Clock::now();
+            expiredCount += std::erase_if(rooms, [now](const auto& room) { return room.second._expiry < now; });
+        });
+
+        return expiredCount;
+    }
+
+    std::size_t RoomStore::GetRoomCount() const {
+        return _rooms.Size();
+    }
+
+    std::string RoomStore::HashPassword(const std::string& connectionName, const std::string& password) {
+        const auto salted = connectionName + '\0' + password;
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<const unsigned char*>(salted.data()), salted.size(), digest);
+
+        static const char* digits = "0123456789abcdef";
+        std::string text;
+
+        for (auto byte : digest) {
+            text += digits[byte >> 4];
+            text += digits[byte & 0xF];
+        }
+
+        return text;
+    }
+}
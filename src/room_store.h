@@ -0,0 +1,133 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "sharded_map.h"
+
+namespace Comms {
+
+    /*
+    * In-memory storage of the offers and answers held by the signalling server, keyed by connection name.
+    *
+    * Rooms live in a ShardedMap so that requests for different connections rarely contend. Rooms expire a fixed
+    * time after they were last published to, matching the maximum time a peer waits for an answer.
+    *
+    * Passwords are not kept, only a SHA-256 hash of each with its connection name, so that rooms can be moved between
+    * nodes without sending them.
+    */
+    class RoomStore {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /*
+        * The signalling state of a single connection.
+        */
+        struct Room {
+            std::string _passwordHash; // The hash of the password the offer was published with. @see HashPassword
+            std::string _offer; // The offer SDP.
+            std::optional<std::string> _answer; // The answer SDP, once published.
+            Clock::time_point _expiry; // When the room is removed.
+            std::vector<std::string> _remoteSubscribers; // Cluster nodes with sockets subscribed to this room.
+        };
+
+        /*
+        * Constructor.
+        *
+        * @param shardCount The number of independently locked shards. Rounded up to a power of two.
+        * @param timeToLive How long a room is kept after it was last published to.
+        */
+        RoomStore(std::size_t shardCount, std::chrono::seconds timeToLive);
+
+        /*
+        * Stores an offer, replacing any existing room with the same name and password, or one that has expired.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        * @param offer The offer SDP.
+        * @return False if an unexpired room with the same name was published with a different password.
+        */
+        bool PublishOffer(const std::string& connectionName, const std::string& password, const std::string& offer);
+
+        /*
+        * Stores an answer for an existing offer.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        * @param answer The answer SDP.
+        * @return False if there is no offer or the password does not match.
+        */
+        bool PublishAnswer(const std::string& connectionName, const std::string& password, const std::string& answer);
+
+        /*
+        * @return The offer SDP string, false if the password is incorrect, or std::monostate if there is no offer.
+        */
+        std::variant<std::monostate, bool, std::string> GetOffer(const std::string& connectionName, const std::string& password) const;
+
+        /*
+        * @return The answer SDP, if one has been published.
+        */
+        std::optional<std::string> GetAnswer(const std::string& connectionName) const;
+
+        /*
+        * @param passwordHash A password hashed with the connection name. @see HashPassword
+        * @return Whether an unexpired room exists whose password has the given hash.
+        */
+        bool IsPasswordCorrect(const std::string& connectionName, const std::string& passwordHash) const;
+
+        /*
+        * Records that another cluster node has a socket subscribed to a room.
+        *
+        * @return False if there is no such room.
+        */
+        bool AddRemoteSubscriber(const std::string& connectionName, const std::string& nodeURL);
+
+        /*
+        * @return The cluster nodes with sockets subscribed to a room.
+        */
+        std::vector<std::string> GetRemoteSubscribers(const std::string& connectionName) const;
+
+        /*
+        * Removes and returns every room whose name matches a predicate, such as rooms now owned by another node.
+        * The predicate is called with a shard locked, so it must not access the store.
+        *
+        * @param predicate Returns true for the names of rooms to extract.
+        * @return The extracted rooms and their names.
+        */
+        std::vector<std::pair<std::string, Room>> ExtractRooms(const std::function<bool(const std::string& connectionName)>& predicate);
+
+        /*
+        * Inserts a room extracted from another store.
+        * An existing room with the same name is only replaced if the inserted room expires later.
+        */
+        void InsertRoom(const std::string& connectionName, Room room);
+
+        /*
+        * Removes every expired room.
+        * Shards are swept one at a time so that no lock is held for longer than a single shard's sweep.
+        *
+        * @return The number of rooms removed.
+        */
+        std::size_t ExpireRooms();
+
+        /*
+        * @return The number of rooms currently stored, including any expired rooms not yet swept.
+        */
+        std::size_t GetRoomCount() const;
+
+        /*
+        * @return The hash a room keeps of its password, in hexadecimal. Salted with the connection name.
+        */
+        static std::string HashPassword(const std::string& connectionName, const std::string& password);
+
+    private:
+        ShardedMap<Room> _rooms; // Rooms keyed by connection name.
+        const std::chrono::seconds _timeToLive; // How long a room is kept after it was last published to.
+    };
+}
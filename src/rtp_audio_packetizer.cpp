@@ -0,0 +1,98 @@
+#include "rtp_audio_packetizer.h"
+
+#include <algorithm>
+#include <random>
+
+#include "opus_packet.h"
+
+namespace {
+    constexpr std::size_t RtpFixedHeaderSize = 12;
+
+    constexpr std::size_t ExtensionHeaderSize = 4; // The profile and length of a header extension.
+    constexpr std::size_t AudioLevelElementSize = 2; // A one-byte extension header (RFC 8285) and the level.
+    constexpr std::size_t TransportSequenceElementSize = 3; // A one-byte extension header and the sequence number.
+
+    void WriteUint16(std::byte* data, std::uint16_t value) {
+        data[0] = std::byte(value >> 8);
+        data[1] = std::byte(value & 0xFF);
+    }
+
+    void WriteUint32(std::byte* data, std::uint32_t value) {
+        WriteUint16(data, static_cast<std::uint16_t>(value >> 16));
+        WriteUint16(data + 2, static_cast<std::uint16_t>(value & 0xFFFF));
+    }
+}
+
+namespace Comms {
+    RtpAudioPacketizer::RtpAudioPacketizer(std::uint32_t ssrc, std::uint8_t payloadType, std::optional<int> audioLevelExtensionId,
+        std::optional<int> transportSequenceExtensionId) :
+        _ssrc(ssrc),
+        _payloadType(payloadType),
+        _audioLevelExtensionId(audioLevelExtensionId),
+        _transportSequenceExtensionId(transportSequenceExtensionId) {
+        // Random initial values, as RFC 3550 recommends, so a restarted stream is not mistaken for a continuation.
+        std::random_device random;
+        _sequenceNumber = static_cast<std::uint16_t>(random());
+        _timestamp = random();
+    }
+
+    rtc::binary RtpAudioPacketizer::Packetize(const std::vector<std::byte>& opusData, AudioLevel level) {
+        rtc::binary packet;
+        Packetize(opusData, level, packet);
+
+        return packet;
+    }
+
+    void RtpAudioPacketizer::Packetize(const std::vector<std::byte>& opusData, AudioLevel level, rtc::binary& packet) {
+        const bool isSilent = IsOpusSilence(opusData.data(), opusData.size());
+
+        // The elements of a one-byte header extension, padded to a whole word.
+        const std::size_t elementsSize = (_audioLevelExtensionId.has_value() ? AudioLevelElementSize : 0) +
+            (_transportSequenceExtensionId.has_value() ? TransportSequenceElementSize : 0);
+        const std::size_t extensionWords = (elementsSize + 3) / 4;
+        const std::size_t headerSize = RtpFixedHeaderSize + (extensionWords > 0 ? ExtensionHeaderSize + extensionWords * 4 : 0);
+
+        packet.assign(headerSize + opusData.size(), std::byte(0)); // Cleared, as the padding and transport sequence number are not written.
+
+        packet[0] = std::byte(extensionWords > 0 ? 0x90 : 0x80); // Version 2, with a header extension if there are elements.
+        packet[1] = std::byte((_wasSilent && !isSilent ? 0x80 : 0x00) | (_payloadType & 0x7F)); // The marker starts a talkspurt.
+        WriteUint16(&packet[2], _sequenceNumber);
+        WriteUint32(&packet[4], _timestamp);
+        WriteUint32(&packet[8], _ssrc);
+
+        if (extensionWords > 0) {
+            WriteUint16(&packet[12], 0xBEDE); // One-byte header extensions.
+            WriteUint16(&packet[14], static_cast<std::uint16_t>(extensionWords));
+        }
+
+        std::size_t offset = RtpFixedHeaderSize + ExtensionHeaderSize;
+
+        if (_audioLevelExtensionId.has_value()) {
+            packet[offset] = std::byte(*_audioLevelExtensionId << 4); // One byte of data follows.
+            packet[offset + 1] = std::byte((level._isVoiceActive && !isSilent ? 0x80 : 0x00) | (isSilent ? AudioLevel::Silence : level._level & 0x7F));
+            offset += AudioLevelElementSize;
+        }
+
+        if (_transportSequenceExtensionId.has_value()) {
+            packet[offset] = std::byte((*_transportSequenceExtensionId << 4) | 0x01); // Two bytes of data follow, written when sent.
+        }
+
+        std::copy(opusData.begin(), opusData.end(), packet.begin() + headerSize);
+
+        _sequenceNumber++;
+        _timestamp += GetOpusSampleCount(opusData.data(), opusData.size());
+        _wasSilent = isSilent;
+    }
+
+    void RtpAudioPacketizer::SetTransportSequenceNumber(rtc::binary& packet, std::uint16_t sequenceNumber) const {
+        if (!_transportSequenceExtensionId.has_value()) {
+            return;
+        }
+
+        const std::size_t offset = RtpFixedHeaderSize + ExtensionHeaderSize + (_audioLevelExtensionId.has_value() ? AudioLevelElementSize : 0) + 1;
+
+        if (packet.size() >= offset + 2) {
+            WriteUint16(&packet[offset], sequenceNumber);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+#include "audio_level.h"
+
+namespace Comms {
+
+    /*
+    * Wraps encoded Opus packets in RTP, tagging each with the level of the audio it was encoded from if the extension was negotiated.
+    * Packets can also reserve room for a transport-wide sequence number, written as each is sent. @see CongestionController
+    *
+    * The level is carried in the RFC 6464 client-to-mixer header extension, so that an SFU can rank speakers without decoding.
+    * Timestamps advance by the duration read from each packet's Opus table of contents.
+    */
+    class RtpAudioPacketizer {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param ssrc The SSRC of the stream, as declared in the session description.
+        * @param payloadType The payload type negotiated for Opus.
+        * @param audioLevelExtensionId The id the audio level extension was negotiated with. Packets carry no level when not set.
+        * @param transportSequenceExtensionId The id the transport-wide sequence number extension was negotiated with, if it was.
+        */
+        RtpAudioPacketizer(std::uint32_t ssrc, std::uint8_t payloadType, std::optional<int> audioLevelExtensionId,
+            std::optional<int> transportSequenceExtensionId = std::nullopt);
+
+        /*
+        * Builds the RTP packet for an encoded frame.
+        *
+        * @param opusData The Opus packet.
+        * @param level The level of the audio the packet was encoded from.
+        * @return The RTP packet.
+        */
+        rtc::binary Packetize(const std::vector<std::byte>& opusData, AudioLevel level);
+
+        /*
+        * Builds the RTP packet for an encoded frame into a packet reused for every frame, which only allocates to grow past
+        * the largest packet built into it before, so that the audio thread can packetise without allocating.
+        *
+        * @param opusData The Opus packet.
+        * @param level The level of the audio the packet was encoded from.
+        * @param packet Receives the RTP packet.
+        */
+        void Packetize(const std::vector<std::byte>& opusData, AudioLevel level, rtc::binary& packet);
+
+        /*
+        * Writes the transport-wide sequence number of a packet built by Packetize, once it is known the packet is being sent.
+        * Does nothing if the extension was not negotiated.
+        */
+        void SetTransportSequenceNumber(rtc::binary& packet, std::uint16_t sequenceNumber) const;
+
+    private:
+        const std::uint32_t _ssrc; // The SSRC of the stream.
+        const std::uint8_t _payloadType; // The payload type negotiated for Opus.
+        const std::optional<int> _audioLevelExtensionId; // The id the audio level extension was negotiated with.
+        const std::optional<int> _transportSequenceExtensionId; // The id the transport-wide sequence number extension was negotiated with.
+
+        std::uint16_t _sequenceNumber = 0; // The sequence number of the next packet.
+        std::uint32_t _timestamp = 0; // The timestamp of the next packet.
+        bool _wasSilent = true; // Whether the previous packet carried no audio. The first packet after silence starts a talkspurt.
+    };
+}
@@ -0,0 +1,115 @@
+#include "rtp_packet.h"
+
+#include <cstdint>
+
+namespace {
+    constexpr std::size_t RtpFixedHeaderSize = 12;
+    constexpr std::uint16_t OneByteHeaderProfile = 0xBEDE;
+    constexpr std::uint16_t TwoByteHeaderProfile = 0x1000; // The upper 12 bits. The lower 4 bits are application defined.
+    constexpr int OneByteHeaderStopId = 15;
+
+    std::uint8_t ReadByte(const std::byte* data, std::size_t offset) {
+        return std::to_integer<std::uint8_t>(data[offset]);
+    }
+
+    std::uint16_t ReadUint16(const std::byte* data, std::size_t offset) {
+        return static_cast<std::uint16_t>((ReadByte(data, offset) << 8) | ReadByte(data, offset + 1));
+    }
+}
+
+namespace Comms {
+    std::optional<std::pair<std::size_t, std::size_t>> GetRtpPayload(const std::byte* packet, std::size_t size) {
+        if (size < RtpFixedHeaderSize) {
+            return std::nullopt;
+        }
+
+        const auto first = std::to_integer<std::uint8_t>(packet[0]);
+        std::size_t offset = RtpFixedHeaderSize + (first & 0x0F) * std::size_t(4);
+        std::size_t end = size;
+
+        if ((first & 0x10) != 0) {
+            if (end < offset + 4) {
+                return std::nullopt;
+            }
+
+            const std::size_t extensionWords = (std::to_integer<std::size_t>(packet[offset + 2]) << 8) | std::to_integer<std::size_t>(packet[offset + 3]);
+            offset += 4 + extensionWords * 4;
+        }
+
+        if ((first & 0x20) != 0) {
+            const std::size_t paddingSize = std::to_integer<std::uint8_t>(packet[end - 1]); // Given by the last byte.
+
+            if (paddingSize > end) {
+                return std::nullopt;
+            }
+
+            end -= paddingSize;
+        }
+
+        if (offset > end) {
+            return std::nullopt;
+        }
+
+        return std::make_pair(offset, end - offset);
+    }
+
+    std::optional<std::pair<std::size_t, std::size_t>> FindRtpHeaderExtension(const std::byte* packet, std::size_t size, int extensionId) {
+        if (size < RtpFixedHeaderSize || (ReadByte(packet, 0) & 0x10) == 0) {
+            return std::nullopt; // No header extension.
+        }
+
+        const std::size_t extensionOffset = RtpFixedHeaderSize + (ReadByte(packet, 0) & 0x0F) * std::size_t(4);
+
+        if (size < extensionOffset + 4) {
+            return std::nullopt;
+        }
+
+        const std::uint16_t profile = ReadUint16(packet, extensionOffset);
+        const std::size_t begin = extensionOffset + 4;
+        const std::size_t end = begin + ReadUint16(packet, extensionOffset + 2) * std::size_t(4);
+
+        if (size < end) {
+            return std::nullopt;
+        }
+
+        const bool isOneByte = profile == OneByteHeaderProfile;
+
+        if (!isOneByte && (profile & 0xFFF0) != TwoByteHeaderProfile) {
+            return std::nullopt;
+        }
+
+        for (std::size_t offset = begin; offset < end;) {
+            const std::uint8_t header = ReadByte(packet, offset);
+            const int id = isOneByte ? header >> 4 : header;
+
+            if (id == 0) {
+                offset++; // Padding.
+                continue;
+            }
+
+            if (isOneByte && id == OneByteHeaderStopId) {
+                break;
+            }
+
+            const std::size_t headerSize = isOneByte ? 1 : 2;
+
+            if (offset + headerSize > end) {
+                break;
+            }
+
+            const std::size_t length = isOneByte ? (header & 0x0F) + std::size_t(1) : ReadByte(packet, offset + 1);
+
+            if (offset + headerSize + length > end) {
+                break;
+            }
+
+            if (id == extensionId) {
+                return std::make_pair(offset + headerSize, length);
+            }
+
+            offset += headerSize + length;
+        }
+
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace Comms {
+
+    /*
+    * Finds the payload of an RTP packet, skipping its CSRCs and header extension and excluding any padding.
+    *
+    * @param packet The RTP packet.
+    * @param size The size of the packet in bytes.
+    * @return The offset and size of the payload, or std::nullopt if the packet is malformed.
+    */
+    std::optional<std::pair<std::size_t, std::size_t>> GetRtpPayload(const std::byte* packet, std::size_t size);
+
+    /*
+    * Finds the data of an element of an RTP packet's header extension (RFC 8285), in either the one-byte or two-byte form.
+    *
+    * @param packet The RTP packet.
+    * @param size The size of the packet in bytes.
+    * @param extensionId The id the extension was negotiated with.
+    * @return The offset and size of the element's data, or std::nullopt if the packet does not carry it.
+    */
+    std::optional<std::pair<std::size_t, std::size_t>> FindRtpHeaderExtension(const std::byte* packet, std::size_t size, int extensionId);
+}
@@ -0,0 +1,49 @@
+#include "rtp_slot_rewriter.h"
+
+namespace {
+    // Timestamp advance between the last packet of one sender and the first of the next: one 20 ms Opus frame at 48 kHz.
+    constexpr std::uint32_t FrameTimestampIncrement = 960;
+}
+
+namespace Comms {
+    RtpSlotRewriter::RtpSlotRewriter(std::uint32_t ssrc) :
+        _ssrc(ssrc) {
+    }
+
+    void RtpSlotRewriter::Rewrite(rtc::RtpHeader& header, std::uint32_t sourceId) {
+        const std::uint16_t sequenceNumber = header.seqNumber();
+        const std::uint32_t timestamp = header.timestamp();
+
+        if (_sourceId != sourceId) {
+            if (_sourceId.has_value()) {
+                // Continue the slot's numbering from the previous sender, so this packet directly follows its last one.
+                _sequenceNumberOffset = static_cast<std::uint16_t>(_lastSequenceNumber + 1 - sequenceNumber);
+                _timestampOffset = _lastTimestamp + FrameTimestampIncrement - timestamp;
+            }
+
+            _sourceId = sourceId;
+            _lastSequenceNumber = static_cast<std::uint16_t>(sequenceNumber + _sequenceNumberOffset - 1);
+        }
+
+        const std::uint16_t rewrittenSequenceNumber = sequenceNumber + _sequenceNumberOffset;
+        const std::uint32_t rewrittenTimestamp = timestamp + _timestampOffset;
+
+        // Only packets newer than any sent before advance the slot. Sequence numbers wrap, so newer means less than half the range ahead.
+        if (static_cast<std::int16_t>(rewrittenSequenceNumber - _lastSequenceNumber) > 0) {
+            _lastSequenceNumber = rewrittenSequenceNumber;
+            _lastTimestamp = rewrittenTimestamp;
+        }
+
+        header.setSsrc(_ssrc);
+        header.setSeqNumber(rewrittenSequenceNumber);
+        header.setTimestamp(rewrittenTimestamp);
+    }
+
+    std::uint32_t RtpSlotRewriter::GetSSRC() const {
+        return _ssrc;
+    }
+
+    std::optional<std::uint32_t> RtpSlotRewriter::GetSourceId() const {
+        return _sourceId;
+    }
+}
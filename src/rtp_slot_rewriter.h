@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    /*
+    * Rewrites forwarded RTP packets so that the streams of several senders can be delivered to a receiver on one of a fixed set
+    * of outgoing SSRCs, each negotiated in the receiver's session description.
+    *
+    * A slot presents one continuous stream to the receiver. Its SSRC never changes, and when the slot is handed from one
+    * sender to another, sequence numbers and timestamps carry on from where the previous sender left off so the receiver's
+    * jitter buffer sees a continuous stream rather than a restart. Payloads are never touched.
+    */
+    class RtpSlotRewriter {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param ssrc The SSRC the slot is sent on.
+        */
+        RtpSlotRewriter(std::uint32_t ssrc);
+
+        /*
+        * Rewrites the header of a packet in place.
+        *
+        * @param header The header of the packet being forwarded.
+        * @param sourceId Identifies the sender. A change of sender starts a new run of sequence numbers and timestamps.
+        */
+        void Rewrite(rtc::RtpHeader& header, std::uint32_t sourceId);
+
+        /*
+        * @return The SSRC the slot is sent on.
+        */
+        std::uint32_t GetSSRC() const;
+
+        /*
+        * @return The sender the slot last forwarded, if any.
+        */
+        std::optional<std::uint32_t> GetSourceId() const;
+
+    private:
+        const std::uint32_t _ssrc; // The SSRC the slot is sent on.
+        std::optional<std::uint32_t> _sourceId; // The sender the slot last forwarded.
+
+        std::uint16_t _sequenceNumberOffset = 0; // Added to the sender's sequence numbers.
+        std::uint32_t _timestampOffset = 0; // Added to the sender's timestamps.
+
+        std::uint16_t _lastSequenceNumber = 0; // The highest sequence number sent on the slot.
+        std::uint32_t _lastTimestamp = 0; // The timestamp of the packet with the highest sequence number.
+    };
+}
@@ -0,0 +1,69 @@
+#include "sample_statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace Comms {
+    void SampleStatistics::Add(double sample) {
+        _samples.push_back(sample);
+        _isSorted = false;
+    }
+
+    void SampleStatistics::Merge(const SampleStatistics& other) {
+        _samples.insert(_samples.end(), other._samples.begin(), other._samples.end());
+        _isSorted = false;
+    }
+
+    std::size_t SampleStatistics::GetCount() const {
+        return _samples.size();
+    }
+
+    double SampleStatistics::GetMean() const {
+        if (_samples.empty()) {
+            return 0.0;
+        }
+
+        return std::accumulate(_samples.begin(), _samples.end(), 0.0) / _samples.size();
+    }
+
+    double SampleStatistics::GetMinimum() const {
+        return GetPercentile(0.0);
+    }
+
+    double SampleStatistics::GetMaximum() const {
+        return GetPercentile(100.0);
+    }
+
+    double SampleStatistics::GetPercentile(double percentile) const {
+        if (_samples.empty()) {
+            return 0.0;
+        }
+
+        Sort();
+
+        const auto rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * _samples.size()));
+
+        return _samples[std::clamp<std::size_t>(rank, 1, _samples.size()) - 1];
+    }
+
+    nlohmann::json SampleStatistics::ToJson() const {
+        return {
+            {"count", GetCount()},
+            {"mean", GetMean()},
+            {"min", GetMinimum()},
+            {"max", GetMaximum()},
+            {"p50", GetPercentile(50.0)},
+            {"p90", GetPercentile(90.0)},
+            {"p99", GetPercentile(99.0)},
+            {"p999", GetPercentile(99.9)}
+        };
+    }
+
+    void SampleStatistics::Sort() const {
+        if (!_isSorted) {
+            std::sort(_samples.begin(), _samples.end());
+            _isSorted = true;
+        }
+    }
+}
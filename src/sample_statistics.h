@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "json/json.hpp"
+
+namespace Comms {
+
+    /*
+    * Collects samples of a measurement, such as a latency, and summarises their distribution.
+    * All samples are retained so that exact percentiles can be reported.
+    */
+    class SampleStatistics {
+    public:
+        /*
+        * Records a sample.
+        *
+        * @param sample The measured value.
+        */
+        void Add(double sample);
+
+        /*
+        * Records every sample of another set of statistics.
+        *
+        * @param other The statistics to merge into this one.
+        */
+        void Merge(const SampleStatistics& other);
+
+        /*
+        * @return The number of samples recorded.
+        */
+        std::size_t GetCount() const;
+
+        /*
+        * @return The arithmetic mean of the samples, or zero if there are none.
+        */
+        double GetMean() const;
+
+        /*
+        * @return The smallest sample, or zero if there are none.
+        */
+        double GetMinimum() const;
+
+        /*
+        * @return The largest sample, or zero if there are none.
+        */
+        double GetMaximum() const;
+
+        /*
+        * Calculates a percentile using the nearest rank method.
+        *
+        * @param percentile The percentile in the range 0 to 100.
+        * @return The sample at the percentile, or zero if there are none.
+        */
+        double GetPercentile(double percentile) const;
+
+        /*
+        * @return The count, mean, minimum, maximum and 50th, 90th, 99th and 99.9th percentiles as a JSON object.
+        */
+        nlohmann::json ToJson() const;
+
+    private:
+        /*
+        * Sorts the samples if any have been added since they were last sorted.
+        */
+        void Sort() const;
+
+        mutable std::vector<double> _samples; // The recorded samples. Sorted lazily when a percentile is requested.
+        mutable bool _isSorted = true; // Whether _samples is currently sorted.
+    };
+}
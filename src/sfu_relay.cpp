@@ -0,0 +1,568 @@
+#include "sfu_relay.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "sfu_room.h"
+#include "sfu_worker.h"
+
+namespace {
+    // Every datagram starts with the magic, a message type, the sending node's id, the node's stream it is numbered on, the
+    // time it was sent, in seconds since the epoch, and its counter within the stream, and ends with its signature,
+    // truncated to SignatureSize bytes.
+    constexpr std::byte Magic[] = { std::byte{ 'C' }, std::byte{ 'R' } };
+    constexpr std::size_t StreamOffset = sizeof(Magic) + 2;
+    constexpr std::size_t CounterOffset = StreamOffset + 1 + 4;
+    constexpr std::size_t HeaderSize = CounterOffset + 8;
+    constexpr std::size_t SignatureSize = 16;
+
+    constexpr std::uint8_t RelayStream = 0; // The stream announcements and departures are numbered on.
+
+    // Message types.
+    constexpr std::uint8_t RoomsMessage = 1; // Room names the sender has participants in. Empty lists keep the link alive.
+    constexpr std::uint8_t RoomsLeftMessage = 2; // Room names the sender no longer has participants in.
+    constexpr std::uint8_t MediaMessage = 3; // Room name, sender id, audio level extension id or 0, then the RTP packet.
+    constexpr std::uint8_t ParticipantLeftMessage = 4; // Room name and the id of a participant that left it.
+
+    constexpr std::chrono::seconds AnnouncementInterval(1); // How often local rooms are announced.
+    constexpr std::chrono::seconds AnnouncementTimeout(5); // How long a room is relayed to a node after it last announced it.
+    constexpr std::chrono::milliseconds ReceiveTimeout(100); // How often the relay thread wakes to announce or stop.
+    constexpr std::chrono::seconds SignatureLifetime(30); // How far a datagram's send time may be from the receiver's clock.
+
+    constexpr std::size_t MaxAnnouncementSize = 1200; // Room lists are split to keep datagrams below a typical MTU.
+    constexpr std::size_t MaxDatagramSize = 2048; // Relayed RTP packets fit a typical MTU, with room for the relay header.
+    constexpr std::size_t ReceiveBatchSize = 64; // The most datagrams received in one system call.
+    constexpr std::size_t ReceiveBufferSize = 4 * 1024 * 1024; // Absorbs bursts while the relay thread is busy.
+
+    std::uint32_t GetUnixSeconds() {
+        return static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    /*
+    * Appends a 32 bit value in network byte order to a datagram.
+    */
+    void WriteUint32(std::vector<std::byte>& datagram, std::uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            datagram.push_back(static_cast<std::byte>(value >> shift));
+        }
+    }
+
+    /*
+    * Appends the header of a message to a datagram.
+    */
+    void WriteHeader(std::vector<std::byte>& datagram, std::uint8_t type, std::uint8_t nodeId, std::uint8_t stream, std::uint64_t counter) {
+        datagram.insert(datagram.end(), std::begin(Magic), std::end(Magic));
+        datagram.push_back(static_cast<std::byte>(type));
+        datagram.push_back(static_cast<std::byte>(nodeId));
+        datagram.push_back(static_cast<std::byte>(stream));
+        WriteUint32(datagram, GetUnixSeconds());
+        WriteUint32(datagram, static_cast<std::uint32_t>(counter >> 32));
+        WriteUint32(datagram, static_cast<std::uint32_t>(counter));
+    }
+
+    /*
+    * Numbers a datagram whose header has been written, on a stream.
+    */
+    void WriteStreamCounter(std::byte* datagram, std::uint8_t stream, std::uint64_t counter) {
+        datagram[StreamOffset] = static_cast<std::byte>(stream);
+
+        for (std::size_t i = 0; i < 8; i++) {
+            datagram[CounterOffset + i] = static_cast<std::byte>(counter >> (56 - 8 * i));
+        }
+    }
+
+    /*
+    * Appends a room name, prefixed by its length, to a datagram.
+    */
+    void WriteName(std::vector<std::byte>& datagram, const std::string& name) {
+        datagram.push_back(static_cast<std::byte>(name.size()));
+
+        const auto bytes = reinterpret_cast<const std::byte*>(name.data());
+        datagram.insert(datagram.end(), bytes, bytes + name.size());
+    }
+
+    /*
+    * Reads a room name written by WriteName, advancing the offset past it.
+    *
+    * @return The name, or std::nullopt if the datagram is too short.
+    */
+    std::optional<std::string> ReadName(const std::byte* data, std::size_t size, std::size_t& offset) {
+        if (offset >= size) {
+            return std::nullopt;
+        }
+
+        const auto length = static_cast<std::size_t>(data[offset]);
+
+        if (offset + 1 + length > size) {
+            return std::nullopt;
+        }
+
+        std::string name(reinterpret_cast<const char*>(data + offset + 1), length);
+        offset += 1 + length;
+
+        return name;
+    }
+
+    /*
+    * Reads a 32 bit value written by WriteUint32, advancing the offset past it.
+    *
+    * @return The value, or std::nullopt if the datagram is too short.
+    */
+    std::optional<std::uint32_t> ReadUint32(const std::byte* data, std::size_t size, std::size_t& offset) {
+        if (offset + 4 > size) {
+            return std::nullopt;
+        }
+
+        std::uint32_t value = 0;
+
+        for (std::size_t i = 0; i < 4; i++) {
+            value = (value << 8) | static_cast<std::uint32_t>(data[offset + i]);
+        }
+
+        offset += 4;
+
+        return value;
+    }
+
+    /*
+    * @return Whether a room name fits the relay's one byte length prefix.
+    */
+    bool IsRelayableName(const std::string& name) {
+        return !name.empty() && name.size() <= 255;
+    }
+}
+
+namespace Comms {
+    SfuRelay::SfuRelay(Configuration configuration) :
+        _configuration(configuration),
+        _key(configuration._key),
+        _nextCounter(ReplayWindow::GetInitialCounter()) {
+        for (auto& counter : _nextMediaCounters) {
+            counter = _nextCounter.load();
+        }
+    }
+
+    SfuRelay::~SfuRelay() {
+        Stop();
+    }
+
+    bool SfuRelay::Start(RoomFinder findRoom) {
+        if (_key.IsEmpty()) {
+            return false; // Without a key, anyone who can reach the socket could inject media into any room.
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            for (const auto& peer : _configuration._peers) {
+                auto endpoint = UdpEndpoint::Parse(peer);
+
+                if (!endpoint.has_value()) {
+                    return false;
+                }
+
+                PeerState state;
+                state._peer = std::make_shared<Peer>(*endpoint);
+                state._isConfigured = true;
+
+                _peers.push_back(std::move(state));
+            }
+        }
+
+        if (!_socket.Bind(_configuration._bindAddress, _configuration._port)) {
+            return false;
+        }
+
+        _socket.SetReceiveTimeout(ReceiveTimeout);
+        _socket.SetReceiveBufferSize(ReceiveBufferSize);
+        _socket.EnableSegmentationOffload();
+
+        _findRoom = std::move(findRoom);
+        _nextAnnouncement = Clock::now();
+        _thread = std::thread([this]() { Run(); });
+
+        return true;
+    }
+
+    void SfuRelay::Stop() {
+        _isStopping = true;
+
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    std::uint8_t SfuRelay::GetNodeId() const {
+        return _configuration._nodeId;
+    }
+
+    std::uint16_t SfuRelay::GetPort() const {
+        return _socket.GetPort();
+    }
+
+    void SfuRelay::AddLocalRoom(const std::string& name) {
+        if (!IsRelayableName(name)) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _localRooms.insert(name);
+        }
+
+        // Announced straight away, so other nodes start relaying to the room's first participant without waiting a second.
+        SendRooms(RoomsMessage, { name });
+    }
+
+    void SfuRelay::RemoveLocalRoom(const std::string& name) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_localRooms.erase(name) == 0) {
+                return;
+            }
+        }
+
+        SendRooms(RoomsLeftMessage, { name });
+    }
+
+    std::vector<std::shared_ptr<SfuRelay::Peer>> SfuRelay::GetRoomPeers(const std::string& name) const {
+        std::vector<std::shared_ptr<Peer>> peers;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (const auto& state : _peers) {
+            if (state._rooms.contains(name)) {
+                peers.push_back(state._peer);
+            }
+        }
+
+        return peers;
+    }
+
+    void SfuRelay::QueueMedia(const std::vector<std::shared_ptr<Peer>>& peers, const std::string& roomName, std::uint32_t senderId,
+        std::optional<int> audioLevelExtensionId, const rtc::binary& packet, UdpSendBatch& batch) {
+        thread_local std::vector<std::byte> datagram;
+
+        // Numbered and signed as the batch is sent, so that the worker's stream leaves in order.
+        datagram.clear();
+        WriteHeader(datagram, MediaMessage, _configuration._nodeId, RelayStream, 0);
+        WriteName(datagram, roomName);
+        WriteUint32(datagram, senderId);
+        datagram.push_back(static_cast<std::byte>(audioLevelExtensionId.value_or(0)));
+        datagram.insert(datagram.end(), packet.begin(), packet.end());
+        datagram.resize(datagram.size() + SignatureSize);
+
+        const auto payload = batch.AddPayload(datagram.data(), datagram.size());
+
+        for (const auto& peer : peers) {
+            batch.AddDatagram(payload, peer->_endpoint);
+            peer->_mediaPacketsSent++;
+        }
+    }
+
+    void SfuRelay::SendQueuedMedia(UdpSendBatch& batch, std::size_t worker) {
+        const auto stream = worker % MediaStreamCount;
+        const auto count = batch.GetPayloadCount();
+
+        // Each payload is numbered once, however many nodes it goes to, and the batch sends each node its payloads in order.
+        auto counter = _nextMediaCounters[stream].fetch_add(count);
+
+        for (std::size_t i = 0; i < count; i++) {
+            WriteStreamCounter(batch.GetPayloadData(i), static_cast<std::uint8_t>(RelayStream + 1 + stream), counter++);
+            Sign(batch.GetPayloadData(i), batch.GetPayloadSize(i));
+        }
+
+        _socket.SendBatch(batch);
+        batch.Clear();
+    }
+
+    void SfuRelay::SendParticipantLeft(const std::vector<std::shared_ptr<Peer>>& peers, const std::string& roomName, std::uint32_t participantId) {
+        std::vector<std::byte> datagram;
+        WriteHeader(datagram, ParticipantLeftMessage, _configuration._nodeId, RelayStream, _nextCounter++);
+        WriteName(datagram, roomName);
+        WriteUint32(datagram, participantId);
+        Sign(datagram);
+
+        for (const auto& peer : peers) {
+            _socket.SendTo(peer->_endpoint, datagram.data(), datagram.size());
+        }
+    }
+
+    std::vector<SfuRelay::PeerStatus> SfuRelay::GetPeerStatus() const {
+        const auto now = Clock::now();
+        std::vector<PeerStatus> statuses;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (const auto& state : _peers) {
+            PeerStatus status;
+            status._endpoint = state._peer->_endpoint.ToString();
+            status._nodeId = state._nodeId;
+            status._isConfigured = state._isConfigured;
+            status._mediaPacketsSent = state._peer->_mediaPacketsSent;
+            status._mediaPacketsReceived = state._peer->_mediaPacketsReceived;
+
+            if (state._lastHeard.has_value()) {
+                status._sinceHeard = std::chrono::duration_cast<std::chrono::milliseconds>(now - *state._lastHeard);
+            }
+
+            for (const auto& [name, announced] : state._rooms) {
+                status._rooms.push_back(name);
+            }
+
+            std::sort(status._rooms.begin(), status._rooms.end());
+            statuses.push_back(std::move(status));
+        }
+
+        return statuses;
+    }
+
+    void SfuRelay::Run() {
+        UdpReceiveBatch batch(ReceiveBatchSize, MaxDatagramSize);
+        std::unordered_map<std::string, std::shared_ptr<SfuRoom>> rooms;
+
+        while (!_isStopping) {
+            _socket.ReceiveBatch(batch);
+
+            for (std::size_t i = 0; i < batch.GetCount(); i++) {
+                HandleDatagram(batch.GetSource(i), batch.GetData(i), batch.GetSize(i), rooms);
+            }
+
+            rooms.clear();
+
+            // Checked after every datagram as well as on timeouts, so a busy link still announces on time.
+            const auto now = Clock::now();
+
+            if (now >= _nextAnnouncement) {
+                Announce(now);
+                _nextAnnouncement = now + AnnouncementInterval;
+            }
+        }
+    }
+
+    void SfuRelay::HandleDatagram(const UdpEndpoint& source, const std::byte* data, std::size_t size,
+        std::unordered_map<std::string, std::shared_ptr<SfuRoom>>& rooms) {
+        if (size < HeaderSize + SignatureSize || !std::equal(std::begin(Magic), std::end(Magic), data) || !Verify(data, size)) {
+            return;
+        }
+
+        size -= SignatureSize; // The messages are read up to the signature.
+
+        const auto type = static_cast<std::uint8_t>(data[2]);
+        const auto nodeId = static_cast<std::uint8_t>(data[3]);
+        std::size_t offset = HeaderSize;
+
+        if (nodeId == _configuration._nodeId) {
+            return; // Another node with this node's id would give its participants the same ids as ours.
+        }
+
+        if (type == RoomsMessage || type == RoomsLeftMessage) {
+            std::vector<std::string> changedRooms;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                auto state = FindPeer(source);
+
+                if (state == nullptr) {
+                    // Nodes only need configuring on one side: the other learns of them from their announcements.
+                    _peers.push_back(PeerState{ std::make_shared<Peer>(source), false, std::nullopt, std::nullopt, {} });
+                    state = &_peers.back();
+                }
+
+                const auto now = Clock::now();
+                state->_nodeId = nodeId;
+                state->_lastHeard = now;
+
+                while (auto name = ReadName(data, size, offset)) {
+                    if (type == RoomsMessage) {
+                        if (state->_rooms.insert_or_assign(*name, now).second) {
+                            changedRooms.push_back(*name);
+                        }
+                    }
+                    else if (state->_rooms.erase(*name) > 0) {
+                        changedRooms.push_back(*name);
+                    }
+                }
+            }
+
+            for (const auto& name : changedRooms) {
+                UpdateRoomPeers(name);
+            }
+
+            rooms.clear(); // Rooms may have been created since they were looked up.
+
+            return;
+        }
+
+        const auto roomName = ReadName(data, size, offset);
+        const auto senderId = ReadUint32(data, size, offset);
+
+        if (!roomName.has_value() || !senderId.has_value()) {
+            return;
+        }
+
+        if (type == MediaMessage) {
+            if (offset + 1 + sizeof(rtc::RtpHeader) > size) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            auto state = FindPeer(source);
+
+            if (state == nullptr) {
+                return; // Media is only accepted from nodes that have announced themselves.
+            }
+
+            state->_peer->_mediaPacketsReceived++;
+        }
+
+        auto room = rooms.find(*roomName);
+
+        if (room == rooms.end()) {
+            room = rooms.emplace(*roomName, _findRoom(*roomName)).first;
+        }
+
+        if (room->second == nullptr) {
+            return; // Everyone here has left the room since this node last announced it.
+        }
+
+        if (type == MediaMessage) {
+            const auto extensionId = static_cast<int>(data[offset++]);
+
+            room->second->GetWorker().PostRelayedPacket(room->second, *senderId, extensionId == 0 ? std::nullopt : std::optional<int>(extensionId),
+                rtc::binary(data + offset, data + size));
+        }
+        else if (type == ParticipantLeftMessage) {
+            room->second->GetWorker().Post([room = room->second, participantId = *senderId]() {
+                room->RemoveRelayedSender(participantId);
+            });
+        }
+    }
+
+    void SfuRelay::Announce(Clock::time_point now) {
+        std::vector<std::string> localRooms;
+        std::vector<std::string> expiredRooms;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            localRooms.assign(_localRooms.begin(), _localRooms.end());
+
+            for (auto& state : _peers) {
+                std::erase_if(state._rooms, [&](const auto& room) {
+                    if (now - room.second < AnnouncementTimeout) {
+                        return false;
+                    }
+
+                    expiredRooms.push_back(room.first);
+                    return true;
+                });
+            }
+
+            // Learned nodes are forgotten once they stop announcing. Configured ones are kept, to be announced to.
+            std::erase_if(_peers, [&](const PeerState& state) {
+                return !state._isConfigured && state._lastHeard.has_value() && now - *state._lastHeard >= AnnouncementTimeout;
+            });
+        }
+
+        // Nodes without rooms are still announced to, which keeps the link alive and tells them this node's id.
+        SendRooms(RoomsMessage, localRooms);
+
+        std::sort(expiredRooms.begin(), expiredRooms.end());
+        expiredRooms.erase(std::unique(expiredRooms.begin(), expiredRooms.end()), expiredRooms.end());
+
+        for (const auto& name : expiredRooms) {
+            UpdateRoomPeers(name);
+        }
+    }
+
+    void SfuRelay::Sign(std::vector<std::byte>& datagram) const {
+        datagram.resize(datagram.size() + SignatureSize);
+        Sign(datagram.data(), datagram.size());
+    }
+
+    void SfuRelay::Sign(std::byte* datagram, std::size_t size) const {
+        const auto signature = _key.Sign(datagram, size - SignatureSize);
+        const auto bytes = reinterpret_cast<const std::byte*>(signature.data());
+
+        std::copy(bytes, bytes + SignatureSize, datagram + size - SignatureSize);
+    }
+
+    bool SfuRelay::Verify(const std::byte* data, std::size_t size) {
+        const auto signedSize = size - SignatureSize;
+
+        if (!_key.Verify(data, signedSize, reinterpret_cast<const std::uint8_t*>(data + signedSize), SignatureSize)) {
+            return false;
+        }
+
+        const auto stream = static_cast<std::uint8_t>(data[StreamOffset]);
+        std::size_t offset = StreamOffset + 1;
+        const auto sentAt = static_cast<std::int64_t>(*ReadUint32(data, size, offset));
+        const auto counterHigh = static_cast<std::uint64_t>(*ReadUint32(data, size, offset));
+        const auto counter = (counterHigh << 32) | *ReadUint32(data, size, offset);
+
+        if (std::abs(static_cast<std::int64_t>(GetUnixSeconds()) - sentAt) > SignatureLifetime.count()) {
+            return false;
+        }
+
+        // By the sending node's id and the stream.
+        return _replayWindows[static_cast<std::uint16_t>((static_cast<std::uint16_t>(data[3]) << 8) | stream)].Accept(counter);
+    }
+
+    void SfuRelay::SendRooms(std::uint8_t type, const std::vector<std::string>& names) {
+        std::vector<std::byte> datagram;
+        WriteHeader(datagram, type, _configuration._nodeId, RelayStream, _nextCounter++);
+
+        for (const auto& name : names) {
+            if (datagram.size() + 1 + name.size() > MaxAnnouncementSize) {
+                Sign(datagram);
+                SendToAll(datagram);
+
+                datagram.clear();
+                WriteHeader(datagram, type, _configuration._nodeId, RelayStream, _nextCounter++);
+            }
+
+            WriteName(datagram, name);
+        }
+
+        if (names.empty() || datagram.size() > HeaderSize) {
+            Sign(datagram);
+            SendToAll(datagram);
+        }
+    }
+
+    void SfuRelay::SendToAll(const std::vector<std::byte>& datagram) {
+        std::vector<std::shared_ptr<Peer>> peers;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            for (const auto& state : _peers) {
+                peers.push_back(state._peer);
+            }
+        }
+
+        for (const auto& peer : peers) {
+            _socket.SendTo(peer->_endpoint, datagram.data(), datagram.size());
+        }
+    }
+
+    void SfuRelay::UpdateRoomPeers(const std::string& name) {
+        // The peers are read before the room is looked up. A room created in between reads them itself, at least as recently.
+        auto peers = GetRoomPeers(name);
+
+        if (auto room = _findRoom(name)) {
+            room->GetWorker().Post([room, peers = std::move(peers)]() mutable {
+                room->SetRelayPeers(std::move(peers));
+            });
+        }
+    }
+
+    SfuRelay::PeerState* SfuRelay::FindPeer(const UdpEndpoint& endpoint) {
+        auto state = std::find_if(_peers.begin(), _peers.end(), [&endpoint](const PeerState& other) {
+            return other._peer->_endpoint == endpoint;
+        });
+
+        return state == _peers.end() ? nullptr : &*state;
+    }
+}
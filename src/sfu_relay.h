@@ -0,0 +1,265 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+#include "cluster_key.h"
+#include "replay_window.h"
+#include "udp_socket.h"
+
+namespace Comms {
+
+    class SfuRoom;
+
+    /*
+    * The link between one SFU node and the other nodes of a cascade, so that participants connected to different nodes can
+    * share a room.
+    *
+    * Nodes form a full mesh over UDP. Every node announces the rooms it has participants in to every other node once a
+    * second, and a node relays the packets of its own participants to each node that has announced the same room. Relayed
+    * packets are forwarded to the receiving node's participants but never relayed again, so each stream crosses between any
+    * two nodes exactly once, however many receivers the other node has, and no stream can loop.
+    *
+    * Rooms are matched by name. Relayed senders keep the participant id their own node gave them, so every node must have a
+    * distinct node id, which SfuServer places in the top byte of its participant ids.
+    *
+    * Relayed packets are sent and received in batches, so a busy link costs a system call per batch rather than per packet.
+    * @see UdpSocket
+    *
+    * Every datagram is signed with a key shared by the nodes, and carries the time it was sent and a counter numbering it
+    * within one of its node's streams. Each forwarding worker relays on a stream of its own, numbered as each batch is sent,
+    * so a stream's datagrams leave in the order they are numbered however a worker's rooms and the workers interleave,
+    * and arrive within the receiver's window. Announcements and departures share one more stream. Datagrams that are
+    * unsigned, signed with another key, more than 30 s old or already received on their node's stream are dropped before
+    * they are read, so only a node holding the key can announce rooms, be relayed to or inject media, and none of its
+    * datagrams can be replayed. The link is not encrypted, so it is still meant for a private network. @see ReplayWindow
+    */
+    class SfuRelay {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /*
+        * Settings for the relay link.
+        */
+        struct Configuration {
+            std::uint8_t _nodeId = 0; // Identifies the node within the cascade. Must be unique.
+            std::string _bindAddress = "0.0.0.0"; // Address the relay socket binds to.
+            std::uint16_t _port = 0; // Port the relay socket binds to. 0 selects any free port.
+            std::vector<std::string> _peers; // The other nodes' relay endpoints, as "host:port".
+            std::string _key; // Secret shared by every node, which signs the datagrams between them. Required.
+        };
+
+        /*
+        * Another node that packets can be relayed to. Held by the rooms that relay to it.
+        */
+        struct Peer {
+            const UdpEndpoint _endpoint; // The node's relay endpoint.
+            std::atomic<std::uint64_t> _mediaPacketsSent = 0; // Packets relayed to the node.
+            std::atomic<std::uint64_t> _mediaPacketsReceived = 0; // Packets relayed from the node.
+
+            Peer(UdpEndpoint endpoint) : _endpoint(endpoint) {}
+        };
+
+        /*
+        * What is known about another node, for monitoring.
+        */
+        struct PeerStatus {
+            std::string _endpoint; // The node's relay endpoint.
+            std::optional<std::uint8_t> _nodeId; // The node's id, once it has announced itself.
+            bool _isConfigured = false; // Whether the node was configured, rather than learned from its announcements.
+            std::optional<std::chrono::milliseconds> _sinceHeard; // Time since the node last announced itself.
+            std::vector<std::string> _rooms; // Rooms the node has participants in.
+            std::uint64_t _mediaPacketsSent = 0; // Packets relayed to the node.
+            std::uint64_t _mediaPacketsReceived = 0; // Packets relayed from the node.
+        };
+
+        /*
+        * Finds the local forwarding room with a name, or returns null if there is none.
+        */
+        using RoomFinder = std::function<std::shared_ptr<SfuRoom>(const std::string& name)>;
+
+        /*
+        * Constructor.
+        *
+        * @param configuration The relay settings.
+        */
+        SfuRelay(Configuration configuration);
+
+        /*
+        * Destructor. Stops the relay if it is running.
+        */
+        ~SfuRelay();
+
+        SfuRelay(const SfuRelay&) = delete;
+        SfuRelay& operator=(const SfuRelay&) = delete;
+
+        /*
+        * Binds the relay socket and starts receiving and announcing on a background thread.
+        *
+        * @param findRoom Finds the rooms relayed packets are delivered to. Called on the relay thread.
+        * @return False if no key is configured, a peer's endpoint cannot be parsed, or the socket could not be bound.
+        */
+        bool Start(RoomFinder findRoom);
+
+        /*
+        * Stops receiving and announcing. Rooms may still relay packets until the relay is destroyed.
+        */
+        void Stop();
+
+        /*
+        * @return The id of this node.
+        */
+        std::uint8_t GetNodeId() const;
+
+        /*
+        * @return The port the relay socket is bound to.
+        */
+        std::uint16_t GetPort() const;
+
+        /*
+        * Announces that this node has participants in a room, so other nodes relay theirs to it.
+        */
+        void AddLocalRoom(const std::string& name);
+
+        /*
+        * Announces that this node no longer has participants in a room.
+        */
+        void RemoveLocalRoom(const std::string& name);
+
+        /*
+        * @return The nodes that have participants in a room, which its local participants' packets are relayed to.
+        */
+        std::vector<std::shared_ptr<Peer>> GetRoomPeers(const std::string& name) const;
+
+        /*
+        * Queues a packet from a local participant to be relayed to other nodes. Safe to call from any worker.
+        *
+        * @param peers The nodes to relay to. The packet is copied into the batch once, however many there are.
+        * @param roomName The room the packet was received in.
+        * @param senderId The participant that sent the packet.
+        * @param audioLevelExtensionId The id the sender negotiated the audio level extension with, if it did.
+        * @param packet The RTP packet.
+        * @param batch The batch to queue the packet in, sent by SendQueuedMedia, which numbers and signs it.
+        */
+        void QueueMedia(const std::vector<std::shared_ptr<Peer>>& peers, const std::string& roomName, std::uint32_t senderId,
+            std::optional<int> audioLevelExtensionId, const rtc::binary& packet, UdpSendBatch& batch);
+
+        /*
+        * Numbers the packets queued in a batch by QueueMedia on a worker's stream, in the order they are sent, signs them,
+        * and sends them in as few system calls as possible, then clears the batch. Only called on the worker's thread.
+        *
+        * @param batch The batch.
+        * @param worker The index of the worker sending it.
+        */
+        void SendQueuedMedia(UdpSendBatch& batch, std::size_t worker);
+
+        /*
+        * Tells other nodes that a local participant has left a room, so they stop ranking them straight away.
+        */
+        void SendParticipantLeft(const std::vector<std::shared_ptr<Peer>>& peers, const std::string& roomName, std::uint32_t participantId);
+
+        /*
+        * @return What is known about each other node.
+        */
+        std::vector<PeerStatus> GetPeerStatus() const;
+
+    private:
+        /*
+        * Another node, and the rooms it has announced.
+        */
+        struct PeerState {
+            std::shared_ptr<Peer> _peer; // The node's relay endpoint and counters.
+            bool _isConfigured = false; // Whether the node was configured, rather than learned from its announcements.
+            std::optional<std::uint8_t> _nodeId; // The node's id, once it has announced itself.
+            std::optional<Clock::time_point> _lastHeard; // When the node last announced itself.
+            std::unordered_map<std::string, Clock::time_point> _rooms; // Rooms the node has participants in, and when each was last announced.
+        };
+
+        /*
+        * Receives datagrams and sends announcements until stopped.
+        */
+        void Run();
+
+        /*
+        * Handles one datagram from another node. Relay thread only.
+        *
+        * @param rooms Rooms already looked up for the datagram's batch, so a batch finds each room once.
+        */
+        void HandleDatagram(const UdpEndpoint& source, const std::byte* data, std::size_t size,
+            std::unordered_map<std::string, std::shared_ptr<SfuRoom>>& rooms);
+
+        /*
+        * Announces every local room to every node, and forgets rooms that nodes have stopped announcing. Relay thread only.
+        */
+        void Announce(Clock::time_point now);
+
+        /*
+        * Appends the signature of a datagram to it, once the rest has been written.
+        */
+        void Sign(std::vector<std::byte>& datagram) const;
+
+        /*
+        * Writes the signature of a datagram into its last SignatureSize bytes, once the rest has been written.
+        */
+        void Sign(std::byte* datagram, std::size_t size) const;
+
+        /*
+        * @return Whether a datagram's signature matches, it was sent recently and it has not been received before. Relay thread only.
+        */
+        bool Verify(const std::byte* data, std::size_t size);
+
+        /*
+        * Sends a list of room names to every node, split across as many datagrams as needed.
+        */
+        void SendRooms(std::uint8_t type, const std::vector<std::string>& names);
+
+        /*
+        * Sends a datagram to every node.
+        */
+        void SendToAll(const std::vector<std::byte>& datagram);
+
+        /*
+        * Tells a local room which nodes to relay to, after nodes have started or stopped announcing it. Relay thread only.
+        */
+        void UpdateRoomPeers(const std::string& name);
+
+        /*
+        * @return The node with an endpoint, or null if it is unknown. Requires _mutex.
+        */
+        PeerState* FindPeer(const UdpEndpoint& endpoint);
+
+        const Configuration _configuration; // The relay settings.
+        // Streams each worker's relayed media is numbered on, by its index modulo the count. Stream 0 is the relay's own.
+        static constexpr std::size_t MediaStreamCount = 255;
+
+        const ClusterKey _key; // Signs and verifies every datagram.
+        std::atomic<std::uint64_t> _nextCounter; // Numbers the next announcement or departure sent, on stream 0.
+        std::array<std::atomic<std::uint64_t>, MediaStreamCount> _nextMediaCounters; // Numbers the next media datagram sent on each worker's stream.
+        std::unordered_map<std::uint16_t, ReplayWindow> _replayWindows; // The counters received on each node's streams, by its id and the stream. Relay thread only.
+
+        UdpSocket _socket; // Sends and receives all relay traffic.
+
+        std::vector<PeerState> _peers; // The other nodes, configured ones first.
+        std::set<std::string> _localRooms; // Rooms this node has participants in.
+        mutable std::mutex _mutex; // Mutex to control read and write access to _peers and _localRooms.
+
+        RoomFinder _findRoom; // Finds the rooms relayed packets are delivered to.
+        Clock::time_point _nextAnnouncement; // When local rooms are next announced. Relay thread only.
+        std::atomic<bool> _isStopping = false; // Set when the relay thread is stopping.
+        std::thread _thread; // Receives datagrams and sends announcements.
+    };
+}
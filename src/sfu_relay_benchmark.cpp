@@ -0,0 +1,144 @@
+#include "sfu_relay_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sfu_relay.h"
+#include "udp_socket.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const char* RoomName = "sfu-relay";
+    const char* RelayKey = "sfu-relay-benchmark-key";
+
+    constexpr std::size_t PacketSize = 120; // A 20 ms Opus packet at 32 kbps, with its RTP header.
+    constexpr std::uint32_t SenderId = 0x01000001; // A participant of the sending node.
+    constexpr std::chrono::milliseconds PollInterval(10);
+
+    /*
+    * @return The media packets a node has accepted from every other node.
+    */
+    std::uint64_t GetReceivedCount(const Comms::SfuRelay& relay) {
+        std::uint64_t count = 0;
+
+        for (const auto& peer : relay.GetPeerStatus()) {
+            count += peer._mediaPacketsReceived;
+        }
+
+        return count;
+    }
+
+    /*
+    * Polls until a condition holds or a deadline passes.
+    *
+    * @return Whether the condition held.
+    */
+    bool WaitUntil(const std::function<bool()>& condition, Clock::time_point deadline) {
+        while (!condition()) {
+            if (Clock::now() >= deadline) {
+                return false;
+            }
+
+            std::this_thread::sleep_for(PollInterval);
+        }
+
+        return true;
+    }
+}
+
+namespace Comms {
+    SfuRelayBenchmark::SfuRelayBenchmark(const CommandLineOptions& options) :
+        _workerCount(static_cast<std::size_t>(std::max<std::int64_t>(options.GetInteger("workers", 2), 1))),
+        _packetCount(static_cast<std::size_t>(std::max<std::int64_t>(options.GetInteger("packets", 1100), 1))),
+        _timeoutSeconds(std::max(options.GetDouble("timeout", 5.0), 0.1)) {
+    }
+
+    nlohmann::json SfuRelayBenchmark::Run() {
+        const auto timeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(_timeoutSeconds));
+
+        // The receiving node has no rooms to deliver to. It counts each packet it accepts before looking for its room.
+        const auto findNoRoom = [](const std::string&) { return std::shared_ptr<SfuRoom>(); };
+
+        SfuRelay::Configuration senderConfiguration;
+        senderConfiguration._nodeId = 1;
+        senderConfiguration._bindAddress = "127.0.0.1";
+        senderConfiguration._key = RelayKey;
+
+        SfuRelay sender(senderConfiguration);
+
+        if (!sender.Start(findNoRoom)) {
+            return { {"error", "Failed to start the sending node"} };
+        }
+
+        // The sender learns of the receiver from its announcements, as a node configured on one side only.
+        SfuRelay::Configuration receiverConfiguration;
+        receiverConfiguration._nodeId = 2;
+        receiverConfiguration._bindAddress = "127.0.0.1";
+        receiverConfiguration._peers = { "127.0.0.1:" + std::to_string(sender.GetPort()) };
+        receiverConfiguration._key = RelayKey;
+
+        SfuRelay receiver(receiverConfiguration);
+
+        if (!receiver.Start(findNoRoom)) {
+            return { {"error", "Failed to start the receiving node"} };
+        }
+
+        receiver.AddLocalRoom(RoomName);
+
+        if (!WaitUntil([&sender]() { return !sender.GetRoomPeers(RoomName).empty(); }, Clock::now() + timeout)) {
+            return { {"error", "The sending node did not learn of the receiving node's room"} };
+        }
+
+        const auto peers = sender.GetRoomPeers(RoomName);
+
+        rtc::binary packet(PacketSize);
+        packet[0] = std::byte{ 0x80 }; // RTP version 2.
+        packet[1] = std::byte{ 111 }; // Opus.
+
+        std::vector<UdpSendBatch> batches(_workerCount);
+
+        for (auto& batch : batches) {
+            for (std::size_t i = 0; i < _packetCount; i++) {
+                sender.QueueMedia(peers, RoomName, SenderId, std::nullopt, packet, batch);
+            }
+        }
+
+        // Sent in reverse, so the first batch queued is the last sent.
+        const auto start = Clock::now();
+        std::uint64_t sentCount = 0;
+        bool isDelivered = true;
+
+        for (std::size_t worker = _workerCount; worker-- > 0 && isDelivered;) {
+            sender.SendQueuedMedia(batches[worker], worker);
+            sentCount += _packetCount;
+
+            isDelivered = WaitUntil([&receiver, sentCount]() { return GetReceivedCount(receiver) >= sentCount; }, Clock::now() + timeout);
+        }
+
+        const double relaySeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const auto receivedCount = GetReceivedCount(receiver);
+        const auto expectedCount = static_cast<std::uint64_t>(_workerCount * _packetCount);
+
+        nlohmann::json results = {
+            {"workers", _workerCount},
+            {"packets_per_worker", _packetCount},
+            {"sent", sentCount},
+            {"received", receivedCount},
+            {"dropped", expectedCount - std::min(receivedCount, expectedCount)},
+            {"relay_s", relaySeconds}
+        };
+
+        if (receivedCount < expectedCount) {
+            results["error"] = std::to_string(expectedCount - receivedCount) + " of " + std::to_string(expectedCount) + " relayed packets were dropped";
+        }
+
+        return results;
+    }
+}
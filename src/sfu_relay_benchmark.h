@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Relays batches of packets between two SfuRelay nodes over loopback, one batch per forwarding worker, and checks that the
+    * receiving node accepts every one. Each worker's batch holds more packets than a ReplayWindow remembers, and the
+    * workers queue their batches in order but send them in reverse, as their flushes interleave on a busy node, so a node
+    * that numbered every packet on one stream as it was queued would see the first worker's packets arrive too far behind.
+    *
+    * Each batch is sent once the one before has arrived, so the receive buffer only needs to hold one batch. Reports the
+    * packets relayed and accepted, and fails with an error if any was dropped.
+    *
+    * Options:
+    *   --workers <n>   Workers relaying a batch each. Default 2.
+    *   --packets <n>   Packets in each worker's batch. Default 1100.
+    *   --timeout <s>   Seconds the nodes have to find each other, and each batch has to arrive. Default 5.
+    */
+    class SfuRelayBenchmark : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The benchmark's command line options.
+        */
+        SfuRelayBenchmark(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const std::size_t _workerCount; // Workers relaying a batch each.
+        const std::size_t _packetCount; // Packets in each worker's batch.
+        const double _timeoutSeconds; // Seconds the nodes have to find each other, and each batch has to arrive.
+    };
+}
@@ -0,0 +1,271 @@
+#include "sfu_room.h"
+
+#include <algorithm>
+
+#include "metrics.h"
+#include "opus_packet.h"
+#include "rtp_packet.h"
+#include "sfu_worker.h"
+
+namespace {
+    // SSRCs of the outgoing slots. Clients send on their own fixed SSRC, which is outside this range.
+    constexpr std::uint32_t SlotSSRCBase = 1000;
+
+    // The level assumed for packets with audio but without the audio level extension, -30 dBov, a typical speaking level.
+    constexpr Comms::AudioLevel UnmeasuredSpeechLevel{ 30, true };
+
+    // Relayed senders are forgotten after this long without a packet. Opus DTX still sends a packet every 400 ms.
+    constexpr std::chrono::seconds RelayedSenderTimeout(10);
+    constexpr std::chrono::seconds RelayedSenderSweepInterval(1);
+
+    Comms::Counter& ReceivedPacketsTotal = Comms::Metrics::AddCounter("comms_sfu_received_packets_total", "RTP packets received from participants and other nodes.");
+    Comms::Counter& ForwardedPacketsTotal = Comms::Metrics::AddCounter("comms_sfu_forwarded_packets_total", "RTP packets forwarded to participants.");
+    Comms::Counter& ForwardedBytesTotal = Comms::Metrics::AddCounter("comms_sfu_forwarded_bytes_total", "Bytes of RTP forwarded to participants.");
+
+    /*
+    * @return The level of a packet's audio, from its audio level extension, or silence if its Opus payload carries no audio.
+    */
+    std::optional<Comms::AudioLevel> GetPacketAudioLevel(const rtc::binary& packet, std::optional<int> audioLevelExtensionId) {
+        const auto payload = Comms::GetRtpPayload(packet.data(), packet.size());
+
+        if (!payload.has_value()) {
+            return std::nullopt;
+        }
+
+        if (Comms::IsOpusSilence(packet.data() + payload->first, payload->second)) {
+            return Comms::AudioLevel(); // DTX is silent whatever level the sender attached.
+        }
+
+        if (audioLevelExtensionId.has_value()) {
+            if (auto level = Comms::ReadAudioLevel(packet.data(), packet.size(), *audioLevelExtensionId)) {
+                return level;
+            }
+        }
+
+        return UnmeasuredSpeechLevel;
+    }
+}
+
+namespace Comms {
+    SfuParticipant::SfuParticipant(std::uint32_t id, std::shared_ptr<rtc::PeerConnection> peerConnection, std::shared_ptr<rtc::Track> track, std::size_t slotCount,
+        std::optional<int> audioLevelExtensionId) :
+        _id(id),
+        _peerConnection(peerConnection),
+        _track(track),
+        _audioLevelExtensionId(audioLevelExtensionId),
+        _isSlotAssigned(slotCount, false) {
+        _slots.reserve(slotCount);
+
+        for (std::size_t slot = 0; slot < slotCount; slot++) {
+            _slots.emplace_back(GetSlotSSRC(slot));
+        }
+    }
+
+    std::uint32_t SfuParticipant::GetSlotSSRC(std::size_t slot) {
+        return SlotSSRCBase + static_cast<std::uint32_t>(slot);
+    }
+
+    std::uint32_t SfuParticipant::GetId() const {
+        return _id;
+    }
+
+    const std::shared_ptr<rtc::Track>& SfuParticipant::GetTrack() const {
+        return _track;
+    }
+
+    const std::shared_ptr<rtc::PeerConnection>& SfuParticipant::GetPeerConnection() const {
+        return _peerConnection;
+    }
+
+    std::optional<int> SfuParticipant::GetAudioLevelExtensionId() const {
+        return _audioLevelExtensionId;
+    }
+
+    void SfuParticipant::Disconnect() {
+        _track->resetCallbacks();
+        _peerConnection->resetCallbacks();
+        _peerConnection->close();
+    }
+
+    RtpSlotRewriter* SfuParticipant::GetSlot(std::uint32_t senderId) {
+        if (auto assigned = _slotBySender.find(senderId); assigned != _slotBySender.end()) {
+            return &_slots[assigned->second];
+        }
+
+        auto freeSlot = std::find(_isSlotAssigned.begin(), _isSlotAssigned.end(), false);
+
+        if (freeSlot == _isSlotAssigned.end()) {
+            return nullptr;
+        }
+
+        *freeSlot = true;
+
+        const auto slot = static_cast<std::size_t>(freeSlot - _isSlotAssigned.begin());
+        _slotBySender[senderId] = slot;
+
+        return &_slots[slot];
+    }
+
+    void SfuParticipant::ReleaseSlot(std::uint32_t senderId) {
+        if (auto assigned = _slotBySender.find(senderId); assigned != _slotBySender.end()) {
+            _isSlotAssigned[assigned->second] = false;
+            _slotBySender.erase(assigned);
+        }
+    }
+
+    SfuRoom::SfuRoom(std::string name, std::string password, SfuWorker& worker, std::size_t lastN, SfuRelay* relay) :
+        MediaRoom(name, password, worker),
+        _speakers(lastN),
+        _relay(relay) {
+
+        if (_relay != nullptr) {
+            _relayPeers = _relay->GetRoomPeers(GetName());
+        }
+    }
+
+    void SfuRoom::AddParticipant(std::shared_ptr<SfuParticipant> participant) {
+        _participants.push_back(participant);
+        _speakers.AddSpeaker(participant->GetId(), ActiveSpeakerDetector::Clock::now());
+    }
+
+    void SfuRoom::RemoveParticipant(std::uint32_t participantId) {
+        auto participant = std::find_if(_participants.begin(), _participants.end(), [participantId](const auto& other) {
+            return other->GetId() == participantId;
+        });
+
+        if (participant == _participants.end()) {
+            return;
+        }
+
+        (*participant)->Disconnect();
+        _participants.erase(participant);
+        RemoveSender(participantId, ActiveSpeakerDetector::Clock::now());
+
+        if (_relay != nullptr && !_relayPeers.empty()) {
+            _relay->SendParticipantLeft(_relayPeers, GetName(), participantId);
+        }
+    }
+
+    void SfuRoom::Close() {
+        auto participants = std::move(_participants);
+        _participants.clear();
+
+        for (const auto& participant : participants) {
+            participant->Disconnect();
+        }
+    }
+
+    void SfuRoom::Receive(std::uint32_t senderId, const rtc::binary& packet) {
+        if (packet.size() < sizeof(rtc::RtpHeader)) {
+            return;
+        }
+
+        // Packets queued before their sender left are dropped, rather than claiming slots that were just released.
+        auto sender = std::find_if(_participants.begin(), _participants.end(), [senderId](const auto& participant) {
+            return participant->GetId() == senderId;
+        });
+
+        if (sender == _participants.end()) {
+            return;
+        }
+
+        // Every packet is relayed, not only the local last-N, as the other nodes rank all of the room's senders themselves.
+        if (_relay != nullptr && !_relayPeers.empty()) {
+            _relay->QueueMedia(_relayPeers, GetName(), senderId, (*sender)->GetAudioLevelExtensionId(), packet, _relayBatch);
+        }
+
+        Forward(senderId, (*sender)->GetAudioLevelExtensionId(), packet);
+    }
+
+    void SfuRoom::ReceiveRelayed(std::uint32_t senderId, std::optional<int> audioLevelExtensionId, const rtc::binary& packet) {
+        if (packet.size() < sizeof(rtc::RtpHeader)) {
+            return;
+        }
+
+        const auto now = ActiveSpeakerDetector::Clock::now();
+
+        if (now >= _nextRelayedSenderSweep) {
+            RemoveSilentRelayedSenders(now);
+            _nextRelayedSenderSweep = now + RelayedSenderSweepInterval;
+        }
+
+        if (auto [sender, isNew] = _relayedSenders.insert_or_assign(senderId, now); isNew) {
+            _speakers.AddSpeaker(senderId, now);
+        }
+
+        Forward(senderId, audioLevelExtensionId, packet);
+    }
+
+    void SfuRoom::Flush() {
+        if (_relayBatch.GetDatagramCount() > 0) {
+            _relay->SendQueuedMedia(_relayBatch, GetWorker().GetIndex());
+        }
+    }
+
+    void SfuRoom::SetRelayPeers(std::vector<std::shared_ptr<SfuRelay::Peer>> peers) {
+        _relayPeers = std::move(peers);
+    }
+
+    void SfuRoom::RemoveRelayedSender(std::uint32_t senderId) {
+        if (_relayedSenders.erase(senderId) > 0) {
+            RemoveSender(senderId, ActiveSpeakerDetector::Clock::now());
+        }
+    }
+
+    void SfuRoom::Forward(std::uint32_t senderId, std::optional<int> audioLevelExtensionId, const rtc::binary& packet) {
+        ReceivedPacketsTotal.Increment();
+        const auto level = GetPacketAudioLevel(packet, audioLevelExtensionId);
+
+        if (!level.has_value()) {
+            return;
+        }
+
+        // Demoted speakers give up their slots, so the speakers that replaced them take over continuous streams.
+        for (const auto demotedId : _speakers.Update(senderId, *level, ActiveSpeakerDetector::Clock::now())) {
+            for (const auto& receiver : _participants) {
+                receiver->ReleaseSlot(demotedId);
+            }
+        }
+
+        for (const auto& receiver : _participants) {
+            if (!_speakers.IsForwarded(senderId, receiver->GetId()) || !receiver->GetTrack()->isOpen()) {
+                continue;
+            }
+
+            auto slot = receiver->GetSlot(senderId);
+
+            if (slot == nullptr) {
+                continue; // More senders than the receiver has slots.
+            }
+
+            _forwardBuffer.assign(packet.begin(), packet.end());
+            slot->Rewrite(*reinterpret_cast<rtc::RtpHeader*>(_forwardBuffer.data()), senderId);
+
+            receiver->GetTrack()->send(_forwardBuffer.data(), _forwardBuffer.size());
+            ForwardedPacketsTotal.Increment();
+            ForwardedBytesTotal.Increment(_forwardBuffer.size());
+        }
+    }
+
+    void SfuRoom::RemoveSilentRelayedSenders(ActiveSpeakerDetector::Clock::time_point now) {
+        std::vector<std::uint32_t> silentSenders;
+
+        for (const auto& [senderId, lastPacket] : _relayedSenders) {
+            if (now - lastPacket >= RelayedSenderTimeout) {
+                silentSenders.push_back(senderId);
+            }
+        }
+
+        for (const auto senderId : silentSenders) {
+            RemoveRelayedSender(senderId);
+        }
+    }
+
+    void SfuRoom::RemoveSender(std::uint32_t senderId, ActiveSpeakerDetector::Clock::time_point now) {
+        _speakers.RemoveSpeaker(senderId, now);
+
+        for (const auto& receiver : _participants) {
+            receiver->ReleaseSlot(senderId);
+        }
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+#include "active_speaker_detector.h"
+#include "media_room.h"
+#include "rtp_slot_rewriter.h"
+#include "sfu_relay.h"
+
+namespace Comms {
+
+    /*
+    * A participant connected to the SFU.
+    *
+    * The participant's session description declares a fixed number of outgoing SSRC slots, and each other participant it
+    * hears is forwarded on one of them. Slot assignment is owned by the worker thread of the participant's room.
+    */
+    class SfuParticipant {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param id Identifies the participant within the SFU.
+        * @param peerConnection The participant's peer connection.
+        * @param track The participant's audio track.
+        * @param slotCount The number of outgoing SSRC slots negotiated for the participant.
+        * @param audioLevelExtensionId The id the participant negotiated the audio level extension with, if it did.
+        */
+        SfuParticipant(std::uint32_t id, std::shared_ptr<rtc::PeerConnection> peerConnection, std::shared_ptr<rtc::Track> track, std::size_t slotCount,
+            std::optional<int> audioLevelExtensionId);
+
+        /*
+        * @return The SSRC of an outgoing slot, as declared in the participant's session description.
+        */
+        static std::uint32_t GetSlotSSRC(std::size_t slot);
+
+        /*
+        * @return Identifies the participant within the SFU.
+        */
+        std::uint32_t GetId() const;
+
+        /*
+        * @return The participant's audio track.
+        */
+        const std::shared_ptr<rtc::Track>& GetTrack() const;
+
+        /*
+        * @return The participant's peer connection.
+        */
+        const std::shared_ptr<rtc::PeerConnection>& GetPeerConnection() const;
+
+        /*
+        * @return The id the participant negotiated the audio level extension with, if it did.
+        */
+        std::optional<int> GetAudioLevelExtensionId() const;
+
+        /*
+        * Clears the callbacks of the participant's track and peer connection, waiting for any that are running, then closes
+        * the peer connection. No callback of the participant runs afterwards, so none can reach a room or server that is
+        * being destroyed.
+        */
+        void Disconnect();
+
+        /*
+        * Returns the slot a sender is forwarded to this participant on, assigning a free slot if it has none.
+        * Worker thread only.
+        *
+        * @return The slot, or null if every slot is assigned to another sender.
+        */
+        RtpSlotRewriter* GetSlot(std::uint32_t senderId);
+
+        /*
+        * Frees the slot assigned to a sender, if any. Worker thread only.
+        */
+        void ReleaseSlot(std::uint32_t senderId);
+
+    private:
+        const std::uint32_t _id; // Identifies the participant within the SFU.
+        const std::shared_ptr<rtc::PeerConnection> _peerConnection; // The participant's peer connection.
+        const std::shared_ptr<rtc::Track> _track; // The participant's audio track.
+        const std::optional<int> _audioLevelExtensionId; // The id the participant negotiated the audio level extension with.
+
+        std::vector<RtpSlotRewriter> _slots; // The outgoing slots.
+        std::vector<bool> _isSlotAssigned; // Whether each slot is assigned to a sender.
+        std::unordered_map<std::uint32_t, std::size_t> _slotBySender; // The slot each sender is forwarded on.
+    };
+
+    /*
+    * A room of participants whose audio is forwarded to each other.
+    *
+    * RTP packets are forwarded without decoding. Only the SSRC, sequence number and timestamp are rewritten for each receiver.
+    * In large rooms only the last-N loudest speakers are forwarded, ranked by the audio level extension and Opus silence.
+    *
+    * When the SFU is part of a cascade, the room also relays its participants' packets to the other nodes with participants in
+    * a room of the same name, and ranks and forwards the packets those nodes relay to it like its own participants'.
+    * @see SfuRelay
+    */
+    class SfuRoom : public MediaRoom {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param name The name identifying the room.
+        * @param password The password required to join the room.
+        * @param worker The worker the room is pinned to.
+        * @param lastN The number of speakers forwarded to each receiver. 0 forwards every speaker.
+        * @param relay The link to the other nodes of the cascade, or null if the SFU is not cascaded. Must outlive the room.
+        */
+        SfuRoom(std::string name, std::string password, SfuWorker& worker, std::size_t lastN, SfuRelay* relay);
+
+        void AddParticipant(std::shared_ptr<SfuParticipant> participant) override;
+
+        /*
+        * Removes a participant, closes its peer connection and frees the slots it was forwarded on, and tells the other nodes
+        * it has left.
+        */
+        void RemoveParticipant(std::uint32_t participantId) override;
+
+        void Close() override;
+
+        /*
+        * Ranks the sender by the packet's audio level, and forwards the packet to every other participant if the sender is
+        * one of the last-N speakers. Relays the packet to the other nodes in the room.
+        */
+        void Receive(std::uint32_t senderId, const rtc::binary& packet) override;
+
+        /*
+        * Ranks and forwards a packet relayed from another node like a participant's, without relaying it any further.
+        */
+        void ReceiveRelayed(std::uint32_t senderId, std::optional<int> audioLevelExtensionId, const rtc::binary& packet) override;
+
+        /*
+        * Sends the packets relayed while handling the worker's last run of packets, in as few system calls as possible.
+        */
+        void Flush() override;
+
+        /*
+        * Sets the other nodes with participants in the room, which participants' packets are relayed to.
+        */
+        void SetRelayPeers(std::vector<std::shared_ptr<SfuRelay::Peer>> peers);
+
+        /*
+        * Stops ranking a sender connected to another node and frees the slots it was forwarded on.
+        */
+        void RemoveRelayedSender(std::uint32_t senderId);
+
+    private:
+        /*
+        * Ranks a sender by a packet's audio level, and forwards the packet to every participant but the sender if the sender
+        * is one of the last-N speakers.
+        */
+        void Forward(std::uint32_t senderId, std::optional<int> audioLevelExtensionId, const rtc::binary& packet);
+
+        /*
+        * Stops ranking relayed senders that have sent nothing for a while, such as those whose node has failed.
+        */
+        void RemoveSilentRelayedSenders(ActiveSpeakerDetector::Clock::time_point now);
+
+        /*
+        * Stops ranking a sender and frees the slots it was forwarded on.
+        */
+        void RemoveSender(std::uint32_t senderId, ActiveSpeakerDetector::Clock::time_point now);
+
+        std::vector<std::shared_ptr<SfuParticipant>> _participants; // The participants, in the order they joined.
+        ActiveSpeakerDetector _speakers; // Chooses which participants are forwarded.
+        rtc::binary _forwardBuffer; // Reused for each rewritten copy of a packet, so forwarding does not allocate.
+
+        SfuRelay* const _relay; // The link to the other nodes of the cascade, or null.
+        std::vector<std::shared_ptr<SfuRelay::Peer>> _relayPeers; // The other nodes with participants in the room.
+        UdpSendBatch _relayBatch; // Packets to relay, sent together when the worker flushes the room.
+        std::unordered_map<std::uint32_t, ActiveSpeakerDetector::Clock::time_point> _relayedSenders; // Senders on other nodes, and when each last sent.
+        ActiveSpeakerDetector::Clock::time_point _nextRelayedSenderSweep; // When silent relayed senders are next looked for.
+    };
+}
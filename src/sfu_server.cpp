@@ -0,0 +1,440 @@
+#include "sfu_server.h"
+
+#include <future>
+
+#include "json/json.hpp"
+
+#include "audio_level.h"
+#include "mcu_room.h"
+#include "metrics.h"
+#include "metrics_server.h"
+
+using json = nlohmann::json;
+
+namespace {
+    constexpr std::chrono::seconds GatheringTimeout(10);
+    constexpr int OpusPayloadType = 111;
+
+    Comms::Counter& AcceptedJoinsTotal = Comms::Metrics::AddCounter("comms_sfu_joins_total", "Requests to join a room, by result.", "result=\"accepted\"");
+    Comms::Counter& RejectedJoinsTotal = Comms::Metrics::AddCounter("comms_sfu_joins_total", "Requests to join a room, by result.", "result=\"rejected\"");
+    Comms::Counter& FailedJoinsTotal = Comms::Metrics::AddCounter("comms_sfu_joins_total", "Requests to join a room, by result.", "result=\"failed\"");
+
+    /*
+    * The audio section of a participant's offer.
+    */
+    struct OfferedAudio {
+        std::string _mid; // The media stream identification tag.
+        std::optional<int> _audioLevelExtensionId; // The id offered for the audio level extension, if it was offered.
+    };
+
+    /*
+    * @return The first audio section of a session description, if it has one.
+    */
+    std::optional<OfferedAudio> GetOfferedAudio(rtc::Description& description) {
+        for (unsigned int i = 0; i < description.mediaCount(); i++) {
+            auto media = description.media(i);
+
+            if (!std::holds_alternative<rtc::Description::Media*>(media)) {
+                continue;
+            }
+
+            auto audio = std::get<rtc::Description::Media*>(media);
+
+            if (audio->type() != "audio") {
+                continue;
+            }
+
+            OfferedAudio offered{ audio->mid(), std::nullopt };
+
+            for (const auto id : audio->extIds()) {
+                if (audio->extMap(id)->uri == Comms::AudioLevelExtensionURI) {
+                    offered._audioLevelExtensionId = id;
+                }
+            }
+
+            return offered;
+        }
+
+        return std::nullopt;
+    }
+}
+
+namespace Comms {
+    SfuServer::SfuServer(Configuration configuration) :
+        _configuration(configuration),
+        _roomsPerWorker(std::max<std::size_t>(configuration._workerCount, 1), 0),
+        _nextParticipantId((static_cast<std::uint32_t>(configuration._nodeId) << 24) + 1) {
+
+        if (_configuration._relayPort.has_value() && !_configuration._isMixing) {
+            SfuRelay::Configuration relayConfiguration;
+            relayConfiguration._nodeId = _configuration._nodeId;
+            relayConfiguration._bindAddress = _configuration._bindAddress;
+            relayConfiguration._port = *_configuration._relayPort;
+            relayConfiguration._peers = _configuration._relayPeers;
+            relayConfiguration._key = _configuration._relayKey;
+
+            _relay = std::make_unique<SfuRelay>(relayConfiguration);
+        }
+
+        for (std::size_t i = 0; i < _roomsPerWorker.size(); i++) {
+            _workers.push_back(std::make_unique<SfuWorker>(i));
+        }
+
+        if (_configuration._certificatePemFile.has_value() && _configuration._keyPemFile.has_value()) {
+            _httpServer = std::make_unique<httplib::SSLServer>(_configuration._certificatePemFile->c_str(), _configuration._keyPemFile->c_str());
+        }
+        else {
+            _httpServer = std::make_unique<httplib::Server>();
+        }
+
+        const auto threadCount = std::max<std::size_t>(_configuration._httpThreadCount, 1);
+        _httpServer->new_task_queue = [threadCount]() { return new httplib::ThreadPool(threadCount); };
+        _httpServer->set_tcp_nodelay(true);
+
+        _httpServer->Post("/join", [this](const httplib::Request& request, httplib::Response& response) {
+            HandleJoin(request, response);
+        });
+
+        _httpServer->Get("/status", [this](const httplib::Request& request, httplib::Response& response) {
+            HandleStatus(request, response);
+        });
+
+        MetricsServer::AddRoute(*_httpServer);
+    }
+
+    SfuServer::~SfuServer() {
+        Stop();
+    }
+
+    bool SfuServer::Start() {
+        if (!_httpServer->is_valid()) {
+            return false; // The certificate or key could not be loaded.
+        }
+
+        if (_configuration._httpPort == 0) {
+            _httpPort = _httpServer->bind_to_any_port(_configuration._bindAddress);
+        }
+        else if (_httpServer->bind_to_port(_configuration._bindAddress, _configuration._httpPort)) {
+            _httpPort = _configuration._httpPort;
+        }
+        else {
+            _httpPort = -1;
+        }
+
+        if (_httpPort < 0) {
+            return false;
+        }
+
+        if (_relay != nullptr && !_relay->Start([this](const std::string& name) { return FindRelayRoom(name); })) {
+            _httpServer->stop();
+            return false;
+        }
+
+        _httpThread = std::thread([this]() { _httpServer->listen_after_bind(); });
+        _httpServer->wait_until_ready();
+
+        return true;
+    }
+
+    void SfuServer::Wait() {
+        if (_httpThread.joinable()) {
+            _httpThread.join();
+        }
+    }
+
+    void SfuServer::Stop() {
+        _httpServer->stop();
+        Wait();
+
+        // Relaying stops first, so no relayed packet or update can be queued to a worker after it has been destroyed.
+        if (_relay != nullptr) {
+            _relay->Stop();
+        }
+
+        // Rooms are released outside the lock, as closing their peer connections runs callbacks that take it.
+        std::unordered_map<std::string, RoomEntry> rooms;
+        {
+            std::lock_guard<std::mutex> lock(_roomsMutex);
+            rooms.swap(_rooms);
+        }
+
+        // Peer connections are closed on their rooms' workers, and every close waited for before the workers are destroyed.
+        // Closing clears the participants' callbacks, so none can queue a packet to a worker, or leave a room through it,
+        // after it has been destroyed.
+        std::vector<std::future<void>> closes;
+
+        for (const auto& [name, entry] : rooms) {
+            auto closed = std::make_shared<std::promise<void>>();
+            closes.push_back(closed->get_future());
+
+            entry._room->GetWorker().Post([room = entry._room, closed]() {
+                room->Close();
+                closed->set_value();
+            });
+        }
+
+        for (auto& closed : closes) {
+            closed.wait();
+        }
+
+        _workers.clear();
+        rooms.clear();
+    }
+
+    int SfuServer::GetHttpPort() const {
+        return _httpPort;
+    }
+
+    std::uint16_t SfuServer::GetRelayPort() const {
+        return _relay != nullptr ? _relay->GetPort() : 0;
+    }
+
+    void SfuServer::HandleJoin(const httplib::Request& request, httplib::Response& response) {
+        auto body = json::parse(request.body, nullptr, false);
+
+        if (body.is_discarded() || !body.contains("connectionName") || !body.contains("offer")) {
+            response.status = 400;
+            return;
+        }
+
+        auto room = EnterRoom(body.value("connectionName", ""), body.value("password", ""));
+
+        if (room == nullptr) {
+            RejectedJoinsTotal.Increment();
+            response.status = 403;
+            return;
+        }
+
+        auto participant = ConnectParticipant(room, body.value("offer", ""));
+
+        if (!participant.has_value()) {
+            LeaveRoom(room, std::nullopt);
+            FailedJoinsTotal.Increment();
+            response.status = 400;
+            return;
+        }
+
+        AcceptedJoinsTotal.Increment();
+
+        json answer = {
+            {"participant", participant->first},
+            {"answer", participant->second}
+        };
+
+        response.set_content(answer.dump(), "application/json");
+    }
+
+    void SfuServer::HandleStatus([[maybe_unused]] const httplib::Request& request, httplib::Response& response) {
+        json status;
+        {
+            std::lock_guard<std::mutex> lock(_roomsMutex);
+            status = {
+                {"rooms", _rooms.size()},
+                {"participants", _participantCount.load()},
+                {"workers", _roomsPerWorker}
+            };
+        }
+
+        if (_relay != nullptr) {
+            json peers = json::array();
+
+            for (const auto& peer : _relay->GetPeerStatus()) {
+                peers.push_back({
+                    {"endpoint", peer._endpoint},
+                    {"node", peer._nodeId.has_value() ? json(*peer._nodeId) : json(nullptr)},
+                    {"configured", peer._isConfigured},
+                    {"last_heard_ms", peer._sinceHeard.has_value() ? json(peer._sinceHeard->count()) : json(nullptr)},
+                    {"rooms", peer._rooms},
+                    {"packets_sent", peer._mediaPacketsSent},
+                    {"packets_received", peer._mediaPacketsReceived}
+                });
+            }
+
+            status["relay"] = {
+                {"node", _relay->GetNodeId()},
+                {"port", _relay->GetPort()},
+                {"peers", peers}
+            };
+        }
+
+        response.set_content(status.dump(), "application/json");
+    }
+
+    std::optional<std::pair<std::uint32_t, std::string>> SfuServer::ConnectParticipant(const std::shared_ptr<MediaRoom>& room, const std::string& offer) {
+        std::optional<OfferedAudio> offeredAudio;
+
+        try {
+            rtc::Description description(offer, rtc::Description::Type::Offer);
+            offeredAudio = GetOfferedAudio(description);
+        }
+        catch (const std::exception&) {
+            return std::nullopt; // Not a valid session description.
+        }
+
+        if (!offeredAudio.has_value()) {
+            return std::nullopt;
+        }
+
+        const auto participantId = _nextParticipantId++;
+        auto peerConnection = std::make_shared<rtc::PeerConnection>(GetPeerConfiguration());
+
+        auto gathered = std::make_shared<std::promise<void>>();
+        auto gatheredFuture = gathered->get_future();
+
+        // Gathering completes again if ICE restarts, and a promise can only be set once.
+        auto isGathered = std::make_shared<std::atomic<bool>>(false);
+
+        peerConnection->onGatheringStateChange([gathered, isGathered](rtc::PeerConnection::GatheringState state) {
+            if (state == rtc::PeerConnection::GatheringState::Complete && !isGathered->exchange(true)) {
+                gathered->set_value(); // Candidates are sent in the answer rather than trickled.
+            }
+        });
+
+        // The SFU's audio section mirrors the participant's, declaring one SSRC per slot so the participant accepts every forwarded stream.
+        rtc::Description::Audio media(offeredAudio->_mid, rtc::Description::Direction::SendRecv);
+
+        // A mixing room sends each participant a single stream.
+        const std::size_t slotCount = _configuration._isMixing ? 1 : _configuration._slotCount;
+
+        for (std::size_t slot = 0; slot < slotCount; slot++) {
+            media.addSSRC(SfuParticipant::GetSlotSSRC(slot), "sfu");
+        }
+
+        media.addOpusCodec(OpusPayloadType);
+
+        if (offeredAudio->_audioLevelExtensionId.has_value()) {
+            media.addExtMap(rtc::Description::Entry::ExtMap(*offeredAudio->_audioLevelExtensionId, AudioLevelExtensionURI));
+        }
+
+        auto track = peerConnection->addTrack(media);
+        auto participant = std::make_shared<SfuParticipant>(participantId, peerConnection, track, slotCount, offeredAudio->_audioLevelExtensionId);
+
+        std::weak_ptr<MediaRoom> weakRoom = room;
+
+        track->onMessage([weakRoom, participantId](rtc::binary message) {
+            if (rtc::IsRtcp(message)) {
+                return; // Reports from participants terminate at the SFU.
+            }
+
+            if (auto room = weakRoom.lock()) {
+                room->GetWorker().PostPacket(room, participantId, std::move(message));
+            }
+        }, nullptr);
+
+        auto hasLeft = std::make_shared<std::atomic<bool>>(false);
+
+        peerConnection->onStateChange([this, weakRoom, participantId, hasLeft](rtc::PeerConnection::State state) {
+            if (state != rtc::PeerConnection::State::Failed && state != rtc::PeerConnection::State::Closed) {
+                return;
+            }
+
+            auto room = weakRoom.lock();
+
+            if (room != nullptr && !hasLeft->exchange(true)) {
+                LeaveRoom(room, participantId);
+            }
+        });
+
+        peerConnection->setRemoteDescription(rtc::Description(offer, rtc::Description::Type::Offer));
+
+        auto answer = gatheredFuture.wait_for(GatheringTimeout) == std::future_status::ready ? peerConnection->localDescription() : std::nullopt;
+
+        if (!answer.has_value()) {
+            hasLeft->store(true); // The caller leaves the room on failure.
+            participant->Disconnect();
+            return std::nullopt;
+        }
+
+        _participantCount++;
+
+        room->GetWorker().Post([room, participant]() {
+            room->AddParticipant(participant);
+        });
+
+        return std::make_pair(participantId, std::string(*answer));
+    }
+
+    std::shared_ptr<MediaRoom> SfuServer::EnterRoom(const std::string& name, const std::string& password) {
+        std::lock_guard<std::mutex> lock(_roomsMutex);
+
+        auto& entry = _rooms[name];
+
+        if (entry._room == nullptr) {
+            const auto worker = std::min_element(_roomsPerWorker.begin(), _roomsPerWorker.end()) - _roomsPerWorker.begin();
+            _roomsPerWorker[worker]++;
+
+            if (_configuration._isMixing) {
+                entry._room = std::make_shared<McuRoom>(name, password, *_workers[worker], _configuration._mixBitrate);
+                _workers[worker]->AddTickingRoom(entry._room);
+            }
+            else {
+                entry._room = std::make_shared<SfuRoom>(name, password, *_workers[worker], std::min(_configuration._lastN, _configuration._slotCount), _relay.get());
+
+                if (_relay != nullptr) {
+                    _relay->AddLocalRoom(name);
+                }
+            }
+        }
+        else if (entry._room->GetPassword() != password) {
+            return nullptr;
+        }
+
+        entry._participantCount++;
+
+        return entry._room;
+    }
+
+    void SfuServer::LeaveRoom(const std::shared_ptr<MediaRoom>& room, std::optional<std::uint32_t> participantId) {
+        {
+            std::lock_guard<std::mutex> lock(_roomsMutex);
+
+            auto entry = _rooms.find(room->GetName());
+
+            if (entry != _rooms.end() && entry->second._room == room && --entry->second._participantCount == 0) {
+                _roomsPerWorker[room->GetWorker().GetIndex()]--;
+                _rooms.erase(entry);
+
+                if (_relay != nullptr) {
+                    _relay->RemoveLocalRoom(room->GetName());
+                }
+            }
+        }
+
+        if (participantId.has_value()) {
+            _participantCount--;
+
+            room->GetWorker().Post([room, participantId]() {
+                room->RemoveParticipant(*participantId);
+            });
+        }
+    }
+
+    std::shared_ptr<SfuRoom> SfuServer::FindRelayRoom(const std::string& name) {
+        std::lock_guard<std::mutex> lock(_roomsMutex);
+
+        auto entry = _rooms.find(name);
+
+        return entry != _rooms.end() ? std::dynamic_pointer_cast<SfuRoom>(entry->second._room) : nullptr;
+    }
+
+    rtc::Configuration SfuServer::GetPeerConfiguration() const {
+        rtc::Configuration configuration;
+
+        for (const auto& iceServer : _configuration._iceServers) {
+            configuration.iceServers.emplace_back(iceServer);
+        }
+
+        configuration.bindAddress = _configuration._mediaBindAddress;
+        configuration.enableIceUdpMux = _configuration._enableIceUdpMux;
+
+        if (_configuration._portRangeBegin != 0) {
+            configuration.portRangeBegin = _configuration._portRangeBegin;
+        }
+
+        if (_configuration._portRangeEnd != 0) {
+            configuration.portRangeEnd = _configuration._portRangeEnd;
+        }
+
+        return configuration;
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "cpp-httplib/httplib.h"
+#include "libdatachannel/rtc.hpp"
+
+#include "media_room.h"
+#include "sfu_relay.h"
+#include "sfu_room.h"
+#include "sfu_worker.h"
+
+namespace Comms {
+
+    /*
+    * A headless Selective Forwarding Unit for multi-party audio calls.
+    *
+    * Each participant joins a room with one peer connection to the SFU, instead of one to every other participant.
+    * The SFU forwards each participant's Opus RTP to everyone else in the room without decoding it, rewriting only the
+    * SSRC, sequence number and timestamp so that each receiver sees a fixed set of continuous streams.
+    *
+    * Participants join over HTTP. The SFU always answers, so clients publish their offer and receive the answer in the response:
+    *   POST /join    {"connectionName", "password", "offer"}  200 {"participant", "answer"}, 403 on a wrong password.
+    *   GET  /status                                           200 {"rooms", "participants", "workers", "relay"}
+    *   GET  /metrics                                          200 in the Prometheus text exposition format. @see Metrics
+    *
+    * In rooms of more than _lastN participants only the loudest _lastN speakers are forwarded, ranked by the RFC 6464 audio
+    * level clients attach to their packets, so that large rooms do not cost every receiver a stream per participant.
+    *
+    * With _isMixing set the server is an MCU instead: each room decodes its participants and sends each of them a single mix
+    * of everyone else, for clients that cannot decode a stream per speaker. @see McuRoom
+    *
+    * With a relay port set the server is one node of a cascade: participants connected to different nodes share a room of
+    * the same name, each node relaying its participants' streams to the others over a relay link. @see SfuRelay
+    * /status then also reports each other node, the rooms it shares and the packets relayed each way. Mixing rooms are
+    * not cascaded.
+    *
+    * Rooms are pinned to per-core SfuWorkers. A room is created by its first participant, which sets its password, and
+    * removed when its last participant leaves.
+    */
+    class SfuServer {
+    public:
+        /*
+        * Settings for the server.
+        */
+        struct Configuration {
+            std::string _bindAddress = "0.0.0.0"; // Address the HTTP API binds to.
+            int _httpPort = 8080; // Port for the HTTP API. 0 selects any free port.
+            std::size_t _httpThreadCount = 16; // Number of HTTP worker threads. Joins block one while ICE candidates are gathered.
+            std::size_t _workerCount = std::max(std::thread::hardware_concurrency(), 1u); // Number of forwarding workers.
+            std::size_t _slotCount = 16; // Outgoing streams negotiated per participant, and so the most senders each can hear.
+            std::size_t _lastN = 5; // The loudest speakers forwarded to each receiver. 0 forwards every speaker, up to _slotCount.
+            bool _isMixing = false; // Whether rooms decode and mix audio, sending each participant one stream, instead of forwarding it.
+            int _mixBitrate = 32000; // The bitrate mixes are encoded at when mixing, in bits per second.
+            std::optional<std::string> _mediaBindAddress; // Address ICE binds to. Any address when not set.
+            std::uint16_t _portRangeBegin = 0; // First UDP port ICE may use. 0 for any.
+            std::uint16_t _portRangeEnd = 0; // Last UDP port ICE may use. 0 for any.
+            bool _enableIceUdpMux = false; // Whether every participant shares a single UDP port.
+            std::vector<std::string> _iceServers; // STUN or TURN servers used to discover the SFU's public address.
+            std::optional<std::string> _certificatePemFile; // Certificate for HTTPS. Plain HTTP is used when not set.
+            std::optional<std::string> _keyPemFile; // Private key for the certificate.
+            std::uint8_t _nodeId = 0; // Identifies the node within a cascade. Must be unique among the nodes.
+            std::optional<std::uint16_t> _relayPort; // UDP port of the relay link to the other nodes. Not cascaded when not set. 0 selects any free port.
+            std::vector<std::string> _relayPeers; // The other nodes' relay endpoints, as "host:port". Only one of each pair of nodes needs the other.
+            std::string _relayKey; // Secret shared by every node of the cascade, which signs the relayed datagrams. Required to cascade.
+        };
+
+        /*
+        * Constructor.
+        *
+        * @param configuration The server settings.
+        */
+        SfuServer(Configuration configuration);
+
+        /*
+        * Destructor. Stops the server if it is running.
+        */
+        ~SfuServer();
+
+        SfuServer(const SfuServer&) = delete;
+        SfuServer& operator=(const SfuServer&) = delete;
+
+        /*
+        * Binds the HTTP API and starts serving on a background thread.
+        *
+        * @return False if the HTTP API could not be bound.
+        */
+        bool Start();
+
+        /*
+        * Blocks until the server is stopped.
+        */
+        void Wait();
+
+        /*
+        * Stops serving and closes every participant's peer connection.
+        */
+        void Stop();
+
+        /*
+        * @return The port the HTTP API is listening on.
+        */
+        int GetHttpPort() const;
+
+        /*
+        * @return The port the relay link is bound to, or 0 if the server is not cascaded.
+        */
+        std::uint16_t GetRelayPort() const;
+
+    private:
+        /*
+        * A room and the bookkeeping used to decide when to remove it.
+        */
+        struct RoomEntry {
+            std::shared_ptr<MediaRoom> _room; // The room.
+            std::size_t _participantCount = 0; // Participants that have joined and not yet left.
+        };
+
+        void HandleJoin(const httplib::Request& request, httplib::Response& response);
+        void HandleStatus(const httplib::Request& request, httplib::Response& response);
+
+        /*
+        * Connects a participant: answers their offer and adds them to the room once the answer is ready.
+        *
+        * @return The participant's id and the answer SDP, or std::nullopt if the connection could not be set up.
+        */
+        std::optional<std::pair<std::uint32_t, std::string>> ConnectParticipant(const std::shared_ptr<MediaRoom>& room, const std::string& offer);
+
+        /*
+        * Finds a room, creating it on the least loaded worker if it does not exist, and counts a participant joining it.
+        *
+        * @return The room, or null if it exists with a different password.
+        */
+        std::shared_ptr<MediaRoom> EnterRoom(const std::string& name, const std::string& password);
+
+        /*
+        * Counts a participant leaving a room, removing the room once it is empty, and removes them from the room's worker.
+        */
+        void LeaveRoom(const std::shared_ptr<MediaRoom>& room, std::optional<std::uint32_t> participantId);
+
+        /*
+        * @return The forwarding room with a name, or null if there is none. Used to deliver relayed packets.
+        */
+        std::shared_ptr<SfuRoom> FindRelayRoom(const std::string& name);
+
+        /*
+        * @return The peer connection configuration for a new participant.
+        */
+        rtc::Configuration GetPeerConfiguration() const;
+
+        const Configuration _configuration; // The server settings.
+
+        std::unique_ptr<SfuRelay> _relay; // The link to the other nodes of the cascade, or null. Outlives the workers, whose rooms use it.
+        std::vector<std::unique_ptr<SfuWorker>> _workers; // The forwarding workers.
+        std::unordered_map<std::string, RoomEntry> _rooms; // Rooms keyed by name.
+        std::vector<std::size_t> _roomsPerWorker; // The number of rooms pinned to each worker.
+        std::mutex _roomsMutex; // Mutex to control read and write access to _rooms and _roomsPerWorker.
+
+        std::atomic<std::uint32_t> _nextParticipantId; // The id given to the next participant. The top byte is the node id.
+        std::atomic<std::size_t> _participantCount = 0; // The number of connected participants.
+
+        std::unique_ptr<httplib::Server> _httpServer; // The HTTP API listener. An httplib::SSLServer when a certificate is configured.
+        std::thread _httpThread; // Runs the HTTP accept loop.
+        int _httpPort = 0; // The port the HTTP API is bound to.
+    };
+}
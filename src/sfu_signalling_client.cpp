@@ -0,0 +1,58 @@
+#include "sfu_signalling_client.h"
+
+#include "json/json.hpp"
+
+#include "persistent_http_client.h"
+
+using json = nlohmann::json;
+
+namespace Comms {
+    SfuSignallingClient::SfuSignallingClient(std::string serviceURL) :
+        _serviceURL(serviceURL),
+        _httpClient(PersistentHttpClient::ForURL(serviceURL)) {
+    }
+
+    void SfuSignallingClient::PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) {
+        if (type != SDPType::Offer) {
+            return;
+        }
+
+        json httpBody = {
+            {"connectionName", connectionName},
+            {"password", password},
+            {"offer", sdp}
+        };
+
+        auto response = _httpClient->Post("/join", httpBody.dump(), "application/json");
+
+        if (!response || response->status != 200) {
+            return; // RetrieveAnswer reports the failure.
+        }
+
+        auto body = json::parse(response->body, nullptr, false);
+
+        if (body.is_object() && body.contains("answer") && body["answer"].is_string()) {
+            std::lock_guard<std::mutex> lock(_answersMutex);
+            _answers[connectionName] = body["answer"].get<std::string>();
+        }
+    }
+
+    std::variant<std::monostate, bool, std::string> SfuSignallingClient::RetrieveOffer([[maybe_unused]] const std::string& connectionName, [[maybe_unused]] const std::string& password) {
+        return std::monostate();
+    }
+
+    std::optional<std::string> SfuSignallingClient::RetrieveAnswer(const std::string& connectionName) {
+        std::lock_guard<std::mutex> lock(_answersMutex);
+
+        auto answer = _answers.find(connectionName);
+
+        if (answer == _answers.end()) {
+            return std::nullopt;
+        }
+
+        auto sdp = std::move(answer->second);
+        _answers.erase(answer);
+
+        return sdp;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "signalling_client.h"
+
+namespace Comms {
+
+    class PersistentHttpClient;
+
+    /*
+    * Signalling with an SfuServer, for joining a multi-party room instead of calling a single peer.
+    *
+    * The SFU answers every offer itself, so there is never an offer to retrieve: every peer offers, and the answer is
+    * returned in the response to POST /join rather than being polled for.
+    * @see SfuServer
+    */
+    class SfuSignallingClient : public SignallingClient {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param serviceURL The base URL of the SFU's HTTP API.
+        */
+        SfuSignallingClient(std::string serviceURL);
+
+        /*
+        * Joins the room with an offer, storing the SFU's answer. Answers cannot be published to an SFU and are ignored.
+        */
+        void PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) override;
+
+        /*
+        * @return Always std::monostate, so that the peer publishes an offer.
+        */
+        std::variant<std::monostate, bool, std::string> RetrieveOffer(const std::string& connectionName, const std::string& password) override;
+
+        /*
+        * @return The answer returned when the offer was published, if the SFU accepted it.
+        */
+        std::optional<std::string> RetrieveAnswer(const std::string& connectionName) override;
+
+    private:
+        const std::string _serviceURL; // The base URL of the SFU's HTTP API.
+        std::shared_ptr<PersistentHttpClient> _httpClient; // The process wide connection to the SFU.
+
+        std::unordered_map<std::string, std::string> _answers; // Answers returned by the SFU, keyed by connection name.
+        std::mutex _answersMutex; // Mutex to control read and write access to _answers.
+    };
+}
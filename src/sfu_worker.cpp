@@ -0,0 +1,176 @@
+#include "sfu_worker.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "media_room.h"
+
+namespace Comms {
+    SfuWorker::SfuWorker(std::size_t index) :
+        _index(index) {
+        _thread = std::thread([this]() {
+            PinToCore();
+            Run();
+        });
+    }
+
+    SfuWorker::~SfuWorker() {
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            _isStopping = true;
+        }
+        _queueCondition.notify_all();
+
+        _thread.join();
+    }
+
+    void SfuWorker::Post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            _tasks.push_back(std::move(task));
+        }
+        _queueCondition.notify_one();
+    }
+
+    void SfuWorker::PostPacket(std::shared_ptr<MediaRoom> room, std::uint32_t senderId, rtc::binary packet) {
+        QueuePacket(QueuedPacket{ std::move(room), senderId, std::move(packet), false, std::nullopt });
+    }
+
+    void SfuWorker::PostRelayedPacket(std::shared_ptr<MediaRoom> room, std::uint32_t senderId, std::optional<int> audioLevelExtensionId, rtc::binary packet) {
+        QueuePacket(QueuedPacket{ std::move(room), senderId, std::move(packet), true, audioLevelExtensionId });
+    }
+
+    void SfuWorker::AddTickingRoom(std::shared_ptr<MediaRoom> room) {
+        Post([this, weakRoom = std::weak_ptr<MediaRoom>(room)]() {
+            if (_tickingRooms.empty()) {
+                _nextTick = Clock::now() + TickInterval;
+            }
+
+            _tickingRooms.push_back(weakRoom);
+        });
+    }
+
+    std::size_t SfuWorker::GetIndex() const {
+        return _index;
+    }
+
+    void SfuWorker::QueuePacket(QueuedPacket packet) {
+        bool wasEmpty = false;
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            wasEmpty = _packets.empty();
+            _packets.push_back(std::move(packet));
+        }
+
+        // The worker only waits when both queues are empty, so it only needs waking for the first packet of a batch.
+        if (wasEmpty) {
+            _queueCondition.notify_one();
+        }
+    }
+
+    void SfuWorker::Run() {
+        std::vector<std::function<void()>> tasks;
+        std::vector<QueuedPacket> packets;
+
+        while (true) {
+            bool stopping = false;
+            {
+                std::unique_lock<std::mutex> lock(_queueMutex);
+                const auto hasWork = [this]() { return _isStopping || !_tasks.empty() || !_packets.empty(); };
+
+                if (_tickingRooms.empty()) {
+                    _queueCondition.wait(lock, hasWork);
+                }
+                else {
+                    _queueCondition.wait_until(lock, _nextTick, hasWork);
+                }
+
+                // Swapping keeps both vectors' capacity, so steady state forwarding does not allocate for the queue.
+                tasks.swap(_tasks);
+                packets.swap(_packets);
+                stopping = _isStopping;
+            }
+
+            // Tasks run first so that a participant added in the same batch as its first packets is present to forward them.
+            for (auto& task : tasks) {
+                task();
+            }
+
+            if (stopping) {
+                return; // Tasks such as closing rooms still run, but forwarding is no longer worthwhile.
+            }
+
+            for (auto& packet : packets) {
+                if (packet._isRelayed) {
+                    packet._room->ReceiveRelayed(packet._senderId, packet._audioLevelExtensionId, packet._packet);
+                }
+                else {
+                    packet._room->Receive(packet._senderId, packet._packet);
+                }
+            }
+
+            // Rooms send what they batched once the whole run is handled. Consecutive repeats are skipped, and a room flushed
+            // again has nothing left to send.
+            MediaRoom* flushedRoom = nullptr;
+
+            for (const auto& packet : packets) {
+                if (packet._room.get() != flushedRoom) {
+                    flushedRoom = packet._room.get();
+                    flushedRoom->Flush();
+                }
+            }
+
+            tasks.clear();
+            packets.clear();
+
+            if (!_tickingRooms.empty() && Clock::now() >= _nextTick) {
+                Tick();
+            }
+        }
+    }
+
+    void SfuWorker::Tick() {
+        const auto now = Clock::now();
+
+        // Ticks keep to a fixed schedule, but a worker that has fallen more than a tick behind skips ahead rather than bursting.
+        _nextTick += TickInterval;
+
+        if (_nextTick <= now) {
+            _nextTick = now + TickInterval;
+        }
+
+        std::erase_if(_tickingRooms, [](const std::weak_ptr<MediaRoom>& weakRoom) {
+            auto room = weakRoom.lock();
+
+            if (room == nullptr) {
+                return true;
+            }
+
+            room->Tick();
+
+            return false;
+        });
+    }
+
+    void SfuWorker::PinToCore() {
+        const auto coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+        const auto core = _index % coreCount;
+
+#ifdef _WIN32
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (core % (sizeof(DWORD_PTR) * 8)));
+#else
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(core, &cores);
+        pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+#endif
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    class MediaRoom;
+
+    /*
+    * A thread, pinned to one core, that owns the forwarding state of the rooms assigned to it.
+    *
+    * Every room is pinned to a single worker and all of its forwarding runs on that worker's thread, so room state needs no
+    * locking and a busy room only competes with the other rooms on its core. Packets received on libdatachannel's threads,
+    * or relayed from other SFU nodes, are queued to the room's worker, which drains its queue in batches. Rooms that mix audio are also ticked once per frame.
+    */
+    class SfuWorker {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::chrono::milliseconds TickInterval{ 20 }; // How often ticking rooms are ticked: one Opus frame.
+
+        /*
+        * Constructor. Starts the worker thread.
+        *
+        * @param index The worker's index, which selects the core it is pinned to.
+        */
+        SfuWorker(std::size_t index);
+
+        /*
+        * Destructor. Runs the tasks still queued, then stops the worker thread, dropping any packets still queued.
+        */
+        ~SfuWorker();
+
+        SfuWorker(const SfuWorker&) = delete;
+        SfuWorker& operator=(const SfuWorker&) = delete;
+
+        /*
+        * Queues a task to run on the worker thread, such as adding a participant to a room.
+        */
+        void Post(std::function<void()> task);
+
+        /*
+        * Queues a received RTP packet to be forwarded within a room.
+        *
+        * @param room The room the packet was received in. Must be pinned to this worker.
+        * @param senderId The participant that sent the packet.
+        * @param packet The packet.
+        */
+        void PostPacket(std::shared_ptr<MediaRoom> room, std::uint32_t senderId, rtc::binary packet);
+
+        /*
+        * Queues an RTP packet relayed from another SFU node to be forwarded within a room.
+        *
+        * @param room The room the packet was relayed to. Must be pinned to this worker.
+        * @param senderId The participant, connected to the other node, that sent the packet.
+        * @param audioLevelExtensionId The id the sender negotiated the audio level extension with, if it did.
+        * @param packet The packet.
+        */
+        void PostRelayedPacket(std::shared_ptr<MediaRoom> room, std::uint32_t senderId, std::optional<int> audioLevelExtensionId, rtc::binary packet);
+
+        /*
+        * Starts ticking a room every TickInterval until it is destroyed.
+        *
+        * @param room The room. Must be pinned to this worker.
+        */
+        void AddTickingRoom(std::shared_ptr<MediaRoom> room);
+
+        /*
+        * @return The worker's index.
+        */
+        std::size_t GetIndex() const;
+
+    private:
+        /*
+        * A received packet waiting to be forwarded.
+        */
+        struct QueuedPacket {
+            std::shared_ptr<MediaRoom> _room; // The room the packet was received in.
+            std::uint32_t _senderId; // The participant that sent the packet.
+            rtc::binary _packet; // The packet.
+            bool _isRelayed = false; // Whether the packet was relayed from another node.
+            std::optional<int> _audioLevelExtensionId; // The audio level extension id of a relayed packet's sender.
+        };
+
+        /*
+        * Queues a packet, waking the worker if it is the first of a batch.
+        */
+        void QueuePacket(QueuedPacket packet);
+
+        /*
+        * Runs queued tasks and forwards queued packets until stopped, then runs the tasks queued before stopping.
+        */
+        void Run();
+
+        /*
+        * Ticks every ticking room, forgetting those that have been destroyed. Worker thread only.
+        */
+        void Tick();
+
+        /*
+        * Pins the calling thread to the core selected by the worker's index.
+        */
+        void PinToCore();
+
+        const std::size_t _index; // The worker's index.
+
+        std::vector<std::function<void()>> _tasks; // Tasks waiting to run.
+        std::vector<QueuedPacket> _packets; // Packets waiting to be forwarded.
+        bool _isStopping = false; // Set when the worker is stopping.
+        std::mutex _queueMutex; // Mutex to control read and write access to _tasks, _packets and _isStopping.
+        std::condition_variable _queueCondition; // Signalled when work is queued or the worker is stopping.
+
+        std::vector<std::weak_ptr<MediaRoom>> _tickingRooms; // Rooms ticked every TickInterval. Worker thread only.
+        Clock::time_point _nextTick; // When the ticking rooms are next due. Worker thread only.
+
+        std::thread _thread; // The worker thread.
+    };
+}
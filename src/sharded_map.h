@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Comms {
+
+    /*
+    * A hash map keyed by string whose key space is split across a fixed number of independently locked shards,
+    * so that operations on different keys rarely contend.
+    *
+    * Access is through callbacks that run while the shard owning a key is locked. Callbacks should be short
+    * and must not access the same map, as shard locks are not re-entrant.
+    */
+    template <typename Value>
+    class ShardedMap {
+    public:
+        using Map = std::unordered_map<std::string, Value>;
+
+        /*
+        * Constructor.
+        *
+        * @param shardCount The number of shards. Rounded up to a power of two.
+        */
+        ShardedMap(std::size_t shardCount) :
+            _shards(std::bit_ceil(std::max<std::size_t>(shardCount, 1))),
+            _shardShift(64 - std::countr_zero(_shards.size())) {
+        }
+
+        /*
+        * Runs a function with the shard owning a key locked.
+        *
+        * @param key The key whose shard is locked.
+        * @param function Called with the shard's map, which contains the key if it is present.
+        * @return The function's return value.
+        */
+        template <typename Function>
+        decltype(auto) WithShard(const std::string& key, Function&& function) {
+            auto& shard = _shards[GetShardIndex(key)];
+
+            std::lock_guard<std::mutex> lock(shard._mutex);
+            return function(shard._map);
+        }
+
+        template <typename Function>
+        decltype(auto) WithShard(const std::string& key, Function&& function) const {
+            const auto& shard = _shards[GetShardIndex(key)];
+
+            std::lock_guard<std::mutex> lock(shard._mutex);
+            return function(static_cast<const Map&>(shard._map));
+        }
+
+        /*
+        * Runs a function on each shard in turn, locking only the shard being visited.
+        *
+        * @param function Called with each shard's map.
+        */
+        template <typename Function>
+        void ForEachShard(Function&& function) {
+            for (auto& shard : _shards) {
+                std::lock_guard<std::mutex> lock(shard._mutex);
+                function(shard._map);
+            }
+        }
+
+        /*
+        * @return The number of entries across all shards.
+        */
+        std::size_t Size() const {
+            std::size_t size = 0;
+
+            for (const auto& shard : _shards) {
+                std::lock_guard<std::mutex> lock(shard._mutex);
+                size += shard._map.size();
+            }
+
+            return size;
+        }
+
+    private:
+        /*
+        * An independently locked portion of the key space.
+        * Aligned to a cache line so that locking one shard does not invalidate its neighbours.
+        */
+        struct alignas(64) Shard {
+            mutable std::mutex _mutex; // Mutex to control read and write access to _map.
+            Map _map; // Entries whose key belongs to this shard.
+        };
+
+        /*
+        * @return The index of the shard responsible for a key.
+        */
+        std::size_t GetShardIndex(const std::string& key) const {
+            if (_shards.size() == 1) {
+                return 0;
+            }
+
+            // The shard is chosen from the high bits of the mixed hash. Each shard's map buckets by the low bits of the
+            // same hash, so masking the low bits here would leave most of every shard's buckets empty.
+            const std::uint64_t hash = std::hash<std::string>{}(key);
+            return static_cast<std::size_t>((hash * FibonacciMultiplier) >> _shardShift);
+        }
+
+        static constexpr std::uint64_t FibonacciMultiplier = 11400714819323198485ull; // 2^64 divided by the golden ratio.
+
+        std::vector<Shard> _shards; // The shards. The size is a power of two so a shard is selected by shifting the hash.
+        const int _shardShift; // Right shift that maps a 64 bit hash onto a shard index.
+    };
+}
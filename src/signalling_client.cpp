@@ -0,0 +1,11 @@
+#include "signalling_client.h"
+
+namespace {
+    const char* StunServerURL = "stun:stun.l.google.com:19302";
+}
+
+namespace Comms {
+    void SignallingClient::ConfigureIce(rtc::Configuration& config) const {
+        config.iceServers.emplace_back(StunServerURL);
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <variant>
+#include <vector>
+#include <functional>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    enum class SDPType {
+        Offer, // A peer's SDP is an offer if they are the first peer to initiate the call.
+        Answer // A peer's SDP is an aswer if they have accepted an offer.
+    };
+
+    enum class RoomJoinResult {
+        Joined, // The peer is a member of the room, and is told of every member as they join and leave.
+        Rejected, // The room has a different password.
+        Unsupported // The service has no rooms, or could not be reached to join one. Peers meet some other way.
+    };
+
+    /*
+    * Exchanges session descriptions between two peers so that a WebRTC connection can be established.
+    * A connection is identified by a user defined name and protected by a user defined password.
+    * The first peer to connect publishes an offer, the second retrieves it and publishes an answer.
+    *
+    * Implementations determine how the offer and answer are transported, e.g. over HTTP, a WebSocket or in-process.
+    */
+    class SignallingClient {
+    public:
+        virtual ~SignallingClient() = default;
+
+        /*
+        * Applies the ICE settings appropriate for peers using this signalling client to a connection configuration.
+        * By default the public google STUN server is used for IP address discovery.
+        *
+        * @param config The configuration of the WebRTC connection about to be created.
+        */
+        virtual void ConfigureIce(rtc::Configuration& config) const;
+
+        /*
+        * Publishes a local offer/answer session description.
+        * This will make the offer or answer available to the remote peer.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        * @param type The offer/answer type of the SDP being published.
+        * @param sdp The session description.
+        */
+        virtual void PublishSDP(const std::string& connectionName, const std::string& password, const SDPType type, const std::string& sdp) = 0;
+
+        /*
+        * Retrieves an offer SDP for a given connection identifier.
+        *
+        * If an offer exists, and the password is correct, the offer is returned.
+        * If an offer exists, but the password is incorrect, the function returns false.
+        * If an offer does not exist the function returns a std::monostate representing no value.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        * @return The offer SDP string, false if the password is incorrect, or std::monostate if there is no offer.
+        */
+        virtual std::variant<std::monostate, bool, std::string> RetrieveOffer(const std::string& connectionName, const std::string& password) = 0;
+
+        /*
+        * Called by the offering peer before it begins gathering ICE candidates for its offer.
+        * Implementations can use this to set up any channel the answer will be delivered on, so that it overlaps with gathering.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        */
+        virtual void PrepareForAnswer([[maybe_unused]] const std::string& connectionName, [[maybe_unused]] const std::string& password) {}
+
+        /*
+        * Retrieves an answer SDP for a given connection identifier.
+        * Peers expect to retrieve answers some amount of time following the publication of an offer,
+        * so this function blocks until an answer is available or the implementation gives up.
+        *
+        * @param connectionName The name identifying the connection.
+        * @return The answer SDP if it was successfully retrieved.
+        */
+        virtual std::optional<std::string> RetrieveAnswer(const std::string& connectionName) = 0;
+
+        /*
+        * Stops waiting for the remote peer: a RetrieveAnswer blocked on this client, now or later, returns nothing promptly.
+        * Called from another thread, e.g. when a call is ended while it is still connecting.
+        * Implementations whose RetrieveAnswer does not block need not override it.
+        */
+        virtual void Cancel() {}
+
+        /*
+        * Sets the function called when the remote peer trickles an ICE candidate.
+        * Implementations that do not support trickled candidates never call it.
+        *
+        * @param callback Called with the candidate string and its media stream identification tag.
+        */
+        virtual void OnRemoteCandidate([[maybe_unused]] std::function<void(std::string candidate, std::string mid)> callback) {}
+
+        /*
+        * Trickles a local ICE candidate to the remote peer as soon as it is gathered, rather than waiting for the session
+        * description that carries every candidate. Called by the answering peer, on a libdatachannel thread, so it must not block.
+        * Implementations that do not support trickled candidates ignore it.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        * @param candidate The candidate string.
+        * @param mid The media stream identification tag of the candidate.
+        */
+        virtual void SendLocalCandidate([[maybe_unused]] const std::string& connectionName, [[maybe_unused]] const std::string& password,
+            [[maybe_unused]] const std::string& candidate, [[maybe_unused]] const std::string& mid) {}
+
+        /*
+        * Called with the tokens of a room's members, in the order they joined, each time one joins or leaves, or with
+        * std::nullopt once the client has lost the room, e.g. because its connection to the service dropped. Called on a
+        * signalling thread, so it must not block.
+        */
+        using MembersHandler = std::function<void(std::optional<std::vector<std::string>> members)>;
+
+        /*
+        * Joins a room of several peers, which the service tells of every member as they join and leave, so that they need
+        * not poll for each other. The room is created by its first member, with its password, and removed once its last
+        * leaves. A client is a member of one room at a time, until LeaveRoom or Cancel is called or the client is destroyed.
+        * Blocks until the service has answered. Implementations without rooms, such as the hosted service's, return
+        * Unsupported. @see MeshSignalling
+        *
+        * @param roomName The name of the room.
+        * @param password The password of the room.
+        * @param token Identifies the member for this join. Must be unique within the room.
+        * @param onMembers Called with the room's members, first with those present once the client has joined.
+        * @return Whether the room was joined.
+        */
+        virtual RoomJoinResult JoinRoom([[maybe_unused]] const std::string& roomName, [[maybe_unused]] const std::string& password,
+            [[maybe_unused]] const std::string& token, [[maybe_unused]] MembersHandler onMembers) {
+            return RoomJoinResult::Unsupported;
+        }
+
+        /*
+        * Leaves the room joined, which the service tells the other members. No more member lists are delivered once it returns.
+        */
+        virtual void LeaveRoom() {}
+    };
+}
@@ -0,0 +1,327 @@
+#include "signalling_cluster.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <utility>
+
+#include "json/json.hpp"
+
+namespace {
+    const char* HeartbeatPath = "/cluster/heartbeat";
+    const char* LeavePath = "/cluster/leave";
+    const char* TimestampHeader = "X-Comms-Cluster-Timestamp"; // When a request was signed, in seconds since the epoch.
+    const char* NodeHeader = "X-Comms-Cluster-Node"; // The base URL of the node that signed a request.
+    const char* CounterHeader = "X-Comms-Cluster-Counter"; // The number the node gave the request. @see ReplayWindow
+    const char* SignatureHeader = "X-Comms-Cluster-Signature"; // The request's signature, in hexadecimal.
+
+    constexpr std::chrono::seconds SignatureLifetime(60); // How far a request's signing time may be from the receiver's clock.
+
+    constexpr std::chrono::seconds HeartbeatInterval(1);
+    constexpr std::chrono::milliseconds HeartbeatTimeout(500);
+    constexpr std::size_t MaximumMissedHeartbeats = 3;
+
+    // Kept-alive links per node. Requests on one link are serialised, so forwarded requests are spread across several.
+    constexpr std::size_t LinksPerNode = 4;
+}
+
+using json = nlohmann::json;
+
+namespace {
+    /*
+    * @return The text a request's signature is computed over.
+    */
+    std::string GetSignedText(const std::string& method, const std::string& path, const httplib::Params& params, const std::string& body,
+        const std::string& timestamp, const std::string& node, const std::string& counter) {
+        std::string text = method + "\n" + path + "\n";
+
+        for (const auto& [name, value] : params) {
+            text += name + "=" + value + "&";
+        }
+
+        return text + "\n" + timestamp + "\n" + node + "\n" + counter + "\n" + body;
+    }
+
+    std::int64_t GetUnixSeconds() {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+namespace Comms {
+    SignallingCluster::SignallingCluster(std::string nodeURL, std::vector<std::string> seedURLs, ClusterKey key) :
+        _nodeURL(nodeURL),
+        _key(std::move(key)),
+        _seedURLs(seedURLs.begin(), seedURLs.end()),
+        _nextCounter(ReplayWindow::GetInitialCounter()) {
+        _ring.AddNode(_nodeURL);
+
+        for (const auto& seedURL : _seedURLs) {
+            if (!seedURL.empty() && seedURL != _nodeURL) {
+                _candidates.insert(seedURL);
+            }
+        }
+    }
+
+    SignallingCluster::~SignallingCluster() {
+        {
+            std::lock_guard<std::mutex> lock(_heartbeatMutex);
+            _isStopping = true;
+        }
+        _heartbeatCondition.notify_all();
+
+        if (_heartbeatThread.joinable()) {
+            _heartbeatThread.join();
+        }
+    }
+
+    void SignallingCluster::Start(std::function<void()> onMembershipChanged) {
+        _onMembershipChanged = onMembershipChanged;
+        _heartbeatThread = std::thread([this]() { RunHeartbeats(); });
+    }
+
+    void SignallingCluster::Leave() {
+        std::vector<std::string> members;
+        {
+            std::unique_lock<std::shared_mutex> lock(_membershipMutex);
+            _ring.RemoveNode(_nodeURL);
+            members = _ring.GetNodes();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_heartbeatMutex);
+            _isStopping = true;
+        }
+        _heartbeatCondition.notify_all();
+
+        if (_heartbeatThread.joinable()) {
+            _heartbeatThread.join();
+        }
+
+        const auto body = json{ {"node", _nodeURL} }.dump();
+
+        for (const auto& member : members) {
+            Post(member, LeavePath, body, "application/json");
+        }
+    }
+
+    const std::string& SignallingCluster::GetNodeURL() const {
+        return _nodeURL;
+    }
+
+    std::string SignallingCluster::GetOwner(const std::string& connectionName) const {
+        std::shared_lock<std::shared_mutex> lock(_membershipMutex);
+        return _ring.GetOwner(connectionName);
+    }
+
+    std::vector<std::string> SignallingCluster::GetMembers() const {
+        std::shared_lock<std::shared_mutex> lock(_membershipMutex);
+        return _ring.GetNodes();
+    }
+
+    void SignallingCluster::AddMember(const std::string& nodeURL) {
+        if (nodeURL.empty() || nodeURL == _nodeURL) {
+            return;
+        }
+
+        bool isAdded = false;
+        {
+            std::unique_lock<std::shared_mutex> lock(_membershipMutex);
+            isAdded = _ring.AddNode(nodeURL);
+            _missedHeartbeats[nodeURL] = 0;
+            _candidates.erase(nodeURL);
+        }
+
+        if (isAdded) {
+            NotifyMembershipChanged();
+        }
+    }
+
+    void SignallingCluster::RemoveMember(const std::string& nodeURL) {
+        if (nodeURL == _nodeURL) {
+            return;
+        }
+
+        bool isRemoved = false;
+        {
+            std::unique_lock<std::shared_mutex> lock(_membershipMutex);
+            isRemoved = _ring.RemoveNode(nodeURL);
+            _missedHeartbeats.erase(nodeURL);
+
+            if (_seedURLs.contains(nodeURL)) {
+                _candidates.insert(nodeURL); // Seeds are retried so that a restarted seed rejoins.
+            }
+        }
+
+        if (isRemoved) {
+            NotifyMembershipChanged();
+        }
+    }
+
+    httplib::Result SignallingCluster::Post(const std::string& nodeURL, const std::string& path, const std::string& body, const std::string& contentType, httplib::Headers headers) {
+        headers.merge(SignRequest("POST", path, {}, body));
+
+        return GetLink(nodeURL)->Post(path, body, contentType, headers);
+    }
+
+    httplib::Result SignallingCluster::Get(const std::string& nodeURL, const std::string& path, const httplib::Params& params, httplib::Headers headers) {
+        headers.merge(SignRequest("GET", path, params, ""));
+
+        return GetLink(nodeURL)->Get(path, params, headers);
+    }
+
+    httplib::Headers SignallingCluster::SignRequest(const std::string& method, const std::string& path, const httplib::Params& params, const std::string& body) const {
+        const auto timestamp = std::to_string(GetUnixSeconds());
+        const auto counter = std::to_string(_nextCounter++);
+
+        return {
+            {TimestampHeader, timestamp},
+            {NodeHeader, _nodeURL},
+            {CounterHeader, counter},
+            {SignatureHeader, _key.SignToHex(GetSignedText(method, path, params, body, timestamp, _nodeURL, counter))}
+        };
+    }
+
+    std::shared_ptr<PersistentHttpClient> SignallingCluster::GetLink(const std::string& nodeURL) {
+        std::lock_guard<std::mutex> lock(_linksMutex);
+
+        auto& nodeLinks = _links[nodeURL];
+
+        if (nodeLinks == nullptr) {
+            nodeLinks = std::make_unique<NodeLinks>();
+
+            for (std::size_t i = 0; i < LinksPerNode; i++) {
+                nodeLinks->_links.push_back(std::make_shared<PersistentHttpClient>(nodeURL));
+            }
+        }
+
+        return nodeLinks->_links[nodeLinks->_nextLink++ % nodeLinks->_links.size()];
+    }
+
+    void SignallingCluster::RunHeartbeats() {
+        std::unique_lock<std::mutex> lock(_heartbeatMutex);
+
+        while (!_isStopping) {
+            if (_isMembershipChanged) {
+                _isMembershipChanged = false;
+                lock.unlock();
+
+                if (_onMembershipChanged) {
+                    _onMembershipChanged();
+                }
+
+                lock.lock();
+                continue;
+            }
+
+            lock.unlock();
+
+            std::vector<std::string> nodes;
+            {
+                std::shared_lock<std::shared_mutex> membershipLock(_membershipMutex);
+
+                for (const auto& [member, missedHeartbeats] : _missedHeartbeats) {
+                    nodes.push_back(member);
+                }
+
+                nodes.insert(nodes.end(), _candidates.begin(), _candidates.end());
+            }
+
+            for (const auto& node : nodes) {
+                if (SendHeartbeat(node)) {
+                    AddMember(node);
+                    continue;
+                }
+
+                bool isDead = false;
+                {
+                    std::unique_lock<std::shared_mutex> membershipLock(_membershipMutex);
+                    auto member = _missedHeartbeats.find(node);
+
+                    if (member != _missedHeartbeats.end()) {
+                        isDead = ++member->second >= MaximumMissedHeartbeats;
+                    }
+                    else if (!_seedURLs.contains(node)) {
+                        _candidates.erase(node); // A node another member mentioned, which may itself be out of date.
+                    }
+                }
+
+                if (isDead) {
+                    RemoveMember(node);
+                }
+            }
+
+            lock.lock();
+            _heartbeatCondition.wait_for(lock, HeartbeatInterval, [this]() { return _isStopping || _isMembershipChanged; });
+        }
+    }
+
+    bool SignallingCluster::SendHeartbeat(const std::string& nodeURL) {
+        auto& link = _heartbeatLinks[nodeURL];
+
+        if (link == nullptr) {
+            link = std::make_unique<PersistentHttpClient>(nodeURL);
+            link->SetTimeouts(HeartbeatTimeout, HeartbeatTimeout);
+        }
+
+        const httplib::Params params = { {"node", _nodeURL} };
+        auto response = link->Get(HeartbeatPath, params, SignRequest("GET", HeartbeatPath, params, ""));
+
+        if (!response || response->status != 200) {
+            return false;
+        }
+
+        auto body = json::parse(response->body, nullptr, false);
+
+        if (body.is_object() && body.contains("members") && body["members"].is_array()) {
+            std::unique_lock<std::shared_mutex> lock(_membershipMutex);
+
+            for (const auto& member : body["members"]) {
+                if (member.is_string() && member != _nodeURL && !_missedHeartbeats.contains(member.get<std::string>())) {
+                    _candidates.insert(member.get<std::string>());
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void SignallingCluster::NotifyMembershipChanged() {
+        {
+            std::lock_guard<std::mutex> lock(_heartbeatMutex);
+            _isMembershipChanged = true;
+        }
+        _heartbeatCondition.notify_all();
+    }
+
+    ClusterRequestVerifier::ClusterRequestVerifier(ClusterKey key) :
+        _key(std::move(key)) {
+    }
+
+    bool ClusterRequestVerifier::Verify(const httplib::Request& request) {
+        const auto timestamp = request.get_header_value(TimestampHeader);
+        const auto node = request.get_header_value(NodeHeader);
+        const auto counterText = request.get_header_value(CounterHeader);
+        const auto signature = request.get_header_value(SignatureHeader);
+        std::int64_t signedAt = 0;
+        std::uint64_t counter = 0;
+
+        try {
+            signedAt = std::stoll(timestamp);
+            counter = std::stoull(counterText);
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+
+        if (std::abs(GetUnixSeconds() - signedAt) > SignatureLifetime.count()) {
+            return false;
+        }
+
+        if (!_key.VerifyHex(GetSignedText(request.method, request.path, request.params, request.body, timestamp, node, counterText), signature)) {
+            return false;
+        }
+
+        // Only a signed request is recorded, so that unsigned ones cannot fill the windows or move them on.
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _windows[node].Accept(counter);
+    }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cluster_key.h"
+#include "hash_ring.h"
+#include "persistent_http_client.h"
+#include "replay_window.h"
+
+namespace Comms {
+
+    /*
+    * Membership and routing for a cluster of signalling servers sharing one room keyspace.
+    *
+    * Connection names are mapped onto nodes by a consistent hash ring, so every node agrees on which one owns a room.
+    * Nodes are identified by the base URL of their HTTP API. Membership is discovered from a list of seed nodes and
+    * maintained by heartbeats: every node heartbeats each member and seed once a second, learns of further members from
+    * the replies, and drops a member that misses three heartbeats in a row. Whenever membership changes, the
+    * membership changed callback is run on the heartbeat thread so that rooms can be moved to their new owners.
+    *
+    * Requests between nodes are sent over a small pool of kept-alive links per node. Every one is signed with the cluster's
+    * shared key, over its method, path, parameters, body, the time it was sent, the sending node and a counter the node
+    * numbers its requests with, and a node serves a request as from another node only if a ClusterRequestVerifier accepts
+    * it. Signatures expire after a minute, so node clocks must agree to within it.
+    */
+    class SignallingCluster {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param nodeURL The base URL other nodes use to reach this node.
+        * @param seedURLs Base URLs of nodes to join the cluster through. Seeds are retried until they respond.
+        * @param key The key shared by every node, which signs the requests sent between them.
+        */
+        SignallingCluster(std::string nodeURL, std::vector<std::string> seedURLs, ClusterKey key);
+
+        /*
+        * Destructor. Stops heartbeats if they are running.
+        */
+        ~SignallingCluster();
+
+        SignallingCluster(const SignallingCluster&) = delete;
+        SignallingCluster& operator=(const SignallingCluster&) = delete;
+
+        /*
+        * Starts sending heartbeats.
+        *
+        * @param onMembershipChanged Called on the heartbeat thread after members have joined or left.
+        */
+        void Start(std::function<void()> onMembershipChanged);
+
+        /*
+        * Leaves the cluster. This node is removed from its own ring, heartbeats stop, and every member is told
+        * that this node has left. Afterwards GetOwner only returns other nodes.
+        */
+        void Leave();
+
+        /*
+        * @return The base URL of this node.
+        */
+        const std::string& GetNodeURL() const;
+
+        /*
+        * @return The base URL of the node owning a connection, or an empty string if there is none.
+        */
+        std::string GetOwner(const std::string& connectionName) const;
+
+        /*
+        * @return The base URLs of every member, including this node unless it has left.
+        */
+        std::vector<std::string> GetMembers() const;
+
+        /*
+        * Adds a member known to be alive, such as one that has just sent a heartbeat.
+        */
+        void AddMember(const std::string& nodeURL);
+
+        /*
+        * Removes a member, such as one that has announced it is leaving.
+        */
+        void RemoveMember(const std::string& nodeURL);
+
+        /*
+        * Sends a signed POST request to another node.
+        *
+        * @param headers Further headers to send.
+        */
+        httplib::Result Post(const std::string& nodeURL, const std::string& path, const std::string& body, const std::string& contentType, httplib::Headers headers = {});
+
+        /*
+        * Sends a signed GET request to another node.
+        *
+        * @param headers Further headers to send.
+        */
+        httplib::Result Get(const std::string& nodeURL, const std::string& path, const httplib::Params& params, httplib::Headers headers = {});
+
+    private:
+        /*
+        * @return Headers carrying a request's signature, and the time it was signed at.
+        */
+        httplib::Headers SignRequest(const std::string& method, const std::string& path, const httplib::Params& params, const std::string& body) const;
+
+        /*
+        * @return A kept-alive link to another node. Successive calls rotate through the node's pool of links.
+        */
+        std::shared_ptr<PersistentHttpClient> GetLink(const std::string& nodeURL);
+
+        /*
+        * Sends heartbeats and runs the membership changed callback until stopped.
+        */
+        void RunHeartbeats();
+
+        /*
+        * Sends one heartbeat to a node and adds any members it knows of as candidates.
+        *
+        * @return True if the node responded.
+        */
+        bool SendHeartbeat(const std::string& nodeURL);
+
+        /*
+        * Wakes the heartbeat thread to run the membership changed callback.
+        */
+        void NotifyMembershipChanged();
+
+        /*
+        * Kept-alive links to one node.
+        */
+        struct NodeLinks {
+            std::vector<std::shared_ptr<PersistentHttpClient>> _links; // The pool of links.
+            std::atomic<std::size_t> _nextLink = 0; // Index of the link handed out next.
+        };
+
+        const std::string _nodeURL; // The base URL of this node.
+        const ClusterKey _key; // Signs the requests sent to other nodes.
+        const std::set<std::string> _seedURLs; // Nodes to join through. Kept as candidates for as long as they are not members.
+        mutable std::atomic<std::uint64_t> _nextCounter; // Numbers the next request signed. @see ReplayWindow
+
+        HashRing _ring; // Maps connection names onto members.
+        std::map<std::string, std::size_t> _missedHeartbeats; // Consecutive missed heartbeats of each other member.
+        std::set<std::string> _candidates; // Nodes heard of but not yet confirmed alive.
+        mutable std::shared_mutex _membershipMutex; // Mutex to control read and write access to _ring, _missedHeartbeats and _candidates.
+
+        std::map<std::string, std::unique_ptr<NodeLinks>> _links; // Links used to forward requests, by node.
+        std::map<std::string, std::unique_ptr<PersistentHttpClient>> _heartbeatLinks; // Links used for heartbeats, by node. Only used by the heartbeat thread.
+        std::mutex _linksMutex; // Mutex to control read and write access to _links.
+
+        std::function<void()> _onMembershipChanged; // Called after members have joined or left.
+        std::thread _heartbeatThread; // Sends heartbeats.
+        bool _isMembershipChanged = false; // Set when the membership changed callback is due.
+        bool _isStopping = false; // Set when heartbeats are stopping.
+        std::mutex _heartbeatMutex; // Mutex to control read and write access to _isMembershipChanged and _isStopping.
+        std::condition_variable _heartbeatCondition; // Signalled on a membership change or when stopping.
+    };
+
+    /*
+    * Checks that requests were sent by a node of the cluster: that each is signed with the cluster's key, recently, and has
+    * not been served before. Each node numbers the requests it signs, so one captured on the network and sent again while
+    * its signature is still valid is rejected. @see ReplayWindow
+    *
+    * Thread safe.
+    */
+    class ClusterRequestVerifier {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param key The cluster's key.
+        */
+        ClusterRequestVerifier(ClusterKey key);
+
+        /*
+        * @param request The request received.
+        * @return False if the request is unsigned, its signature does not match, it has expired or it has been served before.
+        */
+        bool Verify(const httplib::Request& request);
+
+    private:
+        const ClusterKey _key; // The cluster's key.
+        std::map<std::string, ReplayWindow> _windows; // The counters seen from each node, by its URL. Requires _mutex.
+        std::mutex _mutex; // Mutex to control access to _windows.
+    };
+}
@@ -0,0 +1,121 @@
+#include "signalling_latency_benchmark.h"
+
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "persistent_http_client.h"
+#include "sample_statistics.h"
+
+namespace {
+    const char* LoopbackAddress = "127.0.0.1";
+
+    /*
+    * A self-signed certificate and its key, generated in memory for the local stand-in server.
+    */
+    struct SelfSignedCertificate {
+        std::unique_ptr<X509, decltype(&X509_free)> _certificate{ nullptr, X509_free };
+        std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> _key{ nullptr, EVP_PKEY_free };
+    };
+
+    /*
+    * Generates a P-256 key and a certificate for "localhost" signed with it, valid for one day.
+    */
+    SelfSignedCertificate GenerateSelfSignedCertificate() {
+        SelfSignedCertificate result;
+        result._key.reset(EVP_EC_gen("P-256"));
+        result._certificate.reset(X509_new());
+
+        X509* certificate = result._certificate.get();
+        X509_set_version(certificate, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+        X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+        X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 60 * 60);
+        X509_set_pubkey(certificate, result._key.get());
+
+        X509_NAME* name = X509_get_subject_name(certificate);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(certificate, name);
+        X509_sign(certificate, result._key.get(), EVP_sha256());
+
+        return result;
+    }
+
+    /*
+    * Issues requests one after another and records the latency of each in milliseconds.
+    */
+    Comms::SampleStatistics MeasureRequests(std::size_t requestCount, const std::function<void()>& request) {
+        Comms::SampleStatistics latencies{};
+
+        for (std::size_t i = 0; i < requestCount; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            request();
+            latencies.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        return latencies;
+    }
+}
+
+namespace Comms {
+    SignallingLatencyBenchmark::SignallingLatencyBenchmark(const CommandLineOptions& options) :
+        _requestCount(options.GetInteger("requests", 500)),
+        _keepAliveMaxCount(options.GetInteger("keep-alive-max-count", 100)) {
+    }
+
+    nlohmann::json SignallingLatencyBenchmark::Run() {
+        auto certificate = GenerateSelfSignedCertificate();
+
+        httplib::SSLServer server(certificate._certificate.get(), certificate._key.get());
+        server.set_keep_alive_max_count(_keepAliveMaxCount);
+        server.Get("/getAnswer", [](const httplib::Request&, httplib::Response& response) {
+            response.status = 404; // Polling for an answer that has not been published yet.
+        });
+
+        const int port = server.bind_to_any_port(LoopbackAddress);
+        std::thread serverThread([&server]() { server.listen_after_bind(); });
+        server.wait_until_ready();
+
+        const std::string url = std::string("https://") + LoopbackAddress + ":" + std::to_string(port);
+        const httplib::Params params = { {"connectionName", "Benchmark Connection"} };
+
+        auto fresh = MeasureRequests(_requestCount, [&]() {
+            httplib::Client client(url);
+            client.enable_server_certificate_verification(false);
+            client.Get("/getAnswer", params, httplib::Headers{});
+        });
+
+        PersistentHttpClient resumedClient(url, false);
+        resumedClient.DisableCertificateVerification();
+        auto resumed = MeasureRequests(_requestCount, [&]() { resumedClient.Get("/getAnswer", params); });
+
+        PersistentHttpClient persistentClient(url, true);
+        persistentClient.DisableCertificateVerification();
+        auto persistent = MeasureRequests(_requestCount, [&]() { persistentClient.Get("/getAnswer", params); });
+
+        server.stop();
+        serverThread.join();
+
+        auto strategy = [](const SampleStatistics& latencies, const SampleStatistics& baseline, const PersistentHttpClient* client) {
+            nlohmann::json result = {
+                {"latency_ms", latencies.ToJson()},
+                {"mean_reduction_percent", 100.0 * (1.0 - latencies.GetMean() / baseline.GetMean())}
+            };
+
+            if (client != nullptr) {
+                result["full_handshakes"] = client->GetFullHandshakeCount();
+                result["resumed_handshakes"] = client->GetResumedHandshakeCount();
+            }
+
+            return result;
+        };
+
+        return {
+            {"requests", _requestCount},
+            {"keep_alive_max_count", _keepAliveMaxCount},
+            {"fresh", strategy(fresh, fresh, nullptr)},
+            {"resumed", strategy(resumed, fresh, &resumedClient)},
+            {"persistent", strategy(persistent, fresh, &persistentClient)}
+        };
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Measures the per-request latency of signalling calls against a local HTTPS stand-in for the signalling service.
+    * The same /getAnswer polling request is issued with three client strategies:
+    *   "fresh"      A new client per request, paying a TCP and full TLS handshake every time.
+    *   "resumed"    A new TCP connection per request, resuming the previous TLS session.
+    *   "persistent" One kept-alive connection, falling back to a resumed session when the server closes it.
+    *
+    * Options:
+    *   --requests <n>              Number of requests per strategy. Default 500.
+    *   --keep-alive-max-count <n>  Requests the stand-in serves per connection before closing it. Default 100.
+    */
+    class SignallingLatencyBenchmark : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The benchmark's command line options.
+        */
+        SignallingLatencyBenchmark(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        const std::size_t _requestCount; // Number of requests issued per client strategy.
+        const std::size_t _keepAliveMaxCount; // Requests the stand-in server serves on a connection before closing it.
+    };
+}
@@ -0,0 +1,321 @@
+#include "signalling_load_generator.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "persistent_http_client.h"
+#include "sample_statistics.h"
+#include "signalling_server.h"
+#include "signalling_socket.h"
+
+namespace {
+    const char* LoopbackAddress = "127.0.0.1";
+    const char* LoadPassword = "load-password";
+
+    constexpr std::chrono::seconds SubscriberOpenTimeout(10);
+    constexpr std::chrono::seconds AnswerPushTimeout(10);
+    constexpr std::chrono::seconds MembershipTimeout(15);
+
+    // HTTP worker threads added to the in-process server beyond one per publishing thread, for the status and subscribe phases.
+    constexpr std::size_t SpareServerThreads = 8;
+
+    // HTTP worker threads held open on each in-process node by every other node's kept-alive links.
+    constexpr std::size_t ClusterLinksPerNode = 8;
+
+    /*
+    * The latencies and outcome of one phase.
+    */
+    struct PhaseResult {
+        Comms::SampleStatistics _latencies; // Latency of each successful operation in milliseconds.
+        std::size_t _failureCount = 0; // Number of operations that failed.
+        double _durationSeconds = 0; // Wall clock time taken by the phase.
+
+        nlohmann::json ToJson() const {
+            return {
+                {"latency_ms", _latencies.ToJson()},
+                {"failures", _failureCount},
+                {"duration_s", _durationSeconds},
+                {"operations_per_second", _durationSeconds > 0 ? _latencies.GetCount() / _durationSeconds : 0.0}
+            };
+        }
+    };
+
+    /*
+    * Runs operations 0 to count - 1 spread across threads, each thread with its own kept-alive connection,
+    * and records the latency of each. Threads are spread across the given servers.
+    *
+    * @param operation Performs one operation using the thread's client. Returns false if it failed.
+    */
+    PhaseResult RunConcurrently(const std::vector<std::string>& urls, std::size_t count, std::size_t threadCount,
+        const std::function<bool(Comms::PersistentHttpClient& client, std::size_t index)>& operation) {
+        std::vector<PhaseResult> threadResults(threadCount);
+        std::vector<std::thread> threads;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t]() {
+                Comms::PersistentHttpClient client(urls[t % urls.size()]);
+                auto& result = threadResults[t];
+
+                for (std::size_t i = t; i < count; i += threadCount) {
+                    const auto operationStart = std::chrono::steady_clock::now();
+
+                    if (operation(client, i)) {
+                        result._latencies.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - operationStart).count());
+                    }
+                    else {
+                        result._failureCount++;
+                    }
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        PhaseResult result;
+        result._durationSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (const auto& threadResult : threadResults) {
+            result._latencies.Merge(threadResult._latencies);
+            result._failureCount += threadResult._failureCount;
+        }
+
+        return result;
+    }
+
+    /*
+    * @return The connection name used for a pending offer.
+    */
+    std::string GetConnectionName(std::size_t index) {
+        return "load-" + std::to_string(index);
+    }
+
+    /*
+    * @return A request body publishing an offer or answer for a connection.
+    */
+    std::string GetPublishBody(std::size_t index, const char* type, const std::string& sdp) {
+        nlohmann::json body = {
+            {"connectionName", GetConnectionName(index)},
+            {"password", LoadPassword},
+            {type, sdp}
+        };
+
+        return body.dump();
+    }
+
+    /*
+    * @return A stand-in session description of the given size.
+    */
+    std::string GetSyntheticSDP(std::size_t size) {
+        std::string sdp = "v=0\r\no=- 0 0 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n";
+
+        while (sdp.size() < size) {
+            sdp += "a=candidate:1 1 UDP 2122317823 192.168.0.1 50000 typ host\r\n";
+        }
+
+        sdp.resize(size);
+        return sdp;
+    }
+
+    /*
+    * @return The status reported by a server, or null if it could not be read.
+    */
+    nlohmann::json GetStatus(const std::string& url) {
+        Comms::PersistentHttpClient client(url);
+        auto response = client.Get("/status", httplib::Params{});
+
+        if (!response || response->status != 200) {
+            return nlohmann::json();
+        }
+
+        return nlohmann::json::parse(response->body, nullptr, false);
+    }
+
+    /*
+    * @return The sum of a numeric status field across servers.
+    */
+    std::size_t SumStatus(const std::vector<std::string>& urls, const char* field) {
+        std::size_t sum = 0;
+
+        for (const auto& url : urls) {
+            auto status = GetStatus(url);
+            sum += status.is_object() ? status.value(field, std::size_t(0)) : 0;
+        }
+
+        return sum;
+    }
+}
+
+namespace Comms {
+    SignallingLoadGenerator::SignallingLoadGenerator(const CommandLineOptions& options) :
+        _urls(options.GetList("url")),
+        _webSocketURLs(options.GetList("ws-url")),
+        _nodeCount(std::max<std::int64_t>(options.GetInteger("nodes", 1), 1)),
+        _offerCount(options.GetInteger("offers", 100000)),
+        _threadCount(std::max<std::int64_t>(options.GetInteger("threads", 16), 1)),
+        _lookupCount(options.GetInteger("lookups", 10000)),
+        _subscriberCount(options.GetInteger("subscribers", 1000)),
+        _sdpBytes(options.GetInteger("sdp-bytes", 1024)),
+        _shardCount(options.GetInteger("shards", 64)) {
+    }
+
+    nlohmann::json SignallingLoadGenerator::Run() {
+        if (!_urls.empty()) {
+            return RunPhases(_urls, _webSocketURLs);
+        }
+
+        // Start the servers on loopback. With more than one node, the first is the seed the others join through.
+        const auto clusterKey = std::to_string(std::random_device()()) + std::to_string(std::random_device()());
+        std::vector<std::unique_ptr<SignallingServer>> servers;
+        std::vector<std::string> urls;
+        std::vector<std::string> webSocketURLs;
+
+        for (std::size_t i = 0; i < _nodeCount; i++) {
+            SignallingServer::Configuration configuration;
+            configuration._bindAddress = LoopbackAddress;
+            configuration._httpPort = 0;
+            configuration._webSocketPort = 0;
+            configuration._shardCount = _shardCount;
+            configuration._threadCount = _threadCount + (_nodeCount - 1) * ClusterLinksPerNode + SpareServerThreads;
+
+            if (_nodeCount > 1) {
+                configuration._clusterHost = LoopbackAddress;
+                configuration._clusterKey = clusterKey;
+            }
+
+            if (!urls.empty()) {
+                configuration._clusterSeedURLs = { urls.front() };
+            }
+
+            auto server = std::make_unique<SignallingServer>(configuration);
+
+            if (!server->Start()) {
+                return { {"error", "Failed to start an in-process signalling server"} };
+            }
+
+            urls.push_back(std::string("http://") + LoopbackAddress + ":" + std::to_string(server->GetHttpPort()));
+            webSocketURLs.push_back(std::string("ws://") + LoopbackAddress + ":" + std::to_string(server->GetWebSocketPort()) + "/subscribe");
+            servers.push_back(std::move(server));
+        }
+
+        if (_nodeCount > 1 && !WaitForMembership(urls)) {
+            return { {"error", "The in-process cluster did not converge"} };
+        }
+
+        auto results = RunPhases(urls, webSocketURLs);
+
+        if (_nodeCount > 1) {
+            // Stop one node and check that its rooms were handed over rather than lost.
+            const auto start = std::chrono::steady_clock::now();
+            servers.front()->Stop();
+
+            std::vector<std::string> remainingURLs(urls.begin() + 1, urls.end());
+            results["leave"] = {
+                {"duration_s", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()},
+                {"rooms_held", SumStatus(remainingURLs, "rooms")}
+            };
+        }
+
+        for (auto& server : servers) {
+            server->Stop();
+        }
+
+        return results;
+    }
+
+    bool SignallingLoadGenerator::WaitForMembership(const std::vector<std::string>& urls) {
+        const auto deadline = std::chrono::steady_clock::now() + MembershipTimeout;
+
+        while (std::chrono::steady_clock::now() < deadline) {
+            bool isConverged = true;
+
+            for (const auto& url : urls) {
+                auto status = GetStatus(url);
+                isConverged = isConverged && status.is_object() && status.contains("members") && status["members"].size() == urls.size();
+            }
+
+            if (isConverged) {
+                return true;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        return false;
+    }
+
+    nlohmann::json SignallingLoadGenerator::RunPhases(const std::vector<std::string>& urls, const std::vector<std::string>& webSocketURLs) {
+        const auto sdp = GetSyntheticSDP(_sdpBytes);
+
+        // Publish every offer. None is answered, so all of them are pending at once.
+        auto publish = RunConcurrently(urls, _offerCount, _threadCount, [&](PersistentHttpClient& client, std::size_t index) {
+            auto response = client.Post("/connectionOffer", GetPublishBody(index, "offer", sdp), "application/json");
+            return response && response->status == 200;
+        });
+
+        nlohmann::json roomsPerNode = nlohmann::json::array();
+
+        for (const auto& url : urls) {
+            auto status = GetStatus(url);
+            roomsPerNode.push_back(status.is_object() ? status.value("rooms", std::size_t(0)) : 0);
+        }
+
+        // Spread the lookups across the whole key space rather than only the first offers published.
+        const auto lookupCount = std::min(_lookupCount, _offerCount);
+        const auto lookupStride = lookupCount > 0 ? _offerCount / lookupCount : 1;
+
+        auto lookup = RunConcurrently(urls, lookupCount, _threadCount, [&](PersistentHttpClient& client, std::size_t index) {
+            auto response = client.Get("/getOffer", { {"connectionName", GetConnectionName(index * lookupStride)}, {"password", LoadPassword} });
+            return response && response->status == 200;
+        });
+
+        nlohmann::json results = {
+            {"offers", _offerCount},
+            {"threads", _threadCount},
+            {"nodes", urls.size()},
+            {"sdp_bytes", _sdpBytes},
+            {"publish", publish.ToJson()},
+            {"rooms_held", SumStatus(urls, "rooms")},
+            {"rooms_per_node", roomsPerNode},
+            {"lookup", lookup.ToJson()}
+        };
+
+        if (webSocketURLs.empty() || _subscriberCount == 0) {
+            return results;
+        }
+
+        // Subscribe to some of the pending offers, then answer each and time how long the push takes to arrive.
+        // Subscribers are spread across the push channels of every node, so most answers are published on a different node.
+        std::vector<std::unique_ptr<SignallingSocket>> subscribers;
+        const auto subscriberCount = std::min(_subscriberCount, _offerCount);
+
+        for (std::size_t i = 0; i < subscriberCount; i++) {
+            subscribers.push_back(std::make_unique<SignallingSocket>(webSocketURLs[i % webSocketURLs.size()]));
+        }
+
+        for (std::size_t i = 0; i < subscriberCount; i++) {
+            if (subscribers[i]->WaitForOpen(SubscriberOpenTimeout)) {
+                subscribers[i]->Subscribe(GetConnectionName(i), LoadPassword);
+            }
+        }
+
+        const auto subscribedCount = SumStatus(urls, "subscribers");
+
+        auto push = RunConcurrently(urls, subscriberCount, _threadCount, [&](PersistentHttpClient& client, std::size_t index) {
+            auto response = client.Post("/connectionAnswer", GetPublishBody(index, "answer", sdp), "application/json");
+            return response && response->status == 200 && subscribers[index]->WaitForAnswer(AnswerPushTimeout).has_value();
+        });
+
+        results["subscribers"] = subscribedCount;
+        results["answer_push"] = push.ToJson();
+
+        return results;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Drives a signalling server or cluster with many concurrent pending offers and reports the latency of each signalling call.
+    * Targets the servers at --url, or starts --nodes in-process SignallingServers on loopback when no URL is given.
+    * In-process nodes form a cluster, and after the run one node leaves so that the handover of its rooms can be checked.
+    *
+    * Phases:
+    *   publish    --offers offers are published from --threads threads, each with its own kept-alive connection.
+    *   status     /status is read from every node to confirm the offers are all held at once, and how they are spread.
+    *   lookup     --lookups offers are fetched back with /getOffer.
+    *   subscribe  --subscribers WebSocket subscribers wait on a pending offer. Each answer is published and the
+    *              time until it is pushed to the subscriber is recorded.
+    *
+    * Options:
+    *   --url <url,...>        Base URLs of the HTTP API of each node. Default: in-process servers.
+    *   --ws-url <url,...>     URLs of the WebSocket push channel of each node. Required with --url for the subscribe phase.
+    *   --nodes <n>            Number of in-process nodes. Default 1.
+    *   --offers <n>           Number of pending offers. Default 100000.
+    *   --threads <n>          Number of publishing threads. Default 16.
+    *   --lookups <n>          Number of /getOffer requests. Default 10000.
+    *   --subscribers <n>      Number of WebSocket subscribers. Default 1000.
+    *   --sdp-bytes <n>        Size of each synthetic offer. Default 1024.
+    *   --shards <n>           Room store shards of the in-process server. Default 64.
+    */
+    class SignallingLoadGenerator : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The load generator's command line options.
+        */
+        SignallingLoadGenerator(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        /*
+        * Runs every phase against a set of servers.
+        *
+        * @param urls The base URLs of the HTTP API of each node.
+        * @param webSocketURLs The URLs of the push channel of each node, or empty to skip the subscribe phase.
+        */
+        nlohmann::json RunPhases(const std::vector<std::string>& urls, const std::vector<std::string>& webSocketURLs);
+
+        /*
+        * Waits until every node reports every other node as a member.
+        *
+        * @return False if membership did not converge in time.
+        */
+        bool WaitForMembership(const std::vector<std::string>& urls);
+
+        const std::vector<std::string> _urls; // Base URLs of the servers under test. Empty to use in-process servers.
+        const std::vector<std::string> _webSocketURLs; // URLs of the push channels of the servers under test.
+        const std::size_t _nodeCount; // Number of in-process servers.
+        const std::size_t _offerCount; // Number of pending offers published.
+        const std::size_t _threadCount; // Number of threads publishing offers.
+        const std::size_t _lookupCount; // Number of offers fetched back.
+        const std::size_t _subscriberCount; // Number of WebSocket subscribers.
+        const std::size_t _sdpBytes; // Size of each synthetic offer.
+        const std::size_t _shardCount; // Room store shards of the in-process server.
+    };
+}
@@ -0,0 +1,870 @@
+#include "signalling_server.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+
+#include "json/json.hpp"
+
+#include "metrics.h"
+#include "metrics_server.h"
+
+using json = nlohmann::json;
+
+namespace {
+    const char* ForwardedHeader = "X-Comms-Forwarded"; // Marks a request forwarded by another node, which must be served locally.
+    const char* ClusterPathPrefix = "/cluster/";
+    const char* ClusterRoomsPath = "/cluster/rooms";
+    const char* ClusterSubscribePath = "/cluster/subscribe";
+    const char* ClusterPushPath = "/cluster/push";
+
+    constexpr std::chrono::seconds ExpiryInterval(5);
+    constexpr std::size_t KeepAliveMaxCount = 100000;
+    constexpr std::size_t RoomTransferBatchSize = 1000;
+
+    // HTTP requests served, indexed by status class: 1xx to 5xx.
+    const std::array<Comms::Counter*, 5> RequestsTotal = []() {
+        std::array<Comms::Counter*, 5> counters;
+
+        for (std::size_t i = 0; i < counters.size(); i++) {
+            counters[i] = &Comms::Metrics::AddCounter("comms_signalling_requests_total", "HTTP requests served, by status class.", "code=\"" + std::to_string(i + 1) + "xx\"");
+        }
+
+        return counters;
+    }();
+
+    Comms::Histogram& RequestSeconds = Comms::Metrics::AddHistogram("comms_signalling_request_seconds", "Time to serve an HTTP request.", Comms::GetNetworkTimeBounds());
+    Comms::Counter& SocketMessagesTotal = Comms::Metrics::AddCounter("comms_signalling_socket_messages_total", "Messages received on the WebSocket push channel.");
+
+    thread_local std::chrono::steady_clock::time_point RequestStart; // When the request the thread is serving was routed.
+
+    /*
+    * @return A room in the form sent between cluster nodes. The expiry is sent as the time remaining, as clocks are not shared.
+    */
+    json RoomToJson(const std::string& connectionName, const Comms::RoomStore::Room& room) {
+        const auto timeToLive = std::chrono::duration_cast<std::chrono::milliseconds>(room._expiry - Comms::RoomStore::Clock::now());
+
+        return {
+            {"connectionName", connectionName},
+            {"passwordHash", room._passwordHash},
+            {"offer", room._offer},
+            {"answer", room._answer.has_value() ? json(*room._answer) : json()},
+            {"ttlMilliseconds", timeToLive.count()},
+            {"remoteSubscribers", room._remoteSubscribers}
+        };
+    }
+
+    /*
+    * @return A room received from another cluster node.
+    */
+    Comms::RoomStore::Room RoomFromJson(const json& body) {
+        Comms::RoomStore::Room room;
+        room._passwordHash = body.value("passwordHash", "");
+        room._offer = body.value("offer", "");
+        room._expiry = Comms::RoomStore::Clock::now() + std::chrono::milliseconds(body.value("ttlMilliseconds", 0ll));
+
+        if (body.contains("answer") && body["answer"].is_string()) {
+            room._answer = body["answer"].get<std::string>();
+        }
+
+        if (body.contains("remoteSubscribers") && body["remoteSubscribers"].is_array()) {
+            room._remoteSubscribers = body["remoteSubscribers"].get<std::vector<std::string>>();
+        }
+
+        return room;
+    }
+}
+
+namespace Comms {
+    SignallingServer::SignallingServer(Configuration configuration) :
+        _configuration(configuration),
+        _rooms(configuration._shardCount, configuration._roomTimeToLive),
+        _subscribers(configuration._shardCount),
+        _meshRooms(configuration._shardCount),
+        _clusterKey(configuration._clusterKey),
+        _clusterRequestVerifier(_clusterKey) {
+
+        if (_configuration._certificatePemFile.has_value() && _configuration._keyPemFile.has_value()) {
+            _httpServer = std::make_unique<httplib::SSLServer>(_configuration._certificatePemFile->c_str(), _configuration._keyPemFile->c_str());
+        }
+        else {
+            _httpServer = std::make_unique<httplib::Server>();
+        }
+
+        const auto threadCount = std::max<std::size_t>(_configuration._threadCount, 1);
+        _httpServer->new_task_queue = [threadCount]() { return new httplib::ThreadPool(threadCount); };
+
+        // Clients such as PersistentHttpClient keep one connection open for every request they make,
+        // so connections are not closed after cpp-httplib's default of five requests.
+        _httpServer->set_keep_alive_max_count(KeepAliveMaxCount);
+        _httpServer->set_tcp_nodelay(true);
+
+        RegisterRoutes();
+    }
+
+    SignallingServer::~SignallingServer() {
+        Stop();
+    }
+
+    bool SignallingServer::Start() {
+        if (!_httpServer->is_valid()) {
+            return false; // The certificate or key could not be loaded.
+        }
+
+        if (!_configuration._clusterHost.empty() && _clusterKey.IsEmpty()) {
+            return false; // Without a key, any client could pose as a node.
+        }
+
+        if (_configuration._httpPort == 0) {
+            _httpPort = _httpServer->bind_to_any_port(_configuration._bindAddress);
+        }
+        else if (_httpServer->bind_to_port(_configuration._bindAddress, _configuration._httpPort)) {
+            _httpPort = _configuration._httpPort;
+        }
+        else {
+            _httpPort = -1;
+        }
+
+        if (_httpPort < 0) {
+            return false;
+        }
+
+        rtc::WebSocketServer::Configuration webSocketConfiguration;
+        webSocketConfiguration.port = _configuration._webSocketPort;
+        webSocketConfiguration.bindAddress = _configuration._bindAddress;
+        webSocketConfiguration.enableTls = _configuration._certificatePemFile.has_value();
+        webSocketConfiguration.certificatePemFile = _configuration._certificatePemFile;
+        webSocketConfiguration.keyPemFile = _configuration._keyPemFile;
+
+        _webSocketServer = std::make_unique<rtc::WebSocketServer>(webSocketConfiguration);
+        _webSocketServer->onClient([this](std::shared_ptr<rtc::WebSocket> webSocket) {
+            HandleClient(webSocket);
+        });
+
+        _httpThread = std::thread([this]() { _httpServer->listen_after_bind(); });
+        _expiryThread = std::thread([this]() { ExpireRooms(); });
+
+        _httpServer->wait_until_ready();
+
+        if (!_configuration._clusterHost.empty()) {
+            const auto scheme = _configuration._certificatePemFile.has_value() ? "https://" : "http://";
+            const auto nodeURL = scheme + _configuration._clusterHost + ":" + std::to_string(_httpPort);
+
+            _cluster = std::make_unique<SignallingCluster>(nodeURL, _configuration._clusterSeedURLs, _clusterKey);
+            _cluster->Start([this]() { RebalanceRooms(); });
+        }
+
+        return true;
+    }
+
+    void SignallingServer::Wait() {
+        if (_httpThread.joinable()) {
+            _httpThread.join();
+        }
+    }
+
+    void SignallingServer::Stop() {
+        {
+            std::lock_guard<std::mutex> lock(_stopMutex);
+
+            if (_isStopping) {
+                return;
+            }
+
+            _isStopping = true;
+        }
+        _stopCondition.notify_all();
+
+        if (_cluster != nullptr) {
+            // Hand every room over to the remaining members before this node stops answering for them.
+            _cluster->Leave();
+            RebalanceRooms();
+        }
+
+        _httpServer->stop();
+
+        if (_webSocketServer != nullptr) {
+            _webSocketServer->stop();
+        }
+
+        std::unordered_set<std::shared_ptr<rtc::WebSocket>> clients;
+        {
+            std::lock_guard<std::mutex> lock(_clientsMutex);
+            clients.swap(_clients);
+        }
+
+        for (const auto& client : clients) {
+            client->resetCallbacks();
+            client->close();
+        }
+
+        Wait();
+
+        if (_expiryThread.joinable()) {
+            _expiryThread.join();
+        }
+    }
+
+    int SignallingServer::GetHttpPort() const {
+        return _httpPort;
+    }
+
+    std::uint16_t SignallingServer::GetWebSocketPort() const {
+        return _webSocketServer != nullptr ? _webSocketServer->port() : 0;
+    }
+
+    void SignallingServer::RegisterRoutes() {
+        // Every request is counted and timed, from routing until it is logged once its response has been written.
+        // Requests that claim to come from another node are rejected here unless that node signed them.
+        _httpServer->set_pre_routing_handler([this](const httplib::Request& request, httplib::Response& response) {
+            RequestStart = std::chrono::steady_clock::now();
+
+            if (IsClusterRequest(request) && !_clusterRequestVerifier.Verify(request)) {
+                response.status = 403;
+                return httplib::Server::HandlerResponse::Handled;
+            }
+
+            return httplib::Server::HandlerResponse::Unhandled;
+        });
+
+        _httpServer->set_logger([](const httplib::Request&, const httplib::Response& response) {
+            RequestSeconds.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - RequestStart).count());
+            RequestsTotal[std::clamp(response.status / 100, 1, 5) - 1]->Increment();
+        });
+
+        MetricsServer::AddRoute(*_httpServer);
+
+        _httpServer->Post("/connectionOffer", [this](const httplib::Request& request, httplib::Response& response) {
+            HandlePublishOffer(request, response);
+        });
+
+        _httpServer->Post("/connectionAnswer", [this](const httplib::Request& request, httplib::Response& response) {
+            HandlePublishAnswer(request, response);
+        });
+
+        _httpServer->Get("/getOffer", [this](const httplib::Request& request, httplib::Response& response) {
+            HandleGetOffer(request, response);
+        });
+
+        _httpServer->Get("/getAnswer", [this](const httplib::Request& request, httplib::Response& response) {
+            HandleGetAnswer(request, response);
+        });
+
+        _httpServer->Get("/status", [this](const httplib::Request& request, httplib::Response& response) {
+            HandleStatus(request, response);
+        });
+
+        _httpServer->Get("/cluster/heartbeat", [this](const httplib::Request& request, httplib::Response& response) {
+            HandleClusterHeartbeat(request, response);
+        });
+
+        _httpServer->Post("/cluster/leave", [this](const httplib::Request& request, httplib::Response& response) {
+            HandleClusterLeave(request, response);
+        });
+
+        _httpServer->Post(ClusterRoomsPath, [this](const httplib::Request& request, httplib::Response& response) {
+            HandleClusterRooms(request, response);
+        });
+
+        _httpServer->Post(ClusterSubscribePath, [this](const httplib::Request& request, httplib::Response& response) {
+            HandleClusterSubscribe(request, response);
+        });
+
+        _httpServer->Post(ClusterPushPath, [this](const httplib::Request& request, httplib::Response& response) {
+            HandleClusterPush(request, response);
+        });
+    }
+
+    bool SignallingServer::IsClusterRequest(const httplib::Request& request) {
+        return request.path.starts_with(ClusterPathPrefix) || request.has_header(ForwardedHeader);
+    }
+
+    void SignallingServer::HandlePublishOffer(const httplib::Request& request, httplib::Response& response) {
+        auto body = json::parse(request.body, nullptr, false);
+
+        if (body.is_discarded() || !body.contains("connectionName") || !body.contains("offer")) {
+            response.status = 400;
+            return;
+        }
+
+        const auto connectionName = body.value("connectionName", "");
+
+        if (ForwardToOwner(connectionName, request, response)) {
+            return;
+        }
+
+        if (!_rooms.PublishOffer(connectionName, body.value("password", ""), body.value("offer", ""))) {
+            response.status = 403;
+        }
+    }
+
+    void SignallingServer::HandlePublishAnswer(const httplib::Request& request, httplib::Response& response) {
+        auto body = json::parse(request.body, nullptr, false);
+
+        if (body.is_discarded() || !body.contains("connectionName") || !body.contains("answer")) {
+            response.status = 400;
+            return;
+        }
+
+        const auto connectionName = body.value("connectionName", "");
+        const auto answer = body.value("answer", "");
+
+        if (ForwardToOwner(connectionName, request, response)) {
+            return;
+        }
+
+        if (!_rooms.PublishAnswer(connectionName, body.value("password", ""), answer)) {
+            response.status = 403;
+            return;
+        }
+
+        json message = {
+            {"type", "answer"},
+            {"connectionName", connectionName},
+            {"data", answer}
+        };
+
+        Publish(connectionName, message.dump(), nullptr, "");
+    }
+
+    void SignallingServer::HandleGetOffer(const httplib::Request& request, httplib::Response& response) {
+        const auto connectionName = request.get_param_value("connectionName");
+
+        if (ForwardToOwner(connectionName, request, response)) {
+            return;
+        }
+
+        auto offer = _rooms.GetOffer(connectionName, request.get_param_value("password"));
+
+        if (std::holds_alternative<std::string>(offer)) {
+            response.set_content(json{ {"data", std::get<std::string>(offer)} }.dump(), "application/json");
+        }
+        else if (std::holds_alternative<bool>(offer)) {
+            response.status = 403;
+        }
+        else {
+            response.status = 404;
+        }
+    }
+
+    void SignallingServer::HandleGetAnswer(const httplib::Request& request, httplib::Response& response) {
+        const auto connectionName = request.get_param_value("connectionName");
+
+        if (ForwardToOwner(connectionName, request, response)) {
+            return;
+        }
+
+        auto answer = _rooms.GetAnswer(connectionName);
+
+        if (answer.has_value()) {
+            response.set_content(json{ {"data", *answer} }.dump(), "application/json");
+        }
+        else {
+            response.status = 404;
+        }
+    }
+
+    void SignallingServer::HandleStatus([[maybe_unused]] const httplib::Request& request, httplib::Response& response) {
+        json status = {
+            {"rooms", _rooms.GetRoomCount()},
+            {"subscribers", _subscriberCount.load()},
+            {"meshRooms", _meshRooms.Size()}
+        };
+
+        if (_cluster != nullptr) {
+            status["node"] = _cluster->GetNodeURL();
+            status["members"] = _cluster->GetMembers();
+        }
+
+        response.set_content(status.dump(), "application/json");
+    }
+
+    void SignallingServer::HandleClusterHeartbeat(const httplib::Request& request, httplib::Response& response) {
+        if (_cluster == nullptr) {
+            response.status = 404;
+            return;
+        }
+
+        _cluster->AddMember(request.get_param_value("node"));
+
+        json heartbeat = {
+            {"node", _cluster->GetNodeURL()},
+            {"members", _cluster->GetMembers()}
+        };
+
+        response.set_content(heartbeat.dump(), "application/json");
+    }
+
+    void SignallingServer::HandleClusterLeave(const httplib::Request& request, httplib::Response& response) {
+        auto body = json::parse(request.body, nullptr, false);
+
+        if (_cluster == nullptr || body.is_discarded()) {
+            response.status = _cluster == nullptr ? 404 : 400;
+            return;
+        }
+
+        _cluster->RemoveMember(body.value("node", ""));
+    }
+
+    void SignallingServer::HandleClusterRooms(const httplib::Request& request, httplib::Response& response) {
+        auto body = json::parse(request.body, nullptr, false);
+
+        if (_cluster == nullptr || body.is_discarded() || !body.contains("rooms") || !body["rooms"].is_array()) {
+            response.status = _cluster == nullptr ? 404 : 400;
+            return;
+        }
+
+        for (const auto& room : body["rooms"]) {
+            _rooms.InsertRoom(room.value("connectionName", ""), RoomFromJson(room));
+        }
+    }
+
+    void SignallingServer::HandleClusterSubscribe(const httplib::Request& request, httplib::Response& response) {
+        auto body = json::parse(request.body, nullptr, false);
+
+        if (_cluster == nullptr || body.is_discarded()) {
+            response.status = _cluster == nullptr ? 404 : 400;
+            return;
+        }
+
+        const auto connectionName = body.value("connectionName", "");
+
+        // Sockets re-registered after their room moved were authenticated when they subscribed, so carry no hash.
+        if (body.contains("passwordHash") && !_rooms.IsPasswordCorrect(connectionName, body.value("passwordHash", ""))) {
+            response.status = 403;
+            return;
+        }
+
+        if (!_rooms.AddRemoteSubscriber(connectionName, body.value("node", ""))) {
+            response.status = 404;
+            return;
+        }
+
+        // As with a local subscriber, the answer is checked after registering so that one published in between is not missed.
+        auto answer = _rooms.GetAnswer(connectionName);
+
+        if (answer.has_value()) {
+            response.set_content(json{ {"data", *answer} }.dump(), "application/json");
+        }
+        else {
+            response.status = 204;
+        }
+    }
+
+    void SignallingServer::HandleClusterPush(const httplib::Request& request, httplib::Response& response) {
+        auto body = json::parse(request.body, nullptr, false);
+
+        if (_cluster == nullptr || body.is_discarded()) {
+            response.status = _cluster == nullptr ? 404 : 400;
+            return;
+        }
+
+        Publish(body.value("connectionName", ""), body.value("message", ""), nullptr, body.value("origin", ""));
+    }
+
+    bool SignallingServer::ForwardToOwner(const std::string& connectionName, const httplib::Request& request, httplib::Response& response) {
+        if (_cluster == nullptr || request.has_header(ForwardedHeader)) {
+            return false; // Forwarded requests are served locally even if this node's view of the ring differs from the sender's.
+        }
+
+        const auto owner = _cluster->GetOwner(connectionName);
+
+        if (owner.empty() || owner == _cluster->GetNodeURL()) {
+            return false;
+        }
+
+        const httplib::Headers headers = { {ForwardedHeader, _cluster->GetNodeURL()} };
+        auto result = request.method == "POST"
+            ? _cluster->Post(owner, request.path, request.body, request.get_header_value("Content-Type"), headers)
+            : _cluster->Get(owner, request.path, request.params, headers);
+
+        if (!result) {
+            response.status = 503; // The owner is unreachable. Clients retry, by which time it may have been replaced.
+            return true;
+        }
+
+        response.status = result->status;
+
+        if (!result->body.empty()) {
+            response.set_content(result->body, result->get_header_value("Content-Type"));
+        }
+
+        return true;
+    }
+
+    void SignallingServer::Publish(const std::string& connectionName, const std::string& message, const rtc::WebSocket* sender, const std::string& originNode) {
+        SendToSubscribers(connectionName, message, sender);
+
+        if (_cluster == nullptr) {
+            return;
+        }
+
+        const auto& nodeURL = _cluster->GetNodeURL();
+        const auto owner = _cluster->GetOwner(connectionName);
+        const auto body = json{ {"connectionName", connectionName}, {"message", message}, {"origin", nodeURL} }.dump();
+
+        if (owner.empty() || owner == nodeURL) {
+            for (const auto& subscriberNode : _rooms.GetRemoteSubscribers(connectionName)) {
+                if (subscriberNode != originNode) {
+                    _cluster->Post(subscriberNode, ClusterPushPath, body, "application/json");
+                }
+            }
+        }
+        else if (originNode.empty()) {
+            _cluster->Post(owner, ClusterPushPath, body, "application/json");
+        }
+    }
+
+    void SignallingServer::RebalanceRooms() {
+        const auto& nodeURL = _cluster->GetNodeURL();
+
+        auto rooms = _rooms.ExtractRooms([&](const std::string& connectionName) {
+            const auto owner = _cluster->GetOwner(connectionName);
+            return !owner.empty() && owner != nodeURL;
+        });
+
+        std::map<std::string, std::vector<std::pair<std::string, RoomStore::Room>>> roomsByOwner;
+
+        for (auto& room : rooms) {
+            roomsByOwner[_cluster->GetOwner(room.first)].push_back(std::move(room));
+        }
+
+        for (auto& [owner, ownerRooms] : roomsByOwner) {
+            for (std::size_t start = 0; start < ownerRooms.size(); start += RoomTransferBatchSize) {
+                const auto end = std::min(start + RoomTransferBatchSize, ownerRooms.size());
+                json batch = json::array();
+
+                for (std::size_t i = start; i < end; i++) {
+                    batch.push_back(RoomToJson(ownerRooms[i].first, ownerRooms[i].second));
+                }
+
+                auto result = _cluster->Post(owner, ClusterRoomsPath, json{ {"rooms", batch} }.dump(), "application/json");
+
+                if (!result || result->status != 200) {
+                    // Keep the rooms until the next membership change rather than dropping them.
+                    for (std::size_t i = start; i < end; i++) {
+                        _rooms.InsertRoom(ownerRooms[i].first, std::move(ownerRooms[i].second));
+                    }
+                }
+            }
+        }
+
+        // Local sockets subscribed to rooms that moved are registered with the new owner.
+        std::vector<std::string> subscriptions;
+        _subscribers.ForEachShard([&](auto& subscribers) {
+            for (const auto& [connectionName, sockets] : subscribers) {
+                subscriptions.push_back(connectionName);
+            }
+        });
+
+        const auto body = [&nodeURL](const std::string& connectionName) {
+            return json{ {"connectionName", connectionName}, {"node", nodeURL} }.dump();
+        };
+
+        for (const auto& connectionName : subscriptions) {
+            const auto owner = _cluster->GetOwner(connectionName);
+
+            if (!owner.empty() && owner != nodeURL) {
+                _cluster->Post(owner, ClusterSubscribePath, body(connectionName), "application/json");
+            }
+        }
+    }
+
+    void SignallingServer::HandleClient(std::shared_ptr<rtc::WebSocket> webSocket) {
+        {
+            std::lock_guard<std::mutex> lock(_clientsMutex);
+            _clients.insert(webSocket);
+        }
+
+        // The socket's callbacks only hold weak references, as the socket owns them.
+        // Callbacks for one socket are not run concurrently, so the subscription and mesh room need no lock.
+        auto subscription = std::make_shared<std::string>();
+        auto meshRoom = std::make_shared<std::string>();
+        std::weak_ptr<rtc::WebSocket> weakWebSocket = webSocket;
+
+        webSocket->onMessage(nullptr, [this, weakWebSocket, subscription, meshRoom](std::string message) {
+            if (auto webSocket = weakWebSocket.lock()) {
+                HandleSocketMessage(webSocket, *subscription, *meshRoom, message);
+            }
+        });
+
+        webSocket->onClosed([this, weakWebSocket, subscription, meshRoom]() {
+            auto webSocket = weakWebSocket.lock();
+
+            if (webSocket == nullptr) {
+                return;
+            }
+
+            if (!subscription->empty()) {
+                Unsubscribe(webSocket.get(), *subscription);
+            }
+
+            if (!meshRoom->empty()) {
+                LeaveMeshRoom(webSocket.get(), *meshRoom);
+            }
+
+            std::lock_guard<std::mutex> lock(_clientsMutex);
+            _clients.erase(webSocket);
+        });
+    }
+
+    void SignallingServer::HandleSocketMessage(const std::shared_ptr<rtc::WebSocket>& webSocket, std::string& subscription, std::string& meshRoom, const std::string& message) {
+        SocketMessagesTotal.Increment();
+
+        auto body = json::parse(message, nullptr, false);
+
+        if (body.is_discarded()) {
+            return; // Ignore malformed frames rather than tearing down the connection.
+        }
+
+        const auto type = body.value("type", "");
+
+        if (type == "join" || type == "leave") {
+            const auto roomName = body.value("roomName", "");
+
+            if (roomName.empty()) {
+                return;
+            }
+
+            if (!meshRoom.empty()) {
+                LeaveMeshRoom(webSocket.get(), meshRoom); // A socket is a member of one room at a time.
+                meshRoom.clear();
+            }
+
+            if (type == "leave") {
+                return;
+            }
+
+            const auto token = body.value("token", "");
+
+            if (_cluster != nullptr) {
+                // Mesh rooms are not moved between nodes, so members joining through different nodes would never meet.
+                webSocket->send(json{ {"type", "unsupported"}, {"roomName", roomName} }.dump());
+            }
+            else if (token.empty() || !JoinMeshRoom(webSocket, roomName, RoomStore::HashPassword(roomName, body.value("password", "")), token)) {
+                webSocket->send(json{ {"type", "rejected"}, {"roomName", roomName} }.dump());
+            }
+            else {
+                meshRoom = roomName;
+            }
+
+            return;
+        }
+
+        const auto connectionName = body.value("connectionName", "");
+
+        if (connectionName.empty()) {
+            return;
+        }
+
+        if (type == "subscribe" && connectionName != subscription) {
+            if (!subscription.empty()) {
+                Unsubscribe(webSocket.get(), subscription);
+                subscription.clear();
+            }
+
+            if (!Subscribe(webSocket, connectionName, RoomStore::HashPassword(connectionName, body.value("password", "")))) {
+                webSocket->close(); // The client falls back to polling, which only ever returns the answer.
+                return;
+            }
+
+            subscription = connectionName;
+        }
+        else if (type == "candidate" && connectionName == subscription) {
+            Publish(connectionName, message, webSocket.get(), ""); // Only into the room the socket authenticated against.
+        }
+    }
+
+    bool SignallingServer::Subscribe(const std::shared_ptr<rtc::WebSocket>& webSocket, const std::string& connectionName, const std::string& passwordHash) {
+        const auto owner = _cluster != nullptr ? _cluster->GetOwner(connectionName) : std::string();
+        const bool isRemote = !owner.empty() && owner != _cluster->GetNodeURL();
+
+        if (!isRemote && !_rooms.IsPasswordCorrect(connectionName, passwordHash)) {
+            return false;
+        }
+
+        _subscribers.WithShard(connectionName, [&](auto& subscribers) {
+            subscribers[connectionName].push_back(webSocket);
+        });
+        _subscriberCount++;
+
+        // The answer is checked after subscribing so that one published in between is still delivered, at worst twice.
+        std::optional<std::string> answer;
+
+        if (isRemote) {
+            const auto request = json{ {"connectionName", connectionName}, {"node", _cluster->GetNodeURL()}, {"passwordHash", passwordHash} }.dump();
+            auto result = _cluster->Post(owner, ClusterSubscribePath, request, "application/json");
+
+            if (result && (result->status == 403 || result->status == 404)) {
+                Unsubscribe(webSocket.get(), connectionName); // The owner has no such room, or another password.
+                return false;
+            }
+
+            auto body = result && result->status == 200 ? json::parse(result->body, nullptr, false) : json();
+
+            if (body.is_object() && body.contains("data")) {
+                answer = body.value("data", "");
+            }
+        }
+        else {
+            answer = _rooms.GetAnswer(connectionName);
+        }
+
+        if (answer.has_value()) {
+            json message = {
+                {"type", "answer"},
+                {"connectionName", connectionName},
+                {"data", *answer}
+            };
+
+            webSocket->send(message.dump());
+        }
+
+        return true;
+    }
+
+    void SignallingServer::Unsubscribe(const rtc::WebSocket* webSocket, const std::string& connectionName) {
+        const bool wasSubscribed = _subscribers.WithShard(connectionName, [&](auto& subscribers) {
+            auto entry = subscribers.find(connectionName);
+
+            if (entry == subscribers.end()) {
+                return false;
+            }
+
+            const auto removedCount = std::erase_if(entry->second, [webSocket](const auto& subscriber) {
+                return subscriber.lock().get() == webSocket;
+            });
+
+            if (entry->second.empty()) {
+                subscribers.erase(entry);
+            }
+
+            return removedCount > 0;
+        });
+
+        if (wasSubscribed) {
+            _subscriberCount--;
+        }
+    }
+
+    void SignallingServer::SendToSubscribers(const std::string& connectionName, const std::string& message, const rtc::WebSocket* sender) {
+        std::vector<std::shared_ptr<rtc::WebSocket>> recipients;
+
+        _subscribers.WithShard(connectionName, [&](auto& subscribers) {
+            auto entry = subscribers.find(connectionName);
+
+            if (entry == subscribers.end()) {
+                return;
+            }
+
+            for (const auto& subscriber : entry->second) {
+                auto webSocket = subscriber.lock();
+
+                if (webSocket != nullptr && webSocket.get() != sender) {
+                    recipients.push_back(webSocket);
+                }
+            }
+        });
+
+        for (const auto& webSocket : recipients) {
+            if (webSocket->isOpen()) {
+                webSocket->send(message);
+            }
+        }
+    }
+
+    bool SignallingServer::JoinMeshRoom(const std::shared_ptr<rtc::WebSocket>& webSocket, const std::string& roomName, const std::string& passwordHash, const std::string& token) {
+        std::vector<std::shared_ptr<rtc::WebSocket>> recipients;
+        std::string message;
+
+        const bool isJoined = _meshRooms.WithShard(roomName, [&](auto& rooms) {
+            auto [room, isCreated] = rooms.try_emplace(roomName, MeshRoom{ passwordHash, {}, 0 });
+            auto& members = room->second._members;
+
+            if (!isCreated && room->second._passwordHash != passwordHash) {
+                return false;
+            }
+
+            if (std::any_of(members.begin(), members.end(), [&token](const auto& member) { return member.first == token; })) {
+                return false;
+            }
+
+            members.emplace_back(token, webSocket);
+            room->second._version++;
+            message = CollectMembers(roomName, room->second, recipients);
+            return true;
+        });
+
+        // Sent outside the shard lock. Lists sent at once for two changes can arrive in either order, so they carry the version.
+        for (const auto& recipient : recipients) {
+            if (recipient->isOpen()) {
+                recipient->send(message);
+            }
+        }
+
+        return isJoined;
+    }
+
+    void SignallingServer::LeaveMeshRoom(const rtc::WebSocket* webSocket, const std::string& roomName) {
+        std::vector<std::shared_ptr<rtc::WebSocket>> recipients;
+        std::string message;
+
+        _meshRooms.WithShard(roomName, [&](auto& rooms) {
+            auto room = rooms.find(roomName);
+
+            if (room == rooms.end()) {
+                return;
+            }
+
+            auto& members = room->second._members;
+            const auto removedCount = std::erase_if(members, [webSocket](const auto& member) {
+                return member.second.lock().get() == webSocket;
+            });
+
+            if (members.empty()) {
+                rooms.erase(room);
+            }
+            else if (removedCount > 0) {
+                room->second._version++;
+                message = CollectMembers(roomName, room->second, recipients);
+            }
+        });
+
+        for (const auto& recipient : recipients) {
+            if (recipient->isOpen()) {
+                recipient->send(message);
+            }
+        }
+    }
+
+    std::string SignallingServer::CollectMembers(const std::string& roomName, const MeshRoom& room, std::vector<std::shared_ptr<rtc::WebSocket>>& recipients) {
+        auto tokens = json::array();
+
+        for (const auto& [token, member] : room._members) {
+            tokens.push_back(token);
+
+            if (auto webSocket = member.lock()) {
+                recipients.push_back(webSocket);
+            }
+        }
+
+        json message = {
+            {"type", "members"},
+            {"roomName", roomName},
+            {"members", tokens},
+            {"version", room._version}
+        };
+
+        return message.dump();
+    }
+
+    void SignallingServer::ExpireRooms() {
+        std::unique_lock<std::mutex> lock(_stopMutex);
+
+        while (!_stopCondition.wait_for(lock, ExpiryInterval, [this]() { return _isStopping; })) {
+            lock.unlock();
+            _rooms.ExpireRooms();
+            lock.lock();
+        }
+    }
+}
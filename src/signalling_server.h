@@ -0,0 +1,263 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "cpp-httplib/httplib.h"
+#include "libdatachannel/rtc.hpp"
+
+#include "room_store.h"
+#include "sharded_map.h"
+#include "signalling_cluster.h"
+
+namespace Comms {
+
+    /*
+    * A self-hosted signalling service implementing the same HTTP API as the hosted service, plus its WebSocket push channel.
+    *
+    * HTTP (cpp-httplib):
+    *   POST /connectionOffer   {"connectionName", "password", "offer"}   403 if an unexpired room has another password.
+    *   POST /connectionAnswer  {"connectionName", "password", "answer"}
+    *   GET  /getOffer?connectionName=&password=   200 {"data"}, 403 on a wrong password, 404 if there is no offer.
+    *   GET  /getAnswer?connectionName=            200 {"data"}, 404 if there is no answer yet.
+    *   GET  /status                               200 {"rooms", "subscribers", "meshRooms"}
+    *   GET  /metrics                              200 in the Prometheus text exposition format. @see Metrics
+    *
+    * WebSocket (rtc::WebSocketServer), using the protocol spoken by SignallingSocket:
+    *   {"type": "subscribe", "connectionName", "password"}  Pushes {"type": "answer", "data"} once the answer is published, or
+    *                                                        immediately if it already has been. Closes the socket on a wrong password.
+    *   {"type": "candidate", ...}               Relayed to every other socket subscribed to the same connection. Only
+    *                                            accepted for the connection the socket has subscribed to.
+    *   {"type": "join", "roomName", "password", "token"}  Makes the socket a member of a mesh room, created by its first
+    *                                                      member. Pushes {"type": "members", "members", "version"} to
+    *                                                      every member on each join and leave, or {"type": "rejected"} to
+    *                                                      the socket for another password or a token already present.
+    *   {"type": "leave", "roomName"}            Leaves the mesh room. A member also leaves when its socket closes.
+    *
+    * Mesh rooms let several peers find each other without polling. @see MeshSignalling. They are held in memory only for
+    * as long as they have members, and are not clustered: a clustered server answers a join with {"type": "unsupported"},
+    * so that peers fall back to meeting over the HTTP API.
+    *
+    * Rooms are held in a sharded RoomStore and removed by a background sweep once their time to live has passed.
+    *
+    * When a cluster host is configured, the server joins a SignallingCluster and owns only the rooms the cluster's hash
+    * ring assigns to it. Requests for other rooms are forwarded to their owner, sockets subscribed on one node are
+    * registered with the owner so answers and candidates reach them, and rooms are moved when members join or leave.
+    * Rooms are not replicated, so the rooms of a node that fails rather than leaving are lost.
+    *
+    * The /cluster routes, and requests marked as forwarded, are only served when signed with the cluster's key, so that a
+    * client cannot join the ring, move rooms or bypass routing. Rooms are moved between nodes with a hash of their
+    * password rather than the password itself. @see SignallingCluster
+    */
+    class SignallingServer {
+    public:
+        /*
+        * Settings for the server.
+        */
+        struct Configuration {
+            std::string _bindAddress = "0.0.0.0"; // Address both listeners bind to.
+            int _httpPort = 8000; // Port for the HTTP API. 0 selects any free port.
+            std::uint16_t _webSocketPort = 8001; // Port for the WebSocket push channel. 0 selects any free port.
+            std::size_t _shardCount = 64; // Number of independently locked shards in the room and subscriber maps.
+            std::size_t _threadCount = 32; // Number of HTTP worker threads. Each kept-alive connection occupies one while open.
+            std::chrono::seconds _roomTimeToLive = std::chrono::minutes(30); // How long a room is kept after it was last published to.
+            std::optional<std::string> _certificatePemFile; // Certificate for HTTPS and WSS. Plain HTTP and WS are used when not set.
+            std::optional<std::string> _keyPemFile; // Private key for the certificate.
+            std::string _clusterHost; // Host other cluster nodes use to reach this node. Clustering is disabled when empty.
+            std::vector<std::string> _clusterSeedURLs; // Base URLs of nodes to join the cluster through.
+            std::string _clusterKey; // Secret shared by every node, which signs the requests between them. Required to cluster.
+        };
+
+        /*
+        * Constructor.
+        *
+        * @param configuration The server settings.
+        */
+        SignallingServer(Configuration configuration);
+
+        /*
+        * Destructor. Stops the server if it is running.
+        */
+        ~SignallingServer();
+
+        SignallingServer(const SignallingServer&) = delete;
+        SignallingServer& operator=(const SignallingServer&) = delete;
+
+        /*
+        * Binds both listeners and starts serving on background threads.
+        *
+        * @return False if the HTTP listener could not be bound, or clustering is configured without a key.
+        */
+        bool Start();
+
+        /*
+        * Blocks until the server is stopped.
+        */
+        void Wait();
+
+        /*
+        * Stops serving and closes every subscribed socket.
+        */
+        void Stop();
+
+        /*
+        * @return The port the HTTP API is listening on.
+        */
+        int GetHttpPort() const;
+
+        /*
+        * @return The port the WebSocket push channel is listening on.
+        */
+        std::uint16_t GetWebSocketPort() const;
+
+    private:
+        /*
+        * Registers the HTTP API routes.
+        */
+        void RegisterRoutes();
+
+        /*
+        * @return Whether a request must be signed by a cluster node: one to a /cluster route, or one marked as forwarded.
+        */
+        static bool IsClusterRequest(const httplib::Request& request);
+
+        void HandlePublishOffer(const httplib::Request& request, httplib::Response& response);
+        void HandlePublishAnswer(const httplib::Request& request, httplib::Response& response);
+        void HandleGetOffer(const httplib::Request& request, httplib::Response& response);
+        void HandleGetAnswer(const httplib::Request& request, httplib::Response& response);
+        void HandleStatus(const httplib::Request& request, httplib::Response& response);
+        void HandleClusterHeartbeat(const httplib::Request& request, httplib::Response& response);
+        void HandleClusterLeave(const httplib::Request& request, httplib::Response& response);
+        void HandleClusterRooms(const httplib::Request& request, httplib::Response& response);
+        void HandleClusterSubscribe(const httplib::Request& request, httplib::Response& response);
+        void HandleClusterPush(const httplib::Request& request, httplib::Response& response);
+
+        /*
+        * Forwards a request to the node owning a connection, unless this node owns it or the request was already forwarded.
+        *
+        * @return True if the request was forwarded and the response filled in.
+        */
+        bool ForwardToOwner(const std::string& connectionName, const httplib::Request& request, httplib::Response& response);
+
+        /*
+        * Delivers a message to every socket subscribed to a connection across the cluster, other than the sender.
+        * The owner of the connection fans the message out to the other subscribed nodes. Other nodes pass messages
+        * that originated with them to the owner.
+        *
+        * @param sender The socket the message came from, if it came from a local socket.
+        * @param originNode The node the message came from, if it came from another node.
+        */
+        void Publish(const std::string& connectionName, const std::string& message, const rtc::WebSocket* sender, const std::string& originNode);
+
+        /*
+        * Moves rooms this node no longer owns to their owners, and registers local subscriptions with their owners.
+        */
+        void RebalanceRooms();
+
+        /*
+        * Sets up the callbacks of a newly accepted WebSocket client.
+        */
+        void HandleClient(std::shared_ptr<rtc::WebSocket> webSocket);
+
+        /*
+        * Handles a message received on a subscribed socket.
+        *
+        * @param webSocket The socket the message arrived on.
+        * @param subscription The connection name the socket is subscribed to. Set by a subscribe message with the room's password.
+        * @param meshRoom The mesh room the socket is a member of. Set by a join message with the room's password.
+        * @param message The message text.
+        */
+        void HandleSocketMessage(const std::shared_ptr<rtc::WebSocket>& webSocket, std::string& subscription, std::string& meshRoom, const std::string& message);
+
+        /*
+        * Adds a socket to the subscribers of a connection and pushes the answer if it has already been published.
+        * The password is checked against the room by the node that owns it.
+        *
+        * @param passwordHash The password the socket subscribed with, hashed with the connection name.
+        * @return False if there is no such room or the password does not match, leaving the socket unsubscribed.
+        */
+        bool Subscribe(const std::shared_ptr<rtc::WebSocket>& webSocket, const std::string& connectionName, const std::string& passwordHash);
+
+        /*
+        * Removes a socket from the subscribers of a connection.
+        */
+        void Unsubscribe(const rtc::WebSocket* webSocket, const std::string& connectionName);
+
+        /*
+        * Sends a message to every local socket subscribed to a connection, other than the sender.
+        * Sockets are collected under the shard lock and sent to after it is released.
+        */
+        void SendToSubscribers(const std::string& connectionName, const std::string& message, const rtc::WebSocket* sender = nullptr);
+
+        /*
+        * Adds a socket to the members of a mesh room, creating the room if it has none, and pushes the members to every member.
+        *
+        * @param passwordHash The password the socket joined with, hashed with the room name.
+        * @return False if the room has another password or already has a member with the token, leaving the socket out.
+        */
+        bool JoinMeshRoom(const std::shared_ptr<rtc::WebSocket>& webSocket, const std::string& roomName, const std::string& passwordHash, const std::string& token);
+
+        /*
+        * Removes a socket from the members of a mesh room and pushes the members to those remaining. The room is removed
+        * with its last member.
+        */
+        void LeaveMeshRoom(const rtc::WebSocket* webSocket, const std::string& roomName);
+
+        /*
+        * Periodically removes expired rooms until the server is stopped.
+        */
+        void ExpireRooms();
+
+        using Subscribers = std::vector<std::weak_ptr<rtc::WebSocket>>;
+
+        /*
+        * Peers meeting in a room, who are each told of the others as they join and leave.
+        */
+        struct MeshRoom {
+            std::string _passwordHash; // The hash of the password the room was created with. @see RoomStore::HashPassword
+            std::vector<std::pair<std::string, std::weak_ptr<rtc::WebSocket>>> _members; // Each member's token and socket, in the order they joined.
+            std::uint64_t _version = 0; // Counts the changes to the members, so that a client can ignore a list pushed out of order.
+        };
+
+        /*
+        * Builds the members message of a mesh room, and collects its members' sockets to send it to, so that it can be
+        * sent once the room's shard is unlocked.
+        */
+        static std::string CollectMembers(const std::string& roomName, const MeshRoom& room, std::vector<std::shared_ptr<rtc::WebSocket>>& recipients);
+
+        const Configuration _configuration; // The server settings.
+
+        RoomStore _rooms; // Offers and answers keyed by connection name.
+        ShardedMap<Subscribers> _subscribers; // Sockets waiting on each connection, keyed by connection name.
+        std::atomic<std::size_t> _subscriberCount = 0; // Number of sockets currently subscribed to a connection.
+        ShardedMap<MeshRoom> _meshRooms; // Mesh rooms with members, keyed by room name.
+
+        const ClusterKey _clusterKey; // Signs the requests sent to other cluster nodes.
+        ClusterRequestVerifier _clusterRequestVerifier; // Verifies requests from other cluster nodes, and rejects those replayed.
+        std::unique_ptr<SignallingCluster> _cluster; // Cluster membership and routing. Null when clustering is disabled.
+
+        std::unique_ptr<httplib::Server> _httpServer; // The HTTP API listener. An httplib::SSLServer when a certificate is configured.
+        std::unique_ptr<rtc::WebSocketServer> _webSocketServer; // The push channel listener.
+        int _httpPort = 0; // The port the HTTP API is bound to.
+
+        std::unordered_set<std::shared_ptr<rtc::WebSocket>> _clients; // Every open socket. Holds ownership until the socket closes.
+        std::mutex _clientsMutex; // Mutex to control read and write access to _clients.
+
+        std::thread _httpThread; // Runs the HTTP accept loop.
+        std::thread _expiryThread; // Runs the room expiry sweep.
+        bool _isStopping = false; // Set when the server is stopping.
+        std::mutex _stopMutex; // Mutex to control read and write access to _isStopping.
+        std::condition_variable _stopCondition; // Signalled when the server is stopping.
+    };
+}
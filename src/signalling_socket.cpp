@@ -0,0 +1,245 @@
+#include "signalling_socket.h"
+
+#include "json/json.hpp"
+
+using json = nlohmann::json;
+
+namespace Comms {
+    SignallingSocket::SignallingSocket(std::string url) :
+        _webSocket(std::make_shared<rtc::WebSocket>()) {
+
+        _webSocket->onOpen([this]() {
+            {
+                std::lock_guard<std::mutex> lock(_sendMutex);
+
+                for (const auto& message : _pendingMessages) {
+                    Transmit(message);
+                }
+
+                _pendingMessages.clear();
+                _isSendable = true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_stateMutex);
+                _isOpen = true;
+            }
+            _stateChangedCondition.notify_all();
+        });
+
+        _webSocket->onError([this](std::string) {
+            HandleClosed();
+        });
+
+        _webSocket->onClosed([this]() {
+            HandleClosed();
+        });
+
+        _webSocket->onMessage(nullptr, [this](std::string message) {
+            HandleMessage(message);
+        });
+
+        _webSocket->open(url);
+    }
+
+    SignallingSocket::~SignallingSocket() {
+        _webSocket->resetCallbacks();
+        _webSocket->close();
+    }
+
+    bool SignallingSocket::WaitForOpen(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(_stateMutex);
+        _stateChangedCondition.wait_for(lock, timeout, [this]() { return _isClosed || _isOpen; });
+
+        return !_isClosed && _isOpen;
+    }
+
+    void SignallingSocket::Subscribe(const std::string& connectionName, const std::string& password) {
+        _connectionName = connectionName;
+
+        json message = {
+            {"type", "subscribe"},
+            {"connectionName", _connectionName},
+            {"password", password}
+        };
+
+        Send(message.dump());
+    }
+
+    std::optional<std::string> SignallingSocket::WaitForAnswer(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(_stateMutex);
+        _stateChangedCondition.wait_for(lock, timeout, [this]() { return _isClosed || _answer.has_value(); });
+
+        return _answer;
+    }
+
+    void SignallingSocket::OnCandidate(std::function<void(std::string candidate, std::string mid)> callback) {
+        std::lock_guard<std::mutex> lock(_stateMutex);
+        _candidateCallback = callback;
+    }
+
+    void SignallingSocket::SendCandidate(const std::string& candidate, const std::string& mid) {
+        json message = {
+            {"type", "candidate"},
+            {"connectionName", _connectionName},
+            {"candidate", candidate},
+            {"mid", mid}
+        };
+
+        Send(message.dump());
+    }
+
+    void SignallingSocket::JoinRoom(const std::string& roomName, const std::string& password, const std::string& token) {
+        _roomName = roomName;
+
+        json message = {
+            {"type", "join"},
+            {"roomName", _roomName},
+            {"password", password},
+            {"token", token}
+        };
+
+        Send(message.dump());
+    }
+
+    RoomJoinResult SignallingSocket::WaitForJoin(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(_stateMutex);
+        _stateChangedCondition.wait_for(lock, timeout, [this]() { return _isClosed || _joinResult.has_value(); });
+
+        return _joinResult.value_or(RoomJoinResult::Unsupported);
+    }
+
+    void SignallingSocket::OnMembers(SignallingClient::MembersHandler callback) {
+        std::lock_guard<std::mutex> lock(_membersMutex);
+        _membersCallback = callback;
+    }
+
+    void SignallingSocket::LeaveRoom() {
+        json message = {
+            {"type", "leave"},
+            {"roomName", _roomName}
+        };
+
+        Send(message.dump());
+    }
+
+    void SignallingSocket::Close() {
+        {
+            std::lock_guard<std::mutex> lock(_stateMutex);
+            _isClosed = true;
+        }
+        _stateChangedCondition.notify_all();
+
+        _webSocket->close();
+    }
+
+    void SignallingSocket::HandleMessage(const std::string& message) {
+        auto body = json::parse(message, nullptr, false);
+
+        if (body.is_discarded()) {
+            return; // Ignore malformed frames rather than tearing down the connection.
+        }
+
+        const auto type = body.value("type", "");
+
+        if (type == "answer") {
+            {
+                std::lock_guard<std::mutex> lock(_stateMutex);
+                _answer = body.value("data", "");
+            }
+            _stateChangedCondition.notify_all();
+        }
+        else if (type == "candidate") {
+            std::function<void(std::string, std::string)> callback;
+            {
+                std::lock_guard<std::mutex> lock(_stateMutex);
+                callback = _candidateCallback;
+            }
+
+            if (callback) {
+                callback(body.value("candidate", ""), body.value("mid", ""));
+            }
+        }
+        else if (type == "members") {
+            const auto members = body.value("members", json::array());
+            const auto version = body.value("version", std::uint64_t{ 0 });
+
+            if (!members.is_array()) {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_membersMutex);
+
+                // Lists are pushed as members come and go, so one pushed before the last delivered is out of date.
+                if (version <= _membersVersion) {
+                    return;
+                }
+
+                _membersVersion = version;
+
+                if (_membersCallback) {
+                    std::vector<std::string> tokens;
+
+                    for (const auto& member : members) {
+                        if (member.is_string()) {
+                            tokens.push_back(member.get<std::string>());
+                        }
+                    }
+
+                    _membersCallback(std::move(tokens));
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(_stateMutex);
+                _joinResult = RoomJoinResult::Joined;
+            }
+            _stateChangedCondition.notify_all();
+        }
+        else if (type == "rejected" || type == "unsupported") {
+            {
+                std::lock_guard<std::mutex> lock(_stateMutex);
+
+                if (!_joinResult.has_value()) {
+                    _joinResult = type == "rejected" ? RoomJoinResult::Rejected : RoomJoinResult::Unsupported;
+                }
+            }
+            _stateChangedCondition.notify_all();
+        }
+    }
+
+    void SignallingSocket::HandleClosed() {
+        {
+            std::lock_guard<std::mutex> lock(_stateMutex);
+            _isClosed = true;
+        }
+        _stateChangedCondition.notify_all();
+
+        std::lock_guard<std::mutex> lock(_membersMutex);
+
+        // The service drops a member whose socket closes, so the room is lost. Only said once, as both error and close are reported.
+        if (_membersVersion > 0 && _membersCallback) {
+            _membersCallback(std::nullopt);
+            _membersCallback = nullptr;
+        }
+    }
+
+    void SignallingSocket::Send(std::string message) {
+        std::lock_guard<std::mutex> lock(_sendMutex);
+
+        if (_isSendable) {
+            Transmit(message);
+        }
+        else {
+            _pendingMessages.push_back(std::move(message));
+        }
+    }
+
+    void SignallingSocket::Transmit(const std::string& message) {
+        try {
+            _webSocket->send(message);
+        }
+        catch (const std::exception&) {
+            // The socket closed after it opened, e.g. because it was cancelled. WaitForAnswer returns without an answer.
+        }
+    }
+}
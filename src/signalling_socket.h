@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "libdatachannel/rtc.hpp"
+
+#include "signalling_client.h"
+
+namespace Comms {
+
+    /*
+    * A push channel to the signalling service.
+    * Instead of polling the service for an answer, a peer subscribes to its connection name and the service pushes
+    * the answer, and any ICE candidates trickled by the remote peer, as soon as they are published.
+    * Once the socket is open, answer delivery takes a single network round trip.
+    *
+    * A peer can also join a room of several peers, whose members the service pushes to every member as they join and
+    * leave. A member leaves when it says so or its socket closes. @see SignallingClient::JoinRoom
+    *
+    * Messages are JSON text frames:
+    *   {"type": "subscribe", "connectionName": "...", "password": "..."}       Client to service.
+    *   {"type": "answer", "connectionName": "...", "data": "<sdp>"}            Service to client.
+    *   {"type": "candidate", "connectionName": "...", "candidate": "...", "mid": "..."}  Either direction.
+    *   {"type": "join", "roomName": "...", "password": "...", "token": "..."}  Client to service.
+    *   {"type": "leave", "roomName": "..."}                                    Client to service.
+    *   {"type": "members", "roomName": "...", "members": ["<token>", ...], "version": n}  Service to client. Members in
+    *                                                                           the order they joined. Versions only grow.
+    *   {"type": "rejected", "roomName": "..."}                                 Service to client, for another password.
+    *   {"type": "unsupported", "roomName": "..."}                              Service to client, without rooms.
+    *
+    * Messages sent before the socket opens are queued, and sent in order once it does.
+    *
+    * WebSocket functionality is provided by the libdatachannel library.
+    */
+    class SignallingSocket {
+    public:
+        /*
+        * Constructor.
+        * Begins opening the socket immediately so that the handshake overlaps with ICE gathering.
+        *
+        * @param url The WebSocket URL of the signalling service.
+        */
+        SignallingSocket(std::string url);
+
+        /*
+        * Destructor. Closes the socket.
+        */
+        ~SignallingSocket();
+
+        /*
+        * Waits for the socket to open.
+        *
+        * @param timeout The maximum time to wait.
+        * @return True if the socket is open, false if it failed to open or the timeout elapsed.
+        */
+        bool WaitForOpen(std::chrono::milliseconds timeout);
+
+        /*
+        * Subscribes to messages for a connection name. Sent once the socket opens, if it has not yet.
+        * If an answer has already been published for the connection, the service pushes it straight away.
+        * The service closes the socket if the password does not match the one the offer was published with.
+        *
+        * @param connectionName The name identifying the connection.
+        * @param password The password used to grant access to the connection.
+        */
+        void Subscribe(const std::string& connectionName, const std::string& password);
+
+        /*
+        * Waits for the service to push an answer SDP for the subscribed connection.
+        *
+        * @param timeout The maximum time to wait.
+        * @return The answer SDP if it was received before the timeout elapsed or the socket closed.
+        */
+        std::optional<std::string> WaitForAnswer(std::chrono::milliseconds timeout);
+
+        /*
+        * Sets the function called when the remote peer trickles an ICE candidate.
+        *
+        * @param callback Called with the candidate string and its media stream identification tag.
+        */
+        void OnCandidate(std::function<void(std::string candidate, std::string mid)> callback);
+
+        /*
+        * Trickles a local ICE candidate to the remote peer, through the subscribed connection.
+        * Sent once the socket opens, if it has not yet, after the subscription.
+        *
+        * @param candidate The candidate string.
+        * @param mid The media stream identification tag of the candidate.
+        */
+        void SendCandidate(const std::string& candidate, const std::string& mid);
+
+        /*
+        * Joins a room of several peers. Sent once the socket opens, if it has not yet. The service pushes the room's
+        * members once joined, and again each time one joins or leaves.
+        *
+        * @param roomName The name of the room.
+        * @param password The password of the room.
+        * @param token Identifies the member for this join.
+        */
+        void JoinRoom(const std::string& roomName, const std::string& password, const std::string& token);
+
+        /*
+        * Waits for the service to answer JoinRoom.
+        *
+        * @param timeout The maximum time to wait.
+        * @return Joined once the first list of members arrives, Rejected for another password, or Unsupported if the
+        *         service has no rooms, or the socket closed or the timeout elapsed first.
+        */
+        RoomJoinResult WaitForJoin(std::chrono::milliseconds timeout);
+
+        /*
+        * Sets the function called with the room's members each time they are pushed, and with std::nullopt if the socket
+        * closes once the room has been joined. No call is in progress or made once it returns with a null function.
+        */
+        void OnMembers(SignallingClient::MembersHandler callback);
+
+        /*
+        * Leaves the room joined.
+        */
+        void LeaveRoom();
+
+        /*
+        * Closes the socket, so that a wait for it to open, for an answer or to join a room returns. Thread safe.
+        */
+        void Close();
+
+    private:
+        /*
+        * Handles a text frame pushed by the service.
+        *
+        * @param message The JSON message.
+        */
+        void HandleMessage(const std::string& message);
+
+        /*
+        * Sends a message if the socket is open, or queues it until it opens.
+        *
+        * @param message The JSON message.
+        */
+        void Send(std::string message);
+
+        /*
+        * Sends a message on the open socket. A socket closed since it opened drops the message.
+        */
+        void Transmit(const std::string& message);
+
+        /*
+        * Handles the socket failing or closing.
+        */
+        void HandleClosed();
+
+        std::shared_ptr<rtc::WebSocket> _webSocket; // The underlying WebSocket connection.
+        std::string _connectionName; // The connection name subscribed to.
+        std::string _roomName; // The room joined.
+
+        std::vector<std::string> _pendingMessages; // Messages sent before the socket opened, in order.
+        bool _isSendable = false; // Whether the socket has opened and the pending messages have been sent.
+        std::mutex _sendMutex; // Mutex to keep messages in order, controlling access to _pendingMessages and _isSendable.
+
+        std::optional<std::string> _answer; // The answer SDP, set when pushed by the service.
+        std::optional<RoomJoinResult> _joinResult; // The service's answer to JoinRoom, once it has answered.
+        bool _isOpen = false; // Whether the socket has opened.
+        bool _isClosed = false; // Whether the socket has failed or been closed.
+        std::mutex _stateMutex; // Mutex to control read and write access to _answer, _joinResult, _isOpen and _isClosed.
+        std::condition_variable _stateChangedCondition; // Notified when the socket opens or closes, an answer arrives or a join is answered.
+
+        std::function<void(std::string, std::string)> _candidateCallback; // Called when a remote candidate is pushed.
+
+        SignallingClient::MembersHandler _membersCallback; // Called when the room's members are pushed. Requires _membersMutex.
+        std::uint64_t _membersVersion = 0; // The version of the members last delivered, so an older list is not. Requires _membersMutex.
+        std::mutex _membersMutex; // Mutex held while members are delivered, controlling access to _membersCallback and _membersVersion.
+    };
+}
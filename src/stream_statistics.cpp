@@ -0,0 +1,64 @@
+#include "stream_statistics.h"
+
+#include <cmath>
+
+namespace {
+    constexpr std::int64_t BitrateWindow = 1000000; // Microseconds the bitrate is measured over.
+    constexpr double SamplesPerMicrosecond = 0.048; // The RTP clock rate of 48 kHz audio.
+    constexpr double JitterGain = 1.0 / 16.0; // The weight of each packet's transit time difference (RFC 3550 6.4.1).
+
+    // Microseconds between packets after which the stream is treated as having paused, e.g. on hold, rather than jittered.
+    constexpr std::int64_t JitterPauseTime = 500000;
+}
+
+namespace Comms {
+    void StreamStatistics::OnPacket(std::size_t size, std::int64_t now, std::optional<std::uint32_t> rtpTimestamp) {
+        if (_windowStart < 0) {
+            _windowStart = now;
+        }
+        else if (now - _windowStart >= BitrateWindow) {
+            _bitrate.store(static_cast<int>(_windowBytes * 8 * 1000000 / BitrateWindow), std::memory_order_relaxed);
+            _bitrateEnd.store(_windowStart + BitrateWindow, std::memory_order_relaxed);
+
+            // After a gap of more than a second, e.g. while on hold, measuring starts again from this packet.
+            _windowStart = now - _windowStart >= 2 * BitrateWindow ? now : _windowStart + BitrateWindow;
+            _windowBytes = 0;
+        }
+
+        _windowBytes += size;
+
+        if (rtpTimestamp.has_value()) {
+            if (_previousArrival.has_value() && now - _previousArrival->first < JitterPauseTime) {
+                const auto& [previousTime, previousTimestamp] = *_previousArrival;
+                const double arrivalDelta = (now - previousTime) * SamplesPerMicrosecond;
+                const double timestampDelta = static_cast<std::int32_t>(*rtpTimestamp - previousTimestamp);
+
+                _jitter += (std::abs(arrivalDelta - timestampDelta) - _jitter) * JitterGain;
+                _jitterMilliseconds.store(_jitter / SamplesPerMicrosecond / 1000.0, std::memory_order_relaxed);
+            }
+
+            _previousArrival.emplace(now, *rtpTimestamp);
+        }
+
+        _packetCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t StreamStatistics::GetPacketCount() const {
+        return _packetCount.load(std::memory_order_relaxed);
+    }
+
+    int StreamStatistics::GetBitrate(std::int64_t now) const {
+        const auto bitrateEnd = _bitrateEnd.load(std::memory_order_relaxed);
+
+        // A second with no packets is never published, so a bitrate older than the second after it is stale.
+        if (bitrateEnd < 0 || now - bitrateEnd >= 2 * BitrateWindow) {
+            return 0;
+        }
+
+        return _bitrate.load(std::memory_order_relaxed);
+    }
+
+    double StreamStatistics::GetJitter() const {
+        return _jitterMilliseconds.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace Comms {
+
+    /*
+    * Counts the packets of one direction of a connection, and measures their bitrate and, for received RTP, their
+    * interarrival jitter, for display while the call runs.
+    *
+    * Written by one thread at a time, the one sending or receiving the packets, and read by any without a lock: each
+    * figure is published in its own atomic once it is updated.
+    */
+    class StreamStatistics {
+    public:
+        /*
+        * Records a packet. One thread at a time.
+        *
+        * @param size The size of the packet in bytes, headers included.
+        * @param now When it was sent or received, in microseconds.
+        * @param rtpTimestamp The RTP timestamp of a received packet of 48 kHz audio, to measure jitter with, if it has one.
+        */
+        void OnPacket(std::size_t size, std::int64_t now, std::optional<std::uint32_t> rtpTimestamp = std::nullopt);
+
+        /*
+        * @return Packets recorded.
+        */
+        std::uint64_t GetPacketCount() const;
+
+        /*
+        * @param now The time, in microseconds on the clock packets are recorded with.
+        * @return The bitrate over the last whole second, in bits per second, or 0 if no packet has been recorded since.
+        */
+        int GetBitrate(std::int64_t now) const;
+
+        /*
+        * @return The interarrival jitter of the packets recorded with RTP timestamps, in milliseconds (RFC 3550 6.4.1).
+        */
+        double GetJitter() const;
+
+    private:
+        std::int64_t _windowStart = -1; // When the second being measured started, or -1 before the first packet. Writer only.
+        std::size_t _windowBytes = 0; // Bytes recorded in the second being measured. Writer only.
+        std::optional<std::pair<std::int64_t, std::uint32_t>> _previousArrival; // When the last timestamped packet arrived, and its timestamp. Writer only.
+        double _jitter = 0.0; // The jitter, in samples. Writer only.
+
+        std::atomic<std::uint64_t> _packetCount = 0; // Packets recorded.
+        std::atomic<int> _bitrate = 0; // The bitrate of the last whole second measured.
+        std::atomic<std::int64_t> _bitrateEnd = -1; // When the second _bitrate was measured over ended.
+        std::atomic<double> _jitterMilliseconds = 0.0; // _jitter, in milliseconds.
+    };
+}
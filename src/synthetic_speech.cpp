@@ -0,0 +1,49 @@
+#include "synthetic_speech.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "opuscpp/opus_wrapper.h"
+
+namespace {
+    constexpr int SampleRate = 48000;
+    constexpr int FrameSampleCount = 960;
+}
+
+namespace Comms {
+    std::vector<std::int16_t> GenerateSpeech(std::size_t speaker, std::size_t sampleCount) {
+        std::mt19937 random(static_cast<std::uint32_t>(speaker));
+        std::normal_distribution<double> noise(0.0, 300.0);
+
+        const double pitch = 110.0 + 20.0 * speaker;
+        std::vector<std::int16_t> samples(sampleCount);
+
+        for (std::size_t i = 0; i < sampleCount; i++) {
+            const double time = i / static_cast<double>(SampleRate);
+            const double envelope = 0.5 + 0.5 * std::sin(2.0 * 3.14159265 * 4.0 * time);
+            const double voice = std::sin(2.0 * 3.14159265 * pitch * (1.0 + 0.05 * std::sin(time)) * time);
+
+            samples[i] = static_cast<std::int16_t>(std::clamp(8000.0 * envelope * voice + noise(random), -32768.0, 32767.0));
+        }
+
+        return samples;
+    }
+
+    std::vector<SpeechFrame> EncodeSpeech(std::size_t speaker, int bitrate) {
+        opus::Encoder encoder(SampleRate, 1, OPUS_APPLICATION_VOIP);
+        encoder.SetBitrate(bitrate);
+
+        const auto speech = GenerateSpeech(speaker, SpeechFrameCount * FrameSampleCount);
+        std::vector<SpeechFrame> frames;
+
+        for (std::size_t i = 0; i < SpeechFrameCount; i++) {
+            const std::vector<opus_int16> frame(speech.begin() + i * FrameSampleCount, speech.begin() + (i + 1) * FrameSampleCount);
+            const auto encoded = encoder.Encode(frame, FrameSampleCount);
+            auto data = reinterpret_cast<const std::byte*>(encoded.front().data());
+            frames.push_back({ std::vector<std::byte>(data, data + encoded.front().size()), MeasureAudioLevel(frame.data(), frame.size()) });
+        }
+
+        return frames;
+    }
+}
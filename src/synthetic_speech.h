@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "audio_level.h"
+
+namespace Comms {
+
+    /*
+    * One 20 ms frame of encoded speech, ready to send.
+    */
+    struct SpeechFrame {
+        std::vector<std::byte> _packet; // The Opus packet.
+        AudioLevel _level; // The level of the audio the packet was encoded from.
+    };
+
+    constexpr std::size_t SpeechFrameCount = 50; // Frames returned by EncodeSpeech, one second of audio.
+
+    /*
+    * Generates speech-like audio for one speaker: a voiced tone with a wandering pitch, a syllable-rate envelope and noise.
+    *
+    * @param speaker Selects the speaker's pitch and noise, so that different speakers produce different audio.
+    * @param sampleCount The number of 48 kHz mono samples to generate.
+    * @return The samples.
+    */
+    std::vector<std::int16_t> GenerateSpeech(std::size_t speaker, std::size_t sampleCount);
+
+    /*
+    * Encodes a second of speech-like audio for one speaker: a voiced tone with a wandering pitch, a syllable-rate envelope and noise.
+    * Benchmarks and load generators replay the frames in a loop, so that encoding does not count towards what they measure.
+    *
+    * @param speaker Selects the speaker's pitch and noise, so that different speakers produce different packets.
+    * @param bitrate The Opus bitrate in bits per second.
+    * @return SpeechFrameCount consecutive 20 ms frames.
+    */
+    std::vector<SpeechFrame> EncodeSpeech(std::size_t speaker, int bitrate);
+}
@@ -0,0 +1,303 @@
+#include "transport_feedback.h"
+
+#include <algorithm>
+
+#include "rtp_packet.h"
+
+namespace {
+    constexpr std::size_t RtcpHeaderSize = 4;
+    constexpr std::uint8_t TransportFeedbackFormat = 15;
+    constexpr std::uint8_t RtpFeedbackPacketType = 205;
+
+    constexpr std::int64_t ReferenceTimeUnit = 64000; // Microseconds in a unit of the reference time.
+    constexpr std::int64_t DeltaUnit = 250; // Microseconds in a unit of a receive delta.
+
+    constexpr std::size_t MaximumRunLength = 8191; // The longest run a run length chunk can hold.
+    constexpr std::size_t StatusVectorSymbols = 7; // Two-bit symbols in a status vector chunk.
+
+    // Packets reported by one feedback at most. Older packets are dropped from a feedback that would report more.
+    constexpr std::int64_t MaximumReportedPackets = 1000;
+
+    enum Status : std::uint8_t {
+        NotReceived = 0,
+        SmallDelta = 1, // Received, with a delta of one unsigned byte.
+        LargeDelta = 2 // Received, with a delta of two signed bytes.
+    };
+
+    std::uint8_t ReadByte(const std::byte* data, std::size_t offset) {
+        return std::to_integer<std::uint8_t>(data[offset]);
+    }
+
+    std::uint16_t ReadUint16(const std::byte* data, std::size_t offset) {
+        return static_cast<std::uint16_t>((ReadByte(data, offset) << 8) | ReadByte(data, offset + 1));
+    }
+
+    void AppendUint16(rtc::binary& data, std::uint16_t value) {
+        data.push_back(std::byte(value >> 8));
+        data.push_back(std::byte(value & 0xFF));
+    }
+
+    void AppendUint32(rtc::binary& data, std::uint32_t value) {
+        AppendUint16(data, static_cast<std::uint16_t>(value >> 16));
+        AppendUint16(data, static_cast<std::uint16_t>(value & 0xFFFF));
+    }
+
+    /*
+    * Reads the packets reported by one transport-cc feedback message, from its base sequence number onwards.
+    *
+    * @return False if the message is malformed.
+    */
+    bool ParseFeedbackMessage(const std::byte* message, std::size_t size, std::vector<Comms::PacketArrival>& packets) {
+        constexpr std::size_t FixedSize = 20; // Header, both SSRCs, base sequence number, count and reference time.
+
+        if (size < FixedSize) {
+            return false;
+        }
+
+        const std::uint16_t baseSequenceNumber = ReadUint16(message, 12);
+        const std::size_t statusCount = ReadUint16(message, 14);
+
+        // The reference time is a signed 24-bit count of 64 ms.
+        std::int64_t referenceTime = (static_cast<std::int64_t>(ReadByte(message, 16)) << 16) | (ReadByte(message, 17) << 8) | ReadByte(message, 18);
+
+        if (referenceTime & 0x800000) {
+            referenceTime -= 0x1000000;
+        }
+
+        std::vector<std::uint8_t> statuses;
+        std::size_t offset = FixedSize;
+
+        while (statuses.size() < statusCount) {
+            if (offset + 2 > size) {
+                return false;
+            }
+
+            const std::uint16_t chunk = ReadUint16(message, offset);
+            offset += 2;
+
+            if ((chunk & 0x8000) == 0) {
+                // A run length chunk.
+                const auto status = static_cast<std::uint8_t>((chunk >> 13) & 0x03);
+                const std::size_t length = std::min<std::size_t>(chunk & 0x1FFF, statusCount - statuses.size());
+                statuses.insert(statuses.end(), length, status);
+            }
+            else if ((chunk & 0x4000) == 0) {
+                // A status vector chunk of 14 one-bit symbols, received with a small delta or not received.
+                for (int bit = 13; bit >= 0 && statuses.size() < statusCount; bit--) {
+                    statuses.push_back((chunk >> bit) & 0x01 ? SmallDelta : NotReceived);
+                }
+            }
+            else {
+                // A status vector chunk of 7 two-bit symbols.
+                for (int symbol = 6; symbol >= 0 && statuses.size() < statusCount; symbol--) {
+                    statuses.push_back(static_cast<std::uint8_t>((chunk >> (2 * symbol)) & 0x03));
+                }
+            }
+        }
+
+        std::int64_t arrivalTime = referenceTime * ReferenceTimeUnit;
+
+        for (std::size_t i = 0; i < statuses.size(); i++) {
+            const auto sequenceNumber = static_cast<std::uint16_t>(baseSequenceNumber + i);
+
+            if (statuses[i] == SmallDelta) {
+                if (offset + 1 > size) {
+                    return false;
+                }
+
+                arrivalTime += ReadByte(message, offset) * DeltaUnit;
+                offset += 1;
+            }
+            else if (statuses[i] == LargeDelta) {
+                if (offset + 2 > size) {
+                    return false;
+                }
+
+                arrivalTime += static_cast<std::int16_t>(ReadUint16(message, offset)) * DeltaUnit;
+                offset += 2;
+            }
+            else {
+                packets.push_back({ sequenceNumber, std::nullopt });
+                continue;
+            }
+
+            packets.push_back({ sequenceNumber, arrivalTime });
+        }
+
+        return true;
+    }
+
+    /*
+    * Appends one transport-cc feedback message to an RTCP packet, reporting packets from the first given for as long as
+    * each receive delta fits the two signed bytes the format carries.
+    *
+    * @return The first packet not reported, from which the next message should start.
+    */
+    std::vector<Comms::PacketArrival>::const_iterator AppendFeedbackMessage(rtc::binary& feedback, std::uint32_t senderSsrc, std::uint32_t mediaSsrc,
+        std::uint8_t feedbackCount, std::vector<Comms::PacketArrival>::const_iterator begin, std::vector<Comms::PacketArrival>::const_iterator end) {
+        const auto firstArrival = std::find_if(begin, end, [](const auto& packet) { return packet._arrivalTime.has_value(); });
+        const std::int64_t referenceTime = firstArrival != end ? *firstArrival->_arrivalTime / ReferenceTimeUnit : 0;
+
+        // Each delta is from the time the previous one reached, so rounding never accumulates.
+        std::vector<std::uint8_t> statuses;
+        std::vector<std::int64_t> deltas;
+        std::int64_t time = referenceTime * ReferenceTimeUnit;
+        auto packet = begin;
+
+        for (; packet != end; ++packet) {
+            if (!packet->_arrivalTime.has_value()) {
+                statuses.push_back(NotReceived);
+                continue;
+            }
+
+            const std::int64_t offset = *packet->_arrivalTime - time;
+            const std::int64_t delta = offset >= 0 ? (offset + DeltaUnit / 2) / DeltaUnit : -((-offset + DeltaUnit / 2) / DeltaUnit);
+
+            // Never the first arrival, which is within a reference time unit of the reference time.
+            if (delta < INT16_MIN || delta > INT16_MAX) {
+                break;
+            }
+
+            statuses.push_back(delta >= 0 && delta <= 0xFF ? SmallDelta : LargeDelta);
+            deltas.push_back(delta);
+            time += delta * DeltaUnit;
+        }
+
+        const std::size_t start = feedback.size();
+        feedback.push_back(std::byte(0x80 | TransportFeedbackFormat)); // Version 2.
+        feedback.push_back(std::byte(RtpFeedbackPacketType));
+        AppendUint16(feedback, 0); // The length, written once known.
+        AppendUint32(feedback, senderSsrc);
+        AppendUint32(feedback, mediaSsrc);
+        AppendUint16(feedback, begin->_sequenceNumber);
+        AppendUint16(feedback, static_cast<std::uint16_t>(statuses.size()));
+        AppendUint32(feedback, (static_cast<std::uint32_t>(referenceTime & 0xFFFFFF) << 8) | feedbackCount);
+
+        // Runs of one status take a run length chunk, and anything shorter a status vector chunk.
+        for (std::size_t i = 0; i < statuses.size();) {
+            std::size_t run = 1;
+
+            while (i + run < statuses.size() && statuses[i + run] == statuses[i] && run < MaximumRunLength) {
+                run++;
+            }
+
+            if (run >= StatusVectorSymbols || i + run == statuses.size()) {
+                AppendUint16(feedback, static_cast<std::uint16_t>((statuses[i] << 13) | run));
+                i += run;
+            }
+            else {
+                std::uint16_t chunk = 0xC000;
+
+                for (std::size_t symbol = 0; symbol < StatusVectorSymbols && i < statuses.size(); symbol++, i++) {
+                    chunk |= statuses[i] << (2 * (StatusVectorSymbols - 1 - symbol));
+                }
+
+                AppendUint16(feedback, chunk);
+            }
+        }
+
+        for (const auto delta : deltas) {
+            if (delta >= 0 && delta <= 0xFF) {
+                feedback.push_back(std::byte(delta));
+            }
+            else {
+                AppendUint16(feedback, static_cast<std::uint16_t>(static_cast<std::int16_t>(delta)));
+            }
+        }
+
+        while ((feedback.size() - start) % 4 != 0) {
+            feedback.push_back(std::byte(0));
+        }
+
+        const auto words = static_cast<std::uint16_t>((feedback.size() - start) / 4 - 1);
+        feedback[start + 2] = std::byte(words >> 8);
+        feedback[start + 3] = std::byte(words & 0xFF);
+
+        return packet;
+    }
+}
+
+namespace Comms {
+    rtc::binary BuildTransportFeedback(std::uint32_t senderSsrc, std::uint32_t mediaSsrc, std::uint8_t& feedbackCount, const std::vector<PacketArrival>& packets) {
+        rtc::binary feedback;
+
+        // A gap between arrivals too long for a receive delta starts a new message, with its own reference time.
+        for (auto first = packets.begin(); first != packets.end();) {
+            first = AppendFeedbackMessage(feedback, senderSsrc, mediaSsrc, feedbackCount++, first, packets.end());
+        }
+
+        return feedback;
+    }
+
+    std::vector<PacketArrival> ParseTransportFeedback(const std::byte* packet, std::size_t size) {
+        std::vector<PacketArrival> packets;
+
+        for (std::size_t offset = 0; offset + RtcpHeaderSize <= size;) {
+            const std::size_t length = (ReadUint16(packet, offset + 2) + std::size_t(1)) * 4;
+
+            if (offset + length > size) {
+                break;
+            }
+
+            if ((ReadByte(packet, offset) & 0x1F) == TransportFeedbackFormat && ReadByte(packet, offset + 1) == RtpFeedbackPacketType) {
+                if (!ParseFeedbackMessage(packet + offset, length, packets)) {
+                    break;
+                }
+            }
+
+            offset += length;
+        }
+
+        return packets;
+    }
+
+    std::optional<std::uint16_t> ReadTransportSequenceNumber(const std::byte* packet, std::size_t size, int extensionId) {
+        const auto extension = FindRtpHeaderExtension(packet, size, extensionId);
+
+        if (!extension.has_value() || extension->second < 2) {
+            return std::nullopt;
+        }
+
+        return ReadUint16(packet, extension->first);
+    }
+
+    void TransportFeedbackRecorder::OnPacket(std::uint16_t sequenceNumber, std::int64_t arrivalTime) {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // Unwrapped against the highest so far, so sequence numbers keep increasing across the 16-bit wrap.
+        const std::int64_t unwrapped = _highestSequenceNumber.has_value() ?
+            *_highestSequenceNumber + static_cast<std::int16_t>(sequenceNumber - static_cast<std::uint16_t>(*_highestSequenceNumber)) : sequenceNumber;
+
+        if (_nextReported.has_value() && unwrapped < *_nextReported) {
+            return; // Already reported as lost.
+        }
+
+        if (!_nextReported.has_value()) {
+            _nextReported = unwrapped;
+        }
+
+        _arrivals[unwrapped] = arrivalTime;
+        _highestSequenceNumber = std::max(unwrapped, _highestSequenceNumber.value_or(unwrapped));
+    }
+
+    std::optional<std::vector<PacketArrival>> TransportFeedbackRecorder::TakeFeedback() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_arrivals.empty()) {
+            return std::nullopt;
+        }
+
+        const std::int64_t first = std::max(*_nextReported, *_highestSequenceNumber - MaximumReportedPackets + 1);
+        std::vector<PacketArrival> packets;
+
+        for (std::int64_t sequenceNumber = first; sequenceNumber <= *_highestSequenceNumber; sequenceNumber++) {
+            const auto arrival = _arrivals.find(sequenceNumber);
+            packets.push_back({ static_cast<std::uint16_t>(sequenceNumber), arrival != _arrivals.end() ? std::optional<std::int64_t>(arrival->second) : std::nullopt });
+        }
+
+        _arrivals.clear();
+        _nextReported = *_highestSequenceNumber + 1;
+
+        return packets;
+    }
+}
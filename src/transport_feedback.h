@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "libdatachannel/rtc.hpp"
+
+namespace Comms {
+
+    // The URI identifying the transport-wide sequence number RTP header extension in a session description.
+    inline constexpr const char* TransportSequenceExtensionURI = "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01";
+
+    // The extension id offered by clients for the transport-wide sequence number extension.
+    inline constexpr int TransportSequenceExtensionId = 3;
+
+    /*
+    * Whether a packet sent with a transport-wide sequence number arrived, and when, as reported by transport-cc feedback.
+    */
+    struct PacketArrival {
+        std::uint16_t _sequenceNumber; // The packet's transport-wide sequence number.
+        std::optional<std::int64_t> _arrivalTime; // When it arrived in microseconds, on the receiver's clock, if it did.
+    };
+
+    /*
+    * Builds a transport-cc feedback RTCP packet (draft-holmer-rmcat-transport-wide-cc-extensions-01) for a run of consecutive
+    * transport-wide sequence numbers.
+    *
+    * Arrival times are rounded to the 250 microseconds the format carries, without the rounding accumulating. A gap between
+    * arrivals longer than a receive delta can hold, about 8 seconds, ends the feedback message and starts another with its
+    * own reference time, so the packet may be compound.
+    *
+    * @param senderSsrc The SSRC of the stream sending the feedback.
+    * @param mediaSsrc The SSRC of the stream the feedback is about.
+    * @param feedbackCount The count of the first message, advanced past each message built, so that the sender can tell one
+    *                      was lost.
+    * @param packets The packets reported, in consecutive sequence number order starting from the first. Must not be empty.
+    * @return The RTCP packet.
+    */
+    rtc::binary BuildTransportFeedback(std::uint32_t senderSsrc, std::uint32_t mediaSsrc, std::uint8_t& feedbackCount, const std::vector<PacketArrival>& packets);
+
+    /*
+    * Reads the packets reported by the transport-cc feedback in an RTCP packet, which may be compound.
+    *
+    * @param packet The RTCP packet.
+    * @param size The size of the packet in bytes.
+    * @return The packets reported by each feedback message, in order, or an empty list if there was none.
+    */
+    std::vector<PacketArrival> ParseTransportFeedback(const std::byte* packet, std::size_t size);
+
+    /*
+    * Reads the transport-wide sequence number of an RTP packet.
+    *
+    * @param packet The RTP packet.
+    * @param size The size of the packet in bytes.
+    * @param extensionId The id the extension was negotiated with.
+    * @return The sequence number, or std::nullopt if the packet does not carry one.
+    */
+    std::optional<std::uint16_t> ReadTransportSequenceNumber(const std::byte* packet, std::size_t size, int extensionId);
+
+    /*
+    * Records when packets with transport-wide sequence numbers arrive, for the receiver to report them in transport-cc feedback.
+    * Packets are recorded on the thread receiving them and reported from any other.
+    */
+    class TransportFeedbackRecorder {
+    public:
+        /*
+        * Records a packet's arrival.
+        *
+        * @param sequenceNumber The packet's transport-wide sequence number.
+        * @param arrivalTime When it arrived, in microseconds.
+        */
+        void OnPacket(std::uint16_t sequenceNumber, std::int64_t arrivalTime);
+
+        /*
+        * Takes the packets to report in the next feedback: every sequence number after the last one reported, up to the
+        * highest that has arrived, with those that have not arrived reported as lost.
+        *
+        * @return The packets, or nothing if none have arrived since the last feedback.
+        */
+        std::optional<std::vector<PacketArrival>> TakeFeedback();
+
+    private:
+        std::map<std::int64_t, std::int64_t> _arrivals; // Arrival times by unwrapped sequence number, not yet reported.
+        std::optional<std::int64_t> _highestSequenceNumber; // The highest unwrapped sequence number that has arrived.
+        std::optional<std::int64_t> _nextReported; // The unwrapped sequence number the next feedback starts from.
+        std::mutex _mutex; // Mutex to control access to the recorder's state.
+    };
+}
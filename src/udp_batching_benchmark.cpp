@@ -0,0 +1,246 @@
+#include "udp_batching_benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "udp_socket.h"
+
+namespace {
+    constexpr std::size_t ReceiveBatchSize = 64;
+    constexpr std::size_t ReceiveBufferSize = 8 * 1024 * 1024;
+    constexpr std::chrono::milliseconds ReceiveTimeout(50);
+
+    /*
+    * @return The CPU time the calling thread has used, in seconds.
+    */
+    double GetThreadCpuSeconds() {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+
+        const auto toSeconds = [](const FILETIME& time) {
+            return ((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+        };
+
+        return toSeconds(kernel) + toSeconds(user);
+#else
+        timespec time{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+
+        return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+    }
+
+    /*
+    * A socket draining datagrams on its own thread.
+    */
+    struct Receiver {
+        Comms::UdpSocket _socket; // The receiving socket.
+        std::thread _thread; // Drains the socket.
+        std::size_t _received = 0; // Datagrams received. Read once the thread has been joined.
+        double _cpuSeconds = 0.0; // CPU time the thread used. Read once the thread has been joined.
+    };
+
+    /*
+    * @return Packets per second of CPU time, or zero if no time was measured.
+    */
+    double GetPacketsPerCoreSecond(std::size_t packets, double cpuSeconds) {
+        return cpuSeconds > 0.0 ? packets / cpuSeconds : 0.0;
+    }
+}
+
+namespace Comms {
+    UdpBatchingBenchmark::UdpBatchingBenchmark(const CommandLineOptions& options) :
+        _packetCount(std::max<std::int64_t>(options.GetInteger("packets", 200000), 1)),
+        _packetSize(std::clamp<std::int64_t>(options.GetInteger("size", 120), 4, 1400)),
+        _batchSize(std::clamp<std::int64_t>(options.GetInteger("batch", 32), 1, 1024)),
+        _fanOut(std::max<std::int64_t>(options.GetInteger("fan-out", 8), 1)),
+        _isVerifying(options.Has("verify")) {
+    }
+
+    nlohmann::json UdpBatchingBenchmark::Run() {
+        UdpSocket probe;
+        const bool isSegmentationSupported = probe.Bind("127.0.0.1", 0) && probe.EnableSegmentationOffload();
+
+        auto perPacket = RunMode(false, false, 1);
+        auto batched = RunMode(true, false, 1);
+        auto segmented = isSegmentationSupported ? RunMode(true, true, 1) : nlohmann::json(nullptr);
+        auto fanOutPerPacket = RunMode(false, false, _fanOut);
+        auto fanOutBatched = RunMode(true, false, _fanOut);
+        auto fanOutSegmented = isSegmentationSupported ? RunMode(true, true, _fanOut) : nlohmann::json(nullptr);
+
+        const auto getSpeedup = [](const nlohmann::json& batchedMode, const nlohmann::json& perPacketMode, const char* side) {
+            const double baseline = perPacketMode[side];
+            return baseline > 0.0 ? batchedMode[side].get<double>() / baseline : 0.0;
+        };
+
+        nlohmann::json results = {
+            {"packets", _packetCount},
+            {"size", _packetSize},
+            {"batch", _batchSize},
+            {"fan_out", _fanOut},
+            {"segmentation_offload_supported", isSegmentationSupported},
+            {"per_packet", perPacket},
+            {"batched", batched},
+            {"segmented", segmented},
+            {"fan_out_per_packet", fanOutPerPacket},
+            {"fan_out_batched", fanOutBatched},
+            {"fan_out_segmented", fanOutSegmented},
+            {"batched_send_speedup", getSpeedup(batched, perPacket, "send_packets_per_core_second")},
+            {"batched_receive_speedup", getSpeedup(batched, perPacket, "receive_packets_per_core_second")},
+            {"fan_out_send_speedup", getSpeedup(fanOutBatched, fanOutPerPacket, "send_packets_per_core_second")}
+        };
+
+        if (isSegmentationSupported) {
+            results["segmented_send_speedup"] = getSpeedup(segmented, perPacket, "send_packets_per_core_second");
+            results["fan_out_segmented_send_speedup"] = getSpeedup(fanOutSegmented, fanOutPerPacket, "send_packets_per_core_second");
+        }
+
+        if (_isVerifying) {
+            const std::pair<const char*, std::size_t> modes[] = {
+                {"per_packet", 1}, {"batched", 1}, {"segmented", 1},
+                {"fan_out_per_packet", _fanOut}, {"fan_out_batched", _fanOut}, {"fan_out_segmented", _fanOut}
+            };
+
+            for (const auto& [name, fanOut] : modes) {
+                const auto& mode = results[name];
+                const auto expected = _packetCount * fanOut;
+
+                if (mode.is_null()) {
+                    continue; // Skipped, as segmentation offload is not supported.
+                }
+
+                if (mode.contains("error") || mode["datagrams_sent"] != expected || mode["datagrams_received"] != expected) {
+                    results["error"] = std::string(name) + " did not send and receive all " + std::to_string(expected) + " datagrams";
+                    break;
+                }
+            }
+        }
+
+        return results;
+    }
+
+    nlohmann::json UdpBatchingBenchmark::RunMode(bool isBatched, bool isSegmenting, std::size_t fanOut) const {
+        std::atomic<bool> isSending = true;
+        std::vector<std::unique_ptr<Receiver>> receivers;
+        std::vector<UdpEndpoint> destinations;
+
+        for (std::size_t i = 0; i < fanOut; i++) {
+            auto receiver = std::make_unique<Receiver>();
+
+            if (!receiver->_socket.Bind("127.0.0.1", 0)) {
+                return { {"error", "Failed to bind a receiver"} };
+            }
+
+            receiver->_socket.SetReceiveTimeout(ReceiveTimeout);
+            receiver->_socket.SetReceiveBufferSize(ReceiveBufferSize);
+            destinations.push_back(*UdpEndpoint::Resolve("127.0.0.1", receiver->_socket.GetPort()));
+
+            receiver->_thread = std::thread([receiver = receiver.get(), isBatched, &isSending]() {
+                UdpReceiveBatch batch(ReceiveBatchSize, 2048);
+                std::vector<std::byte> buffer(2048);
+                UdpEndpoint source;
+
+                // Drains until the sender has finished and a receive times out with nothing left queued.
+                while (true) {
+                    std::size_t received = 0;
+
+                    if (isBatched) {
+                        received = receiver->_socket.ReceiveBatch(batch);
+                    }
+                    else if (receiver->_socket.ReceiveFrom(buffer.data(), buffer.size(), source).has_value()) {
+                        received = 1;
+                    }
+
+                    receiver->_received += received;
+
+                    if (received == 0 && !isSending) {
+                        break;
+                    }
+                }
+
+                receiver->_cpuSeconds = GetThreadCpuSeconds();
+            });
+
+            receivers.push_back(std::move(receiver));
+        }
+
+        UdpSocket sender;
+        sender.Bind("127.0.0.1", 0);
+
+        if (isSegmenting) {
+            sender.EnableSegmentationOffload();
+        }
+
+        std::vector<std::byte> packet(_packetSize, std::byte{ 0x80 });
+        UdpSendBatch batch;
+        std::size_t sent = 0;
+
+        const auto cpuStart = GetThreadCpuSeconds();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < _packetCount;) {
+            if (isBatched) {
+                batch.Clear();
+
+                for (std::size_t j = 0; j < _batchSize && i < _packetCount; j++, i++) {
+                    std::copy_n(reinterpret_cast<const std::byte*>(&i), 4, packet.begin());
+                    const auto payload = batch.AddPayload(packet.data(), packet.size());
+
+                    for (const auto& destination : destinations) {
+                        batch.AddDatagram(payload, destination);
+                    }
+                }
+
+                sent += sender.SendBatch(batch);
+            }
+            else {
+                std::copy_n(reinterpret_cast<const std::byte*>(&i), 4, packet.begin());
+
+                for (const auto& destination : destinations) {
+                    sent += sender.SendTo(destination, packet.data(), packet.size()) ? 1 : 0;
+                }
+
+                i++;
+            }
+        }
+
+        const auto senderCpuSeconds = GetThreadCpuSeconds() - cpuStart;
+        const auto sendSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        isSending = false;
+
+        std::size_t received = 0;
+        double receiverCpuSeconds = 0.0;
+
+        for (auto& receiver : receivers) {
+            receiver->_thread.join();
+            received += receiver->_received;
+            receiverCpuSeconds += receiver->_cpuSeconds;
+        }
+
+        return {
+            {"datagrams_sent", sent},
+            {"datagrams_received", received},
+            {"loss_percent", sent > 0 ? 100.0 * (sent - std::min(received, sent)) / sent : 0.0},
+            {"send_seconds", sendSeconds},
+            {"send_packets_per_core_second", GetPacketsPerCoreSecond(sent, senderCpuSeconds)},
+            {"receive_packets_per_core_second", GetPacketsPerCoreSecond(received, receiverCpuSeconds)}
+        };
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+#include "benchmark.h"
+#include "command_line_options.h"
+
+namespace Comms {
+
+    /*
+    * Measures how many UDP packets one core can send and receive over loopback, one system call per packet against the
+    * batched paths of UdpSocket: sendmmsg and recvmmsg, UDP generic segmentation offload, and fanning one packet out to
+    * several receivers from a single copy. The segmented modes are skipped where segmentation offload is not supported.
+    *
+    * Each mode sends the same number of packets as fast as the sender can, to one receiver or, for the fan-out modes, to
+    * each of several receivers, every one draining its own socket on its own thread. Packets per core second divides the
+    * packets moved by the CPU time the sending or receiving threads used, so it does not depend on how many cores the
+    * machine has, or on the receivers keeping up. Packets sent faster than the receivers drain them are counted as lost.
+    *
+    * Options:
+    *   --packets <n>  Packets sent in each mode. Default 200000.
+    *   --size <n>     Size of each packet in bytes. Default 120, a relayed 20 ms Opus packet at 32 kbps.
+    *   --batch <n>    Packets sent per system call in the batched modes. Default 32.
+    *   --fan-out <n>  Receivers each packet is sent to in the fan-out modes. Default 8.
+    *   --verify       Fail if any mode sends or receives fewer datagrams than it should. Used as a test, with few enough
+    *                  packets that the receive buffers hold them all.
+    */
+    class UdpBatchingBenchmark : public Benchmark {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param options The benchmark's command line options.
+        */
+        UdpBatchingBenchmark(const CommandLineOptions& options);
+
+        nlohmann::json Run() override;
+
+    private:
+        /*
+        * Sends the packets to the receivers and measures both sides.
+        *
+        * @param isBatched Whether packets are sent with SendBatch and received with ReceiveBatch, rather than one per call.
+        * @param isSegmenting Whether segmentation offload is enabled for the batches.
+        * @param fanOut The number of receivers each packet is sent to.
+        * @return The packets sent, received and lost, and the packets per core second of each side.
+        */
+        nlohmann::json RunMode(bool isBatched, bool isSegmenting, std::size_t fanOut) const;
+
+        const std::size_t _packetCount; // Packets sent in each mode.
+        const std::size_t _packetSize; // Size of each packet in bytes.
+        const std::size_t _batchSize; // Packets sent per system call in the batched modes.
+        const std::size_t _fanOut; // Receivers each packet is sent to in the fan-out modes.
+        const bool _isVerifying; // Whether a mode that loses or fails to send a datagram is reported as an error.
+    };
+}
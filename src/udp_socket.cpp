@@ -0,0 +1,494 @@
+#include "udp_socket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+
+#ifdef _WIN32
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    /*
+    * Initialises Winsock once per process. Nothing to do elsewhere.
+    */
+    void InitialiseSockets() {
+#ifdef _WIN32
+        static std::once_flag initialised;
+
+        std::call_once(initialised, []() {
+            WSADATA data;
+            WSAStartup(MAKEWORD(2, 2), &data);
+        });
+#endif
+    }
+
+    /*
+    * @return The port of a socket address, in host byte order.
+    */
+    std::uint16_t GetAddressPort(const sockaddr_storage& address) {
+        if (address.ss_family == AF_INET6) {
+            return ntohs(reinterpret_cast<const sockaddr_in6&>(address).sin6_port);
+        }
+
+        return ntohs(reinterpret_cast<const sockaddr_in&>(address).sin_port);
+    }
+
+#ifdef __linux__
+    constexpr std::size_t MaxMessagesPerCall = 1024; // UIO_MAXIOV, the most messages sendmmsg accepts at once.
+    constexpr std::size_t MaxSegmentsPerSend = 64; // UDP_MAX_SEGMENTS, the most datagrams one GSO send may carry.
+    constexpr std::size_t MaxSegmentedSize = 65000; // A GSO send must fit in a single IP datagram before it is split.
+    constexpr std::size_t SegmentControlSize = CMSG_SPACE(sizeof(std::uint16_t));
+
+    /*
+    * Orders endpoints by their address bytes, so that datagrams can be grouped by destination.
+    */
+    bool IsEndpointBefore(const Comms::UdpEndpoint& first, const Comms::UdpEndpoint& second) {
+        if (first._addressLength != second._addressLength) {
+            return first._addressLength < second._addressLength;
+        }
+
+        return std::memcmp(&first._address, &second._address, first._addressLength) < 0;
+    }
+#endif
+}
+
+namespace Comms {
+    std::optional<UdpEndpoint> UdpEndpoint::Resolve(const std::string& host, std::uint16_t port) {
+        InitialiseSockets();
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_protocol = IPPROTO_UDP;
+
+        addrinfo* results = nullptr;
+
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &results) != 0 || results == nullptr) {
+            return std::nullopt;
+        }
+
+        UdpEndpoint endpoint;
+        std::memcpy(&endpoint._address, results->ai_addr, results->ai_addrlen);
+        endpoint._addressLength = static_cast<socklen_t>(results->ai_addrlen);
+
+        freeaddrinfo(results);
+
+        return endpoint;
+    }
+
+    std::optional<UdpEndpoint> UdpEndpoint::Parse(const std::string& hostAndPort) {
+        const auto separator = hostAndPort.rfind(':');
+
+        if (separator == std::string::npos || separator == 0) {
+            return std::nullopt;
+        }
+
+        auto host = hostAndPort.substr(0, separator);
+
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        try {
+            const auto port = std::stoul(hostAndPort.substr(separator + 1));
+
+            if (port == 0 || port > 65535) {
+                return std::nullopt;
+            }
+
+            return Resolve(host, static_cast<std::uint16_t>(port));
+        }
+        catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    std::string UdpEndpoint::ToString() const {
+        char host[INET6_ADDRSTRLEN] = {};
+
+        if (_address.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(_address).sin6_addr, host, sizeof(host));
+            return std::string("[").append(host).append("]:") + std::to_string(GetAddressPort(_address));
+        }
+
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(_address).sin_addr, host, sizeof(host));
+        return std::string(host) + ":" + std::to_string(GetAddressPort(_address));
+    }
+
+    bool UdpEndpoint::operator==(const UdpEndpoint& other) const {
+        if (_address.ss_family != other._address.ss_family || GetAddressPort(_address) != GetAddressPort(other._address)) {
+            return false;
+        }
+
+        if (_address.ss_family == AF_INET6) {
+            const auto& address = reinterpret_cast<const sockaddr_in6&>(_address).sin6_addr;
+            const auto& otherAddress = reinterpret_cast<const sockaddr_in6&>(other._address).sin6_addr;
+
+            return std::memcmp(&address, &otherAddress, sizeof(address)) == 0;
+        }
+
+        return reinterpret_cast<const sockaddr_in&>(_address).sin_addr.s_addr == reinterpret_cast<const sockaddr_in&>(other._address).sin_addr.s_addr;
+    }
+
+    std::size_t UdpSendBatch::AddPayload(const std::byte* data, std::size_t size) {
+        _payloads.push_back(Payload{ _buffer.size(), size });
+        _buffer.insert(_buffer.end(), data, data + size);
+
+        return _payloads.size() - 1;
+    }
+
+    void UdpSendBatch::AddDatagram(std::size_t payload, const UdpEndpoint& destination) {
+        _datagrams.push_back(Datagram{ destination, payload });
+    }
+
+    std::size_t UdpSendBatch::GetDatagramCount() const {
+        return _datagrams.size();
+    }
+
+    std::size_t UdpSendBatch::GetPayloadCount() const {
+        return _payloads.size();
+    }
+
+    std::byte* UdpSendBatch::GetPayloadData(std::size_t payload) {
+        return _buffer.data() + _payloads[payload]._offset;
+    }
+
+    std::size_t UdpSendBatch::GetPayloadSize(std::size_t payload) const {
+        return _payloads[payload]._size;
+    }
+
+    void UdpSendBatch::Clear() {
+        _buffer.clear();
+        _payloads.clear();
+        _datagrams.clear();
+    }
+
+    UdpReceiveBatch::UdpReceiveBatch(std::size_t capacity, std::size_t maxDatagramSize) :
+        _maxDatagramSize(maxDatagramSize),
+        _buffer(std::max<std::size_t>(capacity, 1) * maxDatagramSize),
+        _sizes(std::max<std::size_t>(capacity, 1), 0),
+        _sources(std::max<std::size_t>(capacity, 1)) {
+#ifdef __linux__
+        _messages.resize(_sizes.size());
+        _segments.resize(_sizes.size());
+
+        for (std::size_t i = 0; i < _sizes.size(); i++) {
+            _segments[i] = iovec{ _buffer.data() + i * _maxDatagramSize, _maxDatagramSize };
+            _messages[i].msg_hdr.msg_name = &_sources[i]._address;
+            _messages[i].msg_hdr.msg_iov = &_segments[i];
+            _messages[i].msg_hdr.msg_iovlen = 1;
+        }
+#endif
+    }
+
+    std::size_t UdpReceiveBatch::GetCount() const {
+        return _count;
+    }
+
+    const std::byte* UdpReceiveBatch::GetData(std::size_t index) const {
+        return _buffer.data() + index * _maxDatagramSize;
+    }
+
+    std::size_t UdpReceiveBatch::GetSize(std::size_t index) const {
+        return _sizes[index];
+    }
+
+    const UdpEndpoint& UdpReceiveBatch::GetSource(std::size_t index) const {
+        return _sources[index];
+    }
+
+    UdpSocket::UdpSocket() {
+        InitialiseSockets();
+    }
+
+    UdpSocket::~UdpSocket() {
+        Close();
+    }
+
+    bool UdpSocket::Bind(const std::string& address, std::uint16_t port) {
+        Close();
+
+        auto local = UdpEndpoint::Resolve(address, port);
+
+        if (!local.has_value()) {
+            return false;
+        }
+
+        _handle = socket(local->_address.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+
+        if (_handle == InvalidHandle) {
+            return false;
+        }
+
+        if (bind(_handle, reinterpret_cast<const sockaddr*>(&local->_address), local->_addressLength) != 0) {
+            Close();
+            return false;
+        }
+
+        sockaddr_storage bound{};
+        socklen_t boundLength = sizeof(bound);
+
+        if (getsockname(_handle, reinterpret_cast<sockaddr*>(&bound), &boundLength) != 0) {
+            Close();
+            return false;
+        }
+
+        _port = GetAddressPort(bound);
+
+        return true;
+    }
+
+    void UdpSocket::Close() {
+        if (_handle == InvalidHandle) {
+            return;
+        }
+
+#ifdef _WIN32
+        closesocket(_handle);
+#else
+        close(_handle);
+#endif
+
+        _handle = InvalidHandle;
+        _port = 0;
+    }
+
+    std::uint16_t UdpSocket::GetPort() const {
+        return _port;
+    }
+
+    void UdpSocket::SetReceiveTimeout(std::chrono::milliseconds timeout) {
+#ifdef _WIN32
+        const DWORD value = static_cast<DWORD>(timeout.count());
+#else
+        timeval value{};
+        value.tv_sec = static_cast<decltype(value.tv_sec)>(timeout.count() / 1000);
+        value.tv_usec = static_cast<decltype(value.tv_usec)>((timeout.count() % 1000) * 1000);
+#endif
+
+        setsockopt(_handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    bool UdpSocket::SendTo(const UdpEndpoint& destination, const std::byte* data, std::size_t size) {
+        const auto sent = sendto(_handle, reinterpret_cast<const char*>(data), static_cast<int>(size), 0,
+            reinterpret_cast<const sockaddr*>(&destination._address), destination._addressLength);
+
+        return sent >= 0 && static_cast<std::size_t>(sent) == size;
+    }
+
+    std::optional<std::size_t> UdpSocket::ReceiveFrom(std::byte* buffer, std::size_t capacity, UdpEndpoint& source) {
+        source._addressLength = sizeof(source._address);
+
+        const auto received = recvfrom(_handle, reinterpret_cast<char*>(buffer), static_cast<int>(capacity), 0,
+            reinterpret_cast<sockaddr*>(&source._address), &source._addressLength);
+
+        if (received < 0) {
+            return std::nullopt;
+        }
+
+        return static_cast<std::size_t>(received);
+    }
+
+    std::size_t UdpSocket::SendBatch(UdpSendBatch& batch) {
+        const auto count = batch._datagrams.size();
+
+        if (count == 0) {
+            return 0;
+        }
+
+#ifdef __linux__
+        const bool isSegmenting = _isSegmentationOffloadEnabled;
+
+        auto& order = batch._order;
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0);
+
+        // Grouping by destination gives segmentation offload runs to work with. The sort is stable, so each destination
+        // still receives its datagrams in the order they were queued.
+        if (isSegmenting) {
+            std::stable_sort(order.begin(), order.end(), [&batch](std::size_t first, std::size_t second) {
+                return IsEndpointBefore(batch._datagrams[first]._destination, batch._datagrams[second]._destination);
+            });
+        }
+
+        // Sized up front, as messages point into them.
+        batch._segments.resize(count);
+        batch._controls.resize(count * SegmentControlSize);
+        batch._messages.clear();
+
+        std::size_t segment = 0;
+
+        for (std::size_t i = 0; i < count;) {
+            const auto& first = batch._datagrams[order[i]];
+            const auto segmentSize = batch._payloads[first._payload]._size;
+
+            // A GSO send splits into datagrams of the first one's size, so only the last of a run may be shorter.
+            std::size_t runLength = 1;
+            std::size_t runSize = segmentSize;
+
+            while (isSegmenting && i + runLength < count && runLength < MaxSegmentsPerSend) {
+                const auto& next = batch._datagrams[order[i + runLength]];
+                const auto nextSize = batch._payloads[next._payload]._size;
+
+                if (!(next._destination == first._destination) || nextSize > segmentSize || runSize + nextSize > MaxSegmentedSize) {
+                    break;
+                }
+
+                runLength++;
+                runSize += nextSize;
+
+                if (nextSize < segmentSize) {
+                    break;
+                }
+            }
+
+            mmsghdr message{};
+            message.msg_hdr.msg_name = const_cast<sockaddr_storage*>(&first._destination._address);
+            message.msg_hdr.msg_namelen = first._destination._addressLength;
+            message.msg_hdr.msg_iov = &batch._segments[segment];
+            message.msg_hdr.msg_iovlen = runLength;
+
+            for (std::size_t j = 0; j < runLength; j++) {
+                const auto& payload = batch._payloads[batch._datagrams[order[i + j]]._payload];
+                batch._segments[segment + j] = iovec{ batch._buffer.data() + payload._offset, payload._size };
+            }
+
+            if (runLength > 1) {
+                auto control = batch._controls.data() + batch._messages.size() * SegmentControlSize;
+                std::memset(control, 0, SegmentControlSize);
+
+                message.msg_hdr.msg_control = control;
+                message.msg_hdr.msg_controllen = SegmentControlSize;
+
+                auto header = CMSG_FIRSTHDR(&message.msg_hdr);
+                header->cmsg_level = SOL_UDP;
+                header->cmsg_type = UDP_SEGMENT;
+                header->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+
+                const auto size = static_cast<std::uint16_t>(segmentSize);
+                std::memcpy(CMSG_DATA(header), &size, sizeof(size));
+            }
+
+            batch._messages.push_back(message);
+            segment += runLength;
+            i += runLength;
+        }
+
+        std::size_t sentDatagrams = 0;
+
+        for (std::size_t message = 0; message < batch._messages.size();) {
+            const auto messageCount = std::min(batch._messages.size() - message, MaxMessagesPerCall);
+            const auto sent = sendmmsg(_handle, batch._messages.data() + message, static_cast<unsigned int>(messageCount), 0);
+
+            if (sent > 0) {
+                for (int i = 0; i < sent; i++) {
+                    sentDatagrams += batch._messages[message + i].msg_hdr.msg_iovlen;
+                }
+
+                message += static_cast<std::size_t>(sent);
+                continue;
+            }
+
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+
+            const auto& failed = batch._messages[message].msg_hdr;
+
+            // Routes whose device cannot segment reject GSO sends. Segmentation is turned off and the run sent one by one.
+            if (failed.msg_controllen != 0 && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP)) {
+                _isSegmentationOffloadEnabled = false;
+
+                for (std::size_t i = 0; i < failed.msg_iovlen; i++) {
+                    const auto sentSize = sendto(_handle, failed.msg_iov[i].iov_base, failed.msg_iov[i].iov_len, 0,
+                        static_cast<const sockaddr*>(failed.msg_name), failed.msg_namelen);
+
+                    sentDatagrams += sentSize >= 0 ? 1 : 0;
+                }
+            }
+
+            message++; // Anything else is dropped, as UDP would drop it further along.
+        }
+
+        return sentDatagrams;
+#else
+        std::size_t sentDatagrams = 0;
+
+        for (const auto& datagram : batch._datagrams) {
+            const auto& payload = batch._payloads[datagram._payload];
+
+            if (SendTo(datagram._destination, batch._buffer.data() + payload._offset, payload._size)) {
+                sentDatagrams++;
+            }
+        }
+
+        return sentDatagrams;
+#endif
+    }
+
+    std::size_t UdpSocket::ReceiveBatch(UdpReceiveBatch& batch) {
+        batch._count = 0;
+
+#ifdef __linux__
+        for (std::size_t i = 0; i < batch._messages.size(); i++) {
+            batch._messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            batch._messages[i].msg_hdr.msg_flags = 0;
+        }
+
+        // The timeout applies to the first datagram. MSG_WAITFORONE then takes only what is already queued.
+        const auto received = recvmmsg(_handle, batch._messages.data(), static_cast<unsigned int>(batch._messages.size()), MSG_WAITFORONE, nullptr);
+
+        for (int i = 0; i < received; i++) {
+            const auto& message = batch._messages[i];
+
+            if ((message.msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+                continue; // Too long for a slot.
+            }
+
+            // Datagrams after a dropped one move down, so the batch's datagrams are contiguous. Drops are rare.
+            if (batch._count != static_cast<std::size_t>(i)) {
+                std::memcpy(batch._buffer.data() + batch._count * batch._maxDatagramSize, batch._buffer.data() + i * batch._maxDatagramSize, message.msg_len);
+                batch._sources[batch._count]._address = batch._sources[i]._address;
+            }
+
+            batch._sizes[batch._count] = message.msg_len;
+            batch._sources[batch._count]._addressLength = message.msg_hdr.msg_namelen;
+            batch._count++;
+        }
+#else
+        if (auto size = ReceiveFrom(batch._buffer.data(), batch._maxDatagramSize, batch._sources[0])) {
+            batch._sizes[0] = *size;
+            batch._count = 1;
+        }
+#endif
+
+        return batch._count;
+    }
+
+    bool UdpSocket::EnableSegmentationOffload() {
+#ifdef __linux__
+        int segmentSize = 0;
+        socklen_t length = sizeof(segmentSize);
+
+        // Kernels without UDP GSO do not know the option.
+        _isSegmentationOffloadEnabled = getsockopt(_handle, SOL_UDP, UDP_SEGMENT, &segmentSize, &length) == 0;
+#endif
+
+        return _isSegmentationOffloadEnabled;
+    }
+
+    void UdpSocket::SetReceiveBufferSize(std::size_t size) {
+        const int value = static_cast<int>(size);
+        setsockopt(_handle, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+namespace Comms {
+
+    /*
+    * The address and port of a UDP socket, IPv4 or IPv6.
+    */
+    struct UdpEndpoint {
+        sockaddr_storage _address{}; // The socket address.
+        socklen_t _addressLength = 0; // The length of _address in use.
+
+        /*
+        * Resolves a host name or address.
+        *
+        * @param host The host name or numeric address.
+        * @param port The port.
+        * @return The first address the host resolves to, or std::nullopt if it cannot be resolved.
+        */
+        static std::optional<UdpEndpoint> Resolve(const std::string& host, std::uint16_t port);
+
+        /*
+        * Resolves an endpoint written as "host:port", or "[address]:port" for IPv6.
+        *
+        * @return The endpoint, or std::nullopt if it is malformed or cannot be resolved.
+        */
+        static std::optional<UdpEndpoint> Parse(const std::string& hostAndPort);
+
+        /*
+        * @return The endpoint as "address:port", or "[address]:port" for IPv6.
+        */
+        std::string ToString() const;
+
+        bool operator==(const UdpEndpoint& other) const;
+    };
+
+    /*
+    * Datagrams queued to be sent together by UdpSocket::SendBatch.
+    *
+    * Each payload is copied in once, and every datagram sending it refers to that copy, so fanning a packet out to many
+    * destinations costs one copy and one entry per destination in a single system call. Clearing keeps the capacity, so a
+    * batch reused for each burst does not allocate.
+    */
+    class UdpSendBatch {
+    public:
+        /*
+        * Copies a payload into the batch.
+        *
+        * @return Identifies the payload to AddDatagram.
+        */
+        std::size_t AddPayload(const std::byte* data, std::size_t size);
+
+        /*
+        * Queues a payload already in the batch to be sent to a destination.
+        *
+        * @param payload A payload returned by AddPayload since the batch was last cleared.
+        */
+        void AddDatagram(std::size_t payload, const UdpEndpoint& destination);
+
+        /*
+        * @return The number of datagrams queued.
+        */
+        std::size_t GetDatagramCount() const;
+
+        /*
+        * @return The number of payloads copied in.
+        */
+        std::size_t GetPayloadCount() const;
+
+        /*
+        * @return A payload's bytes, which can be changed in place until the batch is sent.
+        */
+        std::byte* GetPayloadData(std::size_t payload);
+
+        /*
+        * @return The size of a payload in bytes.
+        */
+        std::size_t GetPayloadSize(std::size_t payload) const;
+
+        /*
+        * Removes every payload and datagram.
+        */
+        void Clear();
+
+    private:
+        friend class UdpSocket;
+
+        /*
+        * A payload's place in _buffer.
+        */
+        struct Payload {
+            std::size_t _offset; // Offset of the payload in _buffer.
+            std::size_t _size; // Size of the payload in bytes.
+        };
+
+        /*
+        * A payload queued to a destination.
+        */
+        struct Datagram {
+            UdpEndpoint _destination; // Where the payload is sent.
+            std::size_t _payload; // Index of the payload in _payloads.
+        };
+
+        std::vector<std::byte> _buffer; // Every payload, back to back.
+        std::vector<Payload> _payloads; // The payloads.
+        std::vector<Datagram> _datagrams; // The datagrams, in the order they were queued.
+
+        // Scratch space for UdpSocket::SendBatch, kept with the batch so that sending does not allocate.
+        std::vector<std::size_t> _order; // Datagram indices, grouped by destination for segmentation offload.
+#ifdef __linux__
+        std::vector<mmsghdr> _messages; // One per system call entry.
+        std::vector<iovec> _segments; // The payloads of each entry.
+        std::vector<std::byte> _controls; // The segment size control message of each entry.
+#endif
+    };
+
+    /*
+    * Datagrams received together by UdpSocket::ReceiveBatch.
+    */
+    class UdpReceiveBatch {
+    public:
+        /*
+        * Constructor.
+        *
+        * @param capacity The most datagrams received at once.
+        * @param maxDatagramSize The largest datagram received. Longer datagrams are dropped.
+        */
+        UdpReceiveBatch(std::size_t capacity, std::size_t maxDatagramSize);
+
+        UdpReceiveBatch(const UdpReceiveBatch&) = delete;
+        UdpReceiveBatch& operator=(const UdpReceiveBatch&) = delete;
+
+        /*
+        * @return The number of datagrams received.
+        */
+        std::size_t GetCount() const;
+
+        /*
+        * @return A received datagram.
+        */
+        const std::byte* GetData(std::size_t index) const;
+
+        /*
+        * @return The size of a received datagram in bytes.
+        */
+        std::size_t GetSize(std::size_t index) const;
+
+        /*
+        * @return The endpoint a received datagram was sent from.
+        */
+        const UdpEndpoint& GetSource(std::size_t index) const;
+
+    private:
+        friend class UdpSocket;
+
+        const std::size_t _maxDatagramSize; // The largest datagram received.
+
+        std::vector<std::byte> _buffer; // One slot of _maxDatagramSize per datagram.
+        std::vector<std::size_t> _sizes; // The size of each datagram received.
+        std::vector<UdpEndpoint> _sources; // Where each datagram received was sent from.
+        std::size_t _count = 0; // The number of datagrams received.
+
+#ifdef __linux__
+        std::vector<mmsghdr> _messages; // One per slot, for recvmmsg.
+        std::vector<iovec> _segments; // One per slot, for recvmmsg.
+#endif
+    };
+
+    /*
+    * A blocking UDP socket.
+    *
+    * Sending is safe from any number of threads at once. Receiving is meant for a single thread, which is woken by the
+    * receive timeout to check whether it should stop, as closing a socket another thread is blocked on is not portable.
+    *
+    * At high packet rates the per-datagram system call, not the work done with the datagram, dominates. On Linux SendBatch
+    * and ReceiveBatch move a batch of datagrams per call with sendmmsg and recvmmsg, and with segmentation offload enabled
+    * SendBatch also hands runs of equally sized datagrams to one destination to the kernel as a single UDP GSO send.
+    * Elsewhere they fall back to one call per datagram.
+    */
+    class UdpSocket {
+    public:
+        /*
+        * Constructor. The socket is opened by Bind.
+        */
+        UdpSocket();
+
+        /*
+        * Destructor. Closes the socket.
+        */
+        ~UdpSocket();
+
+        UdpSocket(const UdpSocket&) = delete;
+        UdpSocket& operator=(const UdpSocket&) = delete;
+
+        /*
+        * Opens the socket and binds it.
+        *
+        * @param address The local address to bind to, e.g. "0.0.0.0", "::" or "127.0.0.1".
+        * @param port The local port. 0 selects any free port.
+        * @return False if the socket could not be opened or bound.
+        */
+        bool Bind(const std::string& address, std::uint16_t port);
+
+        /*
+        * Closes the socket.
+        */
+        void Close();
+
+        /*
+        * @return The local port the socket is bound to, or 0 if it is not bound.
+        */
+        std::uint16_t GetPort() const;
+
+        /*
+        * Sets how long ReceiveFrom waits for a datagram before giving up.
+        */
+        void SetReceiveTimeout(std::chrono::milliseconds timeout);
+
+        /*
+        * Sends a datagram.
+        *
+        * @return False if the datagram could not be sent.
+        */
+        bool SendTo(const UdpEndpoint& destination, const std::byte* data, std::size_t size);
+
+        /*
+        * Waits for a datagram, up to the receive timeout.
+        *
+        * @param buffer Receives the datagram. Datagrams longer than the buffer are truncated.
+        * @param capacity The size of the buffer in bytes.
+        * @param source Receives the endpoint the datagram was sent from.
+        * @return The size of the datagram, or std::nullopt on timeout or error.
+        */
+        std::optional<std::size_t> ReceiveFrom(std::byte* buffer, std::size_t capacity, UdpEndpoint& source);
+
+        /*
+        * Sends every datagram in a batch, in as few system calls as the platform allows. The batch is left unchanged.
+        *
+        * @return The number of datagrams sent.
+        */
+        std::size_t SendBatch(UdpSendBatch& batch);
+
+        /*
+        * Waits up to the receive timeout for a datagram, then receives as many more as are already queued, up to the batch's capacity.
+        *
+        * @param batch Receives the datagrams, replacing any it held.
+        * @return The number of datagrams received. 0 on timeout or error.
+        */
+        std::size_t ReceiveBatch(UdpReceiveBatch& batch);
+
+        /*
+        * Enables UDP generic segmentation offload for SendBatch, if the platform supports it.
+        *
+        * @return Whether segmentation offload is enabled.
+        */
+        bool EnableSegmentationOffload();
+
+        /*
+        * Sets the size of the kernel's receive buffer, so bursts are queued rather than dropped while the receiver catches up.
+        */
+        void SetReceiveBufferSize(std::size_t size);
+
+    private:
+#ifdef _WIN32
+        using Handle = SOCKET;
+        static constexpr Handle InvalidHandle = INVALID_SOCKET;
+#else
+        using Handle = int;
+        static constexpr Handle InvalidHandle = -1;
+#endif
+
+        Handle _handle = InvalidHandle; // The socket, or InvalidHandle when closed.
+        std::uint16_t _port = 0; // The local port the socket is bound to.
+        std::atomic<bool> _isSegmentationOffloadEnabled = false; // Whether SendBatch uses UDP generic segmentation offload.
+    };
+}
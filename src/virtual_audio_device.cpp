@@ -0,0 +1,129 @@
+#include "virtual_audio_device.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "pipeline_trace.h"
+
+namespace {
+    constexpr ma_uint32 SampleRate = 48000;
+    constexpr ma_uint32 PeriodSampleCount = 480; // 10 ms, a typical shared-mode device period.
+    constexpr std::chrono::duration<double> Period(0.01);
+}
+
+namespace Comms {
+    VirtualAudioDevice::VirtualAudioDevice(const Configuration& configuration, DataCallback callback) :
+        _isLooping(configuration._isLooping),
+        _callback(std::move(callback)),
+        _decoder(nullptr, [](ma_decoder* decoder) {
+            ma_decoder_uninit(decoder);
+            delete decoder;
+        }),
+        _encoder(nullptr, [](ma_encoder* encoder) {
+            ma_encoder_uninit(encoder);
+            delete encoder;
+        }) {
+        if (configuration._isInput) {
+            _file = std::make_unique<MemoryMappedFile>(configuration._path);
+
+            ma_decoder_config config = ma_decoder_config_init(ma_format_s16, 1, SampleRate);
+            config.encodingFormat = ma_encoding_format_wav;
+
+            auto decoder = std::make_unique<ma_decoder>();
+
+            // A decoder that failed to initialise is not uninitialised, so it is only handed over once it has.
+            if (ma_decoder_init_memory(_file->GetData(), _file->GetSize(), &config, decoder.get()) != MA_SUCCESS) {
+                throw std::runtime_error("Could not read WAV file " + configuration._path);
+            }
+
+            _decoder.reset(decoder.release());
+        }
+        else if (!configuration._path.empty()) {
+            const ma_encoder_config config = ma_encoder_config_init(ma_encoding_format_wav, ma_format_s16, 1, SampleRate);
+            auto encoder = std::make_unique<ma_encoder>();
+
+            if (ma_encoder_init_file(configuration._path.c_str(), &config, encoder.get()) != MA_SUCCESS) {
+                throw std::runtime_error("Could not create WAV file " + configuration._path);
+            }
+
+            _encoder.reset(encoder.release());
+        }
+    }
+
+    VirtualAudioDevice::~VirtualAudioDevice() {
+        Stop();
+    }
+
+    void VirtualAudioDevice::Start() {
+        if (_thread.joinable()) {
+            return;
+        }
+
+        _isStopping = false;
+        _thread = std::thread(&VirtualAudioDevice::Run, this);
+    }
+
+    void VirtualAudioDevice::Stop() {
+        if (!_thread.joinable()) {
+            return;
+        }
+
+        _isStopping = true;
+        _thread.join();
+    }
+
+    bool VirtualAudioDevice::IsFinished() const {
+        return _isFinished;
+    }
+
+    void VirtualAudioDevice::Run() {
+        using Clock = std::chrono::steady_clock;
+
+        PipelineTrace::NameThread(_decoder ? "Virtual capture device" : "Virtual playback device");
+
+        const auto start = Clock::now();
+        std::vector<std::int16_t> samples(PeriodSampleCount);
+
+        for (std::uint64_t period = 1; !_isStopping; period++) {
+            // A period's samples are delivered at its end, as a real device's are.
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(Period * period));
+
+            if (_decoder) {
+                ReadFile(samples.data(), PeriodSampleCount);
+                _callback(samples.data(), PeriodSampleCount);
+            }
+            else {
+                _callback(samples.data(), PeriodSampleCount);
+
+                if (_encoder) {
+                    ma_encoder_write_pcm_frames(_encoder.get(), samples.data(), PeriodSampleCount, nullptr);
+                }
+            }
+        }
+    }
+
+    void VirtualAudioDevice::ReadFile(std::int16_t* samples, ma_uint32 sampleCount) {
+        ma_uint64 readCount = 0;
+        ma_decoder_read_pcm_frames(_decoder.get(), samples, sampleCount, &readCount);
+
+        while (readCount < sampleCount && _isLooping) {
+            ma_decoder_seek_to_pcm_frame(_decoder.get(), 0);
+
+            ma_uint64 remainingCount = 0;
+            ma_decoder_read_pcm_frames(_decoder.get(), samples + readCount, sampleCount - readCount, &remainingCount);
+
+            if (remainingCount == 0) {
+                break; // The file has no audio.
+            }
+
+            readCount += remainingCount;
+        }
+
+        if (readCount < sampleCount) {
+            std::fill(samples + readCount, samples + sampleCount, 0);
+            _isFinished = true;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "miniaudio/miniaudio.h"
+
+#include "memory_mapped_file.h"
+
+namespace Comms {
+
+    /*
+    * An audio device with no hardware behind it, so that calls can be benchmarked and tested on machines without a sound card.
+    * Listed and selected by name alongside the real devices. @see AudioInputOutput::AddVirtualDevice
+    *
+    * An input captures a WAV file, mapped into memory and converted to 48 kHz mono as it is read, whatever its own rate and
+    * channels. An output plays to a WAV file, or discards what it plays.
+    *
+    * A thread runs one 10 ms period at a time, handing the period's samples to the data callback as miniaudio does for a
+    * real device. Periods are timed from the start, so late wake-ups do not slow the device down. They run in real time, as
+    * the CallManager and the network a call runs over do. CallSimulation runs calls faster than real time, on a VirtualClock.
+    */
+    class VirtualAudioDevice {
+    public:
+        struct Configuration {
+            std::string _name; // The name the device is listed and selected by.
+            bool _isInput = true; // Whether the device captures from _path, rather than plays to it.
+            std::string _path; // The WAV file captured or played. An output without one discards what it plays.
+            bool _isLooping = false; // Whether an input starts its file again at the end, rather than capture silence.
+        };
+
+        /*
+        * Called once each period: with the samples captured by an input, or with samples to fill for an output to play.
+        */
+        using DataCallback = std::function<void(std::int16_t* samples, ma_uint32 sampleCount)>;
+
+        /*
+        * Constructor. Opens the device's file, if it has one.
+        *
+        * @param configuration The device.
+        * @param callback Called with each period's samples.
+        * @throws std::runtime_error If the file cannot be opened, or an input's file is not a WAV file.
+        */
+        VirtualAudioDevice(const Configuration& configuration, DataCallback callback);
+
+        /*
+        * Destructor. Stops the device, and finishes writing an output's file.
+        */
+        ~VirtualAudioDevice();
+
+        VirtualAudioDevice(const VirtualAudioDevice&) = delete;
+        VirtualAudioDevice& operator=(const VirtualAudioDevice&) = delete;
+
+        /*
+        * Starts running periods, if not already running.
+        */
+        void Start();
+
+        /*
+        * Stops running periods, if running. Start picks up from where the device stopped.
+        */
+        void Stop();
+
+        /*
+        * @return Whether an input has captured the end of its file. Never true when looping, or for an output.
+        */
+        bool IsFinished() const;
+
+    private:
+        /*
+        * Runs periods until stopped.
+        */
+        void Run();
+
+        /*
+        * Reads the next samples of an input's file, starting it again if looping and filling with silence once it ends.
+        */
+        void ReadFile(std::int16_t* samples, ma_uint32 sampleCount);
+
+        const bool _isLooping; // Whether an input starts its file again at the end.
+        const DataCallback _callback; // Called with each period's samples.
+
+        std::unique_ptr<MemoryMappedFile> _file; // An input's file. Decoded in place.
+        std::unique_ptr<ma_decoder, void(*)(ma_decoder*)> _decoder; // Decodes an input's file. Thread only, once started.
+        std::unique_ptr<ma_encoder, void(*)(ma_encoder*)> _encoder; // Writes an output's file. Thread only, once started.
+
+        std::atomic<bool> _isFinished = false; // Set when an input has captured the end of its file.
+        std::atomic<bool> _isStopping = false; // Set when the thread is stopping.
+        std::thread _thread; // Runs the periods.
+    };
+}
@@ -0,0 +1,35 @@
+#include "virtual_clock.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace Comms {
+    std::chrono::microseconds VirtualClock::Now() const {
+        return _now;
+    }
+
+    void VirtualClock::Schedule(std::chrono::microseconds time, Event event) {
+        _events.push({ std::max(time, _now), _nextOrder++, std::move(event) });
+    }
+
+    void VirtualClock::ScheduleRepeating(std::chrono::microseconds start, std::chrono::microseconds interval, Event event) {
+        // Each run hands the event on to the next, so it is never copied.
+        Schedule(start, [this, start, interval, event = std::move(event)]() mutable {
+            event();
+            ScheduleRepeating(start + interval, interval, std::move(event));
+        });
+    }
+
+    void VirtualClock::RunUntil(std::chrono::microseconds end) {
+        while (!_events.empty() && _events.top()._time <= end) {
+            // Moved out before it is popped and run, as running it may schedule events that reorder the queue.
+            auto event = std::move(const_cast<ScheduledEvent&>(_events.top())._event);
+            _now = _events.top()._time;
+            _events.pop();
+
+            event();
+        }
+
+        _now = std::max(_now, end);
+    }
+}
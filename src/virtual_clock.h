@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+namespace Comms {
+
+    /*
+    * A clock that only moves when told to, running events scheduled against it in time order. Stands in for the device
+    * callbacks, timers and network of a call, so that a simulation runs as fast as it can compute and does the same
+    * thing every run.
+    *
+    * Events due at the same time run in the order they were scheduled, so a run depends only on its inputs and never on
+    * how a priority queue breaks ties. Not thread safe: a simulation runs on one thread.
+    */
+    class VirtualClock {
+    public:
+        using Event = std::function<void()>;
+
+        /*
+        * @return The current virtual time, from 0 when the clock was created.
+        */
+        std::chrono::microseconds Now() const;
+
+        /*
+        * Schedules an event. An event scheduled in the past runs next, at the current time.
+        *
+        * @param time When the event runs.
+        * @param event The event, which may schedule further events.
+        */
+        void Schedule(std::chrono::microseconds time, Event event);
+
+        /*
+        * Schedules an event to run every interval, until the clock stops running.
+        *
+        * @param start When the event first runs.
+        * @param interval The time between runs.
+        * @param event The event.
+        */
+        void ScheduleRepeating(std::chrono::microseconds start, std::chrono::microseconds interval, Event event);
+
+        /*
+        * Runs every event due up to and including a time, then moves the clock to it.
+        *
+        * @param end The time to run until.
+        */
+        void RunUntil(std::chrono::microseconds end);
+
+    private:
+        /*
+        * An event waiting to run.
+        */
+        struct ScheduledEvent {
+            std::chrono::microseconds _time; // When the event runs.
+            std::uint64_t _order; // Orders events due at the same time by when they were scheduled.
+            Event _event; // The event.
+
+            bool operator>(const ScheduledEvent& other) const {
+                return _time != other._time ? _time > other._time : _order > other._order;
+            }
+        };
+
+        std::chrono::microseconds _now{ 0 }; // The current virtual time.
+        std::priority_queue<ScheduledEvent, std::vector<ScheduledEvent>, std::greater<ScheduledEvent>> _events; // Events waiting to run, soonest first.
+        std::uint64_t _nextOrder = 0; // The order of the next event scheduled.
+    };
+}
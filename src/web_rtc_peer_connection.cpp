@@ -1,30 +1,73 @@
 #include "web_rtc_peer_connection.h"
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
 
-#define CPPHTTPLIB_OPENSSL_SUPPORT
-#include "cpp-httplib/httplib.h"
-
-#include "json/json.hpp"
+#include "allocation_tracker.h"
+#include "http_signalling_client.h"
+#include "metrics.h"
+#include "packet_capture.h"
+#include "pipeline_trace.h"
 
 namespace {
-    const char* StunServerURL = "stun:stun.l.google.com:19302";
-    const char* SignallingServiceURL = "https://australia-southeast1-comms-link.cloudfunctions.net";
+    constexpr std::uint32_t AudioSSRC = 42;
+    constexpr std::uint8_t OpusPayloadType = 111;
+
+    constexpr int MinimumBitrate = 6000; // The lowest bitrate Opus encodes at.
+    constexpr int MaximumBitrate = 64000; // The bitrate offered in the session description.
+    constexpr double PacingFactor = 2.5; // The pacing bitrate as a multiple of the target, leaving room for bursts.
+    constexpr std::int64_t FeedbackInterval = 100000; // Microseconds between transport-cc feedback.
+    constexpr std::size_t MaximumPacketSize = 1500; // The largest audio packet, reserved up front so packetising never allocates.
+
+    // The RTP header and its extensions at 50 packets a second, which the target counts but the encoder does not.
+    constexpr int HeaderBitrate = 24 * 8 * 50;
+
+    /*
+    * @return The time in microseconds, on a clock shared by every connection.
+    */
+    std::int64_t GetMicroseconds() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 
-    constexpr std::chrono::minutes MaximumPollingDuration(30);
-}
+    /*
+    * @return The sequence number of an RTP packet.
+    */
+    std::uint16_t ReadSequenceNumber(const rtc::binary& packet) {
+        return static_cast<std::uint16_t>((std::to_integer<std::uint16_t>(packet[2]) << 8) | std::to_integer<std::uint16_t>(packet[3]));
+    }
+
+    /*
+    * @return The timestamp of an RTP packet.
+    */
+    std::uint32_t ReadTimestamp(const rtc::binary& packet) {
+        return (std::to_integer<std::uint32_t>(packet[4]) << 24) | (std::to_integer<std::uint32_t>(packet[5]) << 16) |
+            (std::to_integer<std::uint32_t>(packet[6]) << 8) | std::to_integer<std::uint32_t>(packet[7]);
+    }
 
-using json = nlohmann::json;
+    Comms::Counter& SentPacketsTotal = Comms::Metrics::AddCounter("comms_transport_packets_total", "Audio RTP packets sent and received.", "direction=\"sent\"");
+    Comms::Counter& ReceivedPacketsTotal = Comms::Metrics::AddCounter("comms_transport_packets_total", "Audio RTP packets sent and received.", "direction=\"received\"");
+    Comms::Counter& SentBytesTotal = Comms::Metrics::AddCounter("comms_transport_bytes_total", "Bytes of audio RTP sent and received, headers included.", "direction=\"sent\"");
+    Comms::Counter& ReceivedBytesTotal = Comms::Metrics::AddCounter("comms_transport_bytes_total", "Bytes of audio RTP sent and received, headers included.", "direction=\"received\"");
+    Comms::Counter& SentFeedbackTotal = Comms::Metrics::AddCounter("comms_transport_feedback_total", "Transport-cc feedback packets sent and received.", "direction=\"sent\"");
+    Comms::Counter& ReceivedFeedbackTotal = Comms::Metrics::AddCounter("comms_transport_feedback_total", "Transport-cc feedback packets sent and received.", "direction=\"received\"");
+
+    std::atomic<rtc::LogLevel> LogLevel = rtc::LogLevel::Debug; // The level libdatachannel logs at. @see SetLogLevel
+}
 
 namespace Comms {
-    WebRTCPeerConnection::WebRTCPeerConnection(std::string name, std::string password) :
+    WebRTCPeerConnection::WebRTCPeerConnection(std::string name, std::string password, std::shared_ptr<SignallingClient> signallingClient) :
         _rtcConfig(),
-        _localSDP(""),
+        _packetizer(AudioSSRC, OpusPayloadType, AudioLevelExtensionId, TransportSequenceExtensionId),
+        _signallingClient(signallingClient),
         _name(name),
-        _password(password) {
-        rtc::InitLogger(rtc::LogLevel::Debug);
+        _password(password),
+        _localSDP(""),
+        _congestionController(MinimumBitrate, MaximumBitrate),
+        _pacer([this](rtc::binary& packet) { SendPaced(packet); }, static_cast<int>(MaximumBitrate * PacingFactor)) {
+        rtc::InitLogger(LogLevel);
+        _packet.reserve(MaximumPacketSize);
 
-        _rtcConfig.iceServers.emplace_back(StunServerURL);
+        _signallingClient->ConfigureIce(_rtcConfig);
 
         _peerConnection = std::make_unique<rtc::PeerConnection>(_rtcConfig);
         _peerConnection->onGatheringStateChange([&](rtc::PeerConnection::GatheringState state) {
@@ -41,135 +84,263 @@ namespace Comms {
         });
 
         rtc::Description::Audio media("audio", rtc::Description::Direction::SendRecv);
-        media.addSSRC(42, "audio");
-        media.addOpusCodec(111);
-        media.setBitrate(64);
+        media.addSSRC(AudioSSRC, "audio");
+        media.addOpusCodec(OpusPayloadType);
+        media.rtpMap(OpusPayloadType)->addFeedback("transport-cc");
+        media.setBitrate(MaximumBitrate / 1000);
+        media.addExtMap(rtc::Description::Entry::ExtMap(AudioLevelExtensionId, AudioLevelExtensionURI)); // Lets an SFU rank speakers without decoding.
+        media.addExtMap(rtc::Description::Entry::ExtMap(TransportSequenceExtensionId, TransportSequenceExtensionURI));
 
         _mediaTrack = _peerConnection->addTrack(media);
+        _mediaTrack->setMediaHandler(std::make_shared<PacketCaptureHandler>()); // Records nothing until capture is enabled.
 
-        _mediaTrack->onMessage([](rtc::binary message) {
-            std::cout << message.size() << std::endl;
+        _mediaTrack->onMessage([this](rtc::binary message) {
+            ReceiveTransportMessage(message); // Audio is dropped until a handler is set. @see OnAudioData
         }, nullptr);
     }
 
+    WebRTCPeerConnection::WebRTCPeerConnection(std::string name, std::string password) :
+        WebRTCPeerConnection(name, password, std::make_shared<HttpSignallingClient>()) {
+    }
+
+    WebRTCPeerConnection::~WebRTCPeerConnection() {
+        _mediaTrack->resetCallbacks(); // Waits for a message being received, whose callback uses the connection.
+
+        if (auto handler = _mediaTrack->getMediaHandler()) {
+            handler->onOutgoing(nullptr); // Waits for a packet being sent by the handler.
+        }
+    }
+
     void WebRTCPeerConnection::Connect() {
-        auto existingOffer = RetrieveOffer();
+        if (_isClosed) {
+            return;
+        }
 
-        // No existing offer, publish a new one.
-        if (std::holds_alternative<std::monostate>(existingOffer)) { 
+        try {
+            auto existingOffer = _signallingClient->RetrieveOffer(_name, _password);
 
-            GenerateOfferSDP();
-            PublishSDP(SDPType::Offer);
+            // No existing offer, publish a new one.
+            if (std::holds_alternative<std::monostate>(existingOffer)) {
 
-            auto answer = RetrieveAnswer();
+                _signallingClient->OnRemoteCandidate([this](std::string candidate, std::string mid) {
+                    AddRemoteCandidate(rtc::Candidate(candidate, mid));
+                });
+                _signallingClient->PrepareForAnswer(_name, _password); // Overlaps any setup of the answer channel with ICE gathering.
 
-            if (answer.has_value()) {
-                AcceptRemoteSDP(*answer);
+                GenerateOfferSDP();
+
+                if (_isClosed) {
+                    return; // Closed while gathering, so there is no complete offer to publish.
+                }
+
+                _signallingClient->PublishSDP(_name, _password, SDPType::Offer, _localSDP);
+
+                auto answer = _signallingClient->RetrieveAnswer(_name);
+
+                if (answer.has_value() && !_isClosed) {
+                    AcceptRemoteSDP(*answer);
+                }
+            }
+            // Offer exists, accept and publish an answer.
+            else if (std::holds_alternative<std::string>(existingOffer)) {
+                _peerConnection->onLocalCandidate([this](rtc::Candidate candidate) {
+                    _signallingClient->SendLocalCandidate(_name, _password, std::string(candidate), candidate.mid());
+                });
+
+                AcceptRemoteSDP(std::get<std::string>(existingOffer));
+
+                if (!_isClosed) {
+                    _signallingClient->PublishSDP(_name, _password, SDPType::Answer, _localSDP);
+                }
+            }
+            // Incorrect password, close the connection.
+            else {
+                _peerConnection->close();
             }
         }
-        // Offer exists, accept and publish an answer.
-        else if (std::holds_alternative<std::string>(existingOffer)) {
-            AcceptRemoteSDP(std::get<std::string>(existingOffer));
-            PublishSDP(SDPType::Answer);
+        catch (const std::exception&) {
+            // Closing while connecting can make whichever step was running throw. Anything else is still an error.
+            if (!_isClosed) {
+                throw;
+            }
         }
-        // Incorrect password, close the connection.
-        else {
-            _peerConnection->close();
+    }
+
+    void WebRTCPeerConnection::Close() {
+        {
+            std::lock_guard<std::mutex> lock(_localSDPMutex);
+            _isClosed = true;
         }
+        _localSDPNotEmptyCondition.notify_all();
+
+        _signallingClient->Cancel();
+        _peerConnection->close();
     }
 
     rtc::PeerConnection::State WebRTCPeerConnection::GetConnectionState() {
         return _peerConnection->state();
     }
 
-    void WebRTCPeerConnection::SendAudioData(std::vector<std::byte> opusData) {
-        _mediaTrack->send(opusData.data(), sizeof(std::byte) * opusData.size());
+    std::uint16_t WebRTCPeerConnection::SendAudioData(const std::vector<std::byte>& opusData, AudioLevel level) {
+        TraceSpan span(TraceStage::Packetize, PipelineTrace::NoSequenceNumber, _traceId);
+        RealTimeScope scope("Audio thread"); // Packetising and handing the packet to the pacer never allocate.
+        _packetizer.Packetize(opusData, level, _packet);
+
+        const auto sequenceNumber = ReadSequenceNumber(_packet);
+        span.SetSequenceNumber(sequenceNumber);
+
+        _pacer.Send(_packet);
+
+        return sequenceNumber;
     }
 
-    void WebRTCPeerConnection::GenerateOfferSDP() {
-        _peerConnection->setLocalDescription();
+    void WebRTCPeerConnection::OnAudioData(std::function<void(const rtc::binary& packet)> callback) {
+        _mediaTrack->onMessage([this, callback](rtc::binary message) {
+            AllocationScope scope(AllocationTag::Transport);
 
-        WaitForLocalSDP(); // Waits for the complete Offer SDP including ICE candidates
+            if (!ReceiveTransportMessage(message)) {
+                TraceSpan span(TraceStage::Receive, message.size() >= 4 ? ReadSequenceNumber(message) : PipelineTrace::NoSequenceNumber, _traceId);
+                callback(message);
+            }
+        }, nullptr);
     }
 
-    void WebRTCPeerConnection::PublishSDP(const SDPType type) const {
-        const auto typeString = type == SDPType::Offer ? "offer" : "answer";
-        const auto pathName = type == SDPType::Offer ? "/connectionOffer" : "/connectionAnswer";
+    void WebRTCPeerConnection::SetMediaHandler(std::shared_ptr<rtc::MediaHandler> handler) {
+        _mediaTrack->setMediaHandler(std::make_shared<PacketCaptureHandler>(handler));
+    }
+
+    int WebRTCPeerConnection::GetTargetBitrate() const {
+        return std::max(_congestionController.GetTargetBitrate() - HeaderBitrate, MinimumBitrate);
+    }
 
-        json httpBody = {
-            {"connectionName", _name},
-            {"password", _password},
-            {typeString, _localSDP}
+    WebRTCPeerConnection::Stats WebRTCPeerConnection::GetStats() const {
+        const auto now = GetMicroseconds();
+
+        return {
+            _congestionController.GetRoundTripTime(),
+            _receivedStatistics.GetJitter(),
+            _congestionController.GetLossFraction(),
+            _sentStatistics.GetBitrate(now),
+            _receivedStatistics.GetBitrate(now),
+            GetTargetBitrate(),
+            _sentStatistics.GetPacketCount(),
+            _receivedStatistics.GetPacketCount()
         };
+    }
 
-        httplib::Client httpClient(SignallingServiceURL);
-        httpClient.Post(pathName, httpBody.dump(), "application/json");
+    std::uint32_t WebRTCPeerConnection::GetTraceId() const {
+        return _traceId;
     }
 
-    std::variant<std::monostate, bool, std::string> WebRTCPeerConnection::RetrieveOffer() const {
-        httplib::Client httpClient(SignallingServiceURL);
+    void WebRTCPeerConnection::SetLogLevel(rtc::LogLevel level) {
+        LogLevel = level;
+        rtc::InitLogger(level);
+    }
 
-        httplib::Params httpParams = {
-            {"connectionName", _name},
-            {"password",_password}
-        };
-        httplib::Headers httpHeaders{};
+    void WebRTCPeerConnection::SendPaced(rtc::binary& packet) {
+        TraceSpan span(TraceStage::Pace, ReadSequenceNumber(packet), _traceId);
+        const auto sequenceNumber = _transportSequenceNumber++;
+        _packetizer.SetTransportSequenceNumber(packet, sequenceNumber);
+
+        // Recorded before sending, so that feedback about the packet cannot arrive before it is known.
+        const auto now = GetMicroseconds();
+        _congestionController.OnPacketSent(sequenceNumber, packet.size(), now);
+        _mediaTrack->send(packet.data(), packet.size());
+        _sentStatistics.OnPacket(packet.size(), now);
+        SentPacketsTotal.Increment();
+        SentBytesTotal.Increment(packet.size());
+    }
+
+    bool WebRTCPeerConnection::ReceiveTransportMessage(const rtc::binary& message) {
+        const auto now = GetMicroseconds();
 
-        auto response = httpClient.Get("/getOffer", httpParams, httpHeaders);
+        if (rtc::IsRtcp(message)) {
+            const auto packets = ParseTransportFeedback(message.data(), message.size());
 
-        if (response->status == 200) {
-            return json::parse(response->body).value("data", "");
+            if (!packets.empty()) {
+                ReceivedFeedbackTotal.Increment();
+                _congestionController.OnTransportFeedback(packets, now);
+                _pacer.SetPacingBitrate(static_cast<int>(_congestionController.GetTargetBitrate() * PacingFactor));
+            }
+
+            return true;
         }
-        else if (response->status == 403) {
-            return false;
+
+        if (message.size() >= 12) {
+            _receivedStatistics.OnPacket(message.size(), now, ReadTimestamp(message));
+            ReceivedPacketsTotal.Increment();
+            ReceivedBytesTotal.Increment(message.size());
         }
 
-        return std::monostate();
-    }
+        const auto sequenceNumber = ReadTransportSequenceNumber(message.data(), message.size(), TransportSequenceExtensionId);
 
-    std::optional<std::string> WebRTCPeerConnection::RetrieveAnswer() const {
-        httplib::Client httpClient(SignallingServiceURL);
+        if (!sequenceNumber.has_value() || message.size() < 12) {
+            return false;
+        }
 
-        httplib::Params httpParams = {
-            {"connectionName", _name}
-        };
-        httplib::Headers httpHeaders{};
+        _remoteSsrc = (std::to_integer<std::uint32_t>(message[8]) << 24) | (std::to_integer<std::uint32_t>(message[9]) << 16) |
+            (std::to_integer<std::uint32_t>(message[10]) << 8) | std::to_integer<std::uint32_t>(message[11]);
+        _feedbackRecorder.OnPacket(*sequenceNumber, now);
 
-        std::chrono::seconds pollingDuration(std::chrono::seconds::zero());
-        std::chrono::seconds pollingInterval(1);
+        if (now - _lastFeedbackTime >= FeedbackInterval) {
+            SendFeedback(now);
+        }
 
-        do {
-            auto response = httpClient.Get("/getAnswer", httpParams, httpHeaders);
+        return false;
+    }
 
-            if (response->status == 200) {
-                return json::parse(response->body).value("data", "");
-            }
-            else if (response->status == 404) {
+    void WebRTCPeerConnection::SendFeedback(std::int64_t now) {
+        _lastFeedbackTime = now;
 
-                if (pollingDuration >= std::chrono::minutes(5)) {
-                    pollingInterval = std::chrono::seconds(30);
-                }
-                else if (pollingDuration >= std::chrono::seconds(30)) {
-                    pollingInterval = std::chrono::seconds(5);
-                }
+        if (auto packets = _feedbackRecorder.TakeFeedback()) {
+            const auto feedback = BuildTransportFeedback(AudioSSRC, _remoteSsrc, _feedbackCount, *packets);
 
-                pollingDuration += pollingInterval;
-                std::this_thread::sleep_for(pollingInterval);
+            try {
+                _mediaTrack->send(feedback.data(), feedback.size());
+                SentFeedbackTotal.Increment();
             }
-        } while (pollingDuration < MaximumPollingDuration);
+            catch (const std::exception&) {
+                // The track is not open, or closed as the feedback was sent.
+            }
+        }
+    }
 
-        return std::nullopt;
+    void WebRTCPeerConnection::GenerateOfferSDP() {
+        _peerConnection->setLocalDescription();
+
+        WaitForLocalSDP(); // Waits for the complete Offer SDP including ICE candidates
     }
 
     void WebRTCPeerConnection::AcceptRemoteSDP(std::string sdp) {
         rtc::Description remoteSDP(sdp);
         _peerConnection->setRemoteDescription(sdp);
 
+        {
+            std::lock_guard<std::mutex> lock(_remoteCandidatesMutex);
+            _hasRemoteSDP = true;
+
+            for (auto& candidate : _pendingRemoteCandidates) {
+                _peerConnection->addRemoteCandidate(candidate);
+            }
+            _pendingRemoteCandidates.clear();
+        }
+
         WaitForLocalSDP(); // Waits for the complete Answer SDP including ICE candidates
     }
 
+    void WebRTCPeerConnection::AddRemoteCandidate(rtc::Candidate candidate) {
+        std::lock_guard<std::mutex> lock(_remoteCandidatesMutex);
+
+        if (_hasRemoteSDP) {
+            _peerConnection->addRemoteCandidate(candidate);
+        }
+        else {
+            _pendingRemoteCandidates.push_back(candidate);
+        }
+    }
+
     void WebRTCPeerConnection::WaitForLocalSDP() {
         std::unique_lock<std::mutex> lock(_localSDPMutex);
-        _localSDPNotEmptyCondition.wait(lock, [this]() { return !_localSDP.empty(); });
+        _localSDPNotEmptyCondition.wait(lock, [this]() { return !_localSDP.empty() || _isClosed; });
     }
 }
@@ -1,94 +1,159 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <optional>
 #include <chrono>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
 
 #include "libdatachannel/rtc.hpp"
 
-namespace Comms {
+#include "audio_connection.h"
+#include "audio_level.h"
+#include "congestion_controller.h"
+#include "pacer.h"
+#include "pipeline_trace.h"
+#include "rtp_audio_packetizer.h"
+#include "signalling_client.h"
+#include "stream_statistics.h"
+#include "transport_feedback.h"
 
-    enum class SDPType {
-        Offer, // A peer's SDP is an offer if they are the first peer to initiate the call.
-        Answer // A peer's SDP is an aswer if they have accepted an offer.
-    };
+namespace Comms {
 
     /*
     * Represents a WebRTC peer connection for an audio call.
     * Offer and Answer methods are provided for creating a peer to peer connection between two clients.
     * The connection will use Media Transport and is assumed to be for audio only using the OPUS codec.
-    * The public google STUN server is used for IP address discovery.
     * Connections are identified by a user defined name and protected by a user defined password.
+    * Offers and answers are exchanged through a SignallingClient, which also determines the ICE servers used.
+    *
+    * Audio sent is paced, and its bitrate is adapted to the path by delay-based congestion control: each packet carries a
+    * transport-wide sequence number, the remote peer reports when each arrived in transport-cc feedback, and a
+    * CongestionController turns the reports into a target bitrate for the encoder. @see GetTargetBitrate
     * 
     * WebRTC functionality is provided by the libdatachannel library.
     */
-    class WebRTCPeerConnection {
+    class WebRTCPeerConnection : public AudioConnection {
     public:
         /*
         * Constructor
         * 
         * @param name An identifier for this connection.
         * @param password A password used to grant access to this connection.
+        * @param signallingClient The client used to exchange session descriptions with the remote peer.
+        */
+        WebRTCPeerConnection(std::string name, std::string password, std::shared_ptr<SignallingClient> signallingClient);
+
+        /*
+        * Constructor using the hosted signalling service. @see HttpSignallingClient
+        *
+        * @param name An identifier for this connection.
+        * @param password A password used to grant access to this connection.
         */
         WebRTCPeerConnection(std::string name, std::string password);
 
+        /*
+        * Destructor. Detaches the media handler, so that one still holding packets cannot send them on a closed track.
+        */
+        ~WebRTCPeerConnection() override;
+
         /*
         * Attemps to establish the WebRTC connection identified by the user defined name.
         * If no connection offer with this name has been made, this connection will make the offer and wait for a response.
         * If a connection offer has been made, this connection will attempt to accept the offer and establish the connection.
         * If an offer exists but the user defined password does not match the offer, this connection will be closed.
         */
-        void Connect();
+        void Connect() override;
+
+        /*
+        * Stops connecting and closes the connection. A Connect waiting for ICE gathering or the remote peer's answer returns
+        * promptly, and one not yet begun returns at once. Thread safe.
+        */
+        void Close() override;
 
         /*
         * @return The current state of the WebRTC peer connection
         */
-        rtc::PeerConnection::State GetConnectionState();
+        rtc::PeerConnection::State GetConnectionState() override;
 
-        void SendAudioData(std::vector<std::byte> opusData);
+        /*
+        * Sends an encoded frame of audio to the remote peer.
+        * The frame is wrapped in this connection's own RTP header, so one encoded frame can be sent to several peers.
+        *
+        * The packet is paced: it is handed to the pacer's thread without blocking or allocating, and sent from there after the
+        * call returns.
+        *
+        * @param opusData The Opus packet.
+        * @param level The level of the captured audio the packet was encoded from. @see MeasureAudioLevel
+        * @return The RTP sequence number the frame was sent with, so that it can be matched to the remote peer's reception.
+        */
+        std::uint16_t SendAudioData(const std::vector<std::byte>& opusData, AudioLevel level) override;
+
+        /*
+        * Sets the function called with each RTP packet of audio received from the remote peer, on a libdatachannel thread.
+        * Audio received before a function is set is dropped.
+        */
+        void OnAudioData(std::function<void(const rtc::binary& packet)> callback) override;
+
+        /*
+        * Sets a handler that every packet of the media track passes through, e.g. a NetworkImpairment.
+        * The handler's outgoing callback is cleared when the connection is destroyed. It sits behind the track's
+        * PacketCaptureHandler, so packets are captured as the connection sends them, before the handler changes them.
+        */
+        void SetMediaHandler(std::shared_ptr<rtc::MediaHandler> handler);
+
+        /*
+        * @return The bitrate audio should be encoded at for the path to the remote peer, in bits per second. The estimate of
+        *         what the path can carry, less the RTP headers.
+        */
+        int GetTargetBitrate() const override;
+
+        /*
+        * @return A snapshot of the connection's audio and its path, read without blocking the threads sending and receiving.
+        */
+        Stats GetStats() const override;
+
+        /*
+        * @return The id the connection's packets are tagged with in a PipelineTrace.
+        */
+        std::uint32_t GetTraceId() const override;
+
+        /*
+        * Sets how much libdatachannel logs, for every connection in the process. Debug by default.
+        */
+        static void SetLogLevel(rtc::LogLevel level);
 
     private:
         /*
-        * Generates a local offer session description string.
-        * This method should only be called on the peer instance initiating the connection.
+        * Sends a packet the pacer has released, stamping it with the next transport-wide sequence number.
         */
-        void GenerateOfferSDP();
+        void SendPaced(rtc::binary& packet);
 
-        /**
-        * Publishes the local offer/answer session description to the signalling service.
-        * The SDP is sent via a HTTP POST request.
-        * This will make the offer or answer available to peers.
+        /*
+        * Handles the congestion control of a message received on the media track: records the arrival of an RTP packet for
+        * feedback, sending feedback when it is due, or updates the target bitrate from RTCP feedback.
         *
-        * @param type The offer/answer type of the SDP being published.
+        * @return Whether the message was RTCP, and so not audio.
         */
-        void PublishSDP(const SDPType type) const;
+        bool ReceiveTransportMessage(const rtc::binary& message);
 
         /*
-        * Queries the signalling service to retrieve an offer SDP for a given connection identifier.
-        * The response from the service depends on whether an offer exists, and whether the correct password is provided.
-        *
-        * If an offer exists, and the password is correct, the offer is returned.
-        * If an offer exists, but the password is incorrect, the function returns false.
-        * If an offer does not exist the function returns a std::monostate representing no value.
+        * Sends transport-cc feedback for the packets that have arrived since it was last sent, if any.
+        * Only sent as a packet arrives, so that the newest packet reported was not held back and the remote peer's round
+        * trip time is not inflated. Packets before a gap in the audio received are reported with the first packet after it.
         *
-        * @return The offer SDP string, false if the password is incorrect, or std::monostate if there is no offer.
+        * @param now The time in microseconds.
         */
-        std::variant<std::monostate, bool, std::string> RetrieveOffer() const;
+        void SendFeedback(std::int64_t now);
 
         /*
-        * Queries the signalling service to retrieve an answer SDP for a given connection identifier.
-        * Peers expect to retrieve answers some amount of time following the publication of an offer.
-        * Therefore this function will continue to periodically poll the service for an answer.
-        *
-        * For the first 30 seconds of attempting connection, the service will be polled every second.
-        * The polling interval is then increased to 5 seconds until 5 minutes of polling has elapsed.
-        * Finally the polling interval is increased to 30 seconds until the maximum polling duration of 30 minutes has elapsed.
-        *
-        * @return The answer SDP if it was successfully retrieved.
+        * Generates a local offer session description string.
+        * This method should only be called on the peer instance initiating the connection.
         */
-        std::optional<std::string> RetrieveAnswer() const;
+        void GenerateOfferSDP();
 
         /*
         * Receives session description information from a peer.
@@ -100,21 +165,50 @@ namespace Comms {
         */
         void AcceptRemoteSDP(std::string remoteSDP);
 
+        /*
+        * Adds an ICE candidate trickled by the remote peer.
+        * Candidates that arrive before the remote SDP has been set are held until it is accepted.
+        *
+        * @param candidate The remote candidate.
+        */
+        void AddRemoteCandidate(rtc::Candidate candidate);
+
         /*
         * The local SDP is set asynchronously when ICE gathering is complete.
-        * This function waits for it to be updated to a non-empty string.
+        * This function waits for it to be updated to a non-empty string, or for the connection to be closed.
         */
         void WaitForLocalSDP();
 
         rtc::Configuration _rtcConfig; // Configuration for the WebRTC connection.
         std::unique_ptr<rtc::PeerConnection> _peerConnection; // The WebRTC peer connection.
         std::shared_ptr<rtc::Track> _mediaTrack = nullptr; // The media track used to send and recieve media data across the connection.
+        RtpAudioPacketizer _packetizer; // Wraps encoded audio in RTP packets for the media track.
+        rtc::binary _packet; // The packet being packetised, reused for every frame. Audio thread only.
+        std::shared_ptr<SignallingClient> _signallingClient; // Exchanges session descriptions with the remote peer.
         
         const std::string _name; // The name used to identify a connection.
         const std::string _password; // The password used to grant access to the connection.
+        const std::uint32_t _traceId = PipelineTrace::NewConnectionId(); // Tags the connection's packets in a PipelineTrace.
 
         std::string _localSDP; // The local offer or answer session description information to send to a peer.
         std::mutex _localSDPMutex; // Mutex to control read and write access to _localSDP.
-        std::condition_variable _localSDPNotEmptyCondition; // Condition used to evaluate if _localSDP has been updated to a non-empty string.
+        std::condition_variable _localSDPNotEmptyCondition; // Condition used to evaluate if _localSDP has been updated to a non-empty string, or the connection closed.
+        std::atomic<bool> _isClosed = false; // Set by Close, under _localSDPMutex.
+
+        std::vector<rtc::Candidate> _pendingRemoteCandidates; // Remote candidates received before the remote SDP was set.
+        bool _hasRemoteSDP = false; // Whether the remote SDP has been set on the peer connection.
+        std::mutex _remoteCandidatesMutex; // Mutex to control access to _pendingRemoteCandidates and _hasRemoteSDP.
+
+        CongestionController _congestionController; // Estimates the bitrate the path can carry from the remote peer's feedback.
+        TransportFeedbackRecorder _feedbackRecorder; // Records the arrival of the remote peer's packets, for feedback.
+        std::uint16_t _transportSequenceNumber = 0; // The transport-wide sequence number of the next packet sent. Pacer only.
+        std::int64_t _lastFeedbackTime = 0; // When feedback was last sent, in microseconds. Receiving thread only.
+        std::uint32_t _remoteSsrc = 0; // The SSRC of the audio received, which feedback reports on. Receiving thread only.
+        std::uint8_t _feedbackCount = 0; // The count of the next feedback message. Receiving thread only.
+        StreamStatistics _sentStatistics; // The audio packets sent. Written by the pacer.
+        StreamStatistics _receivedStatistics; // The audio packets received. Written by the media track's receiving thread.
+
+        // Declared last, so its thread, the connection's only one, stops before anything it sends with is destroyed.
+        Pacer _pacer; // Spaces the packets sent.
     };
 }
@@ -0,0 +1,123 @@
+#include "web_socket_signalling_client.h"
+
+namespace {
+
+    constexpr std::chrono::seconds SignallingSocketOpenTimeout(5);
+    constexpr std::chrono::minutes MaximumAnswerWait(30);
+}
+
+namespace Comms {
+    WebSocketSignallingClient::WebSocketSignallingClient(std::string serviceURL, std::string socketURL) :
+        HttpSignallingClient(serviceURL),
+        _socketURL(socketURL) {
+    }
+
+    WebSocketSignallingClient::WebSocketSignallingClient() :
+        WebSocketSignallingClient(DefaultServiceURL, DefaultSocketURL) {
+    }
+
+    void WebSocketSignallingClient::PrepareForAnswer([[maybe_unused]] const std::string& connectionName, const std::string& password) {
+        std::lock_guard<std::mutex> lock(_socketMutex);
+        _password = password;
+
+        if (IsCancelled()) {
+            return;
+        }
+
+        _signallingSocket = std::make_unique<SignallingSocket>(_socketURL);
+
+        if (_candidateCallback) {
+            _signallingSocket->OnCandidate(_candidateCallback);
+        }
+    }
+
+    std::optional<std::string> WebSocketSignallingClient::RetrieveAnswer(const std::string& connectionName) {
+        const auto deadline = std::chrono::steady_clock::now() + MaximumAnswerWait; // Bounds the socket and polling together.
+
+        if (_signallingSocket != nullptr && _signallingSocket->WaitForOpen(SignallingSocketOpenTimeout)) {
+            _signallingSocket->Subscribe(connectionName, _password);
+
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            auto answer = _signallingSocket->WaitForAnswer(remaining);
+
+            if (answer.has_value()) {
+                return answer;
+            }
+        }
+
+        return PollForAnswer(connectionName, deadline); // The socket is unavailable or was closed before an answer arrived.
+    }
+
+    void WebSocketSignallingClient::OnRemoteCandidate(std::function<void(std::string candidate, std::string mid)> callback) {
+        std::lock_guard<std::mutex> lock(_socketMutex);
+        _candidateCallback = callback;
+
+        if (_signallingSocket != nullptr) {
+            _signallingSocket->OnCandidate(_candidateCallback);
+        }
+    }
+
+    void WebSocketSignallingClient::SendLocalCandidate(const std::string& connectionName, const std::string& password, const std::string& candidate, const std::string& mid) {
+        std::lock_guard<std::mutex> lock(_socketMutex);
+
+        if (IsCancelled()) {
+            return;
+        }
+
+        if (_signallingSocket == nullptr) {
+            _signallingSocket = std::make_unique<SignallingSocket>(_socketURL);
+            _signallingSocket->Subscribe(connectionName, password); // The service only relays candidates from a subscribed socket.
+        }
+
+        _signallingSocket->SendCandidate(candidate, mid);
+    }
+
+    RoomJoinResult WebSocketSignallingClient::JoinRoom(const std::string& roomName, const std::string& password, const std::string& token, MembersHandler onMembers) {
+        {
+            std::lock_guard<std::mutex> lock(_socketMutex);
+
+            if (IsCancelled()) {
+                return RoomJoinResult::Unsupported;
+            }
+
+            // Replaces the socket of a room left or lost before.
+            _roomSocket = std::make_unique<SignallingSocket>(_socketURL);
+            _roomSocket->OnMembers(onMembers);
+            _roomSocket->JoinRoom(roomName, password, token); // Sent once the socket opens.
+        }
+
+        // Waited for without the lock, so that Cancel can close the socket.
+        const auto result = _roomSocket->WaitForJoin(SignallingSocketOpenTimeout);
+
+        if (result != RoomJoinResult::Joined) {
+            LeaveRoom();
+        }
+
+        return result;
+    }
+
+    void WebSocketSignallingClient::LeaveRoom() {
+        std::lock_guard<std::mutex> lock(_socketMutex);
+
+        if (_roomSocket != nullptr) {
+            _roomSocket->OnMembers(nullptr);
+            _roomSocket->LeaveRoom();
+            _roomSocket->Close(); // The service also drops a member whose socket closes.
+        }
+    }
+
+    void WebSocketSignallingClient::Cancel() {
+        HttpSignallingClient::Cancel();
+
+        std::lock_guard<std::mutex> lock(_socketMutex);
+
+        if (_signallingSocket != nullptr) {
+            _signallingSocket->Close();
+        }
+
+        if (_roomSocket != nullptr) {
+            _roomSocket->OnMembers(nullptr);
+            _roomSocket->Close();
+        }
+    }
+}
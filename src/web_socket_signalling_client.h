@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "http_signalling_client.h"
+#include "signalling_socket.h"
+
+namespace Comms {
+
+    /*
+    * Signalling that receives the answer, and trickles ICE candidates, over a WebSocket push channel.
+    * Offers and answers are still published, and offers retrieved, over the HTTP API, so both URLs must be of the same
+    * service, such as a CommsSignallingServer. @see SignallingServer
+    *
+    * The answering peer opens the channel with its first local candidate and trickles each one as it is gathered. The
+    * answer still carries every candidate, so one trickled before the offering peer subscribed is not missed.
+    * If the socket cannot be opened, or closes before an answer arrives, the HTTP API is polled instead, for what remains
+    * of the 30 minutes an answer is waited for.
+    *
+    * A room is joined over a socket of its own, kept open while the client is a member. If it cannot be opened the join
+    * is Unsupported, so peers fall back to meeting over the HTTP API.
+    * @see SignallingSocket
+    */
+    class WebSocketSignallingClient : public HttpSignallingClient {
+    public:
+        static constexpr const char* DefaultServiceURL = "http://localhost:8000"; // CommsSignallingServer's default HTTP API.
+        static constexpr const char* DefaultSocketURL = "ws://localhost:8001"; // CommsSignallingServer's default push channel.
+
+        /*
+        * Constructor.
+        *
+        * @param serviceURL The base URL of the signalling service's HTTP API.
+        * @param socketURL The WebSocket URL of the signalling service's push channel.
+        */
+        WebSocketSignallingClient(std::string serviceURL, std::string socketURL);
+
+        /*
+        * Constructor using a CommsSignallingServer on this machine, listening on its default ports.
+        */
+        WebSocketSignallingClient();
+
+        /*
+        * Opens the push channel so that the WebSocket handshake overlaps with ICE gathering.
+        */
+        void PrepareForAnswer(const std::string& connectionName, const std::string& password) override;
+
+        std::optional<std::string> RetrieveAnswer(const std::string& connectionName) override;
+
+        void OnRemoteCandidate(std::function<void(std::string candidate, std::string mid)> callback) override;
+
+        /*
+        * Opens and subscribes the push channel on the first candidate. Candidates are queued until the channel opens.
+        */
+        void SendLocalCandidate(const std::string& connectionName, const std::string& password, const std::string& candidate, const std::string& mid) override;
+
+        /*
+        * Opens a socket and joins a room over it, waiting up to 5 seconds for the service to answer.
+        */
+        RoomJoinResult JoinRoom(const std::string& roomName, const std::string& password, const std::string& token, MembersHandler onMembers) override;
+
+        /*
+        * Leaves the room and closes its socket.
+        */
+        void LeaveRoom() override;
+
+        /*
+        * Stops polling and closes the push channel and any room's socket, so that a wait on either returns.
+        */
+        void Cancel() override;
+
+    private:
+        const std::string _socketURL; // The WebSocket URL of the signalling service.
+        std::unique_ptr<SignallingSocket> _signallingSocket = nullptr; // Push channel, opened by PrepareForAnswer or the first local candidate. Only read without _socketMutex by the connecting thread.
+        std::unique_ptr<SignallingSocket> _roomSocket = nullptr; // The socket a room is joined over, opened by JoinRoom. Only read without _socketMutex by the joining thread.
+        std::mutex _socketMutex; // Mutex to control the opening of _signallingSocket and _roomSocket, their closing, and _candidateCallback.
+        std::function<void(std::string, std::string)> _candidateCallback; // Called when a remote candidate is pushed. Requires _socketMutex.
+        std::string _password; // The password the push channel subscribes with, set by PrepareForAnswer.
+    };
+}